@@ -0,0 +1,88 @@
+# Unit tests for the engines' pure logic, as a console program that only
+# needs the core and audio basics modules. Kept apart from the Makefile,
+# which the Projucer rewrites.
+#
+#   make -f Tests.mk            builds build/BAMidiTesterTests
+#   make -f Tests.mk check      builds and runs it
+#
+# build with "V=1" for verbose builds, and JUCE_MODULES=<path> if JUCE lives
+# somewhere else
+
+ifeq ($(V), 1)
+V_AT =
+else
+V_AT = @
+endif
+
+ifndef CONFIG
+  CONFIG=Debug
+endif
+
+JUCE_MODULES ?= /home/blackaddr/Apps/JUCE/modules
+
+JUCE_OUTDIR := build
+JUCE_OBJDIR := build/intermediate/Tests$(CONFIG)
+JUCE_TARGET_TESTS := BAMidiTesterTests
+
+ifeq ($(CONFIG),Debug)
+  JUCE_CONFIGFLAGS := "-DDEBUG=1" "-D_DEBUG=1" -g -ggdb -O0
+else
+  JUCE_CONFIGFLAGS := "-DNDEBUG=1" -O3
+endif
+
+JUCE_CPPFLAGS := -MMD "-DLINUX=1" "-DJUCE_APP_VERSION=1.1.0" "-DJUCE_APP_VERSION_HEX=0x10100" -pthread -I../../JuceLibraryCode -I$(JUCE_MODULES) $(CPPFLAGS)
+JUCE_CXXFLAGS := $(JUCE_CPPFLAGS) $(TARGET_ARCH) $(JUCE_CONFIGFLAGS) -std=c++11 $(CFLAGS) $(CXXFLAGS)
+JUCE_LDFLAGS := $(TARGET_ARCH) -lrt -ldl -lpthread $(LDFLAGS)
+
+SOURCES_TESTS := \
+  ../../Tests/RunTests.cpp \
+  ../../Tests/ControllerEncoderTests.cpp \
+  ../../Tests/SysExCodecTests.cpp \
+  ../../Tests/UmpConverterTests.cpp \
+  ../../Tests/CaptureFileTests.cpp \
+  ../../Tests/MidiFileTests.cpp \
+  ../../Tests/MidiOutputSchedulerTests.cpp \
+  ../../Tests/MpeZoneTests.cpp \
+  ../../Tests/VirtualClockTests.cpp \
+  ../../Source/ControllerEncoder.cpp \
+  ../../Source/SysExCodec.cpp \
+  ../../Source/UmpConverter.cpp \
+  ../../Source/CaptureFile.cpp \
+  ../../Source/MidiFileWriter.cpp \
+  ../../Source/MidiFileReader.cpp \
+  ../../Source/MidiOutputScheduler.cpp \
+  ../../Source/VirtualClock.cpp \
+  ../../Source/AllocationAudit.cpp \
+  ../../Source/MpeZone.cpp \
+  ../../JuceLibraryCode/include_juce_core.cpp \
+  ../../JuceLibraryCode/include_juce_events.cpp \
+  ../../JuceLibraryCode/include_juce_data_structures.cpp \
+  ../../JuceLibraryCode/include_juce_audio_basics.cpp \
+
+OBJECTS_TESTS := $(addprefix $(JUCE_OBJDIR)/,$(notdir $(SOURCES_TESTS:.cpp=.o)))
+
+vpath %.cpp ../../Tests ../../Source ../../JuceLibraryCode
+
+.PHONY: all check clean
+
+all : $(JUCE_OUTDIR)/$(JUCE_TARGET_TESTS)
+
+check : $(JUCE_OUTDIR)/$(JUCE_TARGET_TESTS)
+	@echo Running "BAMidiTester - Tests"
+	$(V_AT)./$(JUCE_OUTDIR)/$(JUCE_TARGET_TESTS)
+
+$(JUCE_OUTDIR)/$(JUCE_TARGET_TESTS) : $(OBJECTS_TESTS)
+	@echo Linking "BAMidiTester - Tests"
+	-$(V_AT)mkdir -p $(JUCE_OUTDIR)
+	$(V_AT)$(CXX) -o $(JUCE_OUTDIR)/$(JUCE_TARGET_TESTS) $(OBJECTS_TESTS) $(JUCE_LDFLAGS)
+
+$(JUCE_OBJDIR)/%.o : %.cpp
+	-$(V_AT)mkdir -p $(JUCE_OBJDIR)
+	@echo "Compiling $(<F)"
+	$(V_AT)$(CXX) $(JUCE_CXXFLAGS) -o "$@" -c "$<"
+
+clean:
+	@echo Cleaning "BAMidiTester - Tests"
+	$(V_AT)rm -rf $(JUCE_OUTDIR)/$(JUCE_TARGET_TESTS) $(JUCE_OBJDIR)
+
+-include $(OBJECTS_TESTS:%.o=%.d)
@@ -0,0 +1,279 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#include "AllocationAudit.h"
+
+#include <cstdlib>
+#include <new>
+
+// glibc lets the program replace malloc, which catches HeapBlock, Array and
+// MidiMessage storage too. Elsewhere only operator new can be counted.
+#if BA_ALLOCATION_AUDIT && defined (__GLIBC__)
+ #define BA_ALLOCATION_AUDIT_MALLOC 1
+#else
+ #define BA_ALLOCATION_AUDIT_MALLOC 0
+#endif
+
+namespace AllocationAudit
+{
+
+#if BA_ALLOCATION_AUDIT
+
+//==============================================================================
+// Touched from operator new, so these must be trivially initialised.
+static thread_local int64 threadAllocationCount = 0;
+static thread_local int sectionDepth = 0;
+static thread_local int ignoreDepth = 0;
+static thread_local int threadSlot = -1;
+
+struct ThreadRecord
+{
+    std::atomic<bool> used { false };
+    char name[64];
+    std::atomic<int64> sections[numPaths];
+    std::atomic<int64> allocations[numPaths];
+    std::atomic<int64> failedSections[numPaths];
+};
+
+enum { maxThreads = 64 };
+static ThreadRecord threadRecords[maxThreads];
+static std::atomic<int> numThreadRecords { 0 };
+static std::atomic<int64> totalFailures { 0 };
+
+static inline void countAllocation() noexcept
+{
+    if (sectionDepth > 0 && ignoreDepth == 0)
+        ++threadAllocationCount;
+}
+
+/*  Claims a record the first time a thread enters a section. Naming it can
+    allocate, so that happens outside of any counted section.
+*/
+static ThreadRecord* getThreadRecord() noexcept
+{
+    if (threadSlot < 0)
+    {
+        auto slot = numThreadRecords.fetch_add (1);
+
+        if (slot >= maxThreads)
+        {
+            numThreadRecords = maxThreads;
+            return nullptr;
+        }
+
+        auto& r = threadRecords[slot];
+        String name;
+
+        if (auto* t = Thread::getCurrentThread())
+            name = t->getThreadName();
+        else if (MessageManager::existsAndIsCurrentThread())
+            name = "Message thread";
+        else
+            name = "Thread " + String::toHexString ((int) (pointer_sized_int) Thread::getCurrentThreadId());
+
+        name.copyToUTF8 (r.name, sizeof (r.name));
+
+        for (int i = 0; i < numPaths; ++i)
+        {
+            r.sections[i] = 0;
+            r.allocations[i] = 0;
+            r.failedSections[i] = 0;
+        }
+
+        r.used = true;
+        threadSlot = slot;
+    }
+
+    return &threadRecords[threadSlot];
+}
+
+//==============================================================================
+ScopedSection::ScopedSection (Path p) noexcept
+    : path (p)
+{
+    if (threadSlot < 0 && sectionDepth == 0)
+        getThreadRecord();
+
+    ++sectionDepth;
+    startCount = threadAllocationCount;
+}
+
+ScopedSection::~ScopedSection() noexcept
+{
+    auto numAllocations = threadAllocationCount - startCount;
+    --sectionDepth;
+
+    if (auto* r = threadSlot >= 0 ? &threadRecords[threadSlot] : nullptr)
+    {
+        ++r->sections[path];
+
+        if (numAllocations > 0)
+        {
+            r->allocations[path] += numAllocations;
+            ++r->failedSections[path];
+        }
+    }
+
+    if (numAllocations > 0)
+    {
+        ++totalFailures;
+
+        // Something on the MIDI hot path hit the heap.
+        jassertfalse;
+    }
+}
+
+ScopedIgnore::ScopedIgnore() noexcept    { ++ignoreDepth; }
+ScopedIgnore::~ScopedIgnore() noexcept   { --ignoreDepth; }
+
+bool isEnabled() noexcept                { return true; }
+int64 getTotalFailures() noexcept        { return totalFailures.load(); }
+
+Array<ThreadCounts> getThreadCounts()
+{
+    Array<ThreadCounts> result;
+    auto numRecords = jmin ((int) maxThreads, numThreadRecords.load());
+
+    for (int i = 0; i < numRecords; ++i)
+    {
+        auto& r = threadRecords[i];
+
+        if (! r.used)
+            continue;
+
+        ThreadCounts c;
+        c.threadName = String (CharPointer_UTF8 (r.name));
+
+        for (int p = 0; p < numPaths; ++p)
+        {
+            c.sections[p] = r.sections[p].load();
+            c.allocations[p] = r.allocations[p].load();
+            c.failedSections[p] = r.failedSections[p].load();
+        }
+
+        result.add (c);
+    }
+
+    return result;
+}
+
+#else
+
+//==============================================================================
+ScopedSection::ScopedSection (Path p) noexcept : path (p), startCount (0) {}
+ScopedSection::~ScopedSection() noexcept {}
+ScopedIgnore::ScopedIgnore() noexcept {}
+ScopedIgnore::~ScopedIgnore() noexcept {}
+
+bool isEnabled() noexcept                { return false; }
+int64 getTotalFailures() noexcept        { return 0; }
+Array<ThreadCounts> getThreadCounts()    { return {}; }
+
+#endif
+
+String getPathName (Path path)
+{
+    return path == sendPath ? "send" : "receive";
+}
+
+} // namespace AllocationAudit
+
+#if BA_ALLOCATION_AUDIT_MALLOC
+
+//==============================================================================
+extern "C"
+{
+    void* __libc_malloc (std::size_t);
+    void* __libc_calloc (std::size_t, std::size_t);
+    void* __libc_realloc (void*, std::size_t);
+
+    void* malloc (std::size_t size) noexcept
+    {
+        AllocationAudit::countAllocation();
+        return __libc_malloc (size);
+    }
+
+    void* calloc (std::size_t num, std::size_t size) noexcept
+    {
+        AllocationAudit::countAllocation();
+        return __libc_calloc (num, size);
+    }
+
+    // shrinking to nothing is a free
+    void* realloc (void* p, std::size_t size) noexcept
+    {
+        if (size > 0)
+            AllocationAudit::countAllocation();
+
+        return __libc_realloc (p, size);
+    }
+}
+
+#endif
+
+#if BA_ALLOCATION_AUDIT
+
+//==============================================================================
+// When malloc is counted, the malloc underneath operator new counts it.
+void* operator new (std::size_t size)
+{
+   #if ! BA_ALLOCATION_AUDIT_MALLOC
+    AllocationAudit::countAllocation();
+   #endif
+
+    if (auto* p = std::malloc (size == 0 ? 1 : size))
+        return p;
+
+    throw std::bad_alloc();
+}
+
+void* operator new[] (std::size_t size)
+{
+    return operator new (size);
+}
+
+void* operator new (std::size_t size, const std::nothrow_t&) noexcept
+{
+   #if ! BA_ALLOCATION_AUDIT_MALLOC
+    AllocationAudit::countAllocation();
+   #endif
+
+    return std::malloc (size == 0 ? 1 : size);
+}
+
+void* operator new[] (std::size_t size, const std::nothrow_t& tag) noexcept
+{
+    return operator new (size, tag);
+}
+
+void operator delete (void* p) noexcept                             { std::free (p); }
+void operator delete[] (void* p) noexcept                           { std::free (p); }
+void operator delete (void* p, std::size_t) noexcept                { std::free (p); }
+void operator delete[] (void* p, std::size_t) noexcept              { std::free (p); }
+void operator delete (void* p, const std::nothrow_t&) noexcept      { std::free (p); }
+void operator delete[] (void* p, const std::nothrow_t&) noexcept    { std::free (p); }
+
+#endif
@@ -0,0 +1,97 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+
+/*  Replaces the global operator new, and on glibc malloc, calloc and realloc
+    as well, so that heap allocations made inside the MIDI send and receive
+    paths can be counted per thread. Without glibc only operator new is
+    seen, which misses JUCE's HeapBlock, Array and MidiBuffer growth and
+    large MidiMessage data. Aligned allocations are never counted.
+
+    Off unless the build defines BA_ALLOCATION_AUDIT=1, since it changes
+    every allocation the app makes.
+*/
+#ifndef BA_ALLOCATION_AUDIT
+ #define BA_ALLOCATION_AUDIT 0
+#endif
+
+//==============================================================================
+namespace AllocationAudit
+{
+    enum Path
+    {
+        sendPath = 0,
+        receivePath,
+        numPaths
+    };
+
+    struct ThreadCounts
+    {
+        String threadName;
+        int64 sections[numPaths];
+        int64 allocations[numPaths];
+        int64 failedSections[numPaths];
+    };
+
+    /** Marks a stretch of code that must not allocate. If it does, the
+        section is recorded as failed and a debug build asserts.
+    */
+    class ScopedSection
+    {
+    public:
+        explicit ScopedSection (Path path) noexcept;
+        ~ScopedSection() noexcept;
+
+    private:
+        Path path;
+        int64 startCount;
+        JUCE_DECLARE_NON_COPYABLE (ScopedSection)
+    };
+
+    /** Allocations inside this are not counted, e.g. calls into the
+        platform MIDI API, or SysEx segments that are allowed to allocate.
+    */
+    class ScopedIgnore
+    {
+    public:
+        ScopedIgnore() noexcept;
+        ~ScopedIgnore() noexcept;
+        JUCE_DECLARE_NON_COPYABLE (ScopedIgnore)
+    };
+
+    bool isEnabled() noexcept;
+
+    /** Total failed sections across all threads, cheap enough to poll. */
+    int64 getTotalFailures() noexcept;
+
+    /** Per-thread counters for every thread that has entered a section. */
+    Array<ThreadCounts> getThreadCounts();
+
+    String getPathName (Path path);
+}
@@ -0,0 +1,375 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#include "AutomationGenerator.h"
+#include "AllocationAudit.h"
+#include "RealtimeThreads.h"
+
+//==============================================================================
+AutomationGenerator::AutomationGenerator (MidiOutputScheduler& s)
+    : Thread ("MIDI automation"), scheduler (s)
+{
+    for (auto& v : lastValues)
+        v = 0;
+}
+
+AutomationGenerator::~AutomationGenerator()
+{
+    stop();
+}
+
+StringArray AutomationGenerator::getShapeNames()
+{
+    return { "Off", "Ramp", "Sine", "Triangle", "Random", "Steps" };
+}
+
+void AutomationGenerator::setLane (int lane, const Lane& settings)
+{
+    jassert (isPositiveAndBelow (lane, (int) numLanes));
+    auto wasActive = isLaneActive (lane);
+
+    {
+        const SpinLock::ScopedLockType sl (settingsLock);
+        lanes[lane] = settings;
+    }
+
+    if (wasActive && settings.shape == off && onLaneReleased != nullptr)
+        onLaneReleased (lane);
+}
+
+AutomationGenerator::Lane AutomationGenerator::getLane (int lane) const
+{
+    const SpinLock::ScopedLockType sl (settingsLock);
+    return lanes[lane];
+}
+
+void AutomationGenerator::setEncoder (int lane, const ControllerEncoder& encoder)
+{
+    const SpinLock::ScopedLockType sl (settingsLock);
+    encoders[lane] = encoder;
+    encoders[lane].reset();
+    encoderChanged[lane] = true;
+}
+
+void AutomationGenerator::setChannel (int newChannel)
+{
+    const SpinLock::ScopedLockType sl (settingsLock);
+    channel = newChannel;
+}
+
+//==============================================================================
+void AutomationGenerator::start (double tickRateHz, int64 randomSeed)
+{
+    stop();
+
+    tickRate = jlimit (1.0, 1000.0, tickRateHz);
+    seed = randomSeed;
+    rng.setSeed (seed);
+
+    {
+        const SpinLock::ScopedLockType sl (settingsLock);
+
+        for (int i = 0; i < numLanes; ++i)
+        {
+            lastRandomCycle[i] = -1;
+            randomValue[i] = 0.0;
+            activeEncoders[i] = encoders[i];
+            activeEncoders[i].reset();
+            encoderChanged[i] = false;
+        }
+    }
+
+    nrpnState.reset();
+    ticks = 0;
+    lateTicks = 0;
+    maxLatenessMs = 0.0;
+
+    scheduler.getClock().threadStarting (*this);
+    startThread (9);
+}
+
+void AutomationGenerator::stop()
+{
+    if (! isThreadRunning())
+        return;
+
+    stopThread (1000);
+
+    if (onLaneReleased != nullptr)
+        for (int i = 0; i < numLanes; ++i)
+            if (getLane (i).shape != off)
+                onLaneReleased (i);
+}
+
+AutomationGenerator::Stats AutomationGenerator::getStats() const
+{
+    Stats s;
+    s.ticks = ticks.load();
+    s.lateTicks = lateTicks.load();
+    s.maxLatenessMs = maxLatenessMs.load();
+    return s;
+}
+
+//==============================================================================
+void AutomationGenerator::run()
+{
+    auto& clock = scheduler.getClock();
+    const VirtualClock::ScopedThread participant (clock, *this);
+    auto periodMs = 1000.0 / tickRate;
+    auto startMs = clock.now();
+    int64 tickIndex = 0;
+
+    while (! threadShouldExit())
+    {
+        RealtimeThreads::applyToCurrentThread (RealtimeThreads::timingThread);
+
+        // every tick is placed relative to the start, so errors never accumulate
+        auto dueMs = startMs + (double) tickIndex * periodMs;
+
+        // sleeps to within the clock's own spin window, then spins
+        clock.waitPrecisely (*this, dueMs);
+
+        if (threadShouldExit())
+            break;
+
+        auto lateness = clock.now() - dueMs;
+
+        if (lateness > maxLatenessMs.load())
+            maxLatenessMs = lateness;
+
+        if (lateness > periodMs)
+        {
+            // skip the ticks we missed rather than bursting to catch up
+            auto missed = (int64) (lateness / periodMs);
+            lateTicks += missed;
+            tickIndex += missed;
+        }
+
+        tick ((double) tickIndex * periodMs * 0.001);
+        ++tickIndex;
+        ++ticks;
+    }
+}
+
+void AutomationGenerator::tick (double seconds)
+{
+    const AllocationAudit::ScopedSection audit (AllocationAudit::sendPath);
+    auto timeStamp = scheduler.getClock().now() * 0.001;
+    Lane current[numLanes];
+    int currentChannel;
+
+    {
+        // only copies under the spin lock; sending takes the scheduler's lock
+        const SpinLock::ScopedLockType sl (settingsLock);
+
+        for (int i = 0; i < numLanes; ++i)
+        {
+            current[i] = lanes[i];
+
+            if (encoderChanged[i])
+            {
+                activeEncoders[i] = encoders[i];
+                encoderChanged[i] = false;
+            }
+        }
+
+        currentChannel = channel;
+    }
+
+    if (nrpnInvalidated.exchange (false))
+        nrpnState.reset();
+
+    for (int i = 0; i < numLanes; ++i)
+    {
+        auto& lane = current[i];
+
+        if (lane.shape == off)
+            continue;
+
+        auto cycles = seconds / jmax (0.001, lane.periodSeconds);
+        auto cycle = (int64) cycles;
+        auto x = getShapeValue (i, lane, cycles - (double) cycle, cycle);
+        auto maxValue = activeEncoders[i].getMaximumValue();
+        auto value = roundToInt ((lane.minimum + (lane.maximum - lane.minimum) * x) * maxValue);
+
+        MidiMessage messages[ControllerEncoder::maxMessages];
+        auto numMessages = activeEncoders[i].encode (currentChannel, value, nrpnState, messages);
+
+        for (int m = 0; m < numMessages; ++m)
+        {
+            messages[m].setTimeStamp (timeStamp);
+            scheduler.sendToAll (messages[m]);
+        }
+
+        lastValues[i] = value;
+    }
+}
+
+double AutomationGenerator::getShapeValue (int lane, const Lane& settings, double phase, int64 cycle)
+{
+    switch (settings.shape)
+    {
+        case ramp:      return phase;
+        case sine:      return 0.5 - 0.5 * std::cos (phase * MathConstants<double>::twoPi);
+        case triangle:  return phase < 0.5 ? phase * 2.0 : 2.0 - phase * 2.0;
+
+        case random:
+            // sample and hold, one new value per period
+            if (cycle != lastRandomCycle[lane])
+            {
+                lastRandomCycle[lane] = cycle;
+                randomValue[lane] = rng.nextDouble();
+            }
+
+            return randomValue[lane];
+
+        case steps:
+        {
+            auto n = jmax (2, settings.numSteps);
+            return (double) jmin (n - 1, (int) (phase * n)) / (double) (n - 1);
+        }
+
+        case off:
+        default:        return 0.0;
+    }
+}
+
+//==============================================================================
+AutomationPanel::AutomationPanel (AutomationGenerator& g)
+    : generator (g)
+{
+    for (int i = 0; i < AutomationGenerator::numLanes; ++i)
+    {
+        auto* c = laneControls.add (new LaneControls());
+        auto lane = generator.getLane (i);
+
+        c->name.setText ("Knob " + String (i + 1), dontSendNotification);
+        addAndMakeVisible (c->name);
+
+        c->shape.addItemList (AutomationGenerator::getShapeNames(), 1);
+        c->shape.setSelectedItemIndex ((int) lane.shape, dontSendNotification);
+        c->shape.onChange = [this, i] { updateLane (i); };
+        addAndMakeVisible (c->shape);
+
+        c->period.setSliderStyle (Slider::LinearHorizontal);
+        c->period.setTextBoxStyle (Slider::TextBoxRight, false, 70, 20);
+        c->period.setRange (0.01, 60.0, 0.01);
+        c->period.setSkewFactorFromMidPoint (2.0);
+        c->period.setTextValueSuffix (" s");
+        c->period.setValue (lane.periodSeconds, dontSendNotification);
+        c->period.onValueChange = [this, i] { updateLane (i); };
+        addAndMakeVisible (c->period);
+
+        c->range.setSliderStyle (Slider::TwoValueHorizontal);
+        c->range.setRange (0.0, 1.0, 0.001);
+        c->range.setMinAndMaxValues (lane.minimum, lane.maximum, dontSendNotification);
+        c->range.onValueChange = [this, i] { updateLane (i); };
+        addAndMakeVisible (c->range);
+    }
+
+    rateLabel.setText ("Tick rate:", dontSendNotification);
+    addAndMakeVisible (rateLabel);
+    rate.setSliderStyle (Slider::LinearHorizontal);
+    rate.setTextBoxStyle (Slider::TextBoxRight, false, 70, 20);
+    rate.setRange (1.0, 1000.0, 1.0);
+    rate.setTextValueSuffix (" Hz");
+    rate.setValue (100.0, dontSendNotification);
+    addAndMakeVisible (rate);
+
+    seedLabel.setText ("Seed:", dontSendNotification);
+    addAndMakeVisible (seedLabel);
+    seed.setInputRestrictions (10, "0123456789");
+    seed.setText ("1");
+    addAndMakeVisible (seed);
+
+    startButton.onClick = [this] { startOrStop(); };
+    addAndMakeVisible (startButton);
+    addAndMakeVisible (statusLabel);
+
+    startTimerHz (4);
+}
+
+AutomationPanel::~AutomationPanel()
+{
+    stopTimer();
+}
+
+void AutomationPanel::updateLane (int i)
+{
+    auto* c = laneControls[i];
+    AutomationGenerator::Lane lane;
+    lane.shape = (AutomationGenerator::Shape) c->shape.getSelectedItemIndex();
+    lane.periodSeconds = c->period.getValue();
+    lane.minimum = c->range.getMinValue();
+    lane.maximum = c->range.getMaxValue();
+    generator.setLane (i, lane);
+}
+
+void AutomationPanel::startOrStop()
+{
+    if (generator.isRunning())
+        generator.stop();
+    else
+        generator.start (rate.getValue(), seed.getText().getLargeIntValue());
+
+    startButton.setButtonText (generator.isRunning() ? "Stop" : "Start");
+}
+
+void AutomationPanel::timerCallback()
+{
+    auto stats = generator.getStats();
+    statusLabel.setText ("Ticks: " + String (stats.ticks)
+                           + "   late: " + String (stats.lateTicks)
+                           + "   worst lateness: " + String (stats.maxLatenessMs, 3) + " ms",
+                         dontSendNotification);
+}
+
+void AutomationPanel::resized()
+{
+    auto area = getLocalBounds().reduced (10);
+    const int rowHeight = 28;
+
+    for (auto* c : laneControls)
+    {
+        auto row = area.removeFromTop (rowHeight);
+        c->name.setBounds (row.removeFromLeft (60));
+        c->shape.setBounds (row.removeFromLeft (100).reduced (2));
+        c->period.setBounds (row.removeFromLeft (jmax (150, row.getWidth() / 2)).reduced (2));
+        c->range.setBounds (row.reduced (2));
+        area.removeFromTop (4);
+    }
+
+    area.removeFromTop (10);
+    auto row = area.removeFromTop (rowHeight);
+    rateLabel.setBounds (row.removeFromLeft (70));
+    rate.setBounds (row.removeFromLeft (250).reduced (2));
+    seedLabel.setBounds (row.removeFromLeft (45));
+    seed.setBounds (row.removeFromLeft (90).reduced (2));
+    startButton.setBounds (row.removeFromRight (80).reduced (2));
+
+    area.removeFromTop (10);
+    statusLabel.setBounds (area.removeFromTop (rowHeight));
+}
@@ -0,0 +1,172 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+#include "ControllerEncoder.h"
+#include "MidiOutputScheduler.h"
+
+//==============================================================================
+/**
+    Drives the four knob controllers with ramps, LFOs and step patterns at a
+    fixed tick rate of up to 1 kHz.
+
+    Ticks are scheduled from absolute time on a dedicated high-priority thread
+    and go straight to the output scheduler. The UI only reads back the last
+    value of each lane to move the on-screen knobs.
+*/
+class AutomationGenerator  : private Thread
+{
+public:
+    enum Shape
+    {
+        off = 0,
+        ramp,
+        sine,
+        triangle,
+        random,
+        steps
+    };
+
+    enum { numLanes = 4 };
+
+    struct Lane
+    {
+        Shape shape = off;
+        double periodSeconds = 2.0;
+        double minimum = 0.0;       // 0..1 of the controller's range
+        double maximum = 1.0;
+        int numSteps = 8;
+    };
+
+    struct Stats
+    {
+        int64 ticks = 0;
+        int64 lateTicks = 0;        // ticks that ran more than one period late
+        double maxLatenessMs = 0.0;
+    };
+
+    //==============================================================================
+    explicit AutomationGenerator (MidiOutputScheduler& scheduler);
+    ~AutomationGenerator();
+
+    void setLane (int lane, const Lane& settings);
+    Lane getLane (int lane) const;
+
+    /** The generator keeps its own copy of each knob's encoder so that it never
+        shares stream state with the UI thread.
+    */
+    void setEncoder (int lane, const ControllerEncoder& encoder);
+    void setChannel (int channel);
+
+    /** Call when something else has sent NRPN on the same device, so the
+        next tick selects its parameter again.
+    */
+    void invalidateNrpnState()               { nrpnInvalidated = true; }
+
+    void start (double tickRateHz, int64 randomSeed);
+    void stop();
+    bool isRunning() const                   { return isThreadRunning(); }
+
+    bool isLaneActive (int lane) const       { return isRunning() && getLane (lane).shape != off; }
+    int getLastValue (int lane) const        { return lastValues[lane].load(); }
+
+    /** Called on the message thread when a lane stops driving its knob, because
+        the generator stopped or the lane was switched off. Whatever sent the
+        knob's controller before can't know what the device has had since.
+    */
+    std::function<void (int lane)> onLaneReleased;
+
+    Stats getStats() const;
+
+    static StringArray getShapeNames();
+
+private:
+    //==============================================================================
+    void run() override;
+    void tick (double secondsSinceStart);
+    double getShapeValue (int lane, const Lane& settings, double phase, int64 cycle);
+
+    MidiOutputScheduler& scheduler;
+
+    // the UI's side; the thread only copies from it under the lock
+    SpinLock settingsLock;
+    Lane lanes[numLanes];
+    ControllerEncoder encoders[numLanes];
+    bool encoderChanged[numLanes] = {};
+    int channel = 1;
+    std::atomic<bool> nrpnInvalidated { false };
+
+    // the thread's side, encoded and sent without the lock held
+    ControllerEncoder activeEncoders[numLanes];
+    ControllerEncoder::ChannelState nrpnState;
+
+    double tickRate = 100.0;
+    Random rng;
+    int64 seed = 0;
+    int64 lastRandomCycle[numLanes];
+    double randomValue[numLanes];
+
+    std::atomic<int> lastValues[numLanes];
+    std::atomic<int64> ticks { 0 }, lateTicks { 0 };
+    std::atomic<double> maxLatenessMs { 0.0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (AutomationGenerator)
+};
+
+//==============================================================================
+class AutomationPanel  : public Component,
+                         private Timer
+{
+public:
+    explicit AutomationPanel (AutomationGenerator& generator);
+    ~AutomationPanel();
+
+    void resized() override;
+
+private:
+    void timerCallback() override;
+    void updateLane (int lane);
+    void startOrStop();
+
+    AutomationGenerator& generator;
+
+    struct LaneControls
+    {
+        Label name;
+        ComboBox shape;
+        Slider period, range;
+    };
+
+    OwnedArray<LaneControls> laneControls;
+    Label rateLabel, seedLabel, statusLabel;
+    Slider rate;
+    TextEditor seed;
+    TextButton startButton { "Start" };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (AutomationPanel)
+};
@@ -0,0 +1,580 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#include "BulkTransfer.h"
+#include "SysExCodec.h"
+
+namespace
+{
+    const uint8 nonCommercialId = 0x7d;
+    const uint8 bulkType = 'B';
+    const uint8 dataPacket = 'D';
+    const uint8 ackPacket = 'A';
+    const uint8 nakPacket = 'N';
+    const int headerSize = 5;                   // id, type, kind and a 14-bit sequence number
+}
+
+//==============================================================================
+BulkTransfer::BulkTransfer (MidiTestPorts& p)
+    : Thread ("SysEx bulk transfer"), ports (p)
+{
+}
+
+BulkTransfer::~BulkTransfer()
+{
+    cancel();
+}
+
+StringArray BulkTransfer::getFlowControlNames()
+{
+    return { "Device ACK/NAK", "Loopback echo", "Timed pacing" };
+}
+
+//==============================================================================
+bool BulkTransfer::start (const MemoryBlock& newData, MidiDeviceListEntry::Ptr newOutput,
+                          MidiDeviceListEntry::Ptr newInput, const Settings& newSettings)
+{
+    cancel();
+    data = newData;
+    makeTestData = false;
+    return begin ((int64) data.getSize(), newOutput, newInput, newSettings);
+}
+
+bool BulkTransfer::startWithTestData (int64 numBytes, MidiDeviceListEntry::Ptr newOutput,
+                                      MidiDeviceListEntry::Ptr newInput, const Settings& newSettings)
+{
+    cancel();
+    data.reset();
+    makeTestData = true;
+    return begin (numBytes, newOutput, newInput, newSettings);
+}
+
+bool BulkTransfer::begin (int64 numBytes, MidiDeviceListEntry::Ptr newOutput,
+                          MidiDeviceListEntry::Ptr newInput, const Settings& newSettings)
+{
+    auto needsInput = newSettings.flowControl != timedPacing;
+
+    if (numBytes <= 0 || newOutput == nullptr || ! newOutput->isOutputOpen()
+         || (needsInput && (newInput == nullptr || ! newInput->isInputOpen())))
+        return false;
+
+    output = newOutput;
+    input = needsInput ? newInput : nullptr;
+    settings = newSettings;
+    settings.packetBytes = jlimit (7, 4096, settings.packetBytes);
+    settings.windowSize = jlimit (1, sequenceMask / 2, settings.windowSize);
+
+    packetBuffer.malloc ((size_t) (headerSize + SysExCodec::getPackedSize (settings.packetBytes) + 1));
+    echoBuffer.malloc ((size_t) settings.packetBytes);
+    windowStart = 0;
+    answerFifo.reset();
+    departureFifo.reset();
+
+    {
+        const SpinLock::ScopedLockType sl (progressLock);
+        progress = {};
+        progress.totalBytes = numBytes;
+        progress.numPackets = (int) ((numBytes + settings.packetBytes - 1) / settings.packetBytes);
+    }
+
+    if (input != nullptr)
+    {
+        inputDevice = input.get();
+        ports.addListener (this);
+    }
+
+    outputDestination = output.get();
+    ports.getScheduler().addMonitor (this);
+    ports.getClock().threadStarting (*this);
+    startThread (5);
+    return true;
+}
+
+void BulkTransfer::cancel()
+{
+    signalThreadShouldExit();
+    ports.getClock().wake (*this);
+    stopThread (2000);
+    ports.removeListener (this);
+    ports.getScheduler().removeMonitor (this);
+    inputDevice = nullptr;
+    outputDestination = nullptr;
+}
+
+BulkTransfer::Progress BulkTransfer::getProgress() const
+{
+    const SpinLock::ScopedLockType sl (progressLock);
+    return progress;
+}
+
+//==============================================================================
+void BulkTransfer::run()
+{
+    const VirtualClock::ScopedThread participant (ports.getClock(), *this);
+    auto ok = transfer();
+    const SpinLock::ScopedLockType sl (progressLock);
+    progress.finished = ok;
+}
+
+bool BulkTransfer::transfer()
+{
+    auto& clock = ports.getClock();
+    auto numPackets = getProgress().numPackets;
+
+    if (makeTestData)
+    {
+        // made here rather than on the message thread, since it can run to megabytes
+        Random random (1);
+        data.setSize ((size_t) getProgress().totalBytes);
+        auto* bytes = static_cast<uint8*> (data.getData());
+
+        for (size_t i = 0; i < data.getSize(); ++i)
+            bytes[i] = (uint8) random.nextInt (256);
+    }
+
+    auto startTime = clock.now();
+    double drainedAt = -1.0;
+
+    packetState.assign ((size_t) numPackets, (uint8) waiting);
+    sentAt.assign ((size_t) numPackets, 0.0);
+    retries.assign ((size_t) numPackets, 0);
+    firstUnfinished = 0;
+    nextToSend = 0;
+
+    auto fail = [this] (const String& error)
+    {
+        const SpinLock::ScopedLockType sl (progressLock);
+        progress.error = error;
+        return false;
+    };
+
+    while (firstUnfinished < numPackets)
+    {
+        if (threadShouldExit())
+            return fail ("Cancelled");
+
+        // packets that have left the scheduler, then answers from the device
+        int start1, size1, start2, size2;
+        departureFifo.prepareToRead (departureFifo.getNumReady(), start1, size1, start2, size2);
+
+        for (int i = 0; i < size1; ++i)  handleDeparture (departures[start1 + i]);
+        for (int i = 0; i < size2; ++i)  handleDeparture (departures[start2 + i]);
+
+        departureFifo.finishedRead (size1 + size2);
+        answerFifo.prepareToRead (answerFifo.getNumReady(), start1, size1, start2, size2);
+
+        for (int i = 0; i < size1; ++i)  handleAnswer (answers[start1 + i]);
+        for (int i = 0; i < size2; ++i)  handleAnswer (answers[start2 + i]);
+
+        answerFifo.finishedRead (size1 + size2);
+        auto now = clock.now();
+
+        if (settings.flowControl == timedPacing)
+        {
+            if (nextToSend == firstUnfinished)
+            {
+                sendPacket (nextToSend++);
+                drainedAt = -1.0;
+            }
+            else
+            {
+                // the packet is done once it has left the output and the device has had its gap
+                auto stats = ports.getScheduler().getStats (*output);
+
+                if (drainedAt < 0.0 && stats.queued[MidiOutputScheduler::bulkPriority] == 0)
+                    drainedAt = now;
+
+                if (drainedAt >= 0.0 && now - drainedAt >= settings.packetGapMs)
+                    packetState[(size_t) firstUnfinished] = done;
+            }
+        }
+        else
+        {
+            for (auto i = firstUnfinished; i < nextToSend; ++i)
+            {
+                // still queued behind earlier packets, so the device can't have answered yet
+                if (packetState[(size_t) i] != inFlight || sentAt[(size_t) i] < 0.0
+                     || now - sentAt[(size_t) i] < settings.ackTimeoutMs)
+                    continue;
+
+                if (retries[(size_t) i] >= settings.maxRetries)
+                    return fail ("Packet " + String (i) + " was not acknowledged after " + String (settings.maxRetries) + " retries");
+
+                {
+                    const SpinLock::ScopedLockType sl (progressLock);
+                    ++progress.timeouts;
+                }
+
+                ++retries[(size_t) i];
+                sendPacket (i);
+            }
+
+            while (nextToSend < numPackets && nextToSend - firstUnfinished < settings.windowSize)
+                sendPacket (nextToSend++);
+        }
+
+        for (auto i = firstUnfinished; i < nextToSend; ++i)
+            if (retries[(size_t) i] > settings.maxRetries)
+                return fail ("Packet " + String (i) + " was rejected " + String (retries[(size_t) i]) + " times");
+
+        while (firstUnfinished < numPackets && packetState[(size_t) firstUnfinished] == done)
+            ++firstUnfinished;
+
+        windowStart = firstUnfinished;
+
+        {
+            const SpinLock::ScopedLockType sl (progressLock);
+            progress.packetsDone = firstUnfinished;
+            progress.bytesDone = jmin (progress.totalBytes, (int64) firstUnfinished * settings.packetBytes);
+            progress.elapsedSeconds = (clock.now() - startTime) * 0.001;
+        }
+
+        clock.waitFor (*this, settings.flowControl == timedPacing ? 1 : 5);
+    }
+
+    return true;
+}
+
+void BulkTransfer::sendPacket (int index)
+{
+    auto offset = (size_t) index * (size_t) settings.packetBytes;
+    auto numBytes = (int) jmin ((size_t) settings.packetBytes, data.getSize() - offset);
+    auto packedSize = SysExCodec::getPackedSize (numBytes);
+    auto* p = packetBuffer.getData();
+
+    p[0] = nonCommercialId;
+    p[1] = bulkType;
+    p[2] = dataPacket;
+    p[3] = (uint8) (index & 0x7f);
+    p[4] = (uint8) ((index >> 7) & 0x7f);
+    SysExCodec::pack (static_cast<const uint8*> (data.getData()) + offset, numBytes, p + headerSize);
+    p[headerSize + packedSize] = SysExCodec::getRolandChecksum (p + 3, packedSize + 2);
+
+    auto message = MidiMessage::createSysExMessage (p, headerSize + packedSize + 1);
+    auto isRetransmit = packetState[(size_t) index] != waiting;
+
+    // a packet the queue refuses never leaves, so its timeout runs from now and it goes again
+    auto queued = ports.getScheduler().send (*output, message);
+    packetState[(size_t) index] = inFlight;
+    sentAt[(size_t) index] = queued ? -1.0 : ports.getClock().now();
+
+    const SpinLock::ScopedLockType sl (progressLock);
+    progress.wireBytes += message.getRawDataSize();
+
+    if (isRetransmit)
+        ++progress.retransmits;
+}
+
+int BulkTransfer::findPacket (int sequence) const noexcept
+{
+    for (auto i = firstUnfinished; i < nextToSend; ++i)
+        if ((i & sequenceMask) == sequence && packetState[(size_t) i] == inFlight)
+            return i;
+
+    return -1;
+}
+
+void BulkTransfer::handleAnswer (int answer)
+{
+    auto index = findPacket (answer & sequenceMask);
+
+    if (index < 0)
+        return;
+
+    if ((answer & nakFlag) == 0)
+    {
+        packetState[(size_t) index] = done;
+        return;
+    }
+
+    {
+        const SpinLock::ScopedLockType sl (progressLock);
+        ++progress.naks;
+    }
+
+    if (++retries[(size_t) index] <= settings.maxRetries)
+        sendPacket (index);
+}
+
+void BulkTransfer::handleDeparture (const Departure& departure)
+{
+    auto index = findPacket (departure.sequence);
+
+    // a retransmission may leave while an earlier copy is still being answered
+    if (index >= 0 && sentAt[(size_t) index] < 0.0)
+        sentAt[(size_t) index] = departure.time;
+}
+
+//==============================================================================
+void BulkTransfer::pushAnswer (int answer) noexcept
+{
+    int start1, size1, start2, size2;
+    answerFifo.prepareToWrite (1, start1, size1, start2, size2);
+
+    // if the worker has fallen this far behind, the timeout will pick the packet up
+    if (size1 > 0)
+    {
+        answers[start1] = answer;
+        answerFifo.finishedWrite (1);
+        ports.getClock().wake (*this);
+    }
+}
+
+void BulkTransfer::midiReceived (MidiDeviceListEntry* source, const MidiMessage& message)
+{
+    // This is called on the MIDI thread
+    if (source != inputDevice.load() || ! message.isSysEx())
+        return;
+
+    auto* d = message.getSysExData();
+    auto size = message.getSysExDataSize();
+
+    if (size < headerSize || d[0] != nonCommercialId || d[1] != bulkType)
+        return;
+
+    auto sequence = (int) d[3] | ((int) d[4] << 7);
+
+    if (settings.flowControl == deviceAcks && size == headerSize && (d[2] == ackPacket || d[2] == nakPacket))
+    {
+        pushAnswer (sequence | (d[2] == nakPacket ? (int) nakFlag : 0));
+    }
+    else if (settings.flowControl == loopbackEcho && d[2] == dataPacket && size > headerSize)
+    {
+        pushAnswer (sequence | (isIntactEcho (sequence, d + headerSize, size - headerSize - 1, d[size - 1]) ? 0 : (int) nakFlag));
+    }
+}
+
+void BulkTransfer::messageSent (MidiOutputScheduler::Destination& destination, const MidiMessage& message, double time)
+{
+    // This is called on the scheduler thread
+    if (&destination != outputDestination.load() || ! message.isSysEx())
+        return;
+
+    auto* d = message.getSysExData();
+
+    if (message.getSysExDataSize() <= headerSize || d[0] != nonCommercialId || d[1] != bulkType || d[2] != dataPacket)
+        return;
+
+    int start1, size1, start2, size2;
+    departureFifo.prepareToWrite (1, start1, size1, start2, size2);
+
+    // never more than a window and its retransmissions waiting, well short of the queue size
+    if (size1 > 0)
+    {
+        departures[start1] = { (int) d[3] | ((int) d[4] << 7), time };
+        departureFifo.finishedWrite (1);
+    }
+}
+
+bool BulkTransfer::isIntactEcho (int sequence, const uint8* packed, int numPacked, uint8 checksum) noexcept
+{
+    if (SysExCodec::getRolandChecksum (packed - 2, numPacked + 2) != checksum)
+        return false;
+
+    // the packet the sequence number refers to lies somewhere in the window
+    auto start = windowStart.load();
+    auto index = start + ((sequence - start) & sequenceMask);
+    auto offset = (int64) index * settings.packetBytes;
+    auto numBytes = (int) jmin ((int64) settings.packetBytes, (int64) data.getSize() - offset);
+
+    return numBytes > 0
+            && numPacked == SysExCodec::getPackedSize (numBytes)
+            && SysExCodec::unpack (packed, numPacked, echoBuffer)
+            && memcmp (echoBuffer, static_cast<const uint8*> (data.getData()) + offset, (size_t) numBytes) == 0;
+}
+
+//==============================================================================
+BulkTransferPanel::BulkTransferPanel (BulkTransfer& t, MidiTestPorts& ports)
+    : ToolPanel (ports, 10), transfer (t)
+{
+    sourceLabel.setText ("Test data:", dontSendNotification);
+    addAndMakeVisible (sourceLabel);
+    testDataSize.setSliderStyle (Slider::LinearHorizontal);
+    testDataSize.setTextBoxStyle (Slider::TextBoxRight, false, 70, 20);
+    testDataSize.setRange (1.0, 4096.0, 1.0);
+    testDataSize.setSkewFactorFromMidPoint (64.0);
+    testDataSize.setTextValueSuffix (" KB");
+    testDataSize.setValue (16.0, dontSendNotification);
+    addAndMakeVisible (testDataSize);
+
+    fileButton.onClick = [this] { chooseFile(); };
+    addAndMakeVisible (fileButton);
+
+    flowLabel.setText ("Flow control:", dontSendNotification);
+    addAndMakeVisible (flowLabel);
+    flowControl.addItemList (BulkTransfer::getFlowControlNames(), 1);
+    flowControl.setSelectedItemIndex (0, dontSendNotification);
+    addAndMakeVisible (flowControl);
+
+    packetLabel.setText ("Packet:", dontSendNotification);
+    addAndMakeVisible (packetLabel);
+    packetBytes.setSliderStyle (Slider::LinearHorizontal);
+    packetBytes.setTextBoxStyle (Slider::TextBoxRight, false, 50, 20);
+    packetBytes.setRange (7.0, 1022.0, 7.0);
+    packetBytes.setValue (252.0, dontSendNotification);
+    addAndMakeVisible (packetBytes);
+
+    windowLabel.setText ("Window:", dontSendNotification);
+    addAndMakeVisible (windowLabel);
+    windowSize.setSliderStyle (Slider::LinearHorizontal);
+    windowSize.setTextBoxStyle (Slider::TextBoxRight, false, 40, 20);
+    windowSize.setRange (1.0, 64.0, 1.0);
+    windowSize.setValue (4.0, dontSendNotification);
+    addAndMakeVisible (windowSize);
+
+    startButton.onClick = [this] { startOrCancel(); };
+    addAndMakeVisible (startButton);
+    addAndMakeVisible (progressBar);
+    addAndMakeVisible (status);
+
+    benchmarkButton.onClick = [this] { runCodecBenchmark(); };
+    addAndMakeVisible (benchmarkButton);
+}
+
+void BulkTransferPanel::chooseFile()
+{
+    FileChooser chooser ("Choose the data to send...", File::getCurrentWorkingDirectory(), "*");
+    fileData.reset();
+    fileName.clear();
+
+    if (chooser.browseForFileToOpen())
+    {
+        auto file = chooser.getResult();
+
+        if (file.loadFileAsData (fileData))
+            fileName = file.getFileName();
+    }
+
+    sourceLabel.setText (fileName.isNotEmpty() ? "File:" : "Test data:", dontSendNotification);
+    testDataSize.setEnabled (fileName.isEmpty());
+    fileButton.setButtonText (fileName.isNotEmpty() ? fileName : String ("Load file..."));
+}
+
+void BulkTransferPanel::startOrCancel()
+{
+    if (transfer.isRunning())
+    {
+        transfer.cancel();
+        return;
+    }
+
+    BulkTransfer::Settings settings;
+    settings.flowControl = (BulkTransfer::FlowControl) flowControl.getSelectedItemIndex();
+    settings.packetBytes = (int) packetBytes.getValue();
+    settings.windowSize = (int) windowSize.getValue();
+
+    auto started = fileName.isNotEmpty() ? transfer.start (fileData, getOutput(), getInput(), settings)
+                                         : transfer.startWithTestData ((int64) testDataSize.getValue() * 1024,
+                                                                       getOutput(), getInput(), settings);
+
+    if (! started)
+        status.setText ("Open the output, and for ACK/NAK or echo the input too, on the main page.", dontSendNotification);
+}
+
+void BulkTransferPanel::runCodecBenchmark()
+{
+    benchmarkButton.setEnabled (false);
+    showMessage ("Running...");
+
+    Component::SafePointer<BulkTransferPanel> safeThis (this);
+
+    Thread::launch ([safeThis]
+    {
+        auto results = SysExCodec::runBenchmark (4 * 1024 * 1024);
+
+        MessageManager::callAsync ([safeThis, results]
+        {
+            if (safeThis != nullptr)
+            {
+                safeThis->showMessage (results);
+                safeThis->benchmarkButton.setEnabled (true);
+            }
+        });
+    });
+}
+
+String BulkTransferPanel::getReportText()
+{
+    // the report only shows the codec benchmark, put there when it finishes
+    return {};
+}
+
+void BulkTransferPanel::update()
+{
+    startButton.setButtonText (transfer.isRunning() ? "Cancel" : "Send");
+
+    auto p = transfer.getProgress();
+
+    if (p.totalBytes == 0)
+        return;
+
+    progressValue = (double) p.bytesDone / (double) p.totalBytes;
+
+    String text;
+    text << p.bytesDone << " / " << p.totalBytes << " bytes, "
+         << String (p.getBytesPerSecond(), 0) << " B/s data, "
+         << String (p.getWireBytesPerSecond(), 0) << " B/s on the wire, "
+         << p.retransmits << " resent (" << p.naks << " NAK, " << p.timeouts << " timeouts)";
+
+    if (p.error.isNotEmpty())
+        text << " - " << p.error;
+    else if (p.finished)
+        text << " - done in " << String (p.elapsedSeconds, 2) << " s";
+
+    status.setText (text, dontSendNotification);
+}
+
+void BulkTransferPanel::resized()
+{
+    auto area = layOutPair();
+
+    auto row = area.removeFromTop (rowHeight);
+    sourceLabel.setBounds (row.removeFromLeft (80));
+    fileButton.setBounds (row.removeFromRight (150).reduced (2));
+    testDataSize.setBounds (row.reduced (2));
+    area.removeFromTop (4);
+
+    row = area.removeFromTop (rowHeight);
+    flowLabel.setBounds (row.removeFromLeft (90));
+    flowControl.setBounds (row.removeFromLeft (150).reduced (2));
+    packetLabel.setBounds (row.removeFromLeft (50));
+    packetBytes.setBounds (row.removeFromLeft (jmax (100, row.getWidth() / 2)).reduced (2));
+    windowLabel.setBounds (row.removeFromLeft (55));
+    windowSize.setBounds (row.reduced (2));
+    area.removeFromTop (10);
+
+    row = area.removeFromTop (rowHeight);
+    startButton.setBounds (row.removeFromRight (80).reduced (2));
+    progressBar.setBounds (row.reduced (2));
+    area.removeFromTop (4);
+
+    status.setBounds (area.removeFromTop (rowHeight * 2));
+    area.removeFromTop (10);
+
+    benchmarkButton.setBounds (area.removeFromTop (rowHeight).removeFromLeft (140).reduced (2));
+    area.removeFromTop (4);
+    report.setBounds (area);
+}
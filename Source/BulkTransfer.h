@@ -0,0 +1,202 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+#include "MidiTestPorts.h"
+#include "ToolPanel.h"
+
+//==============================================================================
+/**
+    Sends a large block of data as a stream of SysEx packets, with a sliding
+    window of packets in flight.
+
+    Packets are F0 7D 'B' 'D' <sequence, 2 bytes> <packed data> <checksum> F7,
+    where the data is 7-bit packed by SysExCodec and the Roland-style checksum
+    covers the sequence and data. The device answers F0 7D 'B' 'A'|'N'
+    <sequence> F7 to acknowledge or reject each one.
+
+    A rejected packet is sent again at once; one not answered in time is sent
+    again after the timeout, up to a retry limit. The timeout runs from when
+    the packet has left the output scheduler, as its monitor reports, so a
+    window of packets queued behind a slow link isn't timed out while it
+    waits its turn. With a loopback cable the
+    echoed packet itself stands in for the ACK: it is unpacked on the MIDI
+    thread and compared with the data sent, and any difference is a NAK.
+    Devices that never answer get timed pacing instead: one packet at a time,
+    with a gap after each has left the output.
+
+    Everything runs on a worker thread; the output scheduler handles the link
+    pacing, so the message thread only reads the progress.
+*/
+class BulkTransfer  : private Thread,
+                      private MidiTestPorts::Listener,
+                      private MidiOutputScheduler::Monitor
+{
+public:
+    enum FlowControl
+    {
+        deviceAcks = 0,
+        loopbackEcho,
+        timedPacing
+    };
+
+    struct Settings
+    {
+        FlowControl flowControl = deviceAcks;
+        int packetBytes = 256;          // unpacked data per packet
+        int windowSize = 4;             // packets in flight before waiting for an answer
+        double ackTimeoutMs = 500.0;
+        int maxRetries = 5;
+        double packetGapMs = 20.0;      // timed pacing only
+    };
+
+    struct Progress
+    {
+        int64 totalBytes = 0;
+        int64 bytesDone = 0;            // data acknowledged, or sent when pacing by time
+        int64 wireBytes = 0;            // everything sent, retransmissions included
+        int numPackets = 0;
+        int packetsDone = 0;
+        int retransmits = 0;
+        int naks = 0;
+        int timeouts = 0;
+        double elapsedSeconds = 0.0;
+        bool finished = false;
+        String error;
+
+        double getBytesPerSecond() const noexcept       { return elapsedSeconds > 0.0 ? (double) bytesDone / elapsedSeconds : 0.0; }
+        double getWireBytesPerSecond() const noexcept   { return elapsedSeconds > 0.0 ? (double) wireBytes / elapsedSeconds : 0.0; }
+    };
+
+    //==============================================================================
+    explicit BulkTransfer (MidiTestPorts& ports);
+    ~BulkTransfer();
+
+    /** The input is only needed when the flow control listens for answers.
+        Returns false if a device it needs isn't open.
+    */
+    bool start (const MemoryBlock& data, MidiDeviceListEntry::Ptr output,
+                MidiDeviceListEntry::Ptr input, const Settings& settings);
+
+    /** Like start(), with seeded random data made on the worker thread. */
+    bool startWithTestData (int64 numBytes, MidiDeviceListEntry::Ptr output,
+                            MidiDeviceListEntry::Ptr input, const Settings& settings);
+    void cancel();
+    bool isRunning() const                  { return isThreadRunning(); }
+
+    Progress getProgress() const;
+
+    static StringArray getFlowControlNames();
+
+private:
+    //==============================================================================
+    enum PacketState { waiting = 0, inFlight, done };
+    enum { sequenceMask = 0x3fff, nakFlag = 0x4000, answerQueueSize = 256, departureQueueSize = 256 };
+
+    struct Departure
+    {
+        int sequence;
+        double time;
+    };
+
+    bool begin (int64 numBytes, MidiDeviceListEntry::Ptr output, MidiDeviceListEntry::Ptr input, const Settings& settings);
+    void run() override;
+    bool transfer();
+    void sendPacket (int index);
+    int findPacket (int sequence) const noexcept;
+    void handleAnswer (int answer);
+    void handleDeparture (const Departure& departure);
+    void pushAnswer (int answer) noexcept;
+    bool isIntactEcho (int sequence, const uint8* packed, int numPacked, uint8 checksum) noexcept;
+
+    void midiReceived (MidiDeviceListEntry* source, const MidiMessage& message) override;
+    void messageSent (MidiOutputScheduler::Destination& destination, const MidiMessage& message, double time) override;
+
+    MidiTestPorts& ports;
+    MidiDeviceListEntry::Ptr output, input;
+    std::atomic<MidiDeviceListEntry*> inputDevice { nullptr };
+    std::atomic<MidiOutputScheduler::Destination*> outputDestination { nullptr };
+    Settings settings;
+    MemoryBlock data;
+    bool makeTestData = false;
+
+    // MIDI thread only, for checking echoes
+    HeapBlock<uint8> echoBuffer;
+    std::atomic<int> windowStart { 0 };
+
+    // worker thread only
+    std::vector<uint8> packetState;
+    std::vector<double> sentAt;         // when it left the scheduler, or -1 while queued
+    std::vector<int> retries;
+    int firstUnfinished = 0, nextToSend = 0;
+    HeapBlock<uint8> packetBuffer;
+
+    // answers travel from the MIDI thread to the worker through here
+    AbstractFifo answerFifo { answerQueueSize };
+    int answers[answerQueueSize];
+
+    // and departures from the scheduler thread
+    AbstractFifo departureFifo { departureQueueSize };
+    Departure departures[departureQueueSize];
+
+    SpinLock progressLock;
+    Progress progress;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (BulkTransfer)
+};
+
+//==============================================================================
+class BulkTransferPanel  : public ToolPanel
+{
+public:
+    BulkTransferPanel (BulkTransfer& transfer, MidiTestPorts& ports);
+
+    void resized() override;
+
+private:
+    String getReportText() override;
+    void update() override;
+    void chooseFile();
+    void startOrCancel();
+    void runCodecBenchmark();
+
+    BulkTransfer& transfer;
+    MemoryBlock fileData;
+    String fileName;
+
+    Label sourceLabel, flowLabel, packetLabel, windowLabel, status;
+    TextButton fileButton { "Load file..." };
+    Slider testDataSize, packetBytes, windowSize;
+    ComboBox flowControl;
+    TextButton startButton { "Send" };
+    double progressValue = 0.0;
+    ProgressBar progressBar { progressValue };
+    TextButton benchmarkButton { "Benchmark codec" };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (BulkTransferPanel)
+};
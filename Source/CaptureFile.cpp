@@ -0,0 +1,528 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#include "CaptureFile.h"
+
+namespace
+{
+    const char segmentMagic[] = "BAMIDCAP";
+    const char indexMagic[] = "BAMCIDX1";
+
+    enum
+    {
+        formatVersion = 1,
+        magicSize = 8,
+        maxSources = 4096,
+
+        endTag = 0,
+        syncTag = 1,
+        firstEventTag = 2,
+
+        // the most an event can take besides its bytes: a tag, a delta, a length and a sync point before it
+        maxRecordOverhead = 64
+    };
+
+    int putVarint (uint8* dest, uint64 value) noexcept
+    {
+        int n = 0;
+
+        while (value >= 0x80)
+        {
+            dest[n++] = (uint8) (value | 0x80);
+            value >>= 7;
+        }
+
+        dest[n++] = (uint8) value;
+        return n;
+    }
+
+    uint64 zigzag (int64 value) noexcept            { return ((uint64) value << 1) ^ (uint64) (value >> 63); }
+    int64 unzigzag (uint64 value) noexcept          { return (int64) (value >> 1) ^ -(int64) (value & 1); }
+
+    int64 toMicroseconds (double ms) noexcept       { return (int64) std::llround (ms * 1000.0); }
+}
+
+//==============================================================================
+CaptureWriter::~CaptureWriter()
+{
+    close();
+}
+
+File CaptureWriter::getSegmentFile (const File& folder, const String& name, int number)
+{
+    return folder.getChildFile (name + " " + String (number).paddedLeft ('0', 4) + ".bamcap");
+}
+
+bool CaptureWriter::open (const Settings& newSettings, const Array<Source>& newSources, double newStartTime)
+{
+    close();
+
+    settings = newSettings;
+    settings.segmentBytes = jmax ((int64) minSegmentBytes, settings.segmentBytes);
+    sources = newSources;
+    startTime = newStartTime;
+    wallClockStart = Time::currentTimeMillis();
+    error.clear();
+
+    segmentNumber = 0;
+    numEvents = 0;
+    closedBytes = 0;
+
+    if (sources.size() > maxSources)
+        return fail ("too many devices to capture");
+
+    auto result = settings.folder.createDirectory();
+
+    if (result.failed())
+        return fail ("couldn't create " + settings.folder.getFullPathName() + ": " + result.getErrorMessage());
+
+    return openSegment (0);
+}
+
+void CaptureWriter::close()
+{
+    closeSegment();
+}
+
+bool CaptureWriter::write (int source, const uint8* bytes, int numBytes, double time)
+{
+    if (data == nullptr || numBytes <= 0 || numBytes > maxEventSize || ! isPositiveAndBelow (source, sources.size()))
+        return false;
+
+    auto t = toMicroseconds (time - startTime);
+
+    if (used + (size_t) numBytes + maxRecordOverhead > capacity
+         || (settings.segmentSeconds > 0.0 && t - segmentStartTime >= toMicroseconds (settings.segmentSeconds * 1000.0)))
+    {
+        closeSegment();
+
+        if (! openSegment (t))
+            return false;
+    }
+    else if (used - lastSyncOffset >= (size_t) settings.syncIntervalBytes
+              || t - lastSyncTime >= toMicroseconds (settings.syncIntervalMs))
+    {
+        writeSync (t);
+    }
+
+    writeVarint ((uint64) (firstEventTag + source));
+    writeVarint (zigzag (t - lastTime));
+    writeVarint ((uint64) numBytes);
+    writeBytes (bytes, (size_t) numBytes);
+
+    lastTime = t;
+    ++numEvents;
+    return true;
+}
+
+//==============================================================================
+bool CaptureWriter::openSegment (int64 time)
+{
+    file = getSegmentFile (settings.folder, settings.name, ++segmentNumber);
+    file.deleteFile();
+
+    {
+        // the full size up front, so it can be mapped; the file system fills it in as it is written
+        FileOutputStream out (file);
+
+        if (out.failedToOpen() || ! out.setPosition (settings.segmentBytes - 1) || ! out.writeByte (0))
+            return fail ("couldn't create " + file.getFullPathName());
+
+        out.flush();
+    }
+
+    mapping.reset (new MemoryMappedFile (file, MemoryMappedFile::readWrite));
+
+    if (mapping->getData() == nullptr || mapping->getSize() < (size_t) settings.segmentBytes)
+        return fail ("couldn't map " + file.getFullPathName());
+
+    data = static_cast<uint8*> (mapping->getData());
+    capacity = mapping->getSize();
+    used = 0;
+    syncPoints.clearQuick();
+
+    writeBytes (segmentMagic, magicSize);
+    writeLittleEndian (formatVersion, 4);
+    writeLittleEndian ((uint64) segmentNumber, 4);
+    writeLittleEndian ((uint64) wallClockStart, 8);
+    writeVarint ((uint64) sources.size());
+
+    for (auto& source : sources)
+    {
+        auto* name = source.name.toRawUTF8();
+        auto length = std::strlen (name);
+
+        data[used++] = source.isOutput ? 1 : 0;
+        writeVarint (length);
+        writeBytes (name, length);
+    }
+
+    segmentStartTime = time;
+    writeSync (time);
+    return true;
+}
+
+void CaptureWriter::closeSegment()
+{
+    if (data == nullptr)
+        return;
+
+    auto length = (int64) used;
+    mapping.reset();
+    data = nullptr;
+    closedBytes += length;
+    used = 0;
+
+    // the end of the records, then the index for seeking
+    MemoryOutputStream index;
+    uint8 buffer[10];
+    int64 lastOffset = 0, time = 0;
+
+    index.writeByte (endTag);
+    index.write (buffer, (size_t) putVarint (buffer, (uint64) syncPoints.size()));
+
+    for (auto& s : syncPoints)
+    {
+        index.write (buffer, (size_t) putVarint (buffer, (uint64) (s.offset - lastOffset)));
+        index.write (buffer, (size_t) putVarint (buffer, zigzag (s.time - time)));
+        lastOffset = s.offset;
+        time = s.time;
+    }
+
+    auto indexOffset = (uint64) length + 1;
+
+    for (int i = 0; i < 8; ++i)
+        buffer[i] = (uint8) (indexOffset >> (8 * i));
+
+    index.write (buffer, 8);
+    index.write (indexMagic, magicSize);
+
+    FileOutputStream out (file);
+
+    if (out.failedToOpen() || ! out.setPosition (length) || out.truncate().failed()
+         || ! out.write (index.getData(), index.getDataSize()))
+        error = "couldn't finish " + file.getFullPathName();
+
+    out.flush();
+}
+
+void CaptureWriter::writeSync (int64 time)
+{
+    syncPoints.add ({ (int64) used, time });
+    lastSyncOffset = used;
+    lastSyncTime = lastTime = time;
+
+    writeVarint (syncTag);
+    writeLittleEndian ((uint64) time, 8);
+    writeLittleEndian ((uint64) numEvents, 8);
+}
+
+bool CaptureWriter::fail (const String& message)
+{
+    error = message;
+    mapping.reset();
+    data = nullptr;
+    used = 0;
+    return false;
+}
+
+void CaptureWriter::writeVarint (uint64 value) noexcept
+{
+    used += (size_t) putVarint (data + used, value);
+}
+
+void CaptureWriter::writeLittleEndian (uint64 value, int numBytes) noexcept
+{
+    for (int i = 0; i < numBytes; ++i)
+        data[used++] = (uint8) (value >> (8 * i));
+}
+
+void CaptureWriter::writeBytes (const void* source, size_t numBytes) noexcept
+{
+    std::memcpy (data + used, source, numBytes);
+    used += numBytes;
+}
+
+//==============================================================================
+CaptureReader::CaptureReader (const File& segment)
+    : file (segment)
+{
+    if (! file.existsAsFile())
+    {
+        fail ("can't find " + file.getFullPathName());
+        return;
+    }
+
+    mapping.reset (new MemoryMappedFile (file, MemoryMappedFile::readOnly));
+    data = static_cast<const uint8*> (mapping->getData());
+    end = mapping->getSize();
+
+    if (data == nullptr)
+    {
+        fail ("couldn't map " + file.getFullPathName());
+        return;
+    }
+
+    if (! readHeader())
+        return;
+
+    if (! readIndex())
+        findSyncPoints();
+
+    seek (0.0);
+}
+
+bool CaptureReader::readHeader()
+{
+    uint64 version, number, start, numSources;
+
+    if (end < magicSize || std::memcmp (data, segmentMagic, magicSize) != 0)
+    {
+        fail (file.getFileName() + " isn't a capture");
+        return false;
+    }
+
+    position = magicSize;
+
+    if (! readLittleEndian (version, 4) || version != formatVersion)
+    {
+        fail (file.getFileName() + " is from a newer version");
+        return false;
+    }
+
+    if (! readLittleEndian (number, 4) || ! readLittleEndian (start, 8)
+         || ! readVarint (numSources) || numSources > maxSources)
+    {
+        fail (file.getFileName() + " has a damaged header");
+        return false;
+    }
+
+    segmentNumber = (int) number;
+    wallClockStart = (int64) start;
+
+    for (uint64 i = 0; i < numSources; ++i)
+    {
+        uint64 isOutput, length;
+
+        if (! readLittleEndian (isOutput, 1) || ! readVarint (length) || length > end - position)
+        {
+            fail (file.getFileName() + " has a damaged header");
+            return false;
+        }
+
+        sources.add ({ String::fromUTF8 ((const char*) data + position, (int) length), isOutput != 0 });
+        position += (size_t) length;
+    }
+
+    recordsStart = position;
+    return true;
+}
+
+bool CaptureReader::readIndex()
+{
+    if (end < recordsStart + 16 || std::memcmp (data + end - magicSize, indexMagic, magicSize) != 0)
+        return false;
+
+    uint64 offset, count;
+    position = end - 16;
+
+    if (! readLittleEndian (offset, 8) || offset < recordsStart || offset > end - 16)
+        return false;
+
+    position = (size_t) offset;
+
+    if (! readVarint (count) || count > end - position)
+        return false;
+
+    int64 syncOffset = 0, time = 0;
+
+    for (uint64 i = 0; i < count; ++i)
+    {
+        uint64 offsetDelta, timeDelta;
+
+        if (! readVarint (offsetDelta) || ! readVarint (timeDelta))
+        {
+            syncPoints.clear();
+            return false;
+        }
+
+        syncOffset += (int64) offsetDelta;
+        time += unzigzag (timeDelta);
+        syncPoints.add ({ syncOffset, time });
+    }
+
+    indexed = true;
+    return true;
+}
+
+void CaptureReader::findSyncPoints()
+{
+    // no index, so the segment wasn't closed: read it through
+    Event e;
+    position = recordsStart;
+
+    for (;;)
+    {
+        auto start = position;
+        auto kind = readRecord (e);
+
+        if (kind == syncRecord)
+            syncPoints.add ({ (int64) start, currentTime });
+        else if (kind != eventRecord)
+            break;
+    }
+}
+
+//==============================================================================
+bool CaptureReader::readNext (Event& event)
+{
+    if (data == nullptr)
+        return false;
+
+    for (;;)
+    {
+        auto start = position;
+
+        switch (readRecord (event))
+        {
+            case eventRecord:   return true;
+            case syncRecord:    break;
+            case endRecord:     return false;
+
+            case damagedRecord:
+            default:
+                error = file.getFileName() + " is damaged at byte " + String ((int64) start);
+                position = start;
+                return false;
+        }
+    }
+}
+
+CaptureReader::RecordKind CaptureReader::readRecord (Event& event) noexcept
+{
+    auto start = position;
+    uint64 tag;
+
+    if (position >= end || ! readVarint (tag))
+        return endRecord;
+
+    if (tag == endTag)
+    {
+        position = start;
+        return endRecord;
+    }
+
+    if (tag == syncTag)
+    {
+        uint64 time, number;
+
+        if (! readLittleEndian (time, 8) || ! readLittleEndian (number, 8))
+            return damagedRecord;
+
+        currentTime = (int64) time;
+        eventNumber = (int64) number;
+        return syncRecord;
+    }
+
+    uint64 delta, length;
+
+    if (tag - firstEventTag >= (uint64) sources.size() || ! readVarint (delta) || ! readVarint (length)
+         || length == 0 || length > CaptureWriter::maxEventSize || length > end - position)
+        return damagedRecord;
+
+    currentTime += unzigzag (delta);
+
+    event.time = (double) currentTime * 0.001;
+    event.source = (int) (tag - firstEventTag);
+    event.data = data + position;
+    event.size = (int) length;
+
+    position += (size_t) length;
+    ++eventNumber;
+    return eventRecord;
+}
+
+void CaptureReader::seek (double time)
+{
+    if (data == nullptr)
+        return;
+
+    auto t = toMicroseconds (time);
+    position = recordsStart;
+
+    for (auto& s : syncPoints)
+    {
+        if (s.time > t)
+            break;
+
+        position = (size_t) s.offset;
+    }
+
+    error.clear();
+}
+
+File CaptureReader::getNextSegment() const
+{
+    auto name = file.getFileNameWithoutExtension().upToLastOccurrenceOf (" ", false, false);
+    auto next = CaptureWriter::getSegmentFile (file.getParentDirectory(), name, segmentNumber + 1);
+    return next.existsAsFile() ? next : File();
+}
+
+bool CaptureReader::readVarint (uint64& value) noexcept
+{
+    value = 0;
+
+    for (int shift = 0; shift < 64 && position < end; shift += 7)
+    {
+        auto byte = data[position++];
+        value |= (uint64) (byte & 0x7f) << shift;
+
+        if ((byte & 0x80) == 0)
+            return true;
+    }
+
+    return false;
+}
+
+bool CaptureReader::readLittleEndian (uint64& value, int numBytes) noexcept
+{
+    if ((size_t) numBytes > end - position)
+        return false;
+
+    value = 0;
+
+    for (int i = 0; i < numBytes; ++i)
+        value |= (uint64) data[position++] << (8 * i);
+
+    return true;
+}
+
+void CaptureReader::fail (const String& message)
+{
+    error = message;
+    mapping.reset();
+    data = nullptr;
+}
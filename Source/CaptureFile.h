@@ -0,0 +1,229 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+
+//==============================================================================
+/**
+    Writes MIDI traffic to a capture: a series of append-only segment files,
+    each readable on its own.
+
+    A segment is created at its full size and mapped into memory, and events
+    are encoded straight into the mapping. Writing one costs no system call,
+    and the OS writes the pages out in the background. Closing a segment
+    trims it to what was written and appends an index of its sync points.
+
+    Little-endian throughout. A varint is 7 bits per byte, low bits first,
+    with the top bit set on every byte but the last.
+
+        header      "BAMIDCAP", uint32 version, uint32 segment number,
+                    int64 wall-clock start in ms since 1970,
+                    varint source count, then per source:
+                    uint8 1 for an output or 0 for an input, varint length, UTF-8 name
+        records     varint tag, then
+                    0           the end of the records
+                    1           sync: int64 time, int64 events before it in the capture
+                    2 + source  event: varint time delta, varint length, the raw bytes
+        index       only in a closed segment: varint count, then per sync point
+                    varint offset delta and varint time delta,
+                    then int64 offset of the index and "BAMCIDX1"
+
+    Times are microseconds since the capture started. An event's time is a
+    delta from the event or sync before it. The delta is zigzag encoded, since
+    events from different devices can arrive slightly out of order.
+    Every segment starts with a sync point, so its times don't depend on
+    the segment before it. A segment left behind by a crash has no index and
+    keeps its full size. Its unwritten part is zeros, which read as the end
+    of the records, so the reader finds the sync points by reading through.
+*/
+class CaptureWriter
+{
+public:
+    struct Settings
+    {
+        File folder;
+        String name = "capture";                    // segments are "<name> 0001.bamcap" and on
+        int64 segmentBytes = 64 * 1024 * 1024;      // a new segment once one is this full
+        double segmentSeconds = 0.0;                // or this old; 0 rotates on size only
+        double syncIntervalMs = 1000.0;             // a sync point this often,
+        int syncIntervalBytes = 256 * 1024;         // or after this much, whichever comes first
+    };
+
+    struct Source
+    {
+        String name;
+        bool isOutput;
+    };
+
+    enum
+    {
+        minSegmentBytes = 1024 * 1024,
+        maxEventSize = 64 * 1024
+    };
+
+    //==============================================================================
+    CaptureWriter() = default;
+    ~CaptureWriter();
+
+    /** Creates the first segment. Returns false, with getError() saying why,
+        if it can't. Event times are measured from startTime, in ms.
+    */
+    bool open (const Settings& settings, const Array<Source>& sources, double startTime);
+
+    /** Returns false if the event is too big, or on a file error, which also
+        closes the capture.
+    */
+    bool write (int source, const uint8* bytes, int numBytes, double time);
+
+    void close();
+
+    bool isOpen() const noexcept            { return data != nullptr; }
+    String getError() const                 { return error; }
+
+    File getCurrentFile() const             { return file; }
+    int getNumSegments() const noexcept     { return segmentNumber; }
+    int64 getNumEvents() const noexcept     { return numEvents; }
+    int64 getNumBytes() const noexcept      { return closedBytes + (int64) used; }
+
+    static File getSegmentFile (const File& folder, const String& name, int segmentNumber);
+
+private:
+    //==============================================================================
+    bool openSegment (int64 time);
+    void closeSegment();
+    void writeSync (int64 time);
+    bool fail (const String& message);
+
+    void writeVarint (uint64 value) noexcept;
+    void writeLittleEndian (uint64 value, int numBytes) noexcept;
+    void writeBytes (const void* source, size_t numBytes) noexcept;
+
+    struct SyncPoint
+    {
+        int64 offset, time;
+    };
+
+    Settings settings;
+    Array<Source> sources;
+    double startTime = 0.0;
+    int64 wallClockStart = 0;
+    String error;
+
+    File file;
+    std::unique_ptr<MemoryMappedFile> mapping;
+    uint8* data = nullptr;
+    size_t capacity = 0, used = 0;
+    int segmentNumber = 0;
+    Array<SyncPoint> syncPoints;
+
+    int64 lastTime = 0, lastSyncTime = 0, segmentStartTime = 0;
+    size_t lastSyncOffset = 0;
+    int64 numEvents = 0, closedBytes = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (CaptureWriter)
+};
+
+//==============================================================================
+/**
+    Reads one segment of a capture, mapped read-only, from the start or from
+    any sync point.
+*/
+class CaptureReader
+{
+public:
+    struct Event
+    {
+        double time;            // ms since the capture started
+        int source;
+        const uint8* data;      // valid as long as the reader
+        int size;
+    };
+
+    explicit CaptureReader (const File& segment);
+
+    /** False if the file isn't a capture segment, and getError() says why. */
+    bool isValid() const noexcept                               { return data != nullptr; }
+    String getError() const                                     { return error; }
+
+    int getSegmentNumber() const noexcept                       { return segmentNumber; }
+    Time getStartTime() const                                   { return Time (wallClockStart); }
+    const Array<CaptureWriter::Source>& getSources() const      { return sources; }
+
+    /** True if the segment was closed and has its index. */
+    bool hasIndex() const noexcept                              { return indexed; }
+    int getNumSyncPoints() const noexcept                       { return syncPoints.size(); }
+
+    /** Returns false at the end of the segment, or where it is damaged, in
+        which case getError() says so.
+    */
+    bool readNext (Event& event);
+
+    /** Goes back to the last sync point at or before a time, in ms, so the
+        next event read is the first one written after it.
+    */
+    void seek (double time);
+
+    /** The events written to the capture before the next one read. */
+    int64 getEventNumber() const noexcept                       { return eventNumber; }
+
+    /** The segment that follows this one, if it exists. */
+    File getNextSegment() const;
+
+private:
+    //==============================================================================
+    struct SyncPoint
+    {
+        int64 offset, time;
+    };
+
+    enum RecordKind { endRecord, syncRecord, eventRecord, damagedRecord };
+
+    RecordKind readRecord (Event& event) noexcept;
+    bool readVarint (uint64& value) noexcept;
+    bool readLittleEndian (uint64& value, int numBytes) noexcept;
+    bool readHeader();
+    bool readIndex();
+    void findSyncPoints();
+    void fail (const String& message);
+
+    File file;
+    std::unique_ptr<MemoryMappedFile> mapping;
+    const uint8* data = nullptr;
+    size_t end = 0, position = 0, recordsStart = 0;
+    String error;
+
+    int segmentNumber = 0;
+    int64 wallClockStart = 0;
+    Array<CaptureWriter::Source> sources;
+    Array<SyncPoint> syncPoints;
+    bool indexed = false;
+
+    int64 currentTime = 0, eventNumber = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (CaptureReader)
+};
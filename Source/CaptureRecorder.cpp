@@ -0,0 +1,702 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#include "CaptureRecorder.h"
+
+namespace
+{
+    const int maxEventsDescribed = 50;
+
+    /** Mostly notes and controllers, then clock, bends, program changes
+        and the odd SysEx, as a busy rig sends them.
+    */
+    Array<MidiMessage> createCorpus (int size)
+    {
+        Random random (0x434150);
+        Array<MidiMessage> corpus;
+        corpus.ensureStorageAllocated (size);
+
+        while (corpus.size() < size)
+        {
+            auto channel = 1 + random.nextInt (16);
+            auto kind = random.nextInt (100);
+
+            if (kind < 40)       corpus.add (MidiMessage::noteOn (channel, random.nextInt (128), (uint8) (1 + random.nextInt (127))));
+            else if (kind < 70)  corpus.add (MidiMessage::controllerEvent (channel, random.nextInt (120), random.nextInt (128)));
+            else if (kind < 80)  corpus.add (MidiMessage::pitchWheel (channel, random.nextInt (16384)));
+            else if (kind < 95)  corpus.add (MidiMessage::midiClock());
+            else if (kind < 99)  corpus.add (MidiMessage::programChange (channel, random.nextInt (128)));
+            else
+            {
+                uint8 data[128];
+                auto length = 16 + random.nextInt (112);
+
+                for (int i = 0; i < length; ++i)
+                    data[i] = (uint8) random.nextInt (128);
+
+                corpus.add (MidiMessage::createSysExMessage (data, length));
+            }
+        }
+
+        return corpus;
+    }
+}
+
+//==============================================================================
+CaptureRecorder::CaptureRecorder (MidiTestPorts& p)
+    : Thread ("Capture recorder"), ports (p)
+{
+}
+
+CaptureRecorder::~CaptureRecorder()
+{
+    // the file is waited for, however long it takes, rather than left half written
+    stop();
+    waitForThreadToExit (-1);
+}
+
+bool CaptureRecorder::start (const Settings& settings)
+{
+    stop();
+
+    if (isThreadRunning())
+    {
+        const ScopedLock sl (resultsLock);
+        error = "the last recording is still being finished";
+        return false;
+    }
+
+    inputs = ports.getOpenDevices (true);
+    outputs.clear();
+
+    if (settings.includeOutputs)
+        outputs = ports.getOpenDevices (false);
+
+    if (inputs.isEmpty() && outputs.isEmpty())
+        return false;
+
+    Array<CaptureWriter::Source> sources;
+    StringArray trackNames;
+
+    for (auto* input : inputs)
+    {
+        sources.add ({ input->deviceInfo.name, false });
+        trackNames.add ("In: " + input->deviceInfo.name);
+    }
+
+    for (auto* output : outputs)
+    {
+        sources.add ({ output->deviceInfo.name, true });
+        trackNames.add ("Out: " + output->deviceInfo.name);
+    }
+
+    format = settings.format;
+    const bool toMidiFile = format == midiFileFormat;
+    auto now = ports.getClock().now();
+    const bool opened = toMidiFile ? midiFileWriter.open (settings.midiFile, trackNames, now)
+                                   : writer.open (settings.capture, sources, now);
+
+    lastFile = toMidiFile ? File() : writer.getCurrentFile();
+    lastError = toMidiFile ? midiFileWriter.getError() : writer.getError();
+
+    {
+        const ScopedLock sl (resultsLock);
+        destination = ! opened ? File() : (toMidiFile ? settings.midiFile.file : settings.capture.folder);
+        currentFile = lastFile;
+        error = lastError;
+        benchmarkReport.clear();
+    }
+
+    if (! opened)
+        return false;
+
+    eventsWritten = 0;
+    bytesWritten = 0;
+    segmentsWritten = 1;
+
+    fifo.reset();
+    droppedBefore = fifo.getNumDropped();
+    benchmarking = false;
+
+    ports.addListener (this);
+
+    if (! outputs.isEmpty())
+        ports.getScheduler().addMonitor (this);
+
+    startThread (5);
+    return true;
+}
+
+void CaptureRecorder::stop()
+{
+    // no more events, then the thread writes what is queued and closes the file
+    ports.removeListener (this);
+    ports.getScheduler().removeMonitor (this);
+    signalThreadShouldExit();
+    notify();
+}
+
+void CaptureRecorder::startBenchmark()
+{
+    stop();
+
+    if (isThreadRunning())
+        return;
+
+    {
+        const ScopedLock sl (resultsLock);
+        benchmarkReport = "Benchmark running...\n";
+    }
+
+    benchmarking = true;
+    startThread (5);
+}
+
+//==============================================================================
+void CaptureRecorder::midiReceived (MidiDeviceListEntry* source, const MidiMessage& message)
+{
+    // This is called on the MIDI thread
+    auto index = inputs.indexOf (source);
+
+    if (index >= 0)
+        fifo.push (message.getRawData(), message.getRawDataSize(), ports.getClock().now(), index);
+}
+
+void CaptureRecorder::messageSent (MidiOutputScheduler::Destination& destination, const MidiMessage& message, double time)
+{
+    // This is called on the output scheduler thread
+    for (int i = 0; i < outputs.size(); ++i)
+    {
+        if (outputs.getObjectPointer (i) == &destination)
+        {
+            fifo.push (message.getRawData(), message.getRawDataSize(), time, inputs.size() + i);
+            return;
+        }
+    }
+}
+
+//==============================================================================
+void CaptureRecorder::run()
+{
+    if (benchmarking)
+    {
+        runBenchmark();
+        return;
+    }
+
+    while (! threadShouldExit())
+    {
+        drain();
+        wait (drainIntervalMs);
+    }
+
+    drain();
+
+    if (format == midiFileFormat)
+        midiFileWriter.close();
+    else
+        writer.close();
+
+    updateStatus();
+}
+
+void CaptureRecorder::drain()
+{
+    if (format == midiFileFormat)
+    {
+        fifo.drain ([this] (const MidiEventFifo::Event& e)
+        {
+            midiFileWriter.write (e.sourceTag, e.data, e.size, e.timeStamp);
+        });
+    }
+    else
+    {
+        fifo.drain ([this] (const MidiEventFifo::Event& e)
+        {
+            writer.write (e.sourceTag, e.data, e.size, e.timeStamp);
+        });
+    }
+
+    updateStatus();
+}
+
+void CaptureRecorder::updateStatus()
+{
+    if (format == midiFileFormat)
+    {
+        eventsWritten = midiFileWriter.getNumEvents();
+        bytesWritten = midiFileWriter.getNumBytes();
+
+        if (midiFileWriter.getError() != lastError)
+        {
+            lastError = midiFileWriter.getError();
+
+            const ScopedLock sl (resultsLock);
+            error = lastError;
+        }
+
+        return;
+    }
+
+    eventsWritten = writer.getNumEvents();
+    bytesWritten = writer.getNumBytes();
+    segmentsWritten = writer.getNumSegments();
+
+    if (writer.getCurrentFile() != lastFile || writer.getError() != lastError)
+    {
+        lastFile = writer.getCurrentFile();
+        lastError = writer.getError();
+
+        const ScopedLock sl (resultsLock);
+        currentFile = lastFile;
+        error = lastError;
+    }
+}
+
+void CaptureRecorder::runBenchmark()
+{
+    auto scratch = File::getSpecialLocation (File::tempDirectory).getChildFile ("BAMidiTester capture benchmark");
+    scratch.deleteRecursively();
+
+    CaptureWriter::Settings settings;
+    settings.folder = scratch;
+    settings.name = "benchmark";
+    settings.segmentBytes = benchmarkSegmentBytes;
+
+    Array<CaptureWriter::Source> sources;
+    sources.add ({ "benchmark input", false });
+    sources.add ({ "benchmark output", true });
+
+    auto corpus = createCorpus (corpusSize);
+    MidiEventFifo handoff;
+    CaptureWriter benchmarkWriter;
+    String s;
+
+    // 100k events a second, as far as the file is concerned
+    auto timeOf = [] (int64 number) { return (double) number * 0.01; };
+
+    auto matches = [&] (const CaptureReader::Event& e, int64 number)
+    {
+        auto& m = corpus.getReference ((int) (number % corpusSize));
+
+        return e.source == (int) (number & 1) && std::abs (e.time - timeOf (number)) < 0.0005
+                && e.size == m.getRawDataSize() && std::memcmp (e.data, m.getRawData(), (size_t) e.size) == 0;
+    };
+
+    if (! benchmarkWriter.open (settings, sources, 0.0))
+    {
+        const ScopedLock sl (resultsLock);
+        benchmarkReport = "Benchmark: " + benchmarkWriter.getError() + "\n";
+        return;
+    }
+
+    auto start = Time::getMillisecondCounterHiRes();
+    int64 numWritten = 0;
+
+    while (numWritten < benchmarkEvents && ! threadShouldExit())
+    {
+        // a batch as the MIDI threads would push it, then drained as the recorder thread would
+        for (int i = 0; i < batchSize; ++i, ++numWritten)
+        {
+            auto& m = corpus.getReference ((int) (numWritten % corpusSize));
+            handoff.push (m.getRawData(), m.getRawDataSize(), timeOf (numWritten), (int) (numWritten & 1));
+        }
+
+        handoff.drain ([&] (const MidiEventFifo::Event& e)
+        {
+            benchmarkWriter.write (e.sourceTag, e.data, e.size, e.timeStamp);
+        });
+    }
+
+    benchmarkWriter.close();
+    auto writeMs = Time::getMillisecondCounterHiRes() - start;
+    auto numBytes = benchmarkWriter.getNumBytes();
+
+    start = Time::getMillisecondCounterHiRes();
+    int64 numRead = 0, changed = 0;
+    int numSegments = 0, numSyncPoints = 0, badSeeks = 0;
+    String readError;
+
+    for (auto file = CaptureWriter::getSegmentFile (scratch, settings.name, 1); file.existsAsFile() && ! threadShouldExit();)
+    {
+        CaptureReader reader (file);
+
+        if (! reader.isValid())
+        {
+            readError = reader.getError();
+            break;
+        }
+
+        ++numSegments;
+        numSyncPoints += reader.getNumSyncPoints();
+
+        CaptureReader::Event e;
+        auto firstInSegment = numRead;
+
+        while (reader.readNext (e))
+            if (! matches (e, numRead++))
+                ++changed;
+
+        if (reader.getError().isNotEmpty())
+            readError = reader.getError();
+
+        // from the sync point before the middle of the segment, on to the middle
+        auto middle = (firstInSegment + numRead) / 2;
+        reader.seek (timeOf (middle));
+
+        if (! reader.readNext (e) || reader.getEventNumber() - 1 < firstInSegment || reader.getEventNumber() - 1 > middle
+             || ! matches (e, reader.getEventNumber() - 1))
+            ++badSeeks;
+
+        file = reader.getNextSegment();
+    }
+
+    auto readMs = Time::getMillisecondCounterHiRes() - start;
+    scratch.deleteRecursively();
+
+    s << "Benchmark: " << numWritten << " events of typical traffic through the FIFO into "
+      << (int) (benchmarkSegmentBytes / (1024 * 1024)) << " MB segments\n\n";
+
+    s << "Written at " << String ((double) numWritten / writeMs * 1.0e-3, 2) << " M events/s, "
+      << String ((double) numBytes / writeMs * 1.0e-3, 1) << " MB/s, "
+      << String ((double) numBytes / (double) numWritten, 2) << " bytes per event, "
+      << numSegments << " segments\n"
+      << "That is " << String ((double) numWritten / writeMs * 1.0e-2, 0) << " times the 100k events/s it has to keep up with\n";
+
+    s << "Read back at " << String ((double) numRead / readMs * 1.0e-3, 2) << " M events/s, "
+      << numSyncPoints << " sync points\n\n";
+
+    s << (numRead == numWritten && changed == 0 ? String ("Every event came back unchanged")
+                                                : String (changed) + " events changed, " + String (numRead) + " of "
+                                                    + String (numWritten) + " read back") << "\n";
+
+    s << (badSeeks == 0 ? String ("Every seek from a sync point landed on the right event")
+                        : String (badSeeks) + " of " + String (numSegments) + " seeks went wrong") << "\n";
+
+    if (readError.isNotEmpty())
+        s << "Error: " << readError << "\n";
+
+    if (threadShouldExit())
+        s = "Benchmark stopped.\n";
+
+    const ScopedLock sl (resultsLock);
+    benchmarkReport = s;
+}
+
+//==============================================================================
+String CaptureRecorder::getReport() const
+{
+    String s;
+    const ScopedLock sl (resultsLock);
+
+    if (destination != File() && ! benchmarking)
+    {
+        auto numEvents = eventsWritten.load();
+        auto numBytes = bytesWritten.load();
+
+        s << (isRecording() ? "Recording " : (isFinishing() ? "Finishing " : "Recorded ")) << inputs.size() << " in and " << outputs.size()
+          << " out into " << destination.getFullPathName() << "\n"
+          << "  " << numEvents << " events, " << String ((double) numBytes / (1024.0 * 1024.0), 2) << " MB";
+
+        if (numEvents > 0)
+            s << ", " << String ((double) numBytes / (double) numEvents, 1) << " bytes per event";
+
+        if (format == midiFileFormat)
+            s << "\n  " << (isRecording() ? "the tracks are put together into one file on stop"
+                                         : (isFinishing() ? "assembling..." : "one track per device")) << "\n";
+        else
+            s << ", " << segmentsWritten.load() << " segments\n";
+
+        if (currentFile != File())
+            s << "  " << (isRecording() ? "writing " : "last ") << currentFile.getFileName() << "\n";
+
+        s << "  " << (fifo.getNumDropped() - droppedBefore) << " lost with the writer behind\n";
+    }
+
+    if (error.isNotEmpty())
+        s << "Error: " << error << "\n";
+
+    if (benchmarkReport.isNotEmpty())
+        s << (s.isNotEmpty() ? "\n" : "") << benchmarkReport;
+
+    return s;
+}
+
+String CaptureRecorder::describe (const File& firstSegment)
+{
+    Array<CaptureWriter::Source> sources;
+    Array<int64> counts;
+    int64 numEvents = 0;
+    double firstTime = 0.0, lastTime = 0.0;
+    int numSegments = 0, numSyncPoints = 0, notClosed = 0;
+    String header, events, problem;
+
+    for (auto file = firstSegment; file.existsAsFile();)
+    {
+        CaptureReader reader (file);
+
+        if (! reader.isValid())
+        {
+            problem = reader.getError();
+            break;
+        }
+
+        if (numSegments++ == 0)
+        {
+            sources = reader.getSources();
+            counts.insertMultiple (0, 0, sources.size());
+            header << file.getFileName() << ", capture started " << reader.getStartTime().toString (true, true) << "\n";
+        }
+
+        numSyncPoints += reader.getNumSyncPoints();
+
+        if (! reader.hasIndex())
+            ++notClosed;
+
+        CaptureReader::Event e;
+
+        while (reader.readNext (e))
+        {
+            if (numEvents++ == 0)
+                firstTime = e.time;
+
+            lastTime = e.time;
+
+            if (isPositiveAndBelow (e.source, counts.size()))
+                ++counts.getReference (e.source);
+
+            if (numEvents <= maxEventsDescribed)
+            {
+                auto& source = sources.getReference (e.source);
+
+                events << String (e.time * 0.001, 6).paddedLeft (' ', 14) << (source.isOutput ? "  -> " : "  <- ")
+                       << source.name << ": " << MidiMessage (e.data, e.size).getDescription() << "\n";
+            }
+        }
+
+        if (reader.getError().isNotEmpty())
+        {
+            problem = reader.getError();
+            break;
+        }
+
+        file = reader.getNextSegment();
+    }
+
+    String s (header);
+    s << numEvents << " events over " << String ((lastTime - firstTime) * 0.001, 3) << " s in " << numSegments
+      << " segments, with " << numSyncPoints << " sync points\n";
+
+    for (int i = 0; i < sources.size(); ++i)
+        s << "  " << (sources.getReference (i).isOutput ? "sent to " : "from ") << sources.getReference (i).name
+          << ": " << counts[i] << "\n";
+
+    if (notClosed > 0)
+        s << notClosed << " segments weren't closed, and were read through without an index\n";
+
+    if (problem.isNotEmpty())
+        s << "Error: " << problem << "\n";
+
+    if (events.isNotEmpty())
+        s << "\nFirst events, in seconds from the start:\n" << events;
+
+    return s;
+}
+
+//==============================================================================
+CapturePanel::CapturePanel (CaptureRecorder& r)
+    : recorder (r)
+{
+    includeOutputs.setToggleState (true, dontSendNotification);
+    addAndMakeVisible (includeOutputs);
+
+    formatLabel.setText ("Format:", dontSendNotification);
+    addAndMakeVisible (formatLabel);
+    formatBox.addItem ("Capture (.bamcap)", 1 + (int) CaptureRecorder::captureFormat);
+    formatBox.addItem ("Standard MIDI File (.mid)", 1 + (int) CaptureRecorder::midiFileFormat);
+    formatBox.setSelectedId (1 + (int) CaptureRecorder::captureFormat, dontSendNotification);
+    formatBox.onChange = [this] { formatChanged(); };
+    addAndMakeVisible (formatBox);
+
+    tempoLabel.setText ("Tempo:", dontSendNotification);
+    addAndMakeVisible (tempoLabel);
+    tempo.setSliderStyle (Slider::LinearHorizontal);
+    tempo.setTextBoxStyle (Slider::TextBoxRight, false, 70, 20);
+    tempo.setRange (20.0, 300.0, 1.0);
+    tempo.setTextValueSuffix (" bpm");
+    tempo.setValue (MidiFileWriter::Settings().beatsPerMinute, dontSendNotification);
+    addAndMakeVisible (tempo);
+
+    // ticks of about 5, 0.5 and 0.03 ms at 120 bpm
+    resolutionLabel.setText ("PPQ:", dontSendNotification);
+    addAndMakeVisible (resolutionLabel);
+
+    for (auto ppq : { 96, 480, 960, 3840, 15360 })
+        resolutionBox.addItem (String (ppq), ppq);
+
+    resolutionBox.setSelectedId (MidiFileWriter::Settings().ticksPerQuarterNote, dontSendNotification);
+    addAndMakeVisible (resolutionBox);
+
+    segmentLabel.setText ("Segment:", dontSendNotification);
+    addAndMakeVisible (segmentLabel);
+    segmentMegabytes.setSliderStyle (Slider::LinearHorizontal);
+    segmentMegabytes.setTextBoxStyle (Slider::TextBoxRight, false, 70, 20);
+    segmentMegabytes.setRange (1.0, 1024.0, 1.0);
+    segmentMegabytes.setSkewFactorFromMidPoint (64.0);
+    segmentMegabytes.setTextValueSuffix (" MB");
+    segmentMegabytes.setValue ((double) (CaptureWriter::Settings().segmentBytes / (1024 * 1024)), dontSendNotification);
+    addAndMakeVisible (segmentMegabytes);
+
+    rotateLabel.setText ("Or every:", dontSendNotification);
+    addAndMakeVisible (rotateLabel);
+    rotateMinutes.setSliderStyle (Slider::LinearHorizontal);
+    rotateMinutes.setTextBoxStyle (Slider::TextBoxRight, false, 70, 20);
+    rotateMinutes.setRange (0.0, 240.0, 1.0);
+    rotateMinutes.setSkewFactorFromMidPoint (30.0);
+    rotateMinutes.textFromValueFunction = [] (double value) { return value > 0.0 ? String ((int) value) + " min" : String ("never"); };
+    rotateMinutes.setValue (CaptureWriter::Settings().segmentSeconds / 60.0, dontSendNotification);
+    addAndMakeVisible (rotateMinutes);
+
+    recordButton.onClick = [this] { startOrStop(); };
+    addAndMakeVisible (recordButton);
+
+    inspectButton.onClick = [this] { inspect(); };
+    addAndMakeVisible (inspectButton);
+
+    benchmarkButton.onClick = [this]
+    {
+        if (recorder.isBenchmarking())
+            recorder.stopBenchmark();
+        else
+            recorder.startBenchmark();
+
+        refresh();
+    };
+    addAndMakeVisible (benchmarkButton);
+
+    formatChanged();
+}
+
+void CapturePanel::startOrStop()
+{
+    if (recorder.isRecording())
+    {
+        recorder.stop();
+    }
+    else
+    {
+        auto name = "BAMidiTester capture " + Time::getCurrentTime().formatted ("%Y-%m-%d %H%M%S");
+        auto documents = File::getSpecialLocation (File::userDocumentsDirectory);
+
+        CaptureRecorder::Settings settings;
+        settings.format = (CaptureRecorder::Format) (formatBox.getSelectedId() - 1);
+        settings.includeOutputs = includeOutputs.getToggleState();
+        settings.capture.folder = documents.getChildFile (name);
+        settings.capture.segmentBytes = (int64) segmentMegabytes.getValue() * 1024 * 1024;
+        settings.capture.segmentSeconds = rotateMinutes.getValue() * 60.0;
+        settings.midiFile.file = documents.getChildFile (name + ".mid");
+        settings.midiFile.beatsPerMinute = tempo.getValue();
+        settings.midiFile.ticksPerQuarterNote = resolutionBox.getSelectedId();
+
+        if (! recorder.start (settings) && recorder.getReport().isEmpty())
+            showMessage (openFirst ("an input or an output"));
+    }
+
+    refresh();
+}
+
+void CapturePanel::formatChanged()
+{
+    const bool toMidiFile = formatBox.getSelectedId() - 1 == CaptureRecorder::midiFileFormat;
+
+    segmentMegabytes.setEnabled (! toMidiFile);
+    rotateMinutes.setEnabled (! toMidiFile);
+    tempo.setEnabled (toMidiFile);
+    resolutionBox.setEnabled (toMidiFile);
+}
+
+void CapturePanel::inspect()
+{
+    FileChooser chooser ("Choose the first segment to read...", File::getSpecialLocation (File::userDocumentsDirectory), "*.bamcap");
+
+    if (chooser.browseForFileToOpen())
+        inspection = CaptureRecorder::describe (chooser.getResult());
+
+    refresh();
+}
+
+void CapturePanel::update()
+{
+    auto finishing = recorder.isFinishing();
+
+    recordButton.setButtonText (recorder.isRecording() ? "Stop" : "Record");
+    recordButton.setEnabled (! finishing);
+    benchmarkButton.setButtonText (recorder.isBenchmarking() ? "Stop benchmark" : "Benchmark");
+    benchmarkButton.setEnabled (! finishing);
+}
+
+String CapturePanel::getReportText()
+{
+    auto text = recorder.getReport();
+
+    if (inspection.isNotEmpty())
+        text << (text.isNotEmpty() ? "\n" : "") << inspection;
+
+    return text;
+}
+
+void CapturePanel::resized()
+{
+    auto area = layOutPair();
+
+    auto row = area.removeFromTop (rowHeight);
+    formatLabel.setBounds (row.removeFromLeft (60));
+    formatBox.setBounds (row.removeFromLeft (200).reduced (2));
+    includeOutputs.setBounds (row.reduced (2));
+    area.removeFromTop (4);
+
+    row = area.removeFromTop (rowHeight);
+    segmentLabel.setBounds (row.removeFromLeft (70));
+    segmentMegabytes.setBounds (row.removeFromLeft (row.getWidth() / 2).reduced (2));
+    rotateLabel.setBounds (row.removeFromLeft (70));
+    rotateMinutes.setBounds (row.reduced (2));
+    area.removeFromTop (4);
+
+    row = area.removeFromTop (rowHeight);
+    tempoLabel.setBounds (row.removeFromLeft (70));
+    tempo.setBounds (row.removeFromLeft (row.getWidth() / 2).reduced (2));
+    resolutionLabel.setBounds (row.removeFromLeft (70));
+    resolutionBox.setBounds (row.removeFromLeft (100).reduced (2));
+    area.removeFromTop (4);
+
+    row = area.removeFromTop (rowHeight);
+    benchmarkButton.setBounds (row.removeFromRight (120).reduced (2));
+    inspectButton.setBounds (row.removeFromRight (100).reduced (2));
+    recordButton.setBounds (row.removeFromRight (80).reduced (2));
+
+    area.removeFromTop (10);
+    report.setBounds (area);
+}
@@ -0,0 +1,167 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+#include "MidiTestPorts.h"
+#include "MidiEventFifo.h"
+#include "CaptureFile.h"
+#include "MidiFileWriter.h"
+#include "ToolPanel.h"
+
+//==============================================================================
+/**
+    Records everything the open devices receive, and optionally everything
+    sent to them, into a capture or a Standard MIDI File with a track for
+    each device.
+
+    The MIDI threads and the scheduler only copy each message into a FIFO.
+    A thread of its own drains it every few milliseconds and writes the
+    events as one batch. A message that finds the FIFO full is counted and
+    lost, never waited for, so recording never holds up a MIDI thread.
+    The recorder only writes down what has already happened, so its thread
+    runs on real time and stays out of the clock. Event times still come
+    from the clock.
+
+    The benchmark pushes typical traffic through the same FIFO and writer
+    into a scratch folder, then reads it all back and checks it.
+*/
+class CaptureRecorder  : private Thread,
+                         private MidiTestPorts::Listener,
+                         private MidiOutputScheduler::Monitor
+{
+public:
+    enum Format
+    {
+        captureFormat = 0,
+        midiFileFormat
+    };
+
+    struct Settings
+    {
+        Format format = captureFormat;
+        CaptureWriter::Settings capture;
+        MidiFileWriter::Settings midiFile;
+        bool includeOutputs = true;
+    };
+
+    //==============================================================================
+    explicit CaptureRecorder (MidiTestPorts& ports);
+    ~CaptureRecorder();
+
+    /** Records the devices open right now; any opened later aren't included.
+        Returns false if nothing is open, the file can't be created, or the
+        last recording is still being finished.
+    */
+    bool start (const Settings& settings);
+
+    /** Stops taking events and returns straight away. The thread writes what
+        is queued and closes the file on its own, which for a long MIDI file
+        takes a while; isFinishing() is true until it is done.
+    */
+    void stop();
+    bool isRecording() const                { return isThreadRunning() && ! benchmarking && ! threadShouldExit(); }
+    bool isFinishing() const                { return isThreadRunning() && ! benchmarking && threadShouldExit(); }
+
+    void startBenchmark();
+    void stopBenchmark()                    { stop(); }
+    bool isBenchmarking() const             { return isThreadRunning() && benchmarking; }
+
+    String getReport() const;
+
+    /** Reads a capture from the given segment through the last, and sums it up. */
+    static String describe (const File& firstSegment);
+
+private:
+    //==============================================================================
+    enum
+    {
+        fifoSize = 4 * 1024 * 1024,
+        drainIntervalMs = 10,
+        benchmarkEvents = 1 << 21,
+        benchmarkSegmentBytes = 4 * 1024 * 1024,
+        corpusSize = 4096,
+        batchSize = 256
+    };
+
+    void run() override;
+    void runBenchmark();
+    void drain();
+    void updateStatus();
+    void midiReceived (MidiDeviceListEntry* source, const MidiMessage& message) override;
+    void messageSent (MidiOutputScheduler::Destination& destination, const MidiMessage& message, double time) override;
+
+    MidiTestPorts& ports;
+    MidiEventFifo fifo { fifoSize, CaptureWriter::maxEventSize };
+
+    // fixed while recording; inputs are sources 0 and on, then the outputs
+    ReferenceCountedArray<MidiDeviceListEntry> inputs, outputs;
+    Format format = captureFormat;
+    bool benchmarking = false;
+
+    // written on the recorder thread while it runs
+    CaptureWriter writer;
+    MidiFileWriter midiFileWriter;
+    int64 droppedBefore = 0;
+    File lastFile;          // what was last published, so the thread never reads the shared copies
+    String lastError;
+
+    std::atomic<int64> eventsWritten { 0 }, bytesWritten { 0 };
+    std::atomic<int> segmentsWritten { 0 };
+
+    CriticalSection resultsLock;
+    File destination, currentFile;
+    String error, benchmarkReport;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (CaptureRecorder)
+};
+
+//==============================================================================
+class CapturePanel  : public ToolPanel
+{
+public:
+    explicit CapturePanel (CaptureRecorder& recorder);
+
+    void resized() override;
+
+private:
+    String getReportText() override;
+    void update() override;
+    void startOrStop();
+    void inspect();
+    void formatChanged();
+
+    CaptureRecorder& recorder;
+    ToggleButton includeOutputs { "Record what is sent too" };
+    Label formatLabel, segmentLabel, rotateLabel, tempoLabel, resolutionLabel;
+    ComboBox formatBox, resolutionBox;
+    Slider segmentMegabytes, rotateMinutes, tempo;
+    TextButton recordButton { "Record" }, inspectButton { "Inspect..." }, benchmarkButton { "Benchmark" };
+    String inspection;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (CapturePanel)
+};
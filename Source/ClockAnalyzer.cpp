@@ -0,0 +1,337 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#include "ClockAnalyzer.h"
+
+#include <complex>
+
+namespace
+{
+    const double alpha = 0.05;                              // how fast the phase follows
+    const double beta = alpha * alpha / (2.0 - alpha);      // and the period, for a critically damped filter
+    const double jitterBinMs = 0.1;
+
+    /** In-place radix-2 FFT; the size must be a power of two. */
+    void fft (std::vector<std::complex<double>>& a)
+    {
+        auto n = a.size();
+
+        for (size_t i = 1, j = 0; i < n; ++i)
+        {
+            auto bit = n >> 1;
+
+            for (; (j & bit) != 0; bit >>= 1)
+                j ^= bit;
+
+            j ^= bit;
+
+            if (i < j)
+                std::swap (a[i], a[j]);
+        }
+
+        for (size_t length = 2; length <= n; length <<= 1)
+        {
+            auto angle = -2.0 * MathConstants<double>::pi / (double) length;
+            std::complex<double> step (std::cos (angle), std::sin (angle));
+
+            for (size_t i = 0; i < n; i += length)
+            {
+                std::complex<double> w (1.0, 0.0);
+
+                for (size_t j = 0; j < length / 2; ++j)
+                {
+                    auto u = a[i + j];
+                    auto v = a[i + j + length / 2] * w;
+                    a[i + j] = u + v;
+                    a[i + j + length / 2] = u - v;
+                    w *= step;
+                }
+            }
+        }
+    }
+}
+
+//==============================================================================
+ClockAnalyzer::ClockAnalyzer (MidiTestPorts& p)
+    : ports (p)
+{
+    for (auto& bin : jitterBins)
+        bin = 0;
+
+    for (auto& e : errors)
+        e = 0.0f;
+}
+
+ClockAnalyzer::~ClockAnalyzer()
+{
+    stop();
+}
+
+bool ClockAnalyzer::start (MidiDeviceListEntry::Ptr newInput, double nominalBpm)
+{
+    stop();
+
+    if (newInput == nullptr || ! newInput->isInputOpen())
+        return false;
+
+    input = newInput;
+    nominalPeriod = nominalBpm > 0.0 ? 60000.0 / (nominalBpm * 24.0) : 0.0;
+
+    filterTicks = 0;
+    tempo = smoothedPeriod = offsetMs = driftPpm = 0.0;
+    ticks = gaps = starts = stops = continues = 0;
+    jitterBelow = jitterAbove = 0;
+    numErrors = 0;
+
+    for (auto& bin : jitterBins)
+        bin = 0;
+
+    {
+        const SpinLock::ScopedLockType sl (statsLock);
+        jitterSum = jitterSumSquares = worstJitter = 0.0;
+        jitterCount = 0;
+    }
+
+    inputDevice = input.get();
+    ports.addListener (this);
+    return true;
+}
+
+void ClockAnalyzer::stop()
+{
+    ports.removeListener (this);
+    inputDevice = nullptr;
+}
+
+//==============================================================================
+void ClockAnalyzer::midiReceived (MidiDeviceListEntry* source, const MidiMessage& message)
+{
+    // This is called on the MIDI thread
+    if (source != inputDevice.load() || message.getRawDataSize() != 1)
+        return;
+
+    switch (message.getRawData()[0])
+    {
+        case 0xf8:  tick (ports.getClock().now()); break;
+        case 0xfa:  ++starts; break;
+        case 0xfb:  ++continues; break;
+        case 0xfc:  ++stops; break;
+        default:    break;
+    }
+}
+
+void ClockAnalyzer::tick (double now) noexcept
+{
+    ++ticks;
+
+    // a clock that stopped and came back is measured afresh
+    if (filterTicks > 0 && now - lastTick > 4.0 * jmax (period, 10.0))
+    {
+        ++gaps;
+        filterTicks = 0;
+    }
+
+    auto interval = now - lastTick;
+    lastTick = now;
+
+    if (filterTicks == 0)
+    {
+        firstTick = now;
+        filterTicks = 1;
+        return;
+    }
+
+    if (filterTicks == 1)
+    {
+        period = interval;
+        expected = now + period;
+        filterTicks = 2;
+        return;
+    }
+
+    auto error = now - expected;
+    expected += alpha * error;
+    period += beta * error;
+    expected += period;
+    ++filterTicks;
+
+    smoothedPeriod = period;
+    tempo = 60000.0 / (period * 24.0);
+
+    if (nominalPeriod > 0.0)
+    {
+        auto shouldHaveTaken = (double) (filterTicks - 1) * nominalPeriod;
+        offsetMs = (now - firstTick) - shouldHaveTaken;
+        driftPpm = offsetMs.load() / shouldHaveTaken * 1.0e6;
+    }
+
+    if (filterTicks <= settleTicks)
+        return;
+
+    auto jitter = interval - period;
+    auto bin = roundToInt (jitter / jitterBinMs) + numJitterBins / 2;
+
+    if (bin < 0)                    ++jitterBelow;
+    else if (bin >= numJitterBins)  ++jitterAbove;
+    else                            ++jitterBins[bin];
+
+    {
+        const SpinLock::ScopedLockType sl (statsLock);
+        jitterSum += jitter;
+        jitterSumSquares += jitter * jitter;
+        worstJitter = jmax (worstJitter, std::abs (jitter));
+        ++jitterCount;
+    }
+
+    auto index = numErrors.load();
+    errors[index % spectrumSize] = (float) error;
+    numErrors = index + 1;
+}
+
+//==============================================================================
+String ClockAnalyzer::getReport() const
+{
+    if (input == nullptr)
+        return {};
+
+    String s;
+    s << "Incoming clock on " << input->deviceInfo.name << (isRunning() ? "" : " (not listening)") << "\n"
+      << "Ticks " << ticks.load() << ", gaps " << gaps.load() << ", starts " << starts.load()
+      << ", continues " << continues.load() << ", stops " << stops.load() << "\n";
+
+    if (tempo.load() <= 0.0)
+        return s;
+
+    s << "Tempo " << String (tempo.load(), 3) << " BPM (" << String (smoothedPeriod.load(), 4) << " ms per tick)\n";
+
+    if (nominalPeriod > 0.0)
+        s << "Against " << String (60000.0 / (nominalPeriod * 24.0), 2) << " BPM on the host clock: "
+          << String (offsetMs.load(), 2) << " ms, " << String (driftPpm.load(), 1) << " ppm\n";
+
+    {
+        const SpinLock::ScopedLockType sl (statsLock);
+
+        if (jitterCount > 0)
+        {
+            auto mean = jitterSum / (double) jitterCount;
+            auto rms = std::sqrt (jmax (0.0, jitterSumSquares / (double) jitterCount - mean * mean));
+
+            s << "Interval jitter " << String (rms, 3) << " ms rms, worst " << String (worstJitter, 3)
+              << " ms, over " << jitterCount << " ticks\n";
+        }
+    }
+
+    // histogram of interval minus period
+    uint32 counts[numJitterBins];
+    uint32 highest = jmax (jitterBelow.load(), jitterAbove.load());
+
+    for (int i = 0; i < numJitterBins; ++i)
+    {
+        counts[i] = jitterBins[i].load();
+        highest = jmax (highest, counts[i]);
+    }
+
+    if (highest > 0)
+    {
+        auto bar = [highest] (uint32 count) { return String::repeatedString ("#", (int) (((uint64) count * 40 + highest - 1) / highest)); };
+        auto edge = (numJitterBins / 2) * jitterBinMs;
+
+        s << "\nJitter (ms)\n";
+
+        if (jitterBelow.load() > 0)
+            s << ("< -" + String (edge, 1)).paddedLeft (' ', 7) << String (jitterBelow.load()).paddedLeft (' ', 9) << "  " << bar (jitterBelow.load()) << "\n";
+
+        for (int i = 0; i < numJitterBins; ++i)
+            if (counts[i] > 0)
+                s << String ((i - numJitterBins / 2) * jitterBinMs, 1).paddedLeft (' ', 7)
+                  << String (counts[i]).paddedLeft (' ', 9) << "  " << bar (counts[i]) << "\n";
+
+        if (jitterAbove.load() > 0)
+            s << ("> " + String (edge, 1)).paddedLeft (' ', 7) << String (jitterAbove.load()).paddedLeft (' ', 9) << "  " << bar (jitterAbove.load()) << "\n";
+    }
+
+    auto available = numErrors.load();
+
+    if (available < spectrumSize)
+        return s << "\nSpectrum of tick error: " << (int) (spectrumSize - available) << " more ticks needed\n";
+
+    // the most recent errors, oldest first, with the mean taken out and a Hann window
+    std::vector<std::complex<double>> bins ((size_t) spectrumSize);
+    double mean = 0.0, windowSum = 0.0;
+
+    for (int i = 0; i < spectrumSize; ++i)
+        mean += errors[(available + i) % spectrumSize].load();
+
+    mean /= spectrumSize;
+
+    for (int i = 0; i < spectrumSize; ++i)
+    {
+        auto window = 0.5 - 0.5 * std::cos (2.0 * MathConstants<double>::pi * i / (spectrumSize - 1));
+        bins[(size_t) i] = (errors[(available + i) % spectrumSize].load() - mean) * window;
+        windowSum += window;
+    }
+
+    fft (bins);
+
+    std::vector<double> magnitudes ((size_t) spectrumSize / 2);
+
+    for (size_t k = 1; k < magnitudes.size(); ++k)
+        magnitudes[k] = 2.0 * std::abs (bins[k]) / windowSum;
+
+    auto sorted = magnitudes;
+    std::sort (sorted.begin(), sorted.end());
+    auto median = sorted[sorted.size() / 2];
+
+    Array<int> peaks;
+
+    for (int k = 2; k < (int) magnitudes.size() - 1; ++k)
+        if (magnitudes[(size_t) k] > magnitudes[(size_t) k - 1] && magnitudes[(size_t) k] >= magnitudes[(size_t) k + 1]
+             && magnitudes[(size_t) k] > 4.0 * median)
+            peaks.add (k);
+
+    std::sort (peaks.begin(), peaks.end(), [&magnitudes] (int a, int b) { return magnitudes[(size_t) a] > magnitudes[(size_t) b]; });
+
+    auto tickMs = smoothedPeriod.load();
+    auto fraction = tickMs - std::floor (tickMs);
+
+    s << "\nSpectrum of tick error over the last " << (int) spectrumSize << " ticks\n"
+      << "1 ms quantisation would show at " << String (jmin (fraction, 1.0 - fraction), 3) << " cycles per tick\n";
+
+    if (peaks.isEmpty())
+        s << "No peaks above the noise floor (" << String (median * 1000.0, 1) << " us)\n";
+
+    for (int i = 0; i < peaks.size() && i < numPeaksShown; ++i)
+    {
+        auto k = peaks[i];
+        auto cyclesPerTick = (double) k / spectrumSize;
+
+        s << String (cyclesPerTick, 3).paddedLeft (' ', 7) << " cycles/tick, every " << String (1.0 / cyclesPerTick, 1)
+          << " ticks, " << String (cyclesPerTick * 1000.0 / tickMs, 2) << " Hz: "
+          << String (magnitudes[(size_t) k] * 1000.0, 1) << " us\n";
+    }
+
+    return s;
+}
@@ -0,0 +1,101 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+#include "MidiTestPorts.h"
+
+//==============================================================================
+/**
+    Measures the quality of a MIDI clock arriving on an input.
+
+    Every tick goes through an alpha-beta filter on the MIDI thread, which
+    tracks both the tick period and where the next tick should land. The
+    tempo comes from the smoothed period. A tick's interval minus the
+    period is its jitter, which goes into a histogram. How far the tick
+    landed from its prediction is its error, which goes into a ring for the
+    spectrum. Drift is the host time elapsed against what the nominal tempo
+    says it should be.
+
+    That is a handful of sums per tick, so the input path costs almost
+    nothing even at 300 BPM. The spectrum of the recent errors is only
+    worked out when the report is asked for. Periodic errors show there as
+    peaks; 1 ms USB frames, for instance, show up at the fractional part of
+    the tick length.
+*/
+class ClockAnalyzer  : private MidiTestPorts::Listener
+{
+public:
+    explicit ClockAnalyzer (MidiTestPorts& ports);
+    ~ClockAnalyzer();
+
+    /** Returns false if the input isn't open. A nominal tempo of 0 skips the
+        drift measurement.
+    */
+    bool start (MidiDeviceListEntry::Ptr input, double nominalBpm);
+    void stop();
+    bool isRunning() const noexcept         { return inputDevice.load() != nullptr; }
+
+    String getReport() const;
+
+private:
+    //==============================================================================
+    enum
+    {
+        spectrumSize = 512,
+        numJitterBins = 81,         // 0.1 ms each, centred on zero
+        settleTicks = 48,           // before the filter's estimates are trusted
+        numPeaksShown = 5
+    };
+
+    void midiReceived (MidiDeviceListEntry* source, const MidiMessage& message) override;
+    void tick (double now) noexcept;
+
+    MidiTestPorts& ports;
+    MidiDeviceListEntry::Ptr input;
+    std::atomic<MidiDeviceListEntry*> inputDevice { nullptr };
+    double nominalPeriod = 0.0;
+
+    // MIDI thread only
+    int64 filterTicks = 0;
+    double firstTick = 0.0, lastTick = 0.0, expected = 0.0, period = 0.0;
+
+    std::atomic<double> tempo { 0.0 }, smoothedPeriod { 0.0 }, offsetMs { 0.0 }, driftPpm { 0.0 };
+    std::atomic<int64> ticks { 0 }, gaps { 0 }, starts { 0 }, stops { 0 }, continues { 0 };
+
+    std::atomic<uint32> jitterBins[numJitterBins];
+    std::atomic<uint32> jitterBelow { 0 }, jitterAbove { 0 };
+
+    SpinLock statsLock;
+    double jitterSum = 0.0, jitterSumSquares = 0.0, worstJitter = 0.0;
+    int64 jitterCount = 0;
+
+    std::atomic<float> errors[spectrumSize];
+    std::atomic<int64> numErrors { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ClockAnalyzer)
+};
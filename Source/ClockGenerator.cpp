@@ -0,0 +1,368 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#include "ClockGenerator.h"
+#include "RealtimeThreads.h"
+
+namespace
+{
+    String describePosition (int64 ticks)
+    {
+        // bars of 4/4
+        auto sixteenths = ticks / ClockGenerator::ticksPerSixteenth;
+
+        return "bar " + String (sixteenths / 16 + 1) + " beat " + String ((sixteenths % 16) / 4 + 1)
+                 + "." + String (sixteenths % 4 + 1) + " (tick " + String (ticks) + ")";
+    }
+}
+
+//==============================================================================
+ClockGenerator::ClockGenerator (MidiTestPorts& p)
+    : Thread ("MIDI clock"), ports (p)
+{
+    for (auto& t : idealTimes)
+        t = 0.0;
+}
+
+ClockGenerator::~ClockGenerator()
+{
+    stop();
+}
+
+bool ClockGenerator::start (MidiDeviceListEntry::Ptr newOutput, double bpm)
+{
+    stop();
+
+    if (newOutput == nullptr || ! newOutput->isOutputOpen())
+        return false;
+
+    output = newOutput;
+    setTempo (bpm);
+    pendingCommand = noCommand;
+    pendingPosition = -1;
+    playing = false;
+    ticksQueued = 0;
+    ticksRefused = 0;
+    ticksSeen = 0;
+    lastSentAt = lastIdeal = 0.0;
+    queueError.reset();
+    sendError.reset();
+
+    {
+        const SpinLock::ScopedLockType sl (intervalLock);
+        intervalSum = intervalSumSquares = worstInterval = 0.0;
+        intervalCount = 0;
+    }
+
+    outputDestination = output.get();
+    ports.getScheduler().addMonitor (this);
+    ports.getClock().threadStarting (*this);
+    startThread (9);
+    return true;
+}
+
+void ClockGenerator::stop()
+{
+    stopThread (2000);
+    ports.getScheduler().removeMonitor (this);
+    outputDestination = nullptr;
+
+    if (output != nullptr && playing.exchange (false))
+        ports.getScheduler().send (*output, MidiMessage::midiStop(), MidiOutputScheduler::realtimePriority);
+}
+
+void ClockGenerator::setTempo (double bpm)
+{
+    tempo = jlimit (20.0, 300.0, bpm);
+}
+
+void ClockGenerator::sendStart()       { pendingCommand = startCommand; }
+void ClockGenerator::sendStop()        { pendingCommand = stopCommand; }
+void ClockGenerator::sendContinue()    { pendingCommand = continueCommand; }
+
+bool ClockGenerator::setSongPosition (int sixteenths)
+{
+    if (playing)
+        return false;
+
+    pendingPosition = jlimit (0, 16383, sixteenths);
+    return true;
+}
+
+//==============================================================================
+void ClockGenerator::run()
+{
+    auto& clock = ports.getClock();
+    const VirtualClock::ScopedThread participant (clock, *this);
+    auto currentTempo = tempo.load();
+    auto msPerTick = 60000.0 / (currentTempo * ticksPerQuarter);
+    auto anchorTime = clock.now() + msPerTick;
+    int64 anchorTick = 0, nextTick = 0;
+
+    while (! threadShouldExit())
+    {
+        RealtimeThreads::applyToCurrentThread (RealtimeThreads::timingThread);
+
+        if (tempo.load() != currentTempo)
+        {
+            // anchor on the last tick, so the next one is the first at the new tempo
+            anchorTime += (double) (nextTick - 1 - anchorTick) * msPerTick;
+            anchorTick = nextTick - 1;
+            currentTempo = tempo.load();
+            msPerTick = 60000.0 / (currentTempo * ticksPerQuarter);
+        }
+
+        auto due = anchorTime + (double) (nextTick - anchorTick) * msPerTick;
+        if (due - clock.now() > spinMs)
+        {
+            // tempo changes are picked up on the way
+            clock.waitUntil (*this, due - spinMs);
+            continue;
+        }
+
+        clock.waitPrecisely (*this, due);
+        auto now = clock.now();
+
+        sendTransport();
+
+        // the monitor may see the tick before send() has even returned
+        auto queued = ticksQueued.load();
+        idealTimes[queued % idealRingSize] = due;
+
+        if (ports.getScheduler().send (*output, MidiMessage::midiClock(), MidiOutputScheduler::realtimePriority))
+        {
+            ticksQueued = queued + 1;
+
+            if (playing)
+                ++songPosition;
+        }
+        else
+        {
+            ++ticksRefused;
+        }
+
+        queueError.record (now - due);
+        ++nextTick;
+    }
+}
+
+void ClockGenerator::sendTransport()
+{
+    auto& scheduler = ports.getScheduler();
+    auto position = pendingPosition.exchange (-1);
+
+    if (position >= 0 && ! playing)
+    {
+        scheduler.send (*output, MidiMessage::songPositionPointer (position), MidiOutputScheduler::realtimePriority);
+        songPosition = (int64) position * ticksPerSixteenth;
+    }
+
+    switch (pendingCommand.exchange (noCommand))
+    {
+        case startCommand:
+            scheduler.send (*output, MidiMessage::midiStart(), MidiOutputScheduler::realtimePriority);
+            songPosition = 0;
+            playing = true;
+            break;
+
+        case continueCommand:
+            scheduler.send (*output, MidiMessage::midiContinue(), MidiOutputScheduler::realtimePriority);
+            playing = true;
+            break;
+
+        case stopCommand:
+            scheduler.send (*output, MidiMessage::midiStop(), MidiOutputScheduler::realtimePriority);
+            playing = false;
+            break;
+
+        default:
+            break;
+    }
+}
+
+void ClockGenerator::messageSent (MidiOutputScheduler::Destination& destination, const MidiMessage& message, double time)
+{
+    // This is called on the scheduler thread
+    if (&destination != outputDestination.load() || message.getRawDataSize() != 1 || message.getRawData()[0] != 0xf8)
+        return;
+
+    auto ideal = idealTimes[ticksSeen % idealRingSize].load();
+    ++ticksSeen;
+    sendError.record (jmax (0.0, time - ideal));
+
+    if (lastSentAt > 0.0)
+    {
+        auto deviation = (time - lastSentAt) - (ideal - lastIdeal);
+
+        const SpinLock::ScopedLockType sl (intervalLock);
+        intervalSum += deviation;
+        intervalSumSquares += deviation * deviation;
+        worstInterval = jmax (worstInterval, std::abs (deviation));
+        ++intervalCount;
+    }
+
+    lastSentAt = time;
+    lastIdeal = ideal;
+}
+
+//==============================================================================
+String ClockGenerator::getReport() const
+{
+    if (output == nullptr)
+        return {};
+
+    String s;
+    s << "Clock: " << String (tempo.load(), 2) << " BPM (" << String (60000.0 / (tempo.load() * ticksPerQuarter), 3)
+      << " ms per tick) -> " << output->deviceInfo.name << (isRunning() ? "" : ", not running") << "\n"
+      << "Transport: " << (playing ? "playing" : "stopped") << " at " << describePosition (songPosition.load()) << "\n"
+      << "Ticks queued " << ticksQueued.load() << ", refused " << ticksRefused.load() << "\n\n"
+      << "Queued late by:             " << queueError.getSummary() << "\n"
+      << "Left the scheduler late by: " << sendError.getSummary() << "\n";
+
+    const SpinLock::ScopedLockType sl (intervalLock);
+
+    if (intervalCount > 0)
+    {
+        auto mean = intervalSum / (double) intervalCount;
+        auto rms = std::sqrt (jmax (0.0, intervalSumSquares / (double) intervalCount - mean * mean));
+
+        s << "Tick-to-tick jitter: " << String (rms, 3) << " ms rms, worst " << String (worstInterval, 3)
+          << " ms, over " << intervalCount << " intervals\n";
+    }
+
+    return s;
+}
+
+//==============================================================================
+ClockPanel::ClockPanel (ClockGenerator& g, ClockAnalyzer& a, MidiTestPorts& ports)
+    : ToolPanel (ports), generator (g), analyzer (a)
+{
+    tempoLabel.setText ("BPM:", dontSendNotification);
+    addAndMakeVisible (tempoLabel);
+    tempo.setSliderStyle (Slider::LinearHorizontal);
+    tempo.setTextBoxStyle (Slider::TextBoxRight, false, 70, 20);
+    tempo.setRange (20.0, 300.0, 0.01);
+    tempo.setValue (generator.getTempo(), dontSendNotification);
+    tempo.onValueChange = [this] { generator.setTempo (tempo.getValue()); };
+    addAndMakeVisible (tempo);
+
+    positionLabel.setText ("16ths:", dontSendNotification);
+    addAndMakeVisible (positionLabel);
+    position.setInputRestrictions (5, "0123456789");
+    position.setText ("0", false);
+    addAndMakeVisible (position);
+
+    runButton.onClick = [this] { runOrStop(); };
+    listenButton.onClick = [this] { listenOrStop(); };
+    startButton.onClick = [this] { generator.sendStart(); };
+    stopButton.onClick = [this] { generator.sendStop(); };
+    continueButton.onClick = [this] { generator.sendContinue(); };
+    locateButton.onClick = [this]
+    {
+        if (! generator.setSongPosition (position.getText().getIntValue()))
+            showMessage ("Stop the transport before moving the song position.");
+    };
+
+    for (auto* button : { &runButton, &startButton, &stopButton, &continueButton, &locateButton, &listenButton })
+        addAndMakeVisible (*button);
+}
+
+void ClockPanel::runOrStop()
+{
+    if (generator.isRunning())
+    {
+        generator.stop();
+    }
+    else
+    {
+        if (! generator.start (getOutput(), tempo.getValue()))
+            showMessage (openFirst ("an output"));
+    }
+
+    refresh();
+}
+
+void ClockPanel::listenOrStop()
+{
+    if (analyzer.isRunning())
+    {
+        analyzer.stop();
+    }
+    else
+    {
+        // drift is measured against the tempo set here
+        if (! analyzer.start (getInput(), tempo.getValue()))
+            showMessage (openFirst ("an input"));
+    }
+
+    refresh();
+}
+
+void ClockPanel::update()
+{
+    auto running = generator.isRunning();
+    runButton.setButtonText (running ? "Stop clock" : "Run clock");
+
+    for (auto* button : { &startButton, &stopButton, &continueButton, &locateButton })
+        button->setEnabled (running);
+
+    listenButton.setButtonText (analyzer.isRunning() ? "Stop analyzing" : "Analyze input");
+}
+
+String ClockPanel::getReportText()
+{
+    auto text = generator.getReport();
+    auto incoming = analyzer.getReport();
+
+    if (incoming.isNotEmpty())
+        text << (text.isNotEmpty() ? "\n" : "") << incoming;
+
+    return text;
+}
+
+void ClockPanel::resized()
+{
+    auto area = layOutPair();
+
+    auto row = area.removeFromTop (rowHeight);
+    tempoLabel.setBounds (row.removeFromLeft (50));
+    runButton.setBounds (row.removeFromRight (90).reduced (2));
+    tempo.setBounds (row.reduced (2));
+    area.removeFromTop (4);
+
+    row = area.removeFromTop (rowHeight);
+    startButton.setBounds (row.removeFromLeft (80).reduced (2));
+    stopButton.setBounds (row.removeFromLeft (80).reduced (2));
+    continueButton.setBounds (row.removeFromLeft (80).reduced (2));
+    row.removeFromLeft (20);
+    positionLabel.setBounds (row.removeFromLeft (50));
+    position.setBounds (row.removeFromLeft (80).reduced (2));
+    locateButton.setBounds (row.removeFromLeft (80).reduced (2));
+    listenButton.setBounds (row.removeFromRight (120).reduced (2));
+
+    area.removeFromTop (10);
+    report.setBounds (area);
+}
@@ -0,0 +1,147 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+#include "ClockAnalyzer.h"
+#include "LatencyHistogram.h"
+#include "MidiTestPorts.h"
+#include "ToolPanel.h"
+
+//==============================================================================
+/**
+    Sends MIDI clock at 24 ticks per quarter note, with Start, Stop, Continue
+    and Song Position Pointer.
+
+    Tick n is due at a fixed anchor time plus n tick lengths, so rounding
+    and late wake-ups never add up to drift. A tempo change moves the anchor
+    to the last tick sent, so the tick after it is the first at the new
+    tempo. Transport messages go out just before the next tick, which makes
+    that tick the first one counted after a Start or Continue.
+
+    The timing thread sleeps until shortly before each tick and spins for the
+    rest. Ticks are queued at real-time priority. The generator measures how
+    late each tick was queued, and how late it left the scheduler, against
+    when it was due, so the quality of the reference is known.
+*/
+class ClockGenerator  : private Thread,
+                        private MidiOutputScheduler::Monitor
+{
+public:
+    enum { ticksPerQuarter = 24, ticksPerSixteenth = 6 };
+
+    //==============================================================================
+    explicit ClockGenerator (MidiTestPorts& ports);
+    ~ClockGenerator();
+
+    /** Starts the ticks, with the transport stopped. Returns false if the
+        output isn't open.
+    */
+    bool start (MidiDeviceListEntry::Ptr output, double bpm);
+
+    /** Sends Stop if the transport is running, then stops the ticks. */
+    void stop();
+    bool isRunning() const                  { return isThreadRunning(); }
+
+    /** Takes effect from the next tick. */
+    void setTempo (double bpm);
+    double getTempo() const noexcept        { return tempo.load(); }
+
+    /** These go out with the next tick. */
+    void sendStart();
+    void sendStop();
+    void sendContinue();
+
+    /** Moves the song position, in sixteenth notes. Only while stopped;
+        returns false otherwise.
+    */
+    bool setSongPosition (int sixteenths);
+
+    bool isPlaying() const noexcept         { return playing.load(); }
+    int64 getSongPositionTicks() const noexcept { return songPosition.load(); }
+
+    String getReport() const;
+
+private:
+    //==============================================================================
+    enum Command { noCommand = 0, startCommand, stopCommand, continueCommand };
+    enum { idealRingSize = 1024, spinMs = 2 };
+
+    void run() override;
+    void sendTransport();
+    void messageSent (MidiOutputScheduler::Destination& destination, const MidiMessage& message, double time) override;
+
+    MidiTestPorts& ports;
+    MidiDeviceListEntry::Ptr output;
+    std::atomic<MidiOutputScheduler::Destination*> outputDestination { nullptr };
+
+    std::atomic<double> tempo { 120.0 };
+    std::atomic<int> pendingCommand { noCommand };
+    std::atomic<int> pendingPosition { -1 };
+    std::atomic<bool> playing { false };
+    std::atomic<int64> songPosition { 0 };
+
+    // when each queued tick was due, for the monitor to compare against
+    std::atomic<double> idealTimes[idealRingSize];
+    std::atomic<int64> ticksQueued { 0 }, ticksRefused { 0 };
+
+    // scheduler thread only
+    int64 ticksSeen = 0;
+    double lastSentAt = 0.0, lastIdeal = 0.0;
+
+    LatencyHistogram queueError, sendError;
+    SpinLock intervalLock;
+    double intervalSum = 0.0, intervalSumSquares = 0.0, worstInterval = 0.0;
+    int64 intervalCount = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ClockGenerator)
+};
+
+//==============================================================================
+class ClockPanel  : public ToolPanel
+{
+public:
+    ClockPanel (ClockGenerator& generator, ClockAnalyzer& analyzer, MidiTestPorts& ports);
+
+    void resized() override;
+
+private:
+    String getReportText() override;
+    void update() override;
+    void runOrStop();
+    void listenOrStop();
+
+    ClockGenerator& generator;
+    ClockAnalyzer& analyzer;
+    Label tempoLabel, positionLabel;
+    Slider tempo;
+    TextEditor position;
+    TextButton runButton { "Run clock" }, startButton { "Start" }, stopButton { "Stop" },
+               continueButton { "Continue" }, locateButton { "Locate" }, listenButton { "Analyze input" };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ClockPanel)
+};
@@ -0,0 +1,110 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#include "ControllerEncoder.h"
+
+//==============================================================================
+void ControllerEncoder::setController (int controllerOrParameterNumber)
+{
+    controller = controllerOrParameterNumber;
+    reset();
+}
+
+void ControllerEncoder::setMode (Mode newMode)
+{
+    mode = newMode;
+    reset();
+}
+
+String ControllerEncoder::getModeName (Mode m)
+{
+    switch (m)
+    {
+        case fourteenBitCC:  return "14-bit CC";
+        case nrpn:           return "NRPN";
+        case sevenBitCC:
+        default:             return "7-bit CC";
+    }
+}
+
+//==============================================================================
+int ControllerEncoder::encode (int channel, int value, ChannelState& state, MidiMessage* dest)
+{
+    jassert (channel > 0 && channel <= 16);
+    value = jlimit (0, getMaximumValue(), value);
+
+    if (channel != lastChannel)
+        reset();
+
+    int numMessages = 0;
+
+    if (mode == sevenBitCC)
+    {
+        if (value != lastValue)
+            dest[numMessages++] = MidiMessage::controllerEvent (channel, controller, value);
+    }
+    else
+    {
+        int msbController = controller;
+        int lsbController = controller + 32;
+
+        if (mode == nrpn)
+        {
+            jassert (isPositiveAndBelow (controller, 16384));
+            auto& selected = state.selectedNrpn[channel - 1];
+
+            if (selected != controller)
+            {
+                dest[numMessages++] = MidiMessage::controllerEvent (channel, 99, controller >> 7);
+                dest[numMessages++] = MidiMessage::controllerEvent (channel, 98, controller & 0x7f);
+                selected = controller;
+                reset();
+            }
+
+            msbController = 6;
+            lsbController = 38;
+        }
+        else
+        {
+            jassert (isPositiveAndBelow (controller, 32));
+        }
+
+        auto msb = value >> 7;
+        auto lsb = value & 0x7f;
+        auto msbChanged = lastValue < 0 || (lastValue >> 7) != msb;
+
+        // a new MSB clears the receiver's LSB, so a zero LSB needn't follow it
+        if (msbChanged)
+            dest[numMessages++] = MidiMessage::controllerEvent (channel, msbController, msb);
+
+        if (msbChanged ? lsb != 0 : lsb != (lastValue & 0x7f))
+            dest[numMessages++] = MidiMessage::controllerEvent (channel, lsbController, lsb);
+    }
+
+    lastChannel = channel;
+    lastValue = value;
+    return numMessages;
+}
@@ -0,0 +1,88 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+
+//==============================================================================
+/**
+    Turns a knob value into the shortest run of controller messages that gets
+    it to the device, in plain 7-bit CC, 14-bit MSB/LSB CC pair or NRPN form.
+
+    The encoder remembers what the receiver already holds: an unchanged MSB is
+    not resent, and the NRPN parameter number is only sent when a different
+    parameter was last selected on that channel.
+*/
+class ControllerEncoder
+{
+public:
+    enum Mode
+    {
+        sevenBitCC = 0,
+        fourteenBitCC,
+        nrpn
+    };
+
+    /** NRPN selection is per channel on the receiver, so every encoder that
+        talks to the same device has to share one of these.
+    */
+    struct ChannelState
+    {
+        ChannelState()      { reset(); }
+        void reset()        { for (auto& p : selectedNrpn) p = -1; }
+
+        int selectedNrpn[16];
+    };
+
+    enum { maxMessages = 4 };
+
+    //==============================================================================
+    ControllerEncoder() = default;
+
+    /** For the CC modes this is the MSB controller (0-31, LSB is +32),
+        for NRPN it is the 14-bit parameter number.
+    */
+    void setController (int controllerOrParameterNumber);
+    void setMode (Mode newMode);
+    Mode getMode() const noexcept           { return mode; }
+    int getMaximumValue() const noexcept    { return mode == sevenBitCC ? 127 : 16383; }
+
+    /** Forgets what was last sent, so the next value goes out in full. */
+    void reset() noexcept                   { lastChannel = -1; lastValue = -1; }
+
+    /** Writes up to maxMessages messages into dest and returns how many. */
+    int encode (int channel, int value, ChannelState& state, MidiMessage* dest);
+
+    static String getModeName (Mode m);
+
+private:
+    //==============================================================================
+    Mode mode = sevenBitCC;
+    int controller = 0;
+    int lastChannel = -1;
+    int lastValue = -1;
+};
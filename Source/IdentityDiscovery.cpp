@@ -0,0 +1,193 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#include "IdentityDiscovery.h"
+
+namespace
+{
+    const uint8 identityRequest[] = { 0xf0, 0x7e, 0x7f, 0x06, 0x01, 0xf7 };
+
+    bool isIdentityReply (const uint8* data, int size) noexcept
+    {
+        return size >= 15 && data[0] == 0xf0 && data[1] == 0x7e && data[3] == 0x06 && data[4] == 0x02;
+    }
+}
+
+//==============================================================================
+IdentityDiscovery::IdentityDiscovery (MidiTestPorts& p)
+    : ports (p)
+{
+}
+
+IdentityDiscovery::~IdentityDiscovery()
+{
+    stopTimer();
+    ports.removeListener (this);
+}
+
+bool IdentityDiscovery::discover (int timeoutMs)
+{
+    if (isRunning())
+        return false;
+
+    inputs = ports.getOpenDevices (true);
+    outputs = ports.getOpenDevices (false);
+
+    if (outputs.isEmpty() || inputs.isEmpty())
+        return false;
+
+    replyFifo.reset();
+    ports.addListener (this);
+
+    MidiMessage request (identityRequest, (int) sizeof (identityRequest));
+
+    for (auto* output : outputs)
+        ports.getScheduler().send (*output, request);
+
+    startTimer (jmax (10, timeoutMs));
+    return true;
+}
+
+void IdentityDiscovery::timerCallback()
+{
+    stopTimer();
+    ports.removeListener (this);
+
+    // every different answer heard on each input
+    std::map<MidiDeviceListEntry*, StringArray> answers;
+
+    int start1, size1, start2, size2;
+    replyFifo.prepareToRead (replyFifo.getNumReady(), start1, size1, start2, size2);
+
+    auto collect = [&] (const Reply& reply)
+    {
+        answers[reply.source].addIfNotAlreadyThere (describeReply (reply.data, reply.size));
+    };
+
+    for (int i = 0; i < size1; ++i)  collect (replies[start1 + i]);
+    for (int i = 0; i < size2; ++i)  collect (replies[start2 + i]);
+
+    replyFifo.finishedRead (size1 + size2);
+
+    for (auto* input : inputs)
+    {
+        auto found = answers.find (input);
+        input->identity = found != answers.end() ? found->second.joinIntoString (" + ") : String ("no reply");
+    }
+
+    for (auto* output : outputs)
+    {
+        output->identity = "no reply";
+
+        for (auto* input : inputs)
+            if (input->deviceInfo.name == output->deviceInfo.name)
+                output->identity = input->identity;
+    }
+
+    inputs.clear();
+    outputs.clear();
+
+    if (onFinished != nullptr)
+        onFinished();
+}
+
+void IdentityDiscovery::midiReceived (MidiDeviceListEntry* source, const MidiMessage& message)
+{
+    // This is called on the MIDI thread
+    auto* data = message.getRawData();
+    auto size = message.getRawDataSize();
+
+    if (! isIdentityReply (data, size))
+        return;
+
+    int start1, size1, start2, size2;
+    replyFifo.prepareToWrite (1, start1, size1, start2, size2);
+
+    if (size1 == 0)
+        return;
+
+    auto& reply = replies[start1];
+    reply.source = source;
+    reply.size = jmin (size, (int) maxReplySize);
+    memcpy (reply.data, data, (size_t) reply.size);
+    replyFifo.finishedWrite (1);
+}
+
+//==============================================================================
+String IdentityDiscovery::getManufacturerName (const uint8* id, int length)
+{
+    struct Manufacturer { uint8 id[3]; const char* name; };
+
+    static const Manufacturer known[] =
+    {
+        { { 0x01 }, "Sequential" },
+        { { 0x04 }, "Moog" },
+        { { 0x06 }, "Lexicon" },
+        { { 0x18 }, "E-mu" },
+        { { 0x40 }, "Kawai" },
+        { { 0x41 }, "Roland" },
+        { { 0x42 }, "Korg" },
+        { { 0x43 }, "Yamaha" },
+        { { 0x44 }, "Casio" },
+        { { 0x47 }, "Akai" },
+        { { 0x7d }, "Non-commercial" },
+        { { 0x00, 0x01, 0x0c }, "Line 6" },
+        { { 0x00, 0x20, 0x29 }, "Novation" },
+        { { 0x00, 0x20, 0x32 }, "Behringer" },
+        { { 0x00, 0x20, 0x3c }, "Elektron" }
+    };
+
+    for (auto& m : known)
+        if ((length == 1 && m.id[0] == id[0] && m.id[0] != 0)
+             || (length == 3 && m.id[0] == 0 && m.id[1] == id[1] && m.id[2] == id[2]))
+            return m.name;
+
+    return "Manufacturer " + String::toHexString (id, length).toUpperCase();
+}
+
+String IdentityDiscovery::describeReply (const uint8* data, int size)
+{
+    if (! isIdentityReply (data, size))
+        return {};
+
+    // a zero first byte means a three byte manufacturer ID
+    auto idLength = data[5] == 0 ? 3 : 1;
+    auto* rest = data + 5 + idLength;
+
+    if (size < 5 + idLength + 8 + 1)
+        return {};
+
+    auto family = rest[0] | (rest[1] << 7);
+    auto member = rest[2] | (rest[3] << 7);
+
+    String s;
+    s << getManufacturerName (data + 5, idLength)
+      << ", family 0x" << String::toHexString (family).paddedLeft ('0', 4)
+      << " model 0x" << String::toHexString (member).paddedLeft ('0', 4)
+      << ", v" << (int) rest[4] << "." << (int) rest[5] << "." << (int) rest[6] << "." << (int) rest[7];
+
+    return s;
+}
@@ -0,0 +1,89 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+#include "MidiTestPorts.h"
+
+//==============================================================================
+/**
+    Asks every open output who is there, all at once, and labels the devices
+    with the answers.
+
+    A Universal Identity Request goes to every open output together, and the
+    replies are collected from every open input within one timeout, so the
+    whole round takes one timeout however many ports there are. Each input
+    is labelled with the identity that arrived on it. An output can't say
+    which reply was its own, so it takes the label of the input with the
+    same name, which is how drivers name the two halves of one port.
+*/
+class IdentityDiscovery  : private MidiTestPorts::Listener,
+                           private Timer
+{
+public:
+    explicit IdentityDiscovery (MidiTestPorts& ports);
+    ~IdentityDiscovery();
+
+    /** Sends the requests. Returns false if nothing is open or a round is
+        already running.
+    */
+    bool discover (int timeoutMs = 1000);
+    bool isRunning() const noexcept         { return isTimerRunning(); }
+
+    /** Called on the message thread when a round has finished and the device
+        labels have been updated.
+    */
+    std::function<void()> onFinished;
+
+    /** "Roland, family 0x0123 model 0x0004, v1.2.0.0", or an empty string if
+        the message isn't an identity reply.
+    */
+    static String describeReply (const uint8* data, int size);
+    static String getManufacturerName (const uint8* id, int length);
+
+private:
+    //==============================================================================
+    enum { maxReplies = 64, maxReplySize = 32 };
+
+    struct Reply
+    {
+        MidiDeviceListEntry* source = nullptr;
+        int size = 0;
+        uint8 data[maxReplySize];
+    };
+
+    void timerCallback() override;
+    void midiReceived (MidiDeviceListEntry* source, const MidiMessage& message) override;
+
+    MidiTestPorts& ports;
+    ReferenceCountedArray<MidiDeviceListEntry> inputs, outputs;
+
+    AbstractFifo replyFifo { maxReplies };
+    Reply replies[maxReplies];
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (IdentityDiscovery)
+};
@@ -0,0 +1,160 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#include "LatencyHistogram.h"
+
+//==============================================================================
+LatencyHistogram::LatencyHistogram()
+{
+    reset();
+}
+
+void LatencyHistogram::reset() noexcept
+{
+    for (auto& c : counts)
+        c.store (0, std::memory_order_relaxed);
+
+    count = 0;
+    sum = 0;
+    minimum = std::numeric_limits<int64>::max();
+    maximum = 0;
+}
+
+int LatencyHistogram::getIndex (int64 micros) noexcept
+{
+    if (micros < linearBuckets)
+        return (int) jmax ((int64) 0, micros);
+
+    int shift = 1;
+
+    while ((micros >> shift) >= linearBuckets)
+        ++shift;
+
+    if (shift > numOctaves)
+        return numBuckets - 1;
+
+    return linearBuckets + (shift - 1) * bucketsPerOctave + (int) ((micros >> shift) - bucketsPerOctave);
+}
+
+int64 LatencyHistogram::getHighestValueAt (int index) noexcept
+{
+    if (index < linearBuckets)
+        return index;
+
+    auto octave = (index - linearBuckets) / bucketsPerOctave;
+    auto subBucket = (int64) ((index - linearBuckets) % bucketsPerOctave + bucketsPerOctave);
+    auto shift = octave + 1;
+
+    return ((subBucket + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record (double milliseconds) noexcept
+{
+    auto micros = (int64) (jmax (0.0, milliseconds) * 1000.0 + 0.5);
+
+    counts[getIndex (micros)].fetch_add (1, std::memory_order_relaxed);
+    sum += micros;
+    ++count;
+
+    auto low = minimum.load();
+    while (micros < low && ! minimum.compare_exchange_weak (low, micros)) {}
+
+    auto high = maximum.load();
+    while (micros > high && ! maximum.compare_exchange_weak (high, micros)) {}
+}
+
+//==============================================================================
+double LatencyHistogram::getMinimum() const noexcept
+{
+    return count.load() > 0 ? (double) minimum.load() * 0.001 : 0.0;
+}
+
+double LatencyHistogram::getMaximum() const noexcept
+{
+    return (double) maximum.load() * 0.001;
+}
+
+double LatencyHistogram::getMean() const noexcept
+{
+    auto n = count.load();
+    return n > 0 ? (double) sum.load() * 0.001 / (double) n : 0.0;
+}
+
+double LatencyHistogram::getPercentile (double percent) const noexcept
+{
+    // count from the buckets themselves so a concurrent record() can't push the target out of reach
+    int64 total = 0;
+
+    for (auto& c : counts)
+        total += c.load (std::memory_order_relaxed);
+
+    if (total == 0)
+        return 0.0;
+
+    auto target = jmax ((int64) 1, (int64) std::ceil (jlimit (0.0, 100.0, percent) * 0.01 * (double) total));
+    int64 seen = 0;
+
+    for (int i = 0; i < numBuckets; ++i)
+    {
+        seen += counts[i].load (std::memory_order_relaxed);
+
+        if (seen >= target)
+            return (double) jmin (getHighestValueAt (i), maximum.load()) * 0.001;
+    }
+
+    return getMaximum();
+}
+
+//==============================================================================
+String LatencyHistogram::getSummary() const
+{
+    String s;
+    s << "n " << getCount()
+      << "  min " << String (getMinimum(), 3)
+      << "  p50 " << String (getPercentile (50.0), 3)
+      << "  p90 " << String (getPercentile (90.0), 3)
+      << "  p99 " << String (getPercentile (99.0), 3)
+      << "  p99.9 " << String (getPercentile (99.9), 3)
+      << "  max " << String (getMaximum(), 3) << " ms";
+    return s;
+}
+
+String LatencyHistogram::getPercentileTable() const
+{
+    const double percentiles[] = { 50.0, 75.0, 90.0, 95.0, 99.0, 99.9, 99.99, 100.0 };
+    auto n = getCount();
+    String s;
+
+    for (auto p : percentiles)
+    {
+        auto label = p < 100.0 ? "p" + String (p) : String ("max");
+        s << label.paddedRight (' ', 8)
+          << String (getPercentile (p), 3).paddedLeft (' ', 10) << " ms"
+          << String ((int64) std::ceil (p * 0.01 * (double) n)).paddedLeft (' ', 10) << " samples\n";
+    }
+
+    return s;
+}
@@ -0,0 +1,80 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+
+//==============================================================================
+/**
+    A latency histogram in the style of HdrHistogram.
+
+    Values are kept in microseconds. Below 128 us every microsecond has its own
+    bucket; above that each power-of-two range is split into 64 buckets, so any
+    value is known to within 1.6% from a microsecond up to days, in a fixed
+    block of counters. One thread may record while others read.
+*/
+class LatencyHistogram
+{
+public:
+    LatencyHistogram();
+
+    void record (double milliseconds) noexcept;
+    void reset() noexcept;
+
+    int64 getCount() const noexcept             { return count.load(); }
+    double getMinimum() const noexcept;
+    double getMaximum() const noexcept;
+    double getMean() const noexcept;
+
+    /** The value at or below which the given percentage of samples fall,
+        in milliseconds.
+    */
+    double getPercentile (double percent) const noexcept;
+
+    /** "n 1000  min 1.02  p50 ..  p90 ..  p99 ..  p99.9 ..  max .. ms" */
+    String getSummary() const;
+
+    /** One line per percentile from p50 to max, with the sample count below it. */
+    String getPercentileTable() const;
+
+private:
+    enum
+    {
+        linearBuckets = 128,
+        bucketsPerOctave = 64,
+        numOctaves = 40,
+        numBuckets = linearBuckets + numOctaves * bucketsPerOctave
+    };
+
+    static int getIndex (int64 micros) noexcept;
+    static int64 getHighestValueAt (int index) noexcept;
+
+    std::atomic<uint32> counts[numBuckets];
+    std::atomic<int64> count { 0 }, sum { 0 }, minimum, maximum;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (LatencyHistogram)
+};
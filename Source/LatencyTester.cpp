@@ -0,0 +1,370 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#include "LatencyTester.h"
+#include "RealtimeThreads.h"
+
+namespace
+{
+    const uint8 nonCommercialId = 0x7d;
+    const uint8 probeType = 'L';
+    const uint8 loadType = 'N';
+    const int probeDataSize = 6;                // id, type and a 28-bit sequence number
+    const int64 sequenceMask = (1 << 28) - 1;
+    const int loadController = 3;               // undefined in the MIDI spec, so nothing should act on it
+    const int loadSysExSize = 128;
+    const double dinBytesPerSecond = 3125.0;
+}
+
+//==============================================================================
+LatencyTester::LatencyTester (MidiTestPorts& p)
+    : Thread ("MIDI latency test"), ports (p)
+{
+    for (auto& s : slotSequence)
+        s = -1;
+
+    for (auto& t : slotSentAt)
+        t = 0.0;
+}
+
+LatencyTester::~LatencyTester()
+{
+    stop();
+}
+
+StringArray LatencyTester::getLoadNames()
+{
+    return { "No load", "Controller stream", "SysEx dumps" };
+}
+
+//==============================================================================
+bool LatencyTester::start (MidiDeviceListEntry::Ptr newOutput, MidiDeviceListEntry::Ptr newInput, const Settings& newSettings)
+{
+    stop();
+
+    if (newOutput == nullptr || ! newOutput->isOutputOpen()
+         || newInput == nullptr || ! newInput->isInputOpen())
+        return false;
+
+    output = newOutput;
+    input = newInput;
+    settings = newSettings;
+    settings.probesPerSecond = jlimit (1.0, 1000.0, settings.probesPerSecond);
+    settings.timeoutMs = jlimit (10.0, 0.5 * maxInFlight * 1000.0 / settings.probesPerSecond, settings.timeoutMs);
+    conditions = RealtimeThreads::getConditionsSummary();
+
+    for (auto& s : slotSequence)
+        s = -1;
+
+    nextSequence = 0;
+    oldestInFlight = 0;
+    histogram.reset();
+    sent = 0;
+    received = 0;
+    lost = 0;
+    unexpected = 0;
+    loadMessages = 0;
+
+    if (settings.load == sysExLoad)
+    {
+        uint8 dump[loadSysExSize - 2] = { nonCommercialId, loadType };
+
+        for (int i = 2; i < (int) sizeof (dump); ++i)
+            dump[i] = (uint8) (i & 0x7f);
+
+        loadMessage = MidiMessage::createSysExMessage (dump, (int) sizeof (dump));
+    }
+
+    inputDevice = input.get();
+    ports.addListener (this);
+    ports.getClock().threadStarting (*this);
+    startThread (9);
+    return true;
+}
+
+void LatencyTester::stop()
+{
+    stopThread (1000);
+    ports.removeListener (this);
+    inputDevice = nullptr;
+}
+
+LatencyTester::Results LatencyTester::getResults() const
+{
+    Results r;
+    r.sent = sent.load();
+    r.received = received.load();
+    r.lost = lost.load();
+    r.unexpected = unexpected.load();
+    r.loadMessages = loadMessages.load();
+    return r;
+}
+
+//==============================================================================
+void LatencyTester::run()
+{
+    auto& clock = ports.getClock();
+    const VirtualClock::ScopedThread participant (clock, *this);
+    auto probeInterval = 1000.0 / settings.probesPerSecond;
+    auto loadInterval = 0.0;
+
+    if (settings.load != noLoad && settings.loadPercent > 0.0)
+    {
+        auto loadBytes = settings.load == sysExLoad ? loadMessage.getRawDataSize() : 3;
+        loadInterval = loadBytes * 1000.0 / (dinBytesPerSecond * settings.loadPercent * 0.01);
+    }
+
+    auto nextProbe = clock.now();
+    auto nextLoad = nextProbe;
+
+    while (! threadShouldExit())
+    {
+        RealtimeThreads::applyToCurrentThread (RealtimeThreads::timingThread);
+        auto now = clock.now();
+
+        if (now >= nextProbe)
+        {
+            sendProbe (now);
+            nextProbe += probeInterval;
+
+            if (nextProbe < now)
+                nextProbe = now + probeInterval;
+        }
+
+        if (loadInterval > 0.0 && now >= nextLoad)
+        {
+            sendLoad();
+            nextLoad += loadInterval;
+
+            // a stalled thread shouldn't come back with a burst of load
+            if (nextLoad < now - 100.0)
+                nextLoad = now;
+        }
+
+        expireProbes (now);
+
+        clock.waitUntil (*this, loadInterval > 0.0 ? jmin (nextProbe, nextLoad) : nextProbe);
+    }
+}
+
+void LatencyTester::sendProbe (double now)
+{
+    if (nextSequence - oldestInFlight >= maxInFlight)
+        return;
+
+    auto sequence = nextSequence++ & sequenceMask;
+    auto slot = (int) (sequence % maxInFlight);
+
+    uint8 data[] = { 0xf0, nonCommercialId, probeType,
+                     (uint8) (sequence & 0x7f), (uint8) ((sequence >> 7) & 0x7f),
+                     (uint8) ((sequence >> 14) & 0x7f), (uint8) ((sequence >> 21) & 0x7f),
+                     0xf7 };
+
+    slotSentAt[slot].store (now, std::memory_order_relaxed);
+    slotSequence[slot].store (sequence, std::memory_order_release);
+    ++sent;
+
+    // a probe the queue won't take is as lost as one the cable dropped
+    if (! ports.getScheduler().send (*output, MidiMessage (data, (int) sizeof (data), now * 0.001),
+                                     MidiOutputScheduler::voicePriority))
+    {
+        auto expected = sequence;
+
+        if (slotSequence[slot].compare_exchange_strong (expected, -1))
+            ++lost;
+    }
+}
+
+void LatencyTester::sendLoad()
+{
+    bool queued;
+
+    if (settings.load == sysExLoad)
+        queued = ports.getScheduler().send (*output, loadMessage);
+    else
+        queued = ports.getScheduler().send (*output, MidiMessage::controllerEvent (settings.loadChannel, loadController,
+                                                                                   loadValue++ & 0x7f));
+
+    if (queued)
+        ++loadMessages;
+}
+
+void LatencyTester::expireProbes (double now)
+{
+    while (oldestInFlight < nextSequence)
+    {
+        auto sequence = oldestInFlight & sequenceMask;
+        auto slot = (int) (sequence % maxInFlight);
+        auto current = slotSequence[slot].load();
+
+        if (current == sequence)
+        {
+            if (now - slotSentAt[slot].load (std::memory_order_relaxed) < settings.timeoutMs)
+                break;
+
+            if (slotSequence[slot].compare_exchange_strong (current, -1))
+                ++lost;
+        }
+
+        ++oldestInFlight;
+    }
+}
+
+//==============================================================================
+void LatencyTester::midiReceived (MidiDeviceListEntry* source, const MidiMessage& message)
+{
+    // This is called on the MIDI thread
+    if (source != inputDevice.load() || ! message.isSysEx())
+        return;
+
+    auto now = ports.getClock().now();
+    auto* data = message.getSysExData();
+
+    if (message.getSysExDataSize() != probeDataSize || data[0] != nonCommercialId || data[1] != probeType)
+        return;
+
+    auto sequence = (int64) data[2] | ((int64) data[3] << 7) | ((int64) data[4] << 14) | ((int64) data[5] << 21);
+    auto slot = (int) (sequence % maxInFlight);
+    auto expected = sequence;
+
+    // the acquire makes the send time the one stored with this sequence, and
+    // the slot can't be reused until the exchange below has freed it
+    if (slotSequence[slot].load (std::memory_order_acquire) == sequence)
+    {
+        auto sentAt = slotSentAt[slot].load (std::memory_order_relaxed);
+
+        if (slotSequence[slot].compare_exchange_strong (expected, -1))
+        {
+            histogram.record (now - sentAt);
+            ++received;
+            return;
+        }
+    }
+
+    // a duplicate, or a probe that already timed out
+    ++unexpected;
+}
+
+//==============================================================================
+String LatencyTester::getReport() const
+{
+    if (output == nullptr || input == nullptr)
+        return {};
+
+    auto r = getResults();
+    auto inFlight = jmax ((int64) 0, r.sent - r.received - r.lost);
+    String s;
+
+    s << "Round trip: " << output->deviceInfo.name << " -> " << input->deviceInfo.name << "\n"
+      << String (settings.probesPerSecond) << " probes/s, " << getLoadNames()[(int) settings.load];
+
+    if (settings.load != noLoad)
+        s << " at " << String (settings.loadPercent) << "% of DIN rate (" << String (r.loadMessages) << " messages)";
+
+    s << "\nThreads: " << conditions << "\n"
+      << "Sent " << r.sent << "  received " << r.received << "  lost " << r.lost
+      << "  in flight " << inFlight << "  unexpected " << r.unexpected << "\n\n"
+      << histogram.getSummary() << "\n\n"
+      << histogram.getPercentileTable();
+
+    return s;
+}
+
+//==============================================================================
+LatencyPanel::LatencyPanel (LatencyTester& t, MidiTestPorts& ports)
+    : ToolPanel (ports), tester (t)
+{
+    rateLabel.setText ("Probe rate:", dontSendNotification);
+    addAndMakeVisible (rateLabel);
+    rate.setSliderStyle (Slider::LinearHorizontal);
+    rate.setTextBoxStyle (Slider::TextBoxRight, false, 70, 20);
+    rate.setRange (1.0, 1000.0, 1.0);
+    rate.setSkewFactorFromMidPoint (50.0);
+    rate.setTextValueSuffix (" /s");
+    rate.setValue (20.0, dontSendNotification);
+    addAndMakeVisible (rate);
+
+    loadLabel.setText ("Background:", dontSendNotification);
+    addAndMakeVisible (loadLabel);
+    load.addItemList (LatencyTester::getLoadNames(), 1);
+    load.setSelectedItemIndex (0, dontSendNotification);
+    addAndMakeVisible (load);
+
+    loadPercent.setSliderStyle (Slider::LinearHorizontal);
+    loadPercent.setTextBoxStyle (Slider::TextBoxRight, false, 70, 20);
+    loadPercent.setRange (1.0, 100.0, 1.0);
+    loadPercent.setTextValueSuffix ("% DIN");
+    loadPercent.setValue (50.0, dontSendNotification);
+    addAndMakeVisible (loadPercent);
+
+    startButton.onClick = [this] { startOrStop(); };
+    addAndMakeVisible (startButton);
+}
+
+void LatencyPanel::startOrStop()
+{
+    if (tester.isRunning())
+    {
+        tester.stop();
+    }
+    else
+    {
+        LatencyTester::Settings settings;
+        settings.probesPerSecond = rate.getValue();
+        settings.load = (LatencyTester::Load) load.getSelectedItemIndex();
+        settings.loadPercent = loadPercent.getValue();
+
+        if (! tester.start (getOutput(), getInput(), settings))
+            showMessage ("Open an output and an input on the main page, and connect them with a loopback cable or through the pedal.");
+    }
+
+    startButton.setButtonText (tester.isRunning() ? "Stop" : "Start");
+    refresh();
+}
+
+String LatencyPanel::getReportText()
+{
+    return tester.getReport();
+}
+
+void LatencyPanel::resized()
+{
+    auto area = layOutPair();
+
+    auto row = area.removeFromTop (rowHeight);
+    rateLabel.setBounds (row.removeFromLeft (80));
+    rate.setBounds (row.removeFromLeft (250).reduced (2));
+    startButton.setBounds (row.removeFromRight (80).reduced (2));
+    area.removeFromTop (4);
+
+    row = area.removeFromTop (rowHeight);
+    loadLabel.setBounds (row.removeFromLeft (80));
+    load.setBounds (row.removeFromLeft (160).reduced (2));
+    loadPercent.setBounds (row.removeFromLeft (250).reduced (2));
+
+    area.removeFromTop (10);
+    report.setBounds (area);
+}
@@ -0,0 +1,142 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+#include "LatencyHistogram.h"
+#include "MidiTestPorts.h"
+#include "ToolPanel.h"
+
+//==============================================================================
+/**
+    Measures round-trip latency through a loopback cable or a device's MIDI thru.
+
+    Probes are 8-byte non-commercial SysEx messages carrying a sequence number,
+    small enough to stay off the heap. They are queued at channel-voice priority
+    so that they wait the way notes and controllers would. The send time is
+    taken when a probe is queued, so any time spent behind background traffic
+    in the scheduler counts towards its latency. Returns are matched on the
+    MIDI thread as they arrive.
+
+    The optional background load goes to the same output. Controller load
+    shares the probes' queue. SysEx load shows how long a probe is held up
+    behind a SysEx dump that is already on the wire.
+*/
+class LatencyTester  : private Thread,
+                       private MidiTestPorts::Listener
+{
+public:
+    enum Load
+    {
+        noLoad = 0,
+        controllerLoad,
+        sysExLoad
+    };
+
+    struct Settings
+    {
+        double probesPerSecond = 20.0;
+        double timeoutMs = 1000.0;      // probes not back by then are counted as lost
+        Load load = noLoad;
+        double loadPercent = 50.0;      // of the DIN byte rate
+        int loadChannel = 16;
+    };
+
+    struct Results
+    {
+        int64 sent = 0;
+        int64 received = 0;
+        int64 lost = 0;
+        int64 unexpected = 0;           // returns that matched no probe in flight
+        int64 loadMessages = 0;
+    };
+
+    //==============================================================================
+    explicit LatencyTester (MidiTestPorts& ports);
+    ~LatencyTester();
+
+    /** Returns false if either device isn't open. */
+    bool start (MidiDeviceListEntry::Ptr output, MidiDeviceListEntry::Ptr input, const Settings& settings);
+    void stop();
+    bool isRunning() const                  { return isThreadRunning(); }
+
+    const LatencyHistogram& getHistogram() const noexcept   { return histogram; }
+    Results getResults() const;
+    String getReport() const;
+
+    static StringArray getLoadNames();
+
+private:
+    //==============================================================================
+    enum { maxInFlight = 4096 };
+
+    void run() override;
+    void midiReceived (MidiDeviceListEntry* source, const MidiMessage& message) override;
+    void sendProbe (double now);
+    void sendLoad();
+    void expireProbes (double now);
+
+    MidiTestPorts& ports;
+    MidiDeviceListEntry::Ptr output, input;
+    std::atomic<MidiDeviceListEntry*> inputDevice { nullptr };
+    Settings settings;
+    String conditions;
+
+    // a probe's slot holds its sequence number until it is matched or expires
+    std::atomic<int64> slotSequence[maxInFlight];
+    std::atomic<double> slotSentAt[maxInFlight];
+    int64 nextSequence = 0, oldestInFlight = 0;
+
+    MidiMessage loadMessage;
+    int loadValue = 0;
+
+    LatencyHistogram histogram;
+    std::atomic<int64> sent { 0 }, received { 0 }, lost { 0 }, unexpected { 0 }, loadMessages { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (LatencyTester)
+};
+
+//==============================================================================
+class LatencyPanel  : public ToolPanel
+{
+public:
+    explicit LatencyPanel (LatencyTester& tester, MidiTestPorts& ports);
+
+    void resized() override;
+
+private:
+    String getReportText() override;
+    void startOrStop();
+
+    LatencyTester& tester;
+    Label rateLabel, loadLabel;
+    Slider rate, loadPercent;
+    ComboBox load;
+    TextButton startButton { "Start" };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (LatencyPanel)
+};
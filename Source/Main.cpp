@@ -42,11 +42,16 @@ public:
     void initialise (const String& commandLine) override
     {
         // This method is where you should put your application's initialisation code..
-        ignoreUnused (commandLine);
 		String titleName = getApplicationName();
 		titleName += String(" v");
 		titleName += getApplicationVersion();
-        mainWindow = new MainWindow (titleName);
+
+		// waits and pacing skip ahead, so long unattended tests finish in seconds
+		bool useSimulatedTime = StringArray::fromTokens(commandLine, true).contains("--simulated-time");
+		if (useSimulatedTime)
+			titleName += String(" (simulated time)");
+
+        mainWindow = new MainWindow (titleName, useSimulatedTime);
     }
 
     void shutdown() override
@@ -80,13 +85,13 @@ public:
     class MainWindow    : public DocumentWindow
     {
     public:
-        MainWindow (String name)  : DocumentWindow (name,
-                                                    LookAndFeel::getDefaultLookAndFeel()
-                                                                 .findColour (ResizableWindow::backgroundColourId),
-                                                    DocumentWindow::allButtons)
+        MainWindow (String name, bool useSimulatedTime)  : DocumentWindow (name,
+                                                                           LookAndFeel::getDefaultLookAndFeel()
+                                                                                        .findColour (ResizableWindow::backgroundColourId),
+                                                                           DocumentWindow::allButtons)
         {
             setUsingNativeTitleBar (true);
-            setContentOwned (new MainContentComponent(), true);
+            setContentOwned (new MainContentComponent (useSimulatedTime), true);
 
             setResizable (true, false);
 
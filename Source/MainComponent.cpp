@@ -25,29 +25,11 @@
 */
 
 #include "MainComponent.h"
+#include "AllocationAudit.h"
+#include "RealtimeThreads.h"
 
 using std::make_shared;
 
-//==============================================================================
-struct MidiDeviceListEntry : ReferenceCountedObject
-{
-    MidiDeviceListEntry (MidiDeviceInfo info) : deviceInfo (info) {}
-
-    MidiDeviceInfo deviceInfo;
-    std::unique_ptr<MidiInput> inDevice;
-    std::unique_ptr<MidiOutput> outDevice;
-
-    using Ptr = ReferenceCountedObjectPtr<MidiDeviceListEntry>;
-};
-
-
-//==============================================================================
-struct MidiCallbackMessage : public Message
-{
-    MidiCallbackMessage (const MidiMessage& msg) : message (msg) {}
-    MidiMessage message;
-};
-
 //==============================================================================
 class MidiDeviceListBox : public ListBox,
 private ListBoxModel
@@ -100,6 +82,18 @@ public:
                             5, 0, width, height,
                             Justification::centredLeft, true);
         }
+
+        if (rowNumber < getNumRows())
+        {
+            auto identity = parent.getMidiDevice (rowNumber, isInput)->identity;
+
+            if (identity.isNotEmpty())
+            {
+                g.setColour (textColour.withAlpha (0.6f));
+                g.setFont ((float) height * 0.55f);
+                g.drawText (identity, 5, 0, width - 10, height, Justification::centredRight, true);
+            }
+        }
     }
 
     //==============================================================================
@@ -129,7 +123,7 @@ public:
     {
         SparseSet<int> selectedRows;
         for (int i = 0; i < midiDevices.size(); ++i)
-            if (midiDevices[i]->inDevice != nullptr || midiDevices[i]->outDevice != nullptr)
+            if (isInput ? midiDevices[i]->isInputOpen() : midiDevices[i]->isOutputOpen())
                 selectedRows.addRange (Range<int> (i, i+1));
 
         lastSelectedItems = selectedRows;
@@ -231,9 +225,10 @@ void PedalAreaComponent::resized()
 }
 
 //==============================================================================
-MainContentComponent::MainContentComponent ()
+MainContentComponent::MainContentComponent (bool useSimulatedTime)
     : midiInputLabel ("Midi Input Label", "MIDI Input:"),
       midiOutputLabel ("Midi Output Label", "MIDI Output:"),
+      linkRateLabel ("Link Rate Label", "Link:"),
       incomingMidiLabel ("Incoming Midi Label", "Received MIDI messages:"),
       outgoingMidiLabel ("Outgoing Midi Label", "Play the keyboard to send MIDI messages..."),
 	  midiChannelLabel ("Channel Label", "Channel: "),
@@ -241,6 +236,8 @@ MainContentComponent::MainContentComponent ()
       midiKeyboard (keyboardState, MidiKeyboardComponent::horizontalKeyboard),
       midiMonitor ("MIDI Monitor"),
       pairButton ("MIDI Bluetooth devices..."),
+      identifyButton ("Identify devices"),
+      testToolsButton ("Test tools..."),
 	  buttonA ("A"),
 	  buttonB("B"),
 	  knob1 ("1"),
@@ -248,12 +245,22 @@ MainContentComponent::MainContentComponent ()
 	  knob3("3"),
 	  knob4("4"),
       midiInputSelector (new MidiDeviceListBox ("Midi Input Selector", *this, true)),
-      midiOutputSelector (new MidiDeviceListBox ("Midi Input Selector", *this, false))
+      midiOutputSelector (new MidiDeviceListBox ("Midi Input Selector", *this, false)),
+      clock (useSimulatedTime ? static_cast<VirtualClock*> (new SimulatedClock (Time::getMillisecondCounterHiRes()))
+                              : new SystemClock())
 {
     setSize (APP_WIDTH, APP_HEIGHT);
 
     addLabelAndSetStyle (midiInputLabel);
     addLabelAndSetStyle (midiOutputLabel);
+    addLabelAndSetStyle (linkRateLabel);
+    linkRateLabel.setJustificationType (Justification::centredRight);
+
+    linkRateBox.addItem ("DIN (3125 B/s)", dinLinkId);
+    linkRateBox.addItem ("USB (unpaced)", unpacedLinkId);
+    linkRateBox.setSelectedId (dinLinkId, dontSendNotification);
+    linkRateBox.addListener (this);
+    addAndMakeVisible (linkRateBox);
     addLabelAndSetStyle (incomingMidiLabel);
     addLabelAndSetStyle (outgoingMidiLabel);
 	addLabelAndSetStyle (midiChannelLabel);
@@ -262,6 +269,8 @@ MainContentComponent::MainContentComponent ()
 	midiChannelText.setText(String(midiChannel));
 	midiChannelText.setJustification(Justification::centred);
 	addAndMakeVisible(midiChannelText);
+	mpeButton.addListener(this);
+	addAndMakeVisible(mpeButton);
 
     midiKeyboard.setName ("MIDI Keyboard");
     addAndMakeVisible (midiKeyboard);
@@ -281,6 +290,18 @@ MainContentComponent::MainContentComponent ()
     addAndMakeVisible (pairButton);
     pairButton.addListener (this);
 
+    addAndMakeVisible (identifyButton);
+    identifyButton.addListener (this);
+    identityDiscovery.onFinished = [this]
+    {
+        identifyButton.setEnabled (true);
+        midiInputSelector->repaint();
+        midiOutputSelector->repaint();
+    };
+
+    addAndMakeVisible (testToolsButton);
+    testToolsButton.addListener (this);
+
 	// Load/Save Button setup
 	loadButton.setButtonText("LOAD");
 	saveButton.setButtonText("SAVE");
@@ -336,6 +357,21 @@ MainContentComponent::MainContentComponent ()
 	addAndMakeVisible(knob4);
 	addAndMakeVisible(knob4Label);
 
+	// Right-click on a knob picks its controller mode
+	for (int i = 0; i < NUM_KNOBS; ++i) {
+		knobEncoders[i].setController(knob1CCId + i);
+		automation.setEncoder(i, knobEncoders[i]);
+		getKnob(i)->addMouseListener(this, false);
+	}
+	automation.setChannel(midiChannel);
+
+	// the generator sent from its own copies of the encoders, and may have
+	// left another NRPN selected
+	automation.onLaneReleased = [this](int knobIndex) {
+		knobEncoders[knobIndex].reset();
+		nrpnState.reset();
+	};
+
     keyboardState.addListener (this);
     addAndMakeVisible (midiInputSelector);
     addAndMakeVisible (midiOutputSelector);
@@ -349,8 +385,10 @@ MainContentComponent::MainContentComponent ()
 	paramTree->setAttribute(knob4Label.getLabelName(), knob4Label.getText());
 	paramTree->setAttribute(buttonALabel.getLabelName(), buttonALabel.getText());
 	paramTree->setAttribute(buttonBLabel.getLabelName(), buttonBLabel.getText());
+	for (int i = 0; i < NUM_KNOBS; ++i)
+		paramTree->setAttribute(getKnobModeAttribute(i), (int)ControllerEncoder::sevenBitCC);
 
-    startTimer (500);
+    startTimerHz (monitorRefreshHz);
 }
 
 //==============================================================================
@@ -369,6 +407,30 @@ void MainContentComponent::addLabelAndSetStyle (Label& label)
 MainContentComponent::~MainContentComponent()
 {
     stopTimer();
+    testTools = nullptr;
+    automation.onLaneReleased = nullptr;
+    automation.stop();
+    latencyTester.stop();
+    stressTester.stop();
+    bulkTransfer.cancel();
+    sweepVerifier.stop();
+    presetSwitchTester.stop();
+    streamDiff.stop();
+    scriptRunner.stop();
+    rigRunner.stop();
+    soakTester.stop();
+    clockGenerator.stop();
+    clockAnalyzer.stop();
+    mpeStressTester.stop();
+    umpMonitor.stopCapture();
+    umpMonitor.stopBenchmark();
+    captureRecorder.stop();
+    midiFilePlayer.stop();
+    outputScheduler.removeAllDestinations();
+
+    for (auto* entry : midiInputs)
+        entry->closeInput();
+
     midiInputs.clear();
     midiOutputs.clear();
     keyboardState.removeListener (this);
@@ -403,7 +465,13 @@ void MainContentComponent::resized()
 		(getWidth() / 2) - (2 * margin), textRowHeight);
 
     midiOutputLabel.setBounds ((getWidth() / 2) + margin, nextRowStart,
-		(getWidth() / 2) - (2 * margin), 24); nextRowStart += textRowHeight + margin;
+		(getWidth() / 2) - (2 * margin), 24);
+
+	const int linkRateBoxWidth = 130;
+	const int linkRateLabelWidth = 40;
+	linkRateBox.setBounds(getWidth() - margin - linkRateBoxWidth, nextRowStart, linkRateBoxWidth, textRowHeight);
+	linkRateLabel.setBounds(linkRateBox.getX() - linkRateLabelWidth, nextRowStart, linkRateLabelWidth, textRowHeight);
+	nextRowStart += textRowHeight + margin;
 
 	const int deviceListHeight = 4 * textRowHeight;
     midiInputSelector->setBounds (margin, nextRowStart,
@@ -414,8 +482,12 @@ void MainContentComponent::resized()
         (getWidth() / 2) - (2 * margin),
 		deviceListHeight); nextRowStart += deviceListHeight + margin;
 
+	const int testToolsButtonWidth = 120;
     pairButton.setBounds (margin, nextRowStart,
-                          getWidth() - (2 * margin), textRowHeight);  nextRowStart += textRowHeight + margin;
+                          getWidth() - (4 * margin) - (2 * testToolsButtonWidth), textRowHeight);
+	identifyButton.setBounds(getWidth() - (2 * margin) - (2 * testToolsButtonWidth), nextRowStart, testToolsButtonWidth, textRowHeight);
+	testToolsButton.setBounds(getWidth() - margin - testToolsButtonWidth, nextRowStart, testToolsButtonWidth, textRowHeight);
+	nextRowStart += textRowHeight + margin;
 
 	// START CUSTOM CONTROLS
 	int pedalAreaStart = nextRowStart;
@@ -474,6 +546,8 @@ void MainContentComponent::resized()
 	const int midiChannelTextEditWidth = 35;
 	midiChannelText.setBounds(saveButton.getX() - midiChannelTextEditWidth - 2 * margin, nextRowStart, midiChannelTextEditWidth, textRowHeight);
 	midiChannelLabel.setBounds(midiChannelText.getX() - midiChannelLabelWidth, nextRowStart, midiChannelLabelWidth, textRowHeight);
+	const int mpeButtonWidth = 60;
+	mpeButton.setBounds(midiChannelLabel.getX() - mpeButtonWidth - margin, nextRowStart, mpeButtonWidth, textRowHeight);
 
 	outgoingMidiLabel.setBounds(margin, nextRowStart, getWidth() - (2 * margin), textRowHeight); nextRowStart += textRowHeight + margin;
 
@@ -490,14 +564,21 @@ void MainContentComponent::resized()
 //==============================================================================
 void MainContentComponent::buttonClicked(Button* buttonThatWasClicked)
 {
-	bool sendMidi = false;
-	int val;
-	MidiMessage *m = nullptr;
+	int ccId = -1;
 	if (buttonThatWasClicked == &pairButton)
 		RuntimePermissions::request(
 			RuntimePermissions::bluetoothMidi,
 			[](bool wasGranted) { if (wasGranted) BluetoothMidiDevicePairingDialogue::open(); });
 
+	if (buttonThatWasClicked == &identifyButton)
+		identifyButton.setEnabled(! identityDiscovery.discover());
+
+	if (buttonThatWasClicked == &testToolsButton)
+		showTestTools();
+
+	if (buttonThatWasClicked == &mpeButton)
+		setMpeEnabled(mpeButton.getToggleState());
+
 	if (buttonThatWasClicked == &saveButton) {
 		FileChooser myChooser("Please provide the XML filename you want to save...",
 			//File::getSpecialLocation(File::userHomeDirectory),
@@ -521,9 +602,7 @@ void MainContentComponent::buttonClicked(Button* buttonThatWasClicked)
 			paramTree = XmlDocument::parse(xmlFile);
 
 			if (!paramTree) {
-				midiMonitor.insertTextAtCaret(String("Error loading file\n"));
-				midiMonitor.insertTextAtCaret(xmlFile.getFileName());
-				midiMonitor.insertTextAtCaret("\n");
+				appendToMonitor("Error loading file\n" + xmlFile.getFileName() + "\n");
 			}
 		}
 
@@ -535,58 +614,133 @@ void MainContentComponent::buttonClicked(Button* buttonThatWasClicked)
 		knob4Label.setText(paramTree->getStringAttribute(StringRef(knob4Label.getLabelName()), String("Err")), dontSendNotification);
 		buttonALabel.setText(paramTree->getStringAttribute(StringRef(buttonALabel.getLabelName()), String("Err")), dontSendNotification);
 		buttonBLabel.setText(paramTree->getStringAttribute(StringRef(buttonBLabel.getLabelName()), String("Err")), dontSendNotification);
+		for (int i = 0; i < NUM_KNOBS; ++i)
+			setKnobMode(i, (ControllerEncoder::Mode)paramTree->getIntAttribute(StringRef(getKnobModeAttribute(i)), ControllerEncoder::sevenBitCC));
 		
 	} else if (buttonThatWasClicked == &buttonA) {
-		// Send the midi CC		
-		if (!buttonA.getToggleState()) { val = CC_OFF; }
-		else { val = CC_ON; }
-		m = new MidiMessage(MidiMessage::controllerEvent(midiChannel, buttonACCId, val));
-		sendMidi = true;
+		ccId = buttonACCId;
 	} else if (buttonThatWasClicked == &buttonB) {
-		// Send the midi CC		
-		if (!buttonB.getToggleState()) { val = CC_OFF; }
-		else { val = CC_ON; }
-		m = new MidiMessage(MidiMessage::controllerEvent(midiChannel, buttonBCCId, val));
-		sendMidi = true;
+		ccId = buttonBCCId;
 	}
 
-	if (sendMidi && m) {
-		m->setTimeStamp(Time::getMillisecondCounterHiRes() * 0.001);
-		sendToOutputs(*m);
-		delete m;
+	if (ccId >= 0) {
+		// Send the midi CC
+		const AllocationAudit::ScopedSection audit(AllocationAudit::sendPath);
+		int val = buttonThatWasClicked->getToggleState() ? CC_ON : CC_OFF;
+		MidiMessage m(MidiMessage::controllerEvent(midiChannel, ccId, val));
+		m.setTimeStamp(clock->now() * 0.001);
+		sendToOutputs(m);
 	}
 }
 
 //==============================================================================
 void MainContentComponent::sliderValueChanged(Slider* slider)
 {
-	bool sendMidi = false;
-	MidiMessage *m = nullptr;
-	if (slider == &knob1) {
-		m = new MidiMessage(MidiMessage::controllerEvent(midiChannel, knob1CCId, (int)knob1.getValue()));
-		m->setTimeStamp(Time::getMillisecondCounterHiRes() * 0.001);
-		sendToOutputs(*m);
-    } else if (slider == &knob2) {
-		m = new MidiMessage(MidiMessage::controllerEvent(midiChannel, knob2CCId, (int)knob2.getValue()));
-		m->setTimeStamp(Time::getMillisecondCounterHiRes() * 0.001);
-		sendToOutputs(*m);
-	} else if (slider == &knob3) {
-		m = new MidiMessage(MidiMessage::controllerEvent(midiChannel, knob3CCId, (int)knob3.getValue()));
-		m->setTimeStamp(Time::getMillisecondCounterHiRes() * 0.001);
-		sendToOutputs(*m);
-	} else if (slider == &knob4) {
-		m = new MidiMessage(MidiMessage::controllerEvent(midiChannel, knob4CCId, (int)knob4.getValue()));
-		m->setTimeStamp(Time::getMillisecondCounterHiRes() * 0.001);
-		sendToOutputs(*m);
+	int knobIndex = getKnobIndex(slider);
+	if (knobIndex < 0 || automation.isLaneActive(knobIndex))
+		return;
+
+	const AllocationAudit::ScopedSection audit(AllocationAudit::sendPath);
+	auto& encoder = knobEncoders[knobIndex];
+
+	// the generator may have selected another NRPN since we last sent
+	if (automation.isRunning() && encoder.getMode() == ControllerEncoder::nrpn) {
+		nrpnState.reset();
+		automation.invalidateNrpnState();
 	}
 
-	if (sendMidi && m) {
-		m->setTimeStamp(Time::getMillisecondCounterHiRes() * 0.001);
-		sendToOutputs(*m);
-		delete m;
+	MidiMessage messages[ControllerEncoder::maxMessages];
+	int numMessages = encoder.encode(midiChannel, (int)slider->getValue(), nrpnState, messages);
+	double timeStamp = clock->now() * 0.001;
+
+	for (int i = 0; i < numMessages; ++i) {
+		messages[i].setTimeStamp(timeStamp);
+		sendToOutputs(messages[i]);
 	}
 }
 
+//==============================================================================
+Slider* MainContentComponent::getKnob(int knobIndex)
+{
+	switch (knobIndex) {
+	case 0: return &knob1;
+	case 1: return &knob2;
+	case 2: return &knob3;
+	case 3: return &knob4;
+	default: return nullptr;
+	}
+}
+
+int MainContentComponent::getKnobIndex(const Component* component)
+{
+	for (int i = 0; i < NUM_KNOBS; ++i)
+		if (component == getKnob(i))
+			return i;
+
+	return -1;
+}
+
+String MainContentComponent::getKnobModeAttribute(int knobIndex)
+{
+	ParamLabel* labels[] = { &knob1Label, &knob2Label, &knob3Label, &knob4Label };
+	return labels[knobIndex]->getLabelName() + "_MODE";
+}
+
+void MainContentComponent::setKnobMode(int knobIndex, ControllerEncoder::Mode mode)
+{
+	auto& encoder = knobEncoders[knobIndex];
+	Slider* knob = getKnob(knobIndex);
+
+	// keep the knob where it is when the resolution changes
+	double position = knob->getValue() / (double)encoder.getMaximumValue();
+	encoder.setMode(mode);
+	knob->setRange(0, encoder.getMaximumValue(), 1);
+	knob->setValue(std::round(position * encoder.getMaximumValue()), dontSendNotification);
+	automation.setEncoder(knobIndex, encoder);
+
+	paramTree->setAttribute(getKnobModeAttribute(knobIndex), (int)mode);
+}
+
+void MainContentComponent::mouseDown(const MouseEvent& e)
+{
+	int knobIndex = getKnobIndex(e.eventComponent);
+	if (knobIndex < 0 || !e.mods.isPopupMenu())
+		return;
+
+	PopupMenu menu;
+	const ControllerEncoder::Mode modes[] = { ControllerEncoder::sevenBitCC, ControllerEncoder::fourteenBitCC, ControllerEncoder::nrpn };
+	for (auto mode : modes)
+		menu.addItem((int)mode + 1, ControllerEncoder::getModeName(mode), true, knobEncoders[knobIndex].getMode() == mode);
+
+	menu.showMenuAsync(PopupMenu::Options().withTargetComponent(getKnob(knobIndex)),
+		[this, knobIndex](int result) {
+			if (result > 0)
+				setKnobMode(knobIndex, (ControllerEncoder::Mode)(result - 1));
+		});
+}
+
+//==============================================================================
+void MainContentComponent::comboBoxChanged(ComboBox* comboBox)
+{
+	if (comboBox == &linkRateBox) {
+		for (auto* entry : midiOutputs)
+			if (entry->isOutputOpen())
+				outputScheduler.setLinkSettings(*entry, getLinkSettings());
+	}
+}
+
+MidiOutputScheduler::LinkSettings MainContentComponent::getLinkSettings() const
+{
+	MidiOutputScheduler::LinkSettings settings;
+
+	if (linkRateBox.getSelectedId() == unpacedLinkId)
+		settings.bytesPerSecond = 0.0;
+	else
+		settings.sysExSegmentSize = 32; // only used by destinations that take raw bytes
+
+	return settings;
+}
+
 void MainContentComponent::labelTextChanged(Label *label)
 {
 
@@ -612,6 +766,27 @@ void MainContentComponent::textEditorTextChanged(TextEditor &editor)
 		midiChannel = value;
 	}
 	midiKeyboard.setMidiChannel(midiChannel);
+	automation.setChannel(midiChannel);
+	for (auto& encoder : knobEncoders)
+		encoder.reset();
+}
+
+void MainContentComponent::setMpeEnabled(bool shouldBeEnabled)
+{
+	// held notes go off on the channels they were played on
+	keyboardState.allNotesOff(0);
+
+	mpeZone.setLayout(MpeZone::lowerZone, shouldBeEnabled ? (int)MpeZone::maxMemberChannels : 0);
+
+	for (auto& message : mpeZone.getConfigurationMessages()) {
+		message.setTimeStamp(clock->now() * 0.001);
+		sendToOutputs(message);
+	}
+
+	// the knobs and buttons go to the whole zone on its master channel
+	if (shouldBeEnabled)
+		midiChannelText.setText("1");
+	midiChannelText.setEnabled(!shouldBeEnabled);
 }
 
 //==============================================================================
@@ -654,8 +829,8 @@ void MainContentComponent::closeUnpluggedDevices (const Array<MidiDeviceInfo>& c
 
         if (! currentlyPluggedInDevices.contains (d.deviceInfo))
         {
-            if (isInputDevice ? d.inDevice .get() != nullptr
-                              : d.outDevice.get() != nullptr)
+            if (isInputDevice ? d.isInputOpen()
+                              : d.isOutputOpen())
                 closeDevice (isInputDevice, i);
 
             midiDevices.remove (i);
@@ -668,6 +843,9 @@ void MainContentComponent::updateDeviceList (bool isInputDeviceList)
     auto availableDevices = isInputDeviceList ? MidiInput::getAvailableDevices()
                                               : MidiOutput::getAvailableDevices();
 
+    auto pedalEntry = simulatedPedal.getEntry (isInputDeviceList);
+    availableDevices.add (pedalEntry->deviceInfo);
+
     if (hasDeviceListChanged (availableDevices, isInputDeviceList))
     {
 
@@ -684,7 +862,7 @@ void MainContentComponent::updateDeviceList (bool isInputDeviceList)
             MidiDeviceListEntry::Ptr entry = findDevice (newDevice, isInputDeviceList);
 
             if (entry == nullptr)
-                entry = new MidiDeviceListEntry (newDevice);
+                entry = newDevice == pedalEntry->deviceInfo ? pedalEntry.get() : new MidiDeviceListEntry (newDevice);
 
             newDeviceList.add (entry);
         }
@@ -701,52 +879,173 @@ void MainContentComponent::updateDeviceList (bool isInputDeviceList)
 //==============================================================================
 void MainContentComponent::timerCallback ()
 {
-    updateDeviceList (true);
-    updateDeviceList (false);
+    showIncomingMessages();
+    reportAllocationAudit();
+
+    // automated knobs only follow the generator at frame rate
+    for (int i = 0; i < NUM_KNOBS; ++i)
+        if (automation.isLaneActive (i))
+            getKnob (i)->setValue (automation.getLastValue (i), dontSendNotification);
+
+    if (++timerTicks % (monitorRefreshHz / 2) == 0)
+    {
+        updateDeviceList (true);
+        updateDeviceList (false);
+    }
+}
+
+//==============================================================================
+void MainContentComponent::showTestTools()
+{
+    if (testTools == nullptr)
+    {
+        testTools.reset (new TestToolsWindow());
+        testTools->addTool ("Automation", new AutomationPanel (automation));
+        testTools->addTool ("Latency", new LatencyPanel (latencyTester, testPorts));
+        testTools->addTool ("Stress", new StressPanel (stressTester, testPorts));
+        testTools->addTool ("Bulk SysEx", new BulkTransferPanel (bulkTransfer, testPorts));
+        testTools->addTool ("Sweep", new SweepPanel (sweepVerifier, testPorts));
+        testTools->addTool ("Presets", new PresetSwitchPanel (presetSwitchTester, testPorts));
+        testTools->addTool ("Diff", new StreamDiffPanel (streamDiff, testPorts));
+        testTools->addTool ("Scripts", new ScriptPanel (scriptRunner, testPorts));
+        testTools->addTool ("Rig", new RigPanel (rigRunner, testPorts));
+        testTools->addTool ("Soak", new SoakPanel (soakTester, testPorts));
+        testTools->addTool ("Clock", new ClockPanel (clockGenerator, clockAnalyzer, testPorts));
+        testTools->addTool ("MPE", new MpeStressPanel (mpeStressTester, testPorts));
+        testTools->addTool ("UMP", new UmpPanel (umpMonitor, testPorts));
+        testTools->addTool ("Pedal", new SimulatedPedalPanel (simulatedPedal));
+        testTools->addTool ("Capture", new CapturePanel (captureRecorder));
+        testTools->addTool ("Player", new MidiFilePlayerPanel (midiFilePlayer, testPorts));
+        testTools->addTool ("Threads", new RealtimeThreadsPanel());
+    }
+
+    testTools->setVisible (true);
+    testTools->toFront (true);
 }
 
 //==============================================================================
 void MainContentComponent::handleNoteOn (MidiKeyboardState*, int midiChannel, int midiNoteNumber, float velocity)
 {
+    const AllocationAudit::ScopedSection audit (AllocationAudit::sendPath);
+    double timeStamp = clock->now() * 0.001;
+
+    if (mpeZone.isActive())
+    {
+        int stolenNote;
+        midiChannel = mpeZone.startNote (midiNoteNumber, stolenNote);
+
+        if (stolenNote >= 0)
+        {
+            MidiMessage off (MidiMessage::noteOff (midiChannel, stolenNote));
+            off.setTimeStamp (timeStamp);
+            sendToOutputs (off);
+        }
+
+        // the member channel still holds the last note's expression, so it starts from neutral
+        MidiMessage expression[MpeZone::maxExpressionMessages];
+        int numMessages = MpeZone::createExpression (midiChannel, 8192, 0, 64, expression);
+
+        for (int i = 0; i < numMessages; ++i)
+        {
+            expression[i].setTimeStamp (timeStamp);
+            sendToOutputs (expression[i]);
+        }
+    }
+
     MidiMessage m (MidiMessage::noteOn (midiChannel, midiNoteNumber, velocity));
-    m.setTimeStamp (Time::getMillisecondCounterHiRes() * 0.001);
+    m.setTimeStamp (timeStamp);
     sendToOutputs (m);
 }
 
 //==============================================================================
 void MainContentComponent::handleNoteOff (MidiKeyboardState*, int midiChannel, int midiNoteNumber, float velocity)
 {
+    const AllocationAudit::ScopedSection audit (AllocationAudit::sendPath);
+
+    if (mpeZone.isActive())
+    {
+        midiChannel = mpeZone.stopNote (midiNoteNumber);
+
+        // stolen by a later note, which already sent its note-off
+        if (midiChannel < 0)
+            return;
+    }
+
     MidiMessage m (MidiMessage::noteOff (midiChannel, midiNoteNumber, velocity));
-    m.setTimeStamp (Time::getMillisecondCounterHiRes() * 0.001);
+    m.setTimeStamp (clock->now() * 0.001);
     sendToOutputs (m);
 }
 
 //==============================================================================
 void MainContentComponent::sendToOutputs(const MidiMessage& msg)
 {
-    for (int i = 0; i < midiOutputs.size(); ++i)
-        if (midiOutputs[i]->outDevice != nullptr)
-            midiOutputs[i]->outDevice->sendMessageNow (msg);
+    outputScheduler.sendToAll (msg);
 }
 
 //==============================================================================
-void MainContentComponent::handleIncomingMidiMessage (MidiInput* /*source*/, const MidiMessage &message)
+void MainContentComponent::midiReceived (MidiDeviceListEntry& source, const MidiMessage& message)
 {
     // This is called on the MIDI thread
-	postMessage(new MidiCallbackMessage(message));
-
+    RealtimeThreads::applyToCurrentThread (RealtimeThreads::inputThread);
+    const AllocationAudit::ScopedSection audit (AllocationAudit::receivePath);
+    testPorts.dispatch (&source, message);
+    incomingMessages.push (message);
 }
 
 //==============================================================================
-void MainContentComponent::handleMessage (const Message& msg)
+void MainContentComponent::showIncomingMessages()
 {
     // This is called on the message loop
-
-    const MidiMessage& mm = dynamic_cast<const MidiCallbackMessage&> (msg).message;
     String midiString;
-	
-	midiString << mm.getDescription() << "\n";
-    midiMonitor.insertTextAtCaret (midiString);
+
+    incomingMessages.drain ([&midiString] (const MidiEventFifo::Event& e)
+    {
+        midiString << MidiMessage (e.data, e.size, e.timeStamp).getDescription() << "\n";
+    });
+
+    if (midiString.isNotEmpty())
+        appendToMonitor (midiString);
+}
+
+void MainContentComponent::appendToMonitor (const String& text)
+{
+    // the oldest half is dropped now and then, so the monitor can run for days
+    const int maxMonitorChars = 256 * 1024;
+
+    midiMonitor.moveCaretToEnd();
+    midiMonitor.insertTextAtCaret (text);
+    monitorLength += text.length();
+
+    if (monitorLength > maxMonitorChars)
+    {
+        auto all = midiMonitor.getText();
+        auto keepFrom = all.indexOfChar (all.length() - maxMonitorChars / 2, '\n') + 1;
+
+        midiMonitor.setText (all.substring (keepFrom > 0 ? keepFrom : all.length() - maxMonitorChars / 2), false);
+        midiMonitor.moveCaretToEnd();
+        monitorLength = midiMonitor.getTotalNumChars();
+    }
+}
+
+//==============================================================================
+void MainContentComponent::reportAllocationAudit()
+{
+    auto failures = AllocationAudit::getTotalFailures();
+
+    if (failures == reportedAuditFailures)
+        return;
+
+    reportedAuditFailures = failures;
+    String report;
+
+    for (auto& t : AllocationAudit::getThreadCounts())
+        for (int p = 0; p < AllocationAudit::numPaths; ++p)
+            if (t.failedSections[p] > 0)
+                report << "Allocation audit: " << t.threadName << " made " << t.allocations[p]
+                       << " heap allocations in " << t.failedSections[p] << " of " << t.sections[p]
+                       << " " << AllocationAudit::getPathName ((AllocationAudit::Path) p) << " calls\n";
+
+    appendToMonitor (report);
 }
 
 //==============================================================================
@@ -754,26 +1053,25 @@ void MainContentComponent::openDevice (bool isInput, int index)
 {
     if (isInput)
     {
-        jassert (midiInputs[index]->inDevice.get() == nullptr);
-        midiInputs[index]->inDevice = MidiInput::openDevice (midiInputs[index]->deviceInfo.identifier, this);
+        jassert (! midiInputs[index]->isInputOpen());
 
-        if (midiInputs[index]->inDevice.get() == nullptr)
+        if (! midiInputs[index]->openInput (*this))
         {
             DBG ("MidiDemo::openDevice: open input device for index = " << index << " failed!");
             return;
         }
-
-        midiInputs[index]->inDevice->start();
     }
     else
     {
-        jassert (midiOutputs[index]->outDevice.get() == nullptr);
-        midiOutputs[index]->outDevice = MidiOutput::openDevice (midiOutputs[index]->deviceInfo.identifier);
+        jassert (! midiOutputs[index]->isOutputOpen());
 
-        if (midiOutputs[index]->outDevice.get() == nullptr)
+        if (! midiOutputs[index]->openOutput())
         {
             DBG ("MidiDemo::openDevice: open output device for index = " << index << " failed!");
+            return;
         }
+
+        outputScheduler.addDestination (*midiOutputs[index], getLinkSettings());
     }
 }
 
@@ -782,14 +1080,14 @@ void MainContentComponent::closeDevice (bool isInput, int index)
 {
     if (isInput)
     {
-        jassert (midiInputs[index]->inDevice != nullptr);
-        midiInputs[index]->inDevice->stop();
-        midiInputs[index]->inDevice = nullptr;
+        jassert (midiInputs[index]->isInputOpen());
+        midiInputs[index]->closeInput();
     }
     else
     {
-        jassert (midiOutputs[index]->outDevice != nullptr);
-        midiOutputs[index]->outDevice = nullptr;
+        jassert (midiOutputs[index]->isOutputOpen());
+        outputScheduler.removeDestination (*midiOutputs[index]);
+        midiOutputs[index]->closeOutput();
     }
 }
 
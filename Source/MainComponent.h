@@ -27,11 +27,33 @@
 #pragma once
 
 #include "JuceHeader.h"
+#include "MidiOutputScheduler.h"
+#include "ControllerEncoder.h"
+#include "MpeZone.h"
+#include "MidiEventFifo.h"
+#include "AutomationGenerator.h"
+#include "MidiTestPorts.h"
+#include "LatencyTester.h"
+#include "StressTester.h"
+#include "BulkTransfer.h"
+#include "SweepVerifier.h"
+#include "PresetSwitchTester.h"
+#include "StreamDiff.h"
+#include "IdentityDiscovery.h"
+#include "ScriptRunner.h"
+#include "RigRunner.h"
+#include "SoakTester.h"
+#include "ClockGenerator.h"
+#include "MpeStressTester.h"
+#include "UmpMonitor.h"
+#include "SimulatedPedal.h"
+#include "CaptureRecorder.h"
+#include "MidiFilePlayer.h"
+#include "TestToolsWindow.h"
 
 //==============================================================================
 
 class MidiDeviceListBox;
-struct MidiDeviceListEntry;
 
 #ifndef GLOBAL_STUFF
 #define GLOBAL_STUFF
@@ -108,31 +130,36 @@ private:
 class MainContentComponent  : public Component,
                               private Timer,
                               private MidiKeyboardStateListener,
-                              private MidiInputCallback,
-                              private MessageListener,
+                              private MidiDeviceListEntry::Receiver,
                               //private Button::Listener,
 							  ImageButton::Listener,
 	                          private Slider::Listener,
+	                          private ComboBox::Listener,
 	                          private ParamLabel::Listener,
 	                          private TextEditor::Listener
 {
 public:
     //==============================================================================
-    MainContentComponent ();
+    /** With simulated time, the scheduler and test tools run on a SimulatedClock
+        instead of the system clock.
+    */
+    explicit MainContentComponent (bool useSimulatedTime = false);
     ~MainContentComponent();
 
     //==============================================================================
     void timerCallback () override;
     void handleNoteOn (MidiKeyboardState*, int midiChannel, int midiNoteNumber, float velocity) override;
     void handleNoteOff (MidiKeyboardState*, int midiChannel, int midiNoteNumber, float velocity) override;
-    void handleMessage (const Message& msg) override;
 
     void paint (Graphics& g) override;
     void resized() override;
     void buttonClicked (Button* buttonThatWasClicked) override;
 	void sliderValueChanged(Slider* slider) override;
+	void comboBoxChanged(ComboBox* comboBox) override;
+	void mouseDown(const MouseEvent& e) override;
 	void labelTextChanged(Label *label);
 	void textEditorTextChanged(TextEditor &editor);
+	void setMpeEnabled(bool shouldBeEnabled);
 
     void openDevice (bool isInput, int index);
     void closeDevice (bool isInput, int index);
@@ -143,8 +170,18 @@ public:
     ReferenceCountedObjectPtr<MidiDeviceListEntry> getMidiDevice (int index, bool isInputDevice) const noexcept;
 private:
     //==============================================================================
-    void handleIncomingMidiMessage (MidiInput *source, const MidiMessage &message) override;
+    void midiReceived (MidiDeviceListEntry& source, const MidiMessage& message) override;
     void sendToOutputs(const MidiMessage& msg);
+    void showIncomingMessages();
+    void appendToMonitor (const String& text);
+    void reportAllocationAudit();
+    void showTestTools();
+    MidiOutputScheduler::LinkSettings getLinkSettings() const;
+
+    Slider* getKnob(int knobIndex);
+    int getKnobIndex(const Component* component);
+    String getKnobModeAttribute(int knobIndex);
+    void setKnobMode(int knobIndex, ControllerEncoder::Mode mode);
 
     //==============================================================================
     bool hasDeviceListChanged (const Array<MidiDeviceInfo>& availableDevices, bool isInputDevice);
@@ -165,12 +202,17 @@ private:
 
     Label midiInputLabel;
     Label midiOutputLabel;
+    Label linkRateLabel;
+    ComboBox linkRateBox;
     Label incomingMidiLabel;
     Label outgoingMidiLabel;
     MidiKeyboardState keyboardState;
     MidiKeyboardComponent midiKeyboard;
     TextEditor midiMonitor;
+    int monitorLength = 0;
     TextButton pairButton;
+    TextButton identifyButton;
+    TextButton testToolsButton;
 
 	const int APP_WIDTH  = 740;
 	const int APP_HEIGHT = 800;
@@ -184,6 +226,10 @@ private:
 	TextEditor midiChannelText;
 	int midiChannel = 1;
 
+	// With MPE on, the keyboard plays each note on a member channel of its own
+	ToggleButton mpeButton { "MPE" };
+	MpeZone mpeZone;
+
 	const int NUM_KNOBS = 4;
 	ParamLabel  effectLabel;
 	Slider knob1;
@@ -214,12 +260,51 @@ private:
 	const int knob3CCId = knob2CCId + 1;
 	const int knob4CCId = knob3CCId + 1;
 
+	// 7-bit, 14-bit or NRPN per knob
+	ControllerEncoder knobEncoders[4];
+	ControllerEncoder::ChannelState nrpnState;
+
     ScopedPointer<MidiDeviceListBox> midiInputSelector;
     ScopedPointer<MidiDeviceListBox> midiOutputSelector;
 
     ReferenceCountedArray<MidiDeviceListEntry> midiInputs;
     ReferenceCountedArray<MidiDeviceListEntry> midiOutputs;
 
+    // Incoming messages wait here for the monitor, so the MIDI thread never allocates
+    static const int monitorRefreshHz = 30;
+    MidiEventFifo incomingMessages;
+    int timerTicks = 0;
+    int64 reportedAuditFailures = 0;
+
+    // Output pacing
+    enum { dinLinkId = 1, unpacedLinkId };
+    std::unique_ptr<VirtualClock> clock;
+    MidiOutputScheduler outputScheduler { *clock };
+
+    // listed with the real devices, for testing without hardware
+    SimulatedPedal simulatedPedal { *clock };
+
+    // Test tools
+    MidiTestPorts testPorts { outputScheduler, midiInputs, midiOutputs };
+    IdentityDiscovery identityDiscovery { testPorts };
+    AutomationGenerator automation { outputScheduler };
+    LatencyTester latencyTester { testPorts };
+    StressTester stressTester { testPorts };
+    BulkTransfer bulkTransfer { testPorts };
+    SweepVerifier sweepVerifier { testPorts };
+    PresetSwitchTester presetSwitchTester { testPorts };
+    StreamDiff streamDiff { testPorts };
+    ScriptRunner scriptRunner { testPorts };
+    RigRunner rigRunner { testPorts };
+    SoakTester soakTester { testPorts };
+    ClockGenerator clockGenerator { testPorts };
+    ClockAnalyzer clockAnalyzer { testPorts };
+    MpeStressTester mpeStressTester { testPorts };
+    UmpMonitor umpMonitor { testPorts };
+    CaptureRecorder captureRecorder { testPorts };
+    MidiFilePlayer midiFilePlayer { testPorts };
+    std::unique_ptr<TestToolsWindow> testTools;
+
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MainContentComponent)
 };
@@ -0,0 +1,109 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+#include "MidiOutputScheduler.h"
+
+//==============================================================================
+/**
+    One row of the input or output device list, and the device itself while
+    it is open. Test tools hold on to entries by pointer, so an entry stays
+    valid after it has been unplugged; its device is just closed.
+
+    Incoming messages are handed on with the entry they came from, so a
+    device that isn't a MidiInput at all, like the simulated pedal, can
+    stand in for a real one.
+*/
+struct MidiDeviceListEntry : ReferenceCountedObject,
+                             MidiOutputScheduler::Destination,
+                             private MidiInputCallback
+{
+    struct Receiver
+    {
+        virtual ~Receiver() = default;
+
+        /** Called on the input's MIDI thread. */
+        virtual void midiReceived (MidiDeviceListEntry& source, const MidiMessage& message) = 0;
+    };
+
+    MidiDeviceListEntry (MidiDeviceInfo info) : deviceInfo (info) {}
+
+    /** Return false if the device can't be opened. */
+    virtual bool openInput (Receiver& newReceiver)
+    {
+        receiver = &newReceiver;
+        inDevice = MidiInput::openDevice (deviceInfo.identifier, this);
+
+        if (inDevice == nullptr)
+            return false;
+
+        inDevice->start();
+        return true;
+    }
+
+    virtual void closeInput()
+    {
+        if (inDevice != nullptr)
+            inDevice->stop();
+
+        inDevice = nullptr;
+    }
+
+    virtual bool openOutput()
+    {
+        outDevice = MidiOutput::openDevice (deviceInfo.identifier);
+        return outDevice != nullptr;
+    }
+
+    virtual void closeOutput()              { outDevice = nullptr; }
+
+    virtual bool isInputOpen() const        { return inDevice != nullptr; }
+    virtual bool isOutputOpen() const       { return outDevice != nullptr; }
+
+    // called on the output scheduler thread
+    void transmit (const MidiMessage& message) override
+    {
+        if (outDevice != nullptr)
+            outDevice->sendMessageNow (message);
+    }
+
+    MidiDeviceInfo deviceInfo;
+    String identity;        // from the last identity discovery, message thread only
+
+    using Ptr = ReferenceCountedObjectPtr<MidiDeviceListEntry>;
+
+private:
+    void handleIncomingMidiMessage (MidiInput*, const MidiMessage& message) override
+    {
+        receiver->midiReceived (*this, message);
+    }
+
+    Receiver* receiver = nullptr;
+    std::unique_ptr<MidiInput> inDevice;
+    std::unique_ptr<MidiOutput> outDevice;
+};
@@ -0,0 +1,143 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#include "MidiEventFifo.h"
+
+//==============================================================================
+MidiEventFifo::MidiEventFifo (int capacityBytes, int maxSize)
+    : fifo (capacityBytes),
+      buffer ((size_t) capacityBytes),
+      scratch ((size_t) maxSize),
+      maxEventSize (maxSize)
+{
+    jassert (maxEventSize + (int) sizeof (Header) < capacityBytes);
+}
+
+void MidiEventFifo::reset() noexcept
+{
+    const SpinLock::ScopedLockType sl (writeLock);
+    fifo.reset();
+}
+
+//==============================================================================
+/*  The region handed out by AbstractFifo may wrap, so these copy a span that
+    starts at offset 'pos' within it, splitting the copy where needed.
+*/
+static void copyIntoRegion (uint8* ring, int pos, const void* src, int numBytes,
+                            int start1, int size1, int start2)
+{
+    auto* s = static_cast<const uint8*> (src);
+
+    if (pos < size1)
+    {
+        auto n = jmin (numBytes, size1 - pos);
+        memcpy (ring + start1 + pos, s, (size_t) n);
+        s += n;
+        numBytes -= n;
+        pos = size1;
+    }
+
+    if (numBytes > 0)
+        memcpy (ring + start2 + (pos - size1), s, (size_t) numBytes);
+}
+
+static void copyFromRegion (const uint8* ring, int pos, void* dest, int numBytes,
+                            int start1, int size1, int start2)
+{
+    auto* d = static_cast<uint8*> (dest);
+
+    if (pos < size1)
+    {
+        auto n = jmin (numBytes, size1 - pos);
+        memcpy (d, ring + start1 + pos, (size_t) n);
+        d += n;
+        numBytes -= n;
+        pos = size1;
+    }
+
+    if (numBytes > 0)
+        memcpy (d, ring + start2 + (pos - size1), (size_t) numBytes);
+}
+
+//==============================================================================
+bool MidiEventFifo::push (const uint8* data, int size, double timeStamp, int sourceTag) noexcept
+{
+    if (size <= 0 || size > maxEventSize)
+    {
+        ++numDropped;
+        return false;
+    }
+
+    const SpinLock::ScopedLockType sl (writeLock);
+    auto total = (int) sizeof (Header) + size;
+
+    if (fifo.getFreeSpace() < total)
+    {
+        ++numDropped;
+        return false;
+    }
+
+    int start1, size1, start2, size2;
+    fifo.prepareToWrite (total, start1, size1, start2, size2);
+    jassert (size1 + size2 == total);
+
+    Header h { timeStamp, (int32) sourceTag, (int32) size };
+    copyIntoRegion (buffer, 0, &h, (int) sizeof (h), start1, size1, start2);
+    copyIntoRegion (buffer, (int) sizeof (h), data, size, start1, size1, start2);
+
+    fifo.finishedWrite (total);
+    return true;
+}
+
+bool MidiEventFifo::push (const MidiMessage& message, int sourceTag) noexcept
+{
+    return push (message.getRawData(), message.getRawDataSize(), message.getTimeStamp(), sourceTag);
+}
+
+bool MidiEventFifo::pop (Event& event) noexcept
+{
+    if (fifo.getNumReady() < (int) sizeof (Header))
+        return false;
+
+    int start1, size1, start2, size2;
+    fifo.prepareToRead ((int) sizeof (Header), start1, size1, start2, size2);
+
+    Header h;
+    copyFromRegion (buffer, 0, &h, (int) sizeof (h), start1, size1, start2);
+
+    auto total = (int) sizeof (Header) + h.size;
+    fifo.prepareToRead (total, start1, size1, start2, size2);
+    jassert (size1 + size2 == total);
+
+    copyFromRegion (buffer, (int) sizeof (h), scratch, h.size, start1, size1, start2);
+    fifo.finishedRead (total);
+
+    event.data = scratch;
+    event.size = h.size;
+    event.timeStamp = h.timeStamp;
+    event.sourceTag = h.sourceTag;
+    return true;
+}
@@ -0,0 +1,97 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+
+//==============================================================================
+/**
+    A fixed-size queue of raw MIDI events for handing messages from a MIDI or
+    timing thread to a single reader without touching the heap.
+
+    Each event is stored as a small header followed by its bytes, so SysEx of
+    any length up to maxEventSize fits alongside short messages. Writers are
+    serialised with a spin lock since several MIDI inputs may call back on
+    different threads; the reader side is lock-free.
+*/
+class MidiEventFifo
+{
+public:
+    struct Event
+    {
+        const uint8* data;
+        int size;
+        double timeStamp;
+        int sourceTag;      // caller-defined, e.g. the index of the input
+    };
+
+    MidiEventFifo (int capacityBytes = 256 * 1024, int maxEventSize = 64 * 1024);
+
+    /** Returns false (and counts a drop) if the event doesn't fit. */
+    bool push (const uint8* data, int size, double timeStamp, int sourceTag = 0) noexcept;
+    bool push (const MidiMessage& message, int sourceTag = 0) noexcept;
+
+    /** Reads one event. The data pointer stays valid until the next call. */
+    bool pop (Event& event) noexcept;
+
+    /** Calls callback (const Event&) for everything queued, up to maxEvents. */
+    template <typename Callback>
+    int drain (Callback&& callback, int maxEvents = std::numeric_limits<int>::max())
+    {
+        Event e;
+        int numRead = 0;
+
+        while (numRead < maxEvents && pop (e))
+        {
+            callback (static_cast<const Event&> (e));
+            ++numRead;
+        }
+
+        return numRead;
+    }
+
+    int getNumBytesReady() const noexcept   { return fifo.getNumReady(); }
+    int64 getNumDropped() const noexcept    { return numDropped.load(); }
+    void reset() noexcept;
+
+private:
+    //==============================================================================
+    struct Header
+    {
+        double timeStamp;
+        int32 sourceTag;
+        int32 size;
+    };
+
+    AbstractFifo fifo;
+    HeapBlock<uint8> buffer, scratch;
+    int maxEventSize;
+    SpinLock writeLock;
+    std::atomic<int64> numDropped { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE (MidiEventFifo)
+};
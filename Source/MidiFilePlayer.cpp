@@ -0,0 +1,276 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#include "MidiFilePlayer.h"
+#include "RealtimeThreads.h"
+
+namespace
+{
+    String describeTime (double ms)
+    {
+        auto minutes = (int64) (ms / 60000.0);
+        return String (minutes) + ":" + String (std::fmod (ms, 60000.0) / 1000.0, 3).paddedLeft ('0', 6);
+    }
+}
+
+//==============================================================================
+MidiFilePlayer::MidiFilePlayer (MidiTestPorts& p)
+    : Thread ("MIDI file player"), ports (p)
+{
+}
+
+MidiFilePlayer::~MidiFilePlayer()
+{
+    stop();
+}
+
+bool MidiFilePlayer::start (const File& newFile, const ReferenceCountedArray<MidiDeviceListEntry>& newOutputs)
+{
+    stop();
+
+    file = newFile;
+    setError ({});
+    outputs.clear();
+
+    for (auto* output : newOutputs)
+        if (output != nullptr && output->isOutputOpen())
+            outputs.add (output);
+
+    if (outputs.isEmpty())
+    {
+        setError ("open an output on the main page first");
+        return false;
+    }
+
+    if (! reader.open (file))
+    {
+        setError (reader.getError());
+        return false;
+    }
+
+    numTracks = reader.getNumTracks();
+    eventsSent = 0;
+    eventsRefused = 0;
+    position = 0.0;
+    tempo = reader.getTempo();
+    progress = 0.0;
+    finished = false;
+    dispatchError.reset();
+
+    ports.getClock().threadStarting (*this);
+    startThread (9);
+    return true;
+}
+
+void MidiFilePlayer::stop()
+{
+    if (! isThreadRunning())
+        return;
+
+    stopThread (2000);
+
+    if (! finished)
+        sendAllNotesOff();
+}
+
+void MidiFilePlayer::sendAllNotesOff()
+{
+    for (auto* output : outputs)
+        if (output->isOutputOpen())
+            for (int channel = 1; channel <= 16; ++channel)
+                ports.getScheduler().send (*output, MidiMessage::allNotesOff (channel));
+}
+
+void MidiFilePlayer::setError (const String& message)
+{
+    const ScopedLock sl (errorLock);
+    error = message;
+}
+
+//==============================================================================
+void MidiFilePlayer::run()
+{
+    auto& clock = ports.getClock();
+    const VirtualClock::ScopedThread participant (clock, *this);
+    auto& scheduler = ports.getScheduler();
+    auto startTime = clock.now() + leadInMs;
+    MidiFileReader::Event event;
+
+    while (! threadShouldExit())
+    {
+        RealtimeThreads::applyToCurrentThread (RealtimeThreads::timingThread);
+
+        if (! reader.readNext (event))
+        {
+            // a file that breaks off part way can leave notes sounding
+            if (reader.getError().isNotEmpty())
+            {
+                setError (reader.getError());
+                sendAllNotesOff();
+            }
+            else
+            {
+                finished = true;
+            }
+
+            break;
+        }
+
+        tempo = reader.getTempo();
+        progress = reader.getProgress();
+
+        auto due = startTime + event.time;
+
+        // a long gap is slept through in pieces, until it is time to spin
+        while (due - clock.now() > spinMs && ! threadShouldExit())
+            clock.waitUntil (*this, due - spinMs);
+
+        if (threadShouldExit())
+            break;
+
+        clock.waitPrecisely (*this, due);
+        auto now = clock.now();
+
+        for (auto* output : outputs)
+            if (! scheduler.send (*output, event.message))
+                ++eventsRefused;
+
+        dispatchError.record (now - due);
+        position = event.time;
+        ++eventsSent;
+    }
+
+    reader.close();
+}
+
+//==============================================================================
+String MidiFilePlayer::getReport() const
+{
+    String s;
+
+    if (outputs.size() > 0)
+    {
+        StringArray names;
+
+        for (auto* output : outputs)
+            names.add (output->deviceInfo.name);
+
+        auto currentTempo = tempo.load();
+
+        s << (isPlaying() ? "Playing " : (finished ? "Finished " : "Stopped ")) << file.getFileName()
+          << " -> " << names.joinIntoString (", ") << "\n"
+          << numTracks << " tracks, " << (currentTempo > 0.0 ? String (currentTempo, 2) + " BPM" : String ("SMPTE timing")) << "\n"
+          << "At " << describeTime (position.load()) << ", " << String (progress.load() * 100.0, 1) << "% of the file read\n"
+          << "Events sent " << eventsSent.load() << ", refused " << eventsRefused.load() << "\n\n"
+          << "Queued late by: " << dispatchError.getSummary() << "\n";
+    }
+
+    const ScopedLock sl (errorLock);
+
+    if (error.isNotEmpty())
+        s << (s.isNotEmpty() ? "\n" : "") << "Error: " << error << "\n";
+
+    return s;
+}
+
+//==============================================================================
+MidiFilePlayerPanel::MidiFilePlayerPanel (MidiFilePlayer& p, MidiTestPorts& testPorts)
+    : ToolPanel (testPorts), player (p), ports (testPorts)
+{
+    addAndMakeVisible (allOutputs);
+
+    chooseButton.onClick = [this] { chooseFile(); };
+    addAndMakeVisible (chooseButton);
+
+    playButton.onClick = [this] { playOrStop(); };
+    addAndMakeVisible (playButton);
+
+    fileLabel.setText ("No file chosen", dontSendNotification);
+    addAndMakeVisible (fileLabel);
+}
+
+void MidiFilePlayerPanel::chooseFile()
+{
+    FileChooser chooser ("Choose a MIDI file to play...", File::getSpecialLocation (File::userDocumentsDirectory), "*.mid;*.midi;*.smf");
+
+    if (chooser.browseForFileToOpen())
+    {
+        file = chooser.getResult();
+        fileLabel.setText (file.getFullPathName(), dontSendNotification);
+    }
+}
+
+void MidiFilePlayerPanel::playOrStop()
+{
+    if (player.isPlaying())
+    {
+        player.stop();
+    }
+    else if (! file.existsAsFile())
+    {
+        showMessage ("Choose a file to play first.");
+    }
+    else
+    {
+        ReferenceCountedArray<MidiDeviceListEntry> outputs;
+
+        if (allOutputs.getToggleState())
+            outputs = ports.getOpenDevices (false);
+        else if (auto output = getOutput())
+            outputs.add (output.get());
+
+        player.start (file, outputs);
+    }
+
+    refresh();
+}
+
+void MidiFilePlayerPanel::update()
+{
+    playButton.setButtonText (player.isPlaying() ? "Stop" : "Play");
+    chooseButton.setEnabled (! player.isPlaying());
+}
+
+String MidiFilePlayerPanel::getReportText()
+{
+    return player.getReport();
+}
+
+void MidiFilePlayerPanel::resized()
+{
+    auto area = layOutPair();
+
+    auto row = area.removeFromTop (rowHeight);
+    chooseButton.setBounds (row.removeFromLeft (130).reduced (2));
+    playButton.setBounds (row.removeFromLeft (100).reduced (2));
+    allOutputs.setBounds (row.removeFromLeft (170).reduced (2));
+    area.removeFromTop (4);
+
+    fileLabel.setBounds (area.removeFromTop (rowHeight));
+    area.removeFromTop (4);
+
+    report.setBounds (area);
+}
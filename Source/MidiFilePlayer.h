@@ -0,0 +1,116 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+#include "LatencyHistogram.h"
+#include "MidiFileReader.h"
+#include "MidiTestPorts.h"
+#include "ToolPanel.h"
+
+//==============================================================================
+/**
+    Plays a Standard MIDI File to one output, or to every open one.
+
+    The file is streamed through a MidiFileReader on the timing thread, an
+    event ahead: the next event is read as soon as the last one is sent, so
+    any disk access falls in the wait before it is due. Event n is due at the
+    start time plus its time in the file, never relative to the event before,
+    so late wake-ups don't add up to drift. The thread sleeps until shortly
+    before each event and spins for the rest, the same as the clock
+    generator, and the player measures how late each event was queued.
+
+    Stopping part way, or a file that can't be read to the end, sends All
+    Notes Off on every channel, so nothing is left hanging.
+*/
+class MidiFilePlayer  : private Thread
+{
+public:
+    explicit MidiFilePlayer (MidiTestPorts& ports);
+    ~MidiFilePlayer();
+
+    /** Returns false, with the reason in the report, if the file can't be
+        read or none of the outputs are open.
+    */
+    bool start (const File& file, const ReferenceCountedArray<MidiDeviceListEntry>& outputs);
+    void stop();
+    bool isPlaying() const                  { return isThreadRunning(); }
+
+    String getReport() const;
+
+private:
+    //==============================================================================
+    enum
+    {
+        leadInMs = 100,
+        spinMs = 2
+    };
+
+    void run() override;
+    void setError (const String& message);
+    void sendAllNotesOff();
+
+    MidiTestPorts& ports;
+    MidiFileReader reader;
+    ReferenceCountedArray<MidiDeviceListEntry> outputs;
+    File file;
+    int numTracks = 0;
+
+    std::atomic<int64> eventsSent { 0 }, eventsRefused { 0 };
+    std::atomic<double> position { 0.0 }, tempo { 0.0 }, progress { 0.0 };
+    std::atomic<bool> finished { false };
+    LatencyHistogram dispatchError;
+
+    CriticalSection errorLock;
+    String error;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MidiFilePlayer)
+};
+
+//==============================================================================
+class MidiFilePlayerPanel  : public ToolPanel
+{
+public:
+    MidiFilePlayerPanel (MidiFilePlayer& player, MidiTestPorts& ports);
+
+    void resized() override;
+
+private:
+    String getReportText() override;
+    void update() override;
+    void chooseFile();
+    void playOrStop();
+
+    MidiFilePlayer& player;
+    MidiTestPorts& ports;
+    ToggleButton allOutputs { "Every open output" };
+    TextButton chooseButton { "Choose file..." }, playButton { "Play" };
+    Label fileLabel;
+    File file;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MidiFilePlayerPanel)
+};
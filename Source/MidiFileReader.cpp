@@ -0,0 +1,339 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#include "MidiFileReader.h"
+
+//==============================================================================
+bool MidiFileReader::open (const File& newFile)
+{
+    close();
+
+    file = newFile;
+    error.clear();
+    totalTrackBytes = trackBytesRead = 0;
+    anchorTick = 0;
+    anchorTime = 0.0;
+    smpteTiming = false;
+
+    stream.reset (new FileInputStream (file));
+
+    if (stream->failedToOpen())
+        return fail ("couldn't open " + file.getFullPathName());
+
+    char id[4];
+
+    if (stream->read (id, 4) != 4 || std::memcmp (id, "MThd", 4) != 0)
+        return fail (file.getFileName() + " isn't a Standard MIDI File");
+
+    auto headerLength = (uint32) stream->readIntBigEndian();
+    format = (uint16) stream->readShortBigEndian();
+    auto numTracks = (int) (uint16) stream->readShortBigEndian();
+    auto division = (uint16) stream->readShortBigEndian();
+
+    if (headerLength < 6 || stream->getPosition() < headerSize)
+        return fail (file.getFileName() + " has a broken header");
+
+    if (format > 1)
+        return fail (file.getFileName() + " is format 2, which holds separate patterns rather than one song");
+
+    if ((division & 0x8000) != 0)
+    {
+        // frames per second, negated in the upper byte, then ticks per frame
+        auto framesPerSecond = -(int) (int8) (division >> 8);
+        auto ticksPerFrame = (int) (division & 0xff);
+
+        if (framesPerSecond <= 0 || ticksPerFrame == 0)
+            return fail (file.getFileName() + " has a broken SMPTE division");
+
+        smpteTiming = true;
+        ticksPerQuarterNote = 0;
+        msPerTick = 1000.0 / ((framesPerSecond == 29 ? 29.97 : (double) framesPerSecond) * ticksPerFrame);
+    }
+    else
+    {
+        if (division == 0)
+            return fail (file.getFileName() + " has no ticks per quarter note");
+
+        // 120 bpm until the file says otherwise
+        ticksPerQuarterNote = division;
+        msPerTick = 500.0 / ticksPerQuarterNote;
+    }
+
+    // only the chunk headers are read; anything that isn't a track is skipped
+    auto length = stream->getTotalLength();
+    auto position = (int64) 8 + headerLength;
+
+    while (tracks.size() < numTracks && position + 8 <= length)
+    {
+        if (! stream->setPosition (position) || stream->read (id, 4) != 4)
+            return fail ("couldn't read " + file.getFullPathName());
+
+        auto chunkLength = (int64) (uint32) stream->readIntBigEndian();
+        position += 8;
+
+        if (std::memcmp (id, "MTrk", 4) == 0)
+        {
+            auto* track = tracks.add (new Track());
+            track->index = tracks.size() - 1;
+            track->filePosition = position;
+            track->fileEnd = jmin (length, position + chunkLength);     // a cut-short last track is read as far as it goes
+            track->buffer.malloc (chunkSize);
+            totalTrackBytes += track->fileEnd - position;
+        }
+
+        position += chunkLength;
+    }
+
+    if (tracks.isEmpty())
+        return fail (file.getFileName() + " has no tracks");
+
+    for (auto* track : tracks)
+        if (! advance (*track))
+            return false;
+
+    return true;
+}
+
+void MidiFileReader::close()
+{
+    tracks.clear();
+    stream.reset();
+}
+
+bool MidiFileReader::readNext (Event& event)
+{
+    while (stream != nullptr)
+    {
+        Track* next = nullptr;
+
+        for (auto* track : tracks)
+            if (! track->finished && (next == nullptr || track->tick < next->tick))
+                next = track;
+
+        if (next == nullptr)
+            return false;
+
+        auto& data = next->data;
+        bool found = false;
+
+        if (next->metaType == 0x51 && data.size() == 3 && ! smpteTiming)
+        {
+            auto microsecondsPerQuarter = (data[0] << 16) | (data[1] << 8) | data[2];
+
+            if (microsecondsPerQuarter > 0)
+            {
+                anchorTime = tickToTime (next->tick);
+                anchorTick = next->tick;
+                msPerTick = microsecondsPerQuarter / (1000.0 * ticksPerQuarterNote);
+            }
+        }
+        else if (next->metaType == 0x2f)
+        {
+            next->finished = true;
+        }
+        else if (next->metaType < 0 && data.size() > 0 && data[0] >= 0x80)
+        {
+            // an F7 packet continuing a SysEx can't be sent on its own, so it isn't
+            event.message = MidiMessage (data.getRawDataPointer(), data.size());
+            event.time = tickToTime (next->tick);
+            event.tick = next->tick;
+            event.track = next->index;
+            found = true;
+        }
+
+        if (! next->finished && ! advance (*next))
+            return false;
+
+        if (found)
+            return true;
+    }
+
+    return false;
+}
+
+double MidiFileReader::getTempo() const noexcept
+{
+    return smpteTiming || msPerTick <= 0.0 ? 0.0 : 60000.0 / (msPerTick * ticksPerQuarterNote);
+}
+
+double MidiFileReader::getProgress() const noexcept
+{
+    return totalTrackBytes > 0 ? (double) trackBytesRead / (double) totalTrackBytes : 0.0;
+}
+
+//==============================================================================
+bool MidiFileReader::fail (const String& message)
+{
+    error = message;
+    close();
+    return false;
+}
+
+bool MidiFileReader::fill (Track& track)
+{
+    auto toRead = (int) jmin ((int64) chunkSize, track.fileEnd - track.filePosition);
+
+    if (toRead <= 0)
+        return false;
+
+    if (! stream->setPosition (track.filePosition) || stream->read (track.buffer, toRead) != toRead)
+        return fail ("couldn't read " + file.getFullPathName());
+
+    track.filePosition += toRead;
+    track.bufferPosition = 0;
+    track.bufferSize = toRead;
+    return true;
+}
+
+bool MidiFileReader::readByte (Track& track, uint8& byte)
+{
+    if (track.bufferPosition == track.bufferSize && ! fill (track))
+        return false;
+
+    byte = track.buffer[track.bufferPosition++];
+    ++trackBytesRead;
+    return true;
+}
+
+bool MidiFileReader::readVariableLength (Track& track, uint32& value)
+{
+    value = 0;
+
+    for (int i = 0; i < 4; ++i)
+    {
+        uint8 byte;
+
+        if (! readByte (track, byte))
+            return false;
+
+        value = (value << 7) | (byte & 0x7f);
+
+        if ((byte & 0x80) == 0)
+            return true;
+    }
+
+    return fail ("track " + String (track.index + 1) + " has a number longer than four bytes");
+}
+
+bool MidiFileReader::readBytes (Track& track, uint32 numBytes)
+{
+    auto remaining = (track.bufferSize - track.bufferPosition) + (track.fileEnd - track.filePosition);
+
+    if ((int64) numBytes > remaining)
+        return false;
+
+    while (numBytes > 0)
+    {
+        if (track.bufferPosition == track.bufferSize && ! fill (track))
+            return false;
+
+        auto n = jmin ((int) numBytes, track.bufferSize - track.bufferPosition);
+        track.data.addArray (track.buffer + track.bufferPosition, n);
+        track.bufferPosition += n;
+        trackBytesRead += n;
+        numBytes -= (uint32) n;
+    }
+
+    return true;
+}
+
+bool MidiFileReader::advance (Track& track)
+{
+    track.data.clearQuick();
+    track.metaType = -1;
+
+    // a track without an end of track event just ends
+    if (track.bufferPosition == track.bufferSize && track.filePosition >= track.fileEnd)
+    {
+        track.finished = true;
+        return true;
+    }
+
+    if (! decode (track))
+        return error.isNotEmpty() ? false
+                                  : fail ("track " + String (track.index + 1) + " ends in the middle of an event");
+
+    return true;
+}
+
+bool MidiFileReader::decode (Track& track)
+{
+    uint32 delta, length;
+    uint8 byte;
+
+    if (! readVariableLength (track, delta) || ! readByte (track, byte))
+        return false;
+
+    track.tick += delta;
+
+    // running status carries on through meta events and SysEx, as most
+    // readers allow, since some files rely on it
+    if (byte == 0xff)
+    {
+        uint8 type;
+
+        if (! readByte (track, type) || ! readVariableLength (track, length) || ! readBytes (track, length))
+            return false;
+
+        track.metaType = type;
+        return true;
+    }
+
+    if (byte == 0xf0 || byte == 0xf7)
+    {
+        if (byte == 0xf0)
+            track.data.add (0xf0);
+
+        return readVariableLength (track, length) && readBytes (track, length);
+    }
+
+    auto status = byte;
+
+    if (byte < 0x80)
+    {
+        if (track.runningStatus == 0)
+            return fail ("track " + String (track.index + 1) + " has data with no status byte before it");
+
+        status = track.runningStatus;
+    }
+    else if (byte > 0xf0)
+    {
+        return fail ("track " + String (track.index + 1) + " has a system message outside an F7 escape");
+    }
+
+    track.runningStatus = status;
+    track.data.add (status);
+
+    if (byte < 0x80)
+        track.data.add (byte);
+
+    return readBytes (track, (uint32) (MidiMessage::getMessageLengthFromFirstByte (status) - track.data.size()));
+}
+
+double MidiFileReader::tickToTime (int64 tick) const noexcept
+{
+    return anchorTime + (double) (tick - anchorTick) * msPerTick;
+}
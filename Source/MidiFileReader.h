@@ -0,0 +1,130 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+
+//==============================================================================
+/**
+    Reads a Standard MIDI File an event at a time, in time order across all
+    its tracks, without loading it.
+
+    open() only reads the header and where each track starts. Every track
+    then has a read buffer of its own, filled from the file a chunk at a
+    time as its cursor moves on, so an hours-long file costs the same memory
+    as a short one. Each track decodes its next event ahead. readNext()
+    takes whichever is due first; on a tie, the lower track goes first, so a
+    tempo change in the first track applies to everything at its tick.
+
+    Tick times become milliseconds through the tempo map as it is read: a
+    tempo change anchors the conversion at its own tick. Files with SMPTE
+    timing have fixed-length ticks and ignore tempo. Meta events are used or
+    skipped; everything else comes out, with SysEx whole and F7 escapes as
+    the raw bytes they hold.
+*/
+class MidiFileReader
+{
+public:
+    struct Event
+    {
+        MidiMessage message;
+        double time = 0.0;          // ms from the start of the file
+        int64 tick = 0;
+        int track = 0;
+    };
+
+    //==============================================================================
+    MidiFileReader() = default;
+
+    /** Returns false, with getError() saying why, if the file can't be read. */
+    bool open (const File& file);
+    void close();
+
+    /** Returns false at the end of the file, or on an error, when getError()
+        says what was wrong.
+    */
+    bool readNext (Event& event);
+
+    bool isOpen() const noexcept            { return stream != nullptr; }
+    String getError() const                 { return error; }
+
+    int getFormat() const noexcept          { return format; }
+    int getNumTracks() const noexcept       { return tracks.size(); }
+    double getTempo() const noexcept;
+
+    /** How much of the track data has been read, from 0 to 1. */
+    double getProgress() const noexcept;
+
+private:
+    //==============================================================================
+    struct Track
+    {
+        // the part of the chunk not read into the buffer yet
+        int64 filePosition = 0, fileEnd = 0;
+        HeapBlock<uint8> buffer;
+        int bufferPosition = 0, bufferSize = 0;
+
+        int index = 0;
+        int64 tick = 0;
+        uint8 runningStatus = 0;
+        bool finished = false;
+
+        // the next event, decoded ahead
+        Array<uint8> data;
+        int metaType = -1;          // -1 for anything that isn't a meta event
+    };
+
+    enum
+    {
+        chunkSize = 16 * 1024,
+        headerSize = 14
+    };
+
+    bool fail (const String& message);
+    bool fill (Track& track);
+    bool readByte (Track& track, uint8& byte);
+    bool readVariableLength (Track& track, uint32& value);
+    bool readBytes (Track& track, uint32 numBytes);
+    bool advance (Track& track);
+    bool decode (Track& track);
+    double tickToTime (int64 tick) const noexcept;
+
+    std::unique_ptr<FileInputStream> stream;
+    File file;
+    OwnedArray<Track> tracks;
+    String error;
+
+    int format = 0, ticksPerQuarterNote = 0;
+    int64 totalTrackBytes = 0, trackBytesRead = 0;
+
+    // the tempo map so far
+    int64 anchorTick = 0;
+    double anchorTime = 0.0, msPerTick = 0.0;
+    bool smpteTiming = false;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MidiFileReader)
+};
@@ -0,0 +1,271 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#include "MidiFileWriter.h"
+
+//==============================================================================
+MidiFileWriter::~MidiFileWriter()
+{
+    close();
+}
+
+bool MidiFileWriter::open (const Settings& newSettings, const StringArray& trackNames, double newStartTime)
+{
+    close();
+
+    settings = newSettings;
+    settings.ticksPerQuarterNote = jlimit ((int) minTicksPerQuarterNote, (int) maxTicksPerQuarterNote, settings.ticksPerQuarterNote);
+    settings.beatsPerMinute = jlimit (1.0, 1000.0, settings.beatsPerMinute);
+    ticksPerMs = settings.ticksPerQuarterNote * settings.beatsPerMinute / 60000.0;
+    startTime = newStartTime;
+    error.clear();
+    numEvents = 0;
+    numBytes = 0;
+
+    auto result = settings.file.getParentDirectory().createDirectory();
+
+    if (result.failed())
+        return fail ("couldn't create " + settings.file.getParentDirectory().getFullPathName() + ": " + result.getErrorMessage());
+
+    for (int i = 0; i < trackNames.size(); ++i)
+    {
+        auto* track = tracks.add (new Track());
+        track->file = settings.file.getSiblingFile (settings.file.getFileNameWithoutExtension() + " track " + String (i + 1) + ".tmp");
+        track->file.deleteFile();
+        track->stream.reset (new FileOutputStream (track->file, streamBufferSize));
+
+        if (track->stream->failedToOpen())
+            return fail ("couldn't create " + track->file.getFullPathName());
+
+        // the track name, at the start
+        auto* name = trackNames[i].toRawUTF8();
+        auto length = (uint32) std::strlen (name);
+
+        track->stream->writeByte (0);
+        track->stream->writeByte ((char) 0xff);
+        track->stream->writeByte (0x03);
+        writeVariableLength (*track->stream, length);
+        track->stream->write (name, length);
+    }
+
+    return true;
+}
+
+bool MidiFileWriter::write (int trackIndex, const uint8* bytes, int size, double time)
+{
+    // a message without a status byte has no place in a file
+    if (! isPositiveAndBelow (trackIndex, tracks.size()) || size <= 0 || bytes[0] < 0x80)
+        return false;
+
+    auto& track = *tracks.getUnchecked (trackIndex);
+    auto before = track.stream->getPosition();
+
+    // out of order by a tick or two is the best a track can do
+    auto tick = jmax (track.lastTick, (int64) std::llround ((time - startTime) * ticksPerMs));
+
+    // the most the event can take: the bridges, a delta, a status, a length and the data
+    auto mostBytes = bridgeBytes * ((tick - track.lastTick) / maxDelta) + 4 + 1 + 4 + size;
+
+    if (track.full || before + mostBytes > maxTrackBytes - endOfTrackBytes)
+    {
+        if (! track.full && error.isEmpty())
+            error = "track " + String (trackIndex + 1) + " is full, at the 2 GB a MIDI file track can hold";
+
+        track.full = true;
+        return false;
+    }
+
+    writeEvent (track, tick, bytes, size);
+
+    if (track.stream->getStatus().failed())
+        return fail ("couldn't write to " + track.file.getFullPathName() + ": " + track.stream->getStatus().getErrorMessage());
+
+    numBytes += track.stream->getPosition() - before;
+    ++numEvents;
+    return true;
+}
+
+void MidiFileWriter::close()
+{
+    if (tracks.isEmpty())
+        return;
+
+    bool written = true;
+
+    for (auto* track : tracks)
+    {
+        track->stream->writeByte (0);
+        track->stream->writeByte ((char) 0xff);
+        track->stream->writeByte (0x2f);
+        track->stream->writeByte (0);
+        track->stream->flush();
+
+        if (track->stream->getStatus().failed())
+        {
+            written = false;
+            error = "couldn't write to " + track->file.getFullPathName();
+        }
+
+        track->stream.reset();
+    }
+
+    if (written && ! assemble() && error.isEmpty())
+        error = "couldn't write " + settings.file.getFullPathName();
+
+    removeTrackFiles();
+}
+
+//==============================================================================
+void MidiFileWriter::writeVariableLength (OutputStream& out, uint32 value)
+{
+    uint8 buffer[5];
+    int n = 0;
+
+    buffer[n++] = (uint8) (value & 0x7f);
+
+    while ((value >>= 7) != 0)
+        buffer[n++] = (uint8) ((value & 0x7f) | 0x80);
+
+    while (n > 0)
+        out.writeByte ((char) buffer[--n]);
+}
+
+void MidiFileWriter::writeEvent (Track& track, int64 tick, const uint8* bytes, int size)
+{
+    auto& out = *track.stream;
+    auto delta = tick - track.lastTick;
+    track.lastTick = tick;
+
+    // a gap too long for one delta is bridged with empty text events
+    for (; delta > maxDelta; delta -= maxDelta)
+    {
+        writeVariableLength (out, maxDelta);
+        out.writeByte ((char) 0xff);
+        out.writeByte (0x01);
+        out.writeByte (0);
+
+        // a meta event cancels running status
+        track.runningStatus = 0;
+    }
+
+    writeVariableLength (out, (uint32) delta);
+
+    auto status = bytes[0];
+
+    if (status == 0xf0)
+    {
+        out.writeByte ((char) 0xf0);
+        writeVariableLength (out, (uint32) size - 1);
+        out.write (bytes + 1, (size_t) size - 1);
+        track.runningStatus = 0;
+    }
+    else if (status > 0xf0)
+    {
+        out.writeByte ((char) 0xf7);
+        writeVariableLength (out, (uint32) size);
+        out.write (bytes, (size_t) size);
+        track.runningStatus = 0;
+    }
+    else
+    {
+        if (status != track.runningStatus)
+            out.writeByte ((char) status);
+
+        out.write (bytes + 1, (size_t) size - 1);
+        track.runningStatus = status;
+    }
+}
+
+bool MidiFileWriter::assemble()
+{
+    settings.file.deleteFile();
+    FileOutputStream out (settings.file, streamBufferSize);
+
+    if (out.failedToOpen())
+        return false;
+
+    out.write ("MThd", 4);
+    out.writeIntBigEndian (6);
+    out.writeShortBigEndian (1);
+    out.writeShortBigEndian ((short) (tracks.size() + 1));
+    out.writeShortBigEndian ((short) settings.ticksPerQuarterNote);
+
+    // the tempo track: a name, 4/4 and the tempo the ticks were counted at
+    auto microsecondsPerBeat = (int) std::lround (60.0e6 / settings.beatsPerMinute);
+    const uint8 tempoTrack[] = { 0x00, 0xff, 0x03, 12, 'B', 'A', 'M', 'i', 'd', 'i', 'T', 'e', 's', 't', 'e', 'r',
+                                 0x00, 0xff, 0x58, 0x04, 0x04, 0x02, 0x18, 0x08,
+                                 0x00, 0xff, 0x51, 0x03, (uint8) (microsecondsPerBeat >> 16),
+                                 (uint8) (microsecondsPerBeat >> 8), (uint8) microsecondsPerBeat,
+                                 0x00, 0xff, 0x2f, 0x00 };
+
+    out.write ("MTrk", 4);
+    out.writeIntBigEndian ((int) sizeof (tempoTrack));
+    out.write (tempoTrack, sizeof (tempoTrack));
+
+    for (auto* track : tracks)
+    {
+        FileInputStream in (track->file);
+
+        if (in.failedToOpen())
+            return false;
+
+        auto length = in.getTotalLength();
+
+        if (length > maxTrackBytes)
+        {
+            error = track->file.getFileName() + " is too long for a MIDI file track";
+            return false;
+        }
+
+        out.write ("MTrk", 4);
+        out.writeIntBigEndian ((int) length);
+
+        if (out.writeFromInputStream (in, length) != length)
+            return false;
+    }
+
+    out.flush();
+    return out.getStatus().wasOk();
+}
+
+bool MidiFileWriter::fail (const String& message)
+{
+    error = message;
+
+    for (auto* track : tracks)
+        track->stream.reset();
+
+    removeTrackFiles();
+    return false;
+}
+
+void MidiFileWriter::removeTrackFiles()
+{
+    for (auto* track : tracks)
+        track->file.deleteFile();
+
+    tracks.clear();
+}
@@ -0,0 +1,122 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+
+//==============================================================================
+/**
+    Writes a type 1 Standard MIDI File as events arrive, with a track for each
+    device after the tempo track.
+
+    A track's length has to be known before its data, so each track is
+    streamed to a file of its own next to the result. close() then puts the
+    header, the tempo track and every track together. However long the
+    recording, only the stream buffers are held in memory.
+
+    Times are converted to ticks at a fixed tempo and resolution. Each track
+    keeps its own running status. A SysEx is stored whole as an F0 event.
+    Any other system message is stored as an F7 escape, since a file has no
+    other way to hold one.
+*/
+class MidiFileWriter
+{
+public:
+    struct Settings
+    {
+        File file;
+        double beatsPerMinute = 120.0;
+        int ticksPerQuarterNote = 960;      // 960 at 120 bpm is about half a millisecond a tick
+    };
+
+    enum
+    {
+        minTicksPerQuarterNote = 24,
+        maxTicksPerQuarterNote = 0x7fff
+    };
+
+    //==============================================================================
+    MidiFileWriter() = default;
+    ~MidiFileWriter();
+
+    /** Returns false, with getError() saying why, if the tracks can't be
+        created. Event times are measured from startTime, in ms.
+    */
+    bool open (const Settings& settings, const StringArray& trackNames, double startTime);
+
+    /** Returns false if the message can't be stored, or on a file error,
+        which also stops the recording. A track that has grown as long as a
+        file can describe takes no more, and the rest of the file carries on.
+    */
+    bool write (int track, const uint8* bytes, int size, double time);
+
+    /** Writes the file and removes the track files. */
+    void close();
+
+    bool isOpen() const noexcept            { return ! tracks.isEmpty(); }
+    String getError() const                 { return error; }
+
+    File getFile() const                    { return settings.file; }
+    int64 getNumEvents() const noexcept     { return numEvents; }
+    int64 getNumBytes() const noexcept      { return numBytes; }
+
+private:
+    //==============================================================================
+    struct Track
+    {
+        File file;
+        std::unique_ptr<FileOutputStream> stream;
+        int64 lastTick = 0;
+        uint8 runningStatus = 0;
+        bool full = false;
+    };
+
+    enum
+    {
+        streamBufferSize = 64 * 1024,
+        maxDelta = 0x0fffffff,          // the most four bytes of variable length can hold
+        maxTrackBytes = 0x7fffffff,     // a chunk length past this is negative to many readers
+        bridgeBytes = 7,                // a four byte delta and an empty text event
+        endOfTrackBytes = 4
+    };
+
+    static void writeVariableLength (OutputStream& out, uint32 value);
+    static void writeEvent (Track& track, int64 tick, const uint8* bytes, int size);
+    bool assemble();
+    bool fail (const String& message);
+    void removeTrackFiles();
+
+    Settings settings;
+    double ticksPerMs = 0.0;
+    double startTime = 0.0;
+    OwnedArray<Track> tracks;
+    String error;
+
+    int64 numEvents = 0, numBytes = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MidiFileWriter)
+};
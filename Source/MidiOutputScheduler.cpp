@@ -0,0 +1,375 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#include "MidiOutputScheduler.h"
+#include "AllocationAudit.h"
+#include "RealtimeThreads.h"
+
+//==============================================================================
+MidiOutputScheduler::Queue::Queue (int capacity)
+    : fifo (capacity), slots ((size_t) capacity)
+{
+}
+
+bool MidiOutputScheduler::Queue::push (const MidiMessage& message)
+{
+    int start1, size1, start2, size2;
+    fifo.prepareToWrite (1, start1, size1, start2, size2);
+
+    if (size1 == 0)
+        return false;
+
+    slots[(size_t) start1] = message;
+    fifo.finishedWrite (1);
+    return true;
+}
+
+const MidiMessage* MidiOutputScheduler::Queue::front() const
+{
+    int start1, size1, start2, size2;
+    fifo.prepareToRead (1, start1, size1, start2, size2);
+
+    return size1 > 0 ? &slots[(size_t) start1] : nullptr;
+}
+
+void MidiOutputScheduler::Queue::popInto (MidiMessage& target)
+{
+    int start1, size1, start2, size2;
+    fifo.prepareToRead (1, start1, size1, start2, size2);
+    jassert (size1 > 0);
+
+    // swapped rather than copied, so nothing is allocated
+    std::swap (target, slots[(size_t) start1]);
+    fifo.finishedRead (1);
+}
+
+//==============================================================================
+MidiOutputScheduler::Link::Link (Destination& d, const LinkSettings& s)
+    : destination (d)
+{
+    applySettings (s);
+}
+
+void MidiOutputScheduler::Link::applySettings (const LinkSettings& s)
+{
+    // segments shorter than 4 bytes could be mistaken for voice messages
+    jassert (s.sysExSegmentSize == 0 || s.sysExSegmentSize >= 4);
+
+    if (queues[0] == nullptr || s.queueCapacity != settings.queueCapacity)
+    {
+        for (auto& q : queues)
+            q.reset (new Queue (s.queueCapacity));
+
+        sysExOffset = 0;
+    }
+
+    settings = s;
+
+    if (! destination.takesSysExSegments())
+        settings.sysExSegmentSize = 0;
+
+    msPerByte = s.bytesPerSecond > 0.0 ? 1000.0 / s.bytesPerSecond : 0.0;
+}
+
+//==============================================================================
+MidiOutputScheduler::MidiOutputScheduler (VirtualClock& c)
+    : Thread ("MIDI output scheduler"), clock (c), outgoing ((size_t) maxOutgoing)
+{
+    monitors.ensureStorageAllocated (8);
+    clock.threadStarting (*this);
+    startThread();
+}
+
+MidiOutputScheduler::~MidiOutputScheduler()
+{
+    signalThreadShouldExit();
+    clock.wake (*this);
+    stopThread (1000);
+}
+
+void MidiOutputScheduler::addDestination (Destination& destination, const LinkSettings& settings)
+{
+    const ScopedLock sl (lock);
+
+    if (auto* link = findLink (destination))
+        link->applySettings (settings);
+    else
+        links.add (new Link (destination, settings));
+}
+
+void MidiOutputScheduler::removeDestination (Destination& destination)
+{
+    const ScopedLock dl (deliveryLock);
+    const ScopedLock sl (lock);
+
+    if (auto* link = findLink (destination))
+        links.removeObject (link);
+}
+
+void MidiOutputScheduler::removeAllDestinations()
+{
+    const ScopedLock dl (deliveryLock);
+    const ScopedLock sl (lock);
+    links.clear();
+}
+
+void MidiOutputScheduler::setLinkSettings (Destination& destination, const LinkSettings& settings)
+{
+    const ScopedLock sl (lock);
+
+    if (auto* link = findLink (destination))
+        link->applySettings (settings);
+}
+
+void MidiOutputScheduler::addMonitor (Monitor* monitor)
+{
+    const ScopedLock dl (deliveryLock);
+    const ScopedLock sl (lock);
+    monitors.addIfNotAlreadyThere (monitor);
+}
+
+void MidiOutputScheduler::removeMonitor (Monitor* monitor)
+{
+    const ScopedLock dl (deliveryLock);
+    const ScopedLock sl (lock);
+    monitors.removeFirstMatchingValue (monitor);
+}
+
+MidiOutputScheduler::Link* MidiOutputScheduler::findLink (Destination& destination) const
+{
+    for (auto* link : links)
+        if (&link->destination == &destination)
+            return link;
+
+    return nullptr;
+}
+
+//==============================================================================
+MidiOutputScheduler::Priority MidiOutputScheduler::getPriorityFor (const MidiMessage& message) noexcept
+{
+    auto status = message.getRawData()[0];
+
+    if (status >= 0xf8)  return realtimePriority;
+    if (status == 0xf0)  return bulkPriority;
+
+    return voicePriority;
+}
+
+bool MidiOutputScheduler::send (Destination& destination, const MidiMessage& message)
+{
+    return send (destination, message, getPriorityFor (message));
+}
+
+bool MidiOutputScheduler::send (Destination& destination, const MidiMessage& message, Priority priority)
+{
+    jassert (isPositiveAndBelow ((int) priority, (int) numPriorities));
+    bool queued = false;
+
+    {
+        const ScopedLock sl (lock);
+
+        if (auto* link = findLink (destination))
+        {
+            queued = link->queues[priority]->push (message);
+
+            if (! queued)
+                ++link->stats.messagesDropped;
+        }
+    }
+
+    if (queued)
+        clock.wake (*this);
+
+    return queued;
+}
+
+void MidiOutputScheduler::sendToAll (const MidiMessage& message)
+{
+    auto priority = getPriorityFor (message);
+
+    {
+        const ScopedLock sl (lock);
+
+        for (auto* link : links)
+            if (! link->queues[priority]->push (message))
+                ++link->stats.messagesDropped;
+    }
+
+    clock.wake (*this);
+}
+
+MidiOutputScheduler::LinkStats MidiOutputScheduler::getStats (Destination& destination) const
+{
+    const ScopedLock sl (lock);
+    LinkStats result;
+
+    if (auto* link = findLink (destination))
+    {
+        result = link->stats;
+
+        for (int i = 0; i < numPriorities; ++i)
+            result.queued[i] = link->queues[i]->size();
+    }
+
+    return result;
+}
+
+//==============================================================================
+void MidiOutputScheduler::run()
+{
+    const VirtualClock::ScopedThread participant (clock, *this);
+
+    while (! threadShouldExit())
+    {
+        RealtimeThreads::applyToCurrentThread (RealtimeThreads::outputThread);
+        double waitMs = -1.0;
+
+        {
+            const ScopedLock dl (deliveryLock);
+            const AllocationAudit::ScopedSection audit (AllocationAudit::sendPath);
+
+            {
+                const ScopedLock sl (lock);
+                auto now = clock.now();
+
+                for (auto* link : links)
+                {
+                    auto linkWait = service (*link, now);
+
+                    if (linkWait >= 0.0)
+                        waitMs = waitMs < 0.0 ? linkWait : jmin (waitMs, linkWait);
+                }
+            }
+
+            deliver();
+        }
+
+        clock.waitUntil (*this, waitMs < 0.0 ? -1.0 : clock.now() + waitMs);
+    }
+}
+
+void MidiOutputScheduler::deliver()
+{
+    for (int i = 0; i < numOutgoing; ++i)
+    {
+        auto& o = outgoing[(size_t) i];
+
+        {
+            // what the driver does with the message is its own business
+            const AllocationAudit::ScopedIgnore ignore;
+            o.destination->transmit (o.message);
+        }
+
+        // monitors see a segmented SysEx once, whole, with its last segment
+        if (o.isSegment && ! o.isLastSegment)
+            continue;
+
+        for (auto* monitor : monitors)
+            monitor->messageSent (*o.destination, o.isSegment ? o.finished : o.message, o.time);
+    }
+
+    numOutgoing = 0;
+}
+
+/*  Takes whatever the link has room for off its queues, for deliver() to
+    transmit. Returns the number of milliseconds until it can take the next
+    message, or -1 if all its queues are empty.
+*/
+double MidiOutputScheduler::service (Link& link, double now)
+{
+    auto& realtime = *link.queues[realtimePriority];
+    auto& voice    = *link.queues[voicePriority];
+    auto& bulk     = *link.queues[bulkPriority];
+
+    for (;;)
+    {
+        // a full batch is delivered before coming straight back for more
+        if (numOutgoing == maxOutgoing)
+            return 0.0;
+
+        Queue* queue = nullptr;
+
+        if (realtime.size() > 0)                               queue = &realtime;
+        else if (link.sysExOffset > 0 || voice.size() == 0)    queue = &bulk;
+        else                                                   queue = &voice;
+
+        auto* head = queue->front();
+
+        if (head == nullptr)
+            return -1.0;
+
+        auto readyAt = link.busyUntil - link.settings.burstBytes * link.msPerByte;
+
+        if (now < readyAt)
+            return readyAt - now;
+
+        auto& o = outgoing[(size_t) numOutgoing++];
+        o.destination = &link.destination;
+        o.time = now;
+
+        auto size = head->getRawDataSize();
+        auto segment = link.settings.sysExSegmentSize;
+        int numBytes;
+
+        if (queue == &bulk && head->isSysEx() && segment > 0 && size > segment)
+        {
+            auto remaining = size - link.sysExOffset;
+            numBytes = jmin (segment, remaining);
+
+            // never leave a tail too short to stand on its own
+            if (remaining - numBytes < 4)
+                numBytes = remaining;
+
+            {
+                // segments longer than a short message are copied to the heap
+                const AllocationAudit::ScopedIgnore ignore;
+                o.message = MidiMessage (head->getRawData() + link.sysExOffset, numBytes, head->getTimeStamp());
+            }
+
+            o.isSegment = true;
+            o.isLastSegment = false;
+            link.sysExOffset += numBytes;
+
+            if (link.sysExOffset >= size)
+            {
+                queue->popInto (o.finished);
+                o.isLastSegment = true;
+                link.sysExOffset = 0;
+                ++link.stats.messagesSent;
+            }
+        }
+        else
+        {
+            numBytes = size;
+            queue->popInto (o.message);
+            o.isSegment = o.isLastSegment = false;
+            ++link.stats.messagesSent;
+        }
+
+        link.stats.bytesSent += numBytes;
+        link.busyUntil = jmax (now, link.busyUntil) + numBytes * link.msPerByte;
+    }
+}
@@ -0,0 +1,184 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+#include "VirtualClock.h"
+
+//==============================================================================
+/**
+    Paces outgoing MIDI to the byte rate of each output link.
+
+    Every destination has three queues. Realtime messages (clock, start, stop..)
+    always go first, channel voice and system common messages next, and SysEx
+    last. On a destination that takes raw bytes, a long SysEx can be sent in
+    segments so that realtime bytes can be slipped in between them; this is the
+    only interleaving MIDI framing allows, so voice messages wait until the
+    SysEx has been finished.
+*/
+class MidiOutputScheduler  : private Thread
+{
+public:
+    enum Priority
+    {
+        realtimePriority = 0,
+        voicePriority,
+        bulkPriority,
+        numPriorities
+    };
+
+    /** Anything that can put bytes on a wire. transmit() is called on the
+        scheduler thread once the modelled link has room for the message,
+        without the scheduler's queues locked.
+    */
+    struct Destination
+    {
+        virtual ~Destination() = default;
+        virtual void transmit (const MidiMessage& message) = 0;
+
+        /** True if transmit() puts the bytes on the wire as they are, so a
+            SysEx can be handed over in pieces. MidiOutput can't take that: the
+            ALSA backend drops a piece that starts with data bytes.
+        */
+        virtual bool takesSysExSegments() const     { return false; }
+    };
+
+    /** Sees every message as it finishes going out, on the scheduler thread.
+        Must not block or allocate.
+    */
+    struct Monitor
+    {
+        virtual ~Monitor() = default;
+        virtual void messageSent (Destination& destination, const MidiMessage& message, double time) = 0;
+    };
+
+    struct LinkSettings
+    {
+        double bytesPerSecond = 3125.0;  // 31250 baud DIN, 10 bits per byte. <= 0 sends unpaced
+        int burstBytes = 3;              // bytes the interface may buffer ahead of the wire
+        int sysExSegmentSize = 0;        // 0 sends SysEx in one piece. Ignored unless the destination takesSysExSegments()
+        int queueCapacity = 1024;        // messages per priority class
+    };
+
+    struct LinkStats
+    {
+        int64 bytesSent = 0;
+        int64 messagesSent = 0;
+        int64 messagesDropped = 0;
+        int queued[numPriorities] = {};
+    };
+
+    //==============================================================================
+    /** The clock paces the links, and is the one the rest of the app should read. */
+    explicit MidiOutputScheduler (VirtualClock& clock);
+    ~MidiOutputScheduler();
+
+    VirtualClock& getClock() const noexcept     { return clock; }
+
+    void addDestination (Destination& destination, const LinkSettings& settings);
+    void removeDestination (Destination& destination);
+    void removeAllDestinations();
+    void setLinkSettings (Destination& destination, const LinkSettings& settings);
+
+    /** Queues a message using the priority class of its status byte.
+        Returns false if the destination is unknown or its queue is full.
+    */
+    bool send (Destination& destination, const MidiMessage& message);
+    bool send (Destination& destination, const MidiMessage& message, Priority priority);
+    void sendToAll (const MidiMessage& message);
+
+    LinkStats getStats (Destination& destination) const;
+
+    /** Once removeMonitor() returns the monitor is no longer being called. */
+    void addMonitor (Monitor* monitor);
+    void removeMonitor (Monitor* monitor);
+
+    static Priority getPriorityFor (const MidiMessage& message) noexcept;
+
+private:
+    //==============================================================================
+    struct Queue
+    {
+        explicit Queue (int capacity);
+
+        bool push (const MidiMessage& message);
+        const MidiMessage* front() const;
+        void popInto (MidiMessage& target);
+        int size() const noexcept   { return fifo.getNumReady(); }
+        void clear()                { fifo.reset(); }
+
+        AbstractFifo fifo;
+        std::vector<MidiMessage> slots;
+    };
+
+    /** A message taken off a queue, waiting to be transmitted outside the lock. */
+    struct Outgoing
+    {
+        Destination* destination = nullptr;
+        MidiMessage message;            // what goes on the wire
+        MidiMessage finished;           // the whole SysEx, once its last segment is out
+        bool isSegment = false, isLastSegment = false;
+        double time = 0.0;
+    };
+
+    enum { maxOutgoing = 256 };
+
+    struct Link
+    {
+        Link (Destination& d, const LinkSettings& s);
+        void applySettings (const LinkSettings& s);
+
+        Destination& destination;
+        LinkSettings settings;
+        std::unique_ptr<Queue> queues[numPriorities];
+        int sysExOffset = 0;        // bytes of the head SysEx already on the wire
+        double msPerByte = 0.0;
+        double busyUntil = 0.0;
+        LinkStats stats;
+    };
+
+    void run() override;
+    double service (Link& link, double now);
+    void deliver();
+    Link* findLink (Destination& destination) const;
+
+    VirtualClock& clock;
+
+    // send() only ever takes lock, so it never waits for a driver. The
+    // scheduler thread holds deliveryLock while it transmits, which keeps
+    // destinations and monitors alive until it is done with them.
+    CriticalSection deliveryLock, lock;
+    OwnedArray<Link> links;
+    Array<Monitor*> monitors;
+
+    // scheduler thread only
+    std::vector<Outgoing> outgoing;
+    int numOutgoing = 0;
+
+    //==============================================================================
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MidiOutputScheduler)
+};
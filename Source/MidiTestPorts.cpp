@@ -0,0 +1,139 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#include "MidiTestPorts.h"
+
+//==============================================================================
+MidiTestPorts::MidiTestPorts (MidiOutputScheduler& s,
+                              const ReferenceCountedArray<MidiDeviceListEntry>& in,
+                              const ReferenceCountedArray<MidiDeviceListEntry>& out)
+    : scheduler (s), inputs (in), outputs (out)
+{
+    // adding a listener shouldn't have to grow the array under the MIDI thread's feet
+    listeners.ensureStorageAllocated (16);
+}
+
+ReferenceCountedArray<MidiDeviceListEntry> MidiTestPorts::getOpenDevices (bool isInput) const
+{
+    ReferenceCountedArray<MidiDeviceListEntry> open;
+
+    for (auto* entry : isInput ? inputs : outputs)
+        if (isInput ? entry->isInputOpen() : entry->isOutputOpen())
+            open.add (entry);
+
+    return open;
+}
+
+void MidiTestPorts::addListener (Listener* listener)
+{
+    const ScopedLock sl (listenerLock);
+    listeners.addIfNotAlreadyThere (listener);
+}
+
+void MidiTestPorts::removeListener (Listener* listener)
+{
+    const ScopedLock sl (listenerLock);
+    listeners.removeFirstMatchingValue (listener);
+}
+
+void MidiTestPorts::dispatch (MidiDeviceListEntry* source, const MidiMessage& message)
+{
+    const ScopedLock sl (listenerLock);
+
+    for (auto* listener : listeners)
+        listener->midiReceived (source, message);
+}
+
+//==============================================================================
+MidiPairSelector::MidiPairSelector (MidiTestPorts& p)
+    : ports (p)
+{
+    addAndMakeVisible (outputLabel);
+    addAndMakeVisible (outputBox);
+    addAndMakeVisible (inputLabel);
+    addAndMakeVisible (inputBox);
+
+    outputBox.setTextWhenNoChoicesAvailable ("No outputs open");
+    inputBox.setTextWhenNoChoicesAvailable ("No inputs open");
+
+    timerCallback();
+    startTimer (500);
+}
+
+MidiPairSelector::~MidiPairSelector()
+{
+    stopTimer();
+}
+
+MidiDeviceListEntry::Ptr MidiPairSelector::getOutput() const
+{
+    return outputs[outputBox.getSelectedItemIndex()];
+}
+
+MidiDeviceListEntry::Ptr MidiPairSelector::getInput() const
+{
+    return inputs[inputBox.getSelectedItemIndex()];
+}
+
+void MidiPairSelector::timerCallback()
+{
+    refresh (outputBox, outputs, false);
+    refresh (inputBox, inputs, true);
+}
+
+void MidiPairSelector::refresh (ComboBox& box, ReferenceCountedArray<MidiDeviceListEntry>& current, bool isInput)
+{
+    auto open = ports.getOpenDevices (isInput);
+    bool changed = open.size() != current.size();
+
+    for (int i = 0; ! changed && i < open.size(); ++i)
+        changed = open[i] != current[i];
+
+    if (! changed)
+        return;
+
+    // keep the same device selected if it is still there
+    auto selected = current[box.getSelectedItemIndex()];
+    current = open;
+    box.clear (dontSendNotification);
+
+    for (int i = 0; i < current.size(); ++i)
+        box.addItem (current[i]->deviceInfo.name, i + 1);
+
+    auto index = selected != nullptr ? current.indexOf (selected) : -1;
+    box.setSelectedItemIndex (jmax (0, index), dontSendNotification);
+}
+
+void MidiPairSelector::resized()
+{
+    auto area = getLocalBounds();
+    auto half = area.removeFromLeft (area.getWidth() / 2);
+
+    outputLabel.setBounds (half.removeFromLeft (60));
+    outputBox.setBounds (half.reduced (2));
+    inputLabel.setBounds (area.removeFromLeft (70));
+    inputBox.setBounds (area.reduced (2));
+}
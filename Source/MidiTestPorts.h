@@ -0,0 +1,107 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+#include "MidiDeviceListEntry.h"
+
+//==============================================================================
+/**
+    What the test tools get from the main window: the devices the user has
+    opened, the scheduler to send through, and a look at every incoming
+    message on the MIDI thread.
+*/
+class MidiTestPorts
+{
+public:
+    struct Listener
+    {
+        virtual ~Listener() = default;
+
+        /** Called on the MIDI input thread for every message, before it is
+            queued for the monitor. Must not block or allocate.
+        */
+        virtual void midiReceived (MidiDeviceListEntry* source, const MidiMessage& message) = 0;
+    };
+
+    MidiTestPorts (MidiOutputScheduler& scheduler,
+                   const ReferenceCountedArray<MidiDeviceListEntry>& inputs,
+                   const ReferenceCountedArray<MidiDeviceListEntry>& outputs);
+
+    MidiOutputScheduler& getScheduler() const noexcept     { return scheduler; }
+    VirtualClock& getClock() const noexcept                 { return scheduler.getClock(); }
+
+    /** The devices that are open right now. Message thread only. */
+    ReferenceCountedArray<MidiDeviceListEntry> getOpenDevices (bool isInput) const;
+
+    /** Once removeListener() returns the listener is no longer being called. */
+    void addListener (Listener* listener);
+    void removeListener (Listener* listener);
+
+    /** Called by the owner from its MIDI input callback. */
+    void dispatch (MidiDeviceListEntry* source, const MidiMessage& message);
+
+private:
+    MidiOutputScheduler& scheduler;
+    const ReferenceCountedArray<MidiDeviceListEntry>& inputs;
+    const ReferenceCountedArray<MidiDeviceListEntry>& outputs;
+
+    CriticalSection listenerLock;
+    Array<Listener*> listeners;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MidiTestPorts)
+};
+
+//==============================================================================
+/**
+    A pair of combo boxes picking one open output and one open input, for the
+    tests that send on one port and listen on another. The lists follow the
+    devices opened on the main page.
+*/
+class MidiPairSelector  : public Component,
+                          private Timer
+{
+public:
+    explicit MidiPairSelector (MidiTestPorts& ports);
+    ~MidiPairSelector();
+
+    MidiDeviceListEntry::Ptr getOutput() const;
+    MidiDeviceListEntry::Ptr getInput() const;
+
+    void resized() override;
+
+private:
+    void timerCallback() override;
+    void refresh (ComboBox& box, ReferenceCountedArray<MidiDeviceListEntry>& current, bool isInput);
+
+    MidiTestPorts& ports;
+    Label outputLabel { {}, "Send to:" }, inputLabel { {}, "Listen on:" };
+    ComboBox outputBox, inputBox;
+    ReferenceCountedArray<MidiDeviceListEntry> outputs, inputs;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MidiPairSelector)
+};
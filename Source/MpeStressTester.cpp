@@ -0,0 +1,573 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#include "MpeStressTester.h"
+#include "RealtimeThreads.h"
+
+namespace
+{
+    const double settleMs = 300.0;
+    const uint8 noteVelocity = 100;
+}
+
+//==============================================================================
+MpeStressTester::MpeStressTester (MidiTestPorts& p)
+    : Thread ("MPE stress test"), ports (p)
+{
+    for (auto& lane : seen)
+        for (auto& stream : lane)
+            for (auto& word : stream)
+                word = 0;
+
+    for (auto& lane : laneOfChannel)
+        lane = -1;
+}
+
+MpeStressTester::~MpeStressTester()
+{
+    stop();
+}
+
+//==============================================================================
+bool MpeStressTester::start (MidiDeviceListEntry::Ptr newOutput, MidiDeviceListEntry::Ptr newInput, const Settings& newSettings)
+{
+    stop();
+
+    if (newOutput == nullptr || ! newOutput->isOutputOpen()
+         || newInput == nullptr || ! newInput->isInputOpen())
+        return false;
+
+    output = newOutput;
+    input = newInput;
+    settings = newSettings;
+    settings.numNotes = jlimit (1, (int) maxNotes, settings.numNotes);
+    settings.stepFactor = jmax (1.01, settings.stepFactor);
+    conditions = RealtimeThreads::getConditionsSummary();
+
+    for (auto& lane : seen)
+        for (auto& stream : lane)
+            for (auto& word : stream)
+                word = 0;
+
+    for (auto& lane : highestReceived)
+        for (auto& highest : lane)
+            highest = -1;
+
+    for (auto& lane : laneOfChannel)
+        lane = -1;
+
+    nextMessage = 0;
+    duplicates = 0;
+    reordered = 0;
+    smeared = 0;
+    notesReceived = 0;
+
+    {
+        const ScopedLock sl (resultsLock);
+        steps.clear();
+        verdict.clear();
+    }
+
+    inputDevice = input.get();
+    ports.addListener (this);
+    ports.getClock().threadStarting (*this);
+    startThread (9);
+    return true;
+}
+
+void MpeStressTester::stop()
+{
+    stopThread (2000);
+    ports.removeListener (this);
+    inputDevice = nullptr;
+}
+
+//==============================================================================
+void MpeStressTester::run()
+{
+    const VirtualClock::ScopedThread participant (ports.getClock(), *this);
+    configureZone();
+
+    auto rate = settings.startRate;
+    int lossySteps = 0;
+    String result;
+
+    while (! threadShouldExit() && rate <= settings.maxRate * 1.0001)
+    {
+        Step step;
+
+        if (! runStep (rate, step))
+            break;
+
+        {
+            const ScopedLock sl (resultsLock);
+            steps.add (step);
+        }
+
+        lossySteps = step.isLossy (settings.lossThreshold) ? lossySteps + 1 : 0;
+
+        if (lossySteps >= settings.lossyStepsToStop)
+            break;
+
+        rate *= settings.stepFactor;
+    }
+
+    if (threadShouldExit())
+        stopNotes();
+
+    Array<Step> all;
+
+    {
+        const ScopedLock sl (resultsLock);
+        all = steps;
+    }
+
+    int knee = -1;
+
+    for (int i = 0; i < all.size() && knee < 0; ++i)
+        if (all[i].isLossy (settings.lossThreshold))
+            knee = i;
+
+    auto describe = [] (const Step& s)
+    {
+        return String (s.updateRate, 0) + " updates/s per note (" + String (s.offeredRate, 0) + " msg/s)";
+    };
+
+    if (knee < 0)
+        result << "No loss or smearing up to " << (all.isEmpty() ? String ("the first step") : describe (all.getLast()));
+    else if (knee == 0)
+        result << "Per-note data breaks down from the first step, " << describe (all[0]);
+    else
+        result << "Per-note data breaks down at " << describe (all[knee]) << "; last clean step "
+               << describe (all[knee - 1]);
+
+    if (knee >= 0)
+        result << (all[knee].smeared > all[knee].lost ? ", mostly smeared onto other notes" : ", mostly dropped");
+
+    const ScopedLock sl (resultsLock);
+    verdict = result;
+}
+
+void MpeStressTester::configureZone()
+{
+    // exactly one member channel per note, so nothing is ever stolen
+    zone.setLayout (settings.layout, settings.numNotes);
+
+    for (auto& message : zone.getConfigurationMessages())
+        ports.getScheduler().send (*output, message);
+
+    ports.getClock().waitFor (*this, settleMs);
+}
+
+bool MpeStressTester::runStep (double rate, Step& step)
+{
+    const int64 messagesPerRound = (int64) settings.numNotes * numStreams;
+
+    step.updateRate = rate;
+    step.offeredRate = rate * (double) messagesPerRound;
+
+    auto durationMs = settings.stepSeconds * 1000.0;
+    auto firstMessage = nextMessage;
+    auto duplicatesBefore = duplicates.load();
+    auto reorderedBefore = reordered.load();
+    auto smearedBefore = smeared.load();
+    auto notesBefore = notesReceived.load();
+
+    startNotes();
+
+    auto stepStart = ports.getClock().now();
+    int64 due = 0;
+
+    for (;;)
+    {
+        RealtimeThreads::applyToCurrentThread (RealtimeThreads::timingThread);
+
+        if (threadShouldExit())
+            return false;
+
+        auto elapsed = ports.getClock().now() - stepStart;
+
+        if (elapsed >= durationMs)
+            break;
+
+        // a whole round of updates, every stream of every note, falls due at once
+        due = jmax (due, ((int64) (elapsed * rate * 0.001) + 1) * messagesPerRound);
+
+        while (step.sent < due)
+        {
+            auto index = nextMessage;
+            auto sequence = index / messagesPerRound;
+            auto& word = seen[(index / numStreams) % settings.numNotes][index % numStreams][(sequence % windowBits) / 32];
+            word.fetch_and (~(1u << (sequence % 32)), std::memory_order_relaxed);
+
+            // a refused message is retried, so a full queue never shows up as loss
+            if (! ports.getScheduler().send (*output, createMessage (index)))
+                break;
+
+            ++nextMessage;
+            ++step.sent;
+        }
+
+        ports.getClock().waitFor (*this, 1);
+    }
+
+    step.notQueued = jmax ((int64) 0, (int64) (step.offeredRate * settings.stepSeconds) - step.sent);
+
+    stopNotes();
+
+    // let the output queue drain onto the link, then give the last messages time to come back
+    for (;;)
+    {
+        auto stats = ports.getScheduler().getStats (*output);
+
+        if (stats.queued[MidiOutputScheduler::voicePriority] + stats.queued[MidiOutputScheduler::bulkPriority] == 0)
+            break;
+
+        ports.getClock().waitFor (*this, 10);
+
+        if (threadShouldExit())
+            return false;
+    }
+
+    auto settleUntil = ports.getClock().now() + settleMs;
+
+    while (ports.getClock().now() < settleUntil)
+    {
+        ports.getClock().waitFor (*this, 10);
+
+        if (threadShouldExit())
+            return false;
+    }
+
+    int64 sentPerLane[maxNotes] = {}, receivedPerLane[maxNotes] = {};
+
+    for (auto index = firstMessage; index < nextMessage; ++index)
+    {
+        auto lane = (int) ((index / numStreams) % settings.numNotes);
+        ++sentPerLane[lane];
+
+        if (wasReceived (lane, (int) (index % numStreams), index / messagesPerRound))
+            ++receivedPerLane[lane];
+    }
+
+    for (int lane = 0; lane < settings.numNotes; ++lane)
+    {
+        step.received += receivedPerLane[lane];
+
+        if (sentPerLane[lane] > 0)
+            step.worstNoteLoss = jmax (step.worstNoteLoss, 1.0 - (double) receivedPerLane[lane] / (double) sentPerLane[lane]);
+    }
+
+    step.lost = step.sent - step.received;
+    step.duplicates = duplicates.load() - duplicatesBefore;
+    step.reordered = reordered.load() - reorderedBefore;
+    step.smeared = smeared.load() - smearedBefore;
+    step.notesMissing = jmax ((int64) 0, 2 * (int64) settings.numNotes - (notesReceived.load() - notesBefore));
+    step.achievedRate = (double) step.received / settings.stepSeconds;
+    return true;
+}
+
+void MpeStressTester::startNotes()
+{
+    // arrivals from the last step were given time to come in, so its channels can be reused
+    for (auto& lane : laneOfChannel)
+        lane = -1;
+
+    zone.releaseAll();
+
+    for (int lane = 0; lane < settings.numNotes; ++lane)
+    {
+        int stolenNote;
+        auto channel = zone.startNote (firstNote + lane, stolenNote);
+        jassert (stolenNote < 0);
+
+        channelOfLane[lane] = channel;
+        laneOfChannel[channel - 1] = lane;
+    }
+
+    for (int lane = 0; lane < settings.numNotes; ++lane)
+        ports.getScheduler().send (*output, MidiMessage::noteOn (channelOfLane[lane], firstNote + lane, noteVelocity));
+}
+
+void MpeStressTester::stopNotes()
+{
+    for (int lane = 0; lane < settings.numNotes; ++lane)
+    {
+        auto channel = zone.stopNote (firstNote + lane);
+
+        if (channel < 0)
+            continue;
+
+        // a hung note would spoil the next step, so this waits for room in the queue
+        while (! ports.getScheduler().send (*output, MidiMessage::noteOff (channel, firstNote + lane, (uint8) 0x40)))
+        {
+            if (threadShouldExit())
+                break;
+
+            ports.getClock().waitFor (*this, 1);
+        }
+    }
+}
+
+MidiMessage MpeStressTester::createMessage (int64 index) const noexcept
+{
+    auto lane = (int) ((index / numStreams) % settings.numNotes);
+    auto sequence = index / ((int64) settings.numNotes * numStreams);
+    auto channel = channelOfLane[lane];
+
+    switch (index % numStreams)
+    {
+        case 0:     return MidiMessage::pitchWheel (channel, (lane << 10) | (int) (sequence % bendModulus));
+        case 1:     return MidiMessage::channelPressureChange (channel, (int) (sequence % sevenBitModulus));
+        default:    return MidiMessage::controllerEvent (channel, MpeZone::timbreController, (int) (sequence % sevenBitModulus));
+    }
+}
+
+bool MpeStressTester::wasReceived (int lane, int stream, int64 sequence) const noexcept
+{
+    return ((seen[lane][stream][(sequence % windowBits) / 32].load (std::memory_order_relaxed) >> (sequence % 32)) & 1) != 0;
+}
+
+//==============================================================================
+void MpeStressTester::midiReceived (MidiDeviceListEntry* source, const MidiMessage& message)
+{
+    // This is called on the MIDI thread
+    if (source != inputDevice.load())
+        return;
+
+    auto channel = message.getChannel();
+
+    if (channel < 1)
+        return;
+
+    auto isTimbre = message.isControllerOfType (MpeZone::timbreController);
+
+    if (! (message.isPitchWheel() || message.isChannelPressure() || isTimbre || message.isNoteOnOrOff()))
+        return;
+
+    auto lane = laneOfChannel[channel - 1].load();
+
+    if (lane < 0)
+    {
+        ++smeared;
+        return;
+    }
+
+    if (message.isNoteOnOrOff())
+    {
+        if (message.getNoteNumber() == firstNote + lane)
+            ++notesReceived;
+        else
+            ++smeared;
+    }
+    else if (message.isPitchWheel())
+    {
+        auto value = message.getPitchWheelValue();
+
+        if ((value >> 10) == lane)
+            markReceived (lane, 0, value % bendModulus, bendModulus);
+        else
+            ++smeared;
+    }
+    else if (message.isChannelPressure())
+    {
+        markReceived (lane, 1, message.getChannelPressureValue(), sevenBitModulus);
+    }
+    else
+    {
+        markReceived (lane, 2, message.getControllerValue(), sevenBitModulus);
+    }
+}
+
+void MpeStressTester::markReceived (int lane, int stream, int64 value, int64 modulus) noexcept
+{
+    // the sequence number nearest to the one expected next that has these low bits;
+    // the 7-bit streams can only tell a gap of up to 63 updates from a late arrival
+    auto& highest = highestReceived[lane][stream];
+    auto expected = highest + 1;
+    auto offset = ((value - expected) % modulus + modulus) % modulus;
+
+    if (offset >= modulus / 2)
+        offset -= modulus;
+
+    auto sequence = expected + offset;
+
+    if (sequence < 0)
+        return;
+
+    auto& word = seen[lane][stream][(sequence % windowBits) / 32];
+    auto bit = 1u << (sequence % 32);
+    auto wasSeen = (word.fetch_or (bit, std::memory_order_relaxed) & bit) != 0;
+
+    if (sequence > highest)
+        highest = sequence;
+    else if (wasSeen)
+        ++duplicates;
+    else
+        ++reordered;
+}
+
+//==============================================================================
+String MpeStressTester::getVerdict() const
+{
+    const ScopedLock sl (resultsLock);
+    return verdict;
+}
+
+String MpeStressTester::getReport() const
+{
+    if (output == nullptr || input == nullptr)
+        return {};
+
+    String s;
+    s << "MPE " << (settings.layout == MpeZone::lowerZone ? "lower" : "upper") << " zone, " << settings.numNotes
+      << " notes: " << output->deviceInfo.name << " -> " << input->deviceInfo.name << "\n"
+      << "Threads: " << conditions << "\n\n"
+      << String ("upd/s").paddedLeft (' ', 7) << String ("offered").paddedLeft (' ', 9)
+      << String ("received").paddedLeft (' ', 10) << String ("lost").paddedLeft (' ', 8)
+      << String ("smeared").paddedLeft (' ', 9) << String ("notes").paddedLeft (' ', 7)
+      << String ("reorder").paddedLeft (' ', 9) << String ("dupes").paddedLeft (' ', 7)
+      << String ("refused").paddedLeft (' ', 9) << String ("worst").paddedLeft (' ', 8) << "\n";
+
+    const ScopedLock sl (resultsLock);
+
+    for (auto& step : steps)
+    {
+        s << String (step.updateRate, 0).paddedLeft (' ', 7)
+          << String (step.offeredRate, 0).paddedLeft (' ', 9)
+          << String (step.achievedRate, 0).paddedLeft (' ', 10)
+          << String (step.lost).paddedLeft (' ', 8)
+          << String (step.smeared).paddedLeft (' ', 9)
+          << String (step.notesMissing).paddedLeft (' ', 7)
+          << String (step.reordered).paddedLeft (' ', 9)
+          << String (step.duplicates).paddedLeft (' ', 7)
+          << String (step.notQueued).paddedLeft (' ', 9)
+          << (String (step.worstNoteLoss * 100.0, 1) + "%").paddedLeft (' ', 8)
+          << (step.isLossy (settings.lossThreshold) ? "  <- breaks" : "") << "\n";
+    }
+
+    if (verdict.isNotEmpty())
+        s << "\n" << verdict << "\n";
+
+    return s;
+}
+
+//==============================================================================
+MpeStressPanel::MpeStressPanel (MpeStressTester& t, MidiTestPorts& ports)
+    : ToolPanel (ports), tester (t)
+{
+    zoneLabel.setText ("Zone:", dontSendNotification);
+    addAndMakeVisible (zoneLabel);
+    zoneBox.addItem ("Lower (master 1)", 1 + (int) MpeZone::lowerZone);
+    zoneBox.addItem ("Upper (master 16)", 1 + (int) MpeZone::upperZone);
+    zoneBox.setSelectedId (1 + (int) MpeZone::lowerZone, dontSendNotification);
+    addAndMakeVisible (zoneBox);
+
+    notesLabel.setText ("Notes:", dontSendNotification);
+    addAndMakeVisible (notesLabel);
+    numNotes.setSliderStyle (Slider::LinearHorizontal);
+    numNotes.setTextBoxStyle (Slider::TextBoxRight, false, 40, 20);
+    numNotes.setRange (1.0, (double) MpeZone::maxMemberChannels, 1.0);
+    numNotes.setValue (8.0, dontSendNotification);
+    addAndMakeVisible (numNotes);
+
+    rangeLabel.setText ("Rate:", dontSendNotification);
+    addAndMakeVisible (rangeLabel);
+    rateRange.setSliderStyle (Slider::TwoValueHorizontal);
+    rateRange.setRange (5.0, 5000.0, 5.0);
+    rateRange.setSkewFactorFromMidPoint (500.0);
+    rateRange.setMinAndMaxValues (50.0, 2000.0, dontSendNotification);
+    rateRange.setPopupDisplayEnabled (true, true, this);
+    rateRange.setTextValueSuffix (" updates/s per note");
+    addAndMakeVisible (rateRange);
+
+    stepLabel.setText ("Step:", dontSendNotification);
+    addAndMakeVisible (stepLabel);
+    stepSeconds.setSliderStyle (Slider::LinearHorizontal);
+    stepSeconds.setTextBoxStyle (Slider::TextBoxRight, false, 60, 20);
+    stepSeconds.setRange (0.5, 10.0, 0.5);
+    stepSeconds.setTextValueSuffix (" s");
+    stepSeconds.setValue (2.0, dontSendNotification);
+    addAndMakeVisible (stepSeconds);
+
+    startButton.onClick = [this] { startOrStop(); };
+    addAndMakeVisible (startButton);
+}
+
+void MpeStressPanel::startOrStop()
+{
+    if (tester.isRunning())
+    {
+        tester.stop();
+    }
+    else
+    {
+        MpeStressTester::Settings settings;
+        settings.layout = (MpeZone::Layout) (zoneBox.getSelectedId() - 1);
+        settings.numNotes = (int) numNotes.getValue();
+        settings.startRate = rateRange.getMinValue();
+        settings.maxRate = rateRange.getMaxValue();
+        settings.stepSeconds = stepSeconds.getValue();
+
+        if (! tester.start (getOutput(), getInput(), settings))
+            showMessage ("Open an output and an input on the main page and connect them through the device under test. "
+                         "Set the link to USB (unpaced) to test beyond the DIN rate.");
+    }
+
+    refresh();
+}
+
+void MpeStressPanel::update()
+{
+    startButton.setButtonText (tester.isRunning() ? "Stop" : "Start");
+}
+
+String MpeStressPanel::getReportText()
+{
+    return tester.getReport();
+}
+
+void MpeStressPanel::resized()
+{
+    auto area = layOutPair();
+
+    auto row = area.removeFromTop (rowHeight);
+    zoneLabel.setBounds (row.removeFromLeft (60));
+    zoneBox.setBounds (row.removeFromLeft (150).reduced (2));
+    notesLabel.setBounds (row.removeFromLeft (50));
+    numNotes.setBounds (row.removeFromLeft (200).reduced (2));
+    startButton.setBounds (row.removeFromRight (80).reduced (2));
+    area.removeFromTop (4);
+
+    row = area.removeFromTop (rowHeight);
+    rangeLabel.setBounds (row.removeFromLeft (60));
+    stepSeconds.setBounds (row.removeFromRight (200).reduced (2));
+    stepLabel.setBounds (row.removeFromRight (40));
+    rateRange.setBounds (row.reduced (2));
+
+    area.removeFromTop (10);
+    report.setBounds (area);
+}
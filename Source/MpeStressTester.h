@@ -0,0 +1,169 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+#include "MidiTestPorts.h"
+#include "MpeZone.h"
+#include "ToolPanel.h"
+
+//==============================================================================
+/**
+    Finds the update rate at which a device starts dropping or smearing
+    per-note MPE data.
+
+    Each step holds N notes in an MPE zone, one per member channel. Every
+    note sends pitch bend, pressure and CC74 updates at the step's rate, and
+    the rate rises from one step to the next. Each stream carries a running
+    sequence number in its values. Pitch bend also carries the note's lane
+    in its top four bits. The receiving side checks every stream the way the
+    plain stress test does, so gaps, duplicates and late arrivals are counted
+    per note.
+
+    Data that comes back on the wrong note counts as smeared. That is a
+    bend whose lane doesn't match its channel, or anything that arrives on a
+    member channel with no note on it. A device that merges member channels,
+    or thins and resends expression, shows up here rather than as plain loss.
+*/
+class MpeStressTester  : private Thread,
+                         private MidiTestPorts::Listener
+{
+public:
+    struct Settings
+    {
+        MpeZone::Layout layout = MpeZone::lowerZone;
+        int numNotes = 8;
+        double startRate = 50.0;        // updates per second per note, each one bend, pressure and CC74
+        double maxRate = 2000.0;
+        double stepFactor = 1.5;
+        double stepSeconds = 2.0;
+        double lossThreshold = 0.001;
+        int lossyStepsToStop = 2;
+    };
+
+    struct Step
+    {
+        double updateRate = 0.0;
+        double offeredRate = 0.0;       // messages per second over all notes
+        double achievedRate = 0.0;
+        int64 sent = 0;
+        int64 notQueued = 0;
+        int64 received = 0;
+        int64 lost = 0;
+        int64 duplicates = 0;
+        int64 reordered = 0;
+        int64 smeared = 0;
+        int64 notesMissing = 0;         // note-ons and note-offs that never came back on their channel
+        double worstNoteLoss = 0.0;     // fraction lost by the note that fared worst
+
+        bool isLossy (double threshold) const noexcept
+        {
+            return sent > 0 && (double) (lost + smeared + notesMissing) > threshold * (double) sent;
+        }
+    };
+
+    //==============================================================================
+    explicit MpeStressTester (MidiTestPorts& ports);
+    ~MpeStressTester();
+
+    /** Returns false if either device isn't open. */
+    bool start (MidiDeviceListEntry::Ptr output, MidiDeviceListEntry::Ptr input, const Settings& settings);
+    void stop();
+    bool isRunning() const                  { return isThreadRunning(); }
+
+    /** The one-line outcome, once a run has finished; empty until then. */
+    String getVerdict() const;
+    String getReport() const;
+
+private:
+    //==============================================================================
+    enum
+    {
+        maxNotes = MpeZone::maxMemberChannels,
+        numStreams = 3,                 // bend, pressure, CC74
+        windowBits = 1 << 15,
+        firstNote = 48,
+        bendModulus = 1 << 10,
+        sevenBitModulus = 128
+    };
+
+    void run() override;
+    void configureZone();
+    bool runStep (double rate, Step& step);
+    MidiMessage createMessage (int64 index) const noexcept;
+    void startNotes();
+    void stopNotes();
+    bool wasReceived (int lane, int stream, int64 sequence) const noexcept;
+
+    void midiReceived (MidiDeviceListEntry* source, const MidiMessage& message) override;
+    void markReceived (int lane, int stream, int64 value, int64 modulus) noexcept;
+
+    MidiTestPorts& ports;
+    MidiDeviceListEntry::Ptr output, input;
+    std::atomic<MidiDeviceListEntry*> inputDevice { nullptr };
+    Settings settings;
+    MpeZone zone;
+    String conditions;
+
+    int channelOfLane[maxNotes];
+    std::atomic<int> laneOfChannel[16];     // -1 where no note is playing
+    int64 nextMessage = 0;                  // bend, pressure and CC74 for each lane in turn
+    std::atomic<uint32> seen[maxNotes][numStreams][windowBits / 32];
+
+    // MIDI thread only
+    int64 highestReceived[maxNotes][numStreams];
+
+    std::atomic<int64> duplicates { 0 }, reordered { 0 }, smeared { 0 }, notesReceived { 0 };
+
+    CriticalSection resultsLock;
+    Array<Step> steps;
+    String verdict;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MpeStressTester)
+};
+
+//==============================================================================
+class MpeStressPanel  : public ToolPanel
+{
+public:
+    MpeStressPanel (MpeStressTester& tester, MidiTestPorts& ports);
+
+    void resized() override;
+
+private:
+    String getReportText() override;
+    void update() override;
+    void startOrStop();
+
+    MpeStressTester& tester;
+    Label zoneLabel, notesLabel, rangeLabel, stepLabel;
+    ComboBox zoneBox;
+    Slider numNotes, rateRange, stepSeconds;
+    TextButton startButton { "Start" };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MpeStressPanel)
+};
@@ -0,0 +1,149 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#include "MpeZone.h"
+
+//==============================================================================
+MpeZone::MpeZone()
+{
+    releaseAll();
+}
+
+void MpeZone::setLayout (Layout newLayout, int numMemberChannels)
+{
+    layout = newLayout;
+    numMembers = jlimit (0, (int) maxMemberChannels, numMemberChannels);
+    releaseAll();
+}
+
+bool MpeZone::isMemberChannel (int channel) const noexcept
+{
+    return layout == lowerZone ? (channel >= 2 && channel < 2 + numMembers)
+                               : (channel <= 15 && channel > 15 - numMembers);
+}
+
+Array<MidiMessage> MpeZone::getConfigurationMessages (int noteBendRange) const
+{
+    auto rpn = [] (int channel, int parameter, int value)
+    {
+        return Array<MidiMessage> { MidiMessage::controllerEvent (channel, 101, 0),
+                                    MidiMessage::controllerEvent (channel, 100, parameter),
+                                    MidiMessage::controllerEvent (channel, 6, value),
+                                    MidiMessage::controllerEvent (channel, 101, 127),
+                                    MidiMessage::controllerEvent (channel, 100, 127) };
+    };
+
+    // RPN 6 on the master channel sets the number of members
+    auto messages = rpn (getMasterChannel(), 6, numMembers);
+
+    // RPN 0 on any member sets the bend range for all of them
+    if (isActive())
+        messages.addArray (rpn (getMemberChannel (0), 0, jlimit (0, 96, noteBendRange)));
+
+    return messages;
+}
+
+//==============================================================================
+int MpeZone::startNote (int noteNumber, int& stolenNote) noexcept
+{
+    jassert (isPositiveAndBelow (noteNumber, 128));
+    stolenNote = -1;
+
+    if (! isActive())
+        return -1;
+
+    // the same key again replaces the note it already has
+    auto member = (int) memberOfNote[noteNumber];
+
+    if (member < 0)
+    {
+        int oldestFree = -1, oldestBusy = -1;
+
+        for (int i = 0; i < numMembers; ++i)
+        {
+            auto& oldest = noteOnMember[i] < 0 ? oldestFree : oldestBusy;
+
+            if (oldest < 0 || lastChange[i] - changeCounter < lastChange[oldest] - changeCounter)
+                oldest = i;
+        }
+
+        member = oldestFree >= 0 ? oldestFree : oldestBusy;
+    }
+
+    if (noteOnMember[member] >= 0)
+    {
+        stolenNote = noteOnMember[member];
+        memberOfNote[stolenNote] = -1;
+    }
+
+    noteOnMember[member] = noteNumber;
+    memberOfNote[noteNumber] = (int8) member;
+    lastChange[member] = changeCounter++;
+    return getMemberChannel (member);
+}
+
+int MpeZone::stopNote (int noteNumber) noexcept
+{
+    jassert (isPositiveAndBelow (noteNumber, 128));
+    auto member = (int) memberOfNote[noteNumber];
+
+    if (member < 0)
+        return -1;
+
+    memberOfNote[noteNumber] = -1;
+    noteOnMember[member] = -1;
+    lastChange[member] = changeCounter++;
+    return getMemberChannel (member);
+}
+
+int MpeZone::getChannelForNote (int noteNumber) const noexcept
+{
+    auto member = isPositiveAndBelow (noteNumber, 128) ? (int) memberOfNote[noteNumber] : -1;
+    return member >= 0 ? getMemberChannel (member) : -1;
+}
+
+void MpeZone::releaseAll() noexcept
+{
+    for (int i = 0; i < maxMemberChannels; ++i)
+    {
+        noteOnMember[i] = -1;
+        lastChange[i] = 0;
+    }
+
+    for (auto& member : memberOfNote)
+        member = -1;
+
+    changeCounter = 1;
+}
+
+//==============================================================================
+int MpeZone::createExpression (int channel, int pitchBend, int pressure, int timbre, MidiMessage* dest) noexcept
+{
+    dest[0] = MidiMessage::pitchWheel (channel, jlimit (0, 16383, pitchBend));
+    dest[1] = MidiMessage::channelPressureChange (channel, jlimit (0, 127, pressure));
+    dest[2] = MidiMessage::controllerEvent (channel, timbreController, jlimit (0, 127, timbre));
+    return maxExpressionMessages;
+}
@@ -0,0 +1,111 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+
+//==============================================================================
+/**
+    One MPE zone: a master channel and the member channels next to it, with
+    the per-note channel allocation an MPE sender does.
+
+    A lower zone has its master on channel 1 and members counting up from 2.
+    An upper zone has its master on 16 and members counting down from 15.
+    Each new note gets a member channel of its own, so pitch bend, pressure
+    and CC74 sent on that channel move only that note.
+
+    A note goes to the free channel that has been free the longest, which
+    leaves a released note's tail alone for as long as possible. When every
+    member channel is busy the oldest note is stolen, and the caller sends
+    its note-off first. This has no locks and never allocates; use it from
+    one thread.
+*/
+class MpeZone
+{
+public:
+    enum Layout
+    {
+        lowerZone = 0,
+        upperZone
+    };
+
+    enum
+    {
+        maxMemberChannels = 15,
+        timbreController = 74,
+        defaultNoteBendRange = 48,
+        maxExpressionMessages = 3
+    };
+
+    //==============================================================================
+    MpeZone();
+
+    /** 0 member channels turns the zone off. Any notes still allocated are forgotten. */
+    void setLayout (Layout newLayout, int numMemberChannels);
+    Layout getLayout() const noexcept               { return layout; }
+    int getNumMemberChannels() const noexcept       { return numMembers; }
+    bool isActive() const noexcept                  { return numMembers > 0; }
+
+    int getMasterChannel() const noexcept           { return layout == lowerZone ? 1 : 16; }
+    bool isMemberChannel (int channel) const noexcept;
+
+    /** The MPE Configuration Message for this zone, followed by the per-note
+        pitch bend range on the members. With the zone off, this is the
+        message that turns it off on the receiver.
+    */
+    Array<MidiMessage> getConfigurationMessages (int noteBendRange = defaultNoteBendRange) const;
+
+    //==============================================================================
+    /** Returns the channel for the new note, or -1 if the zone is off. If a
+        note had to make way, stolenNote is set to it (otherwise -1); it was
+        playing on the returned channel.
+    */
+    int startNote (int noteNumber, int& stolenNote) noexcept;
+
+    /** Frees the note's channel and returns it, or -1 if the note isn't playing. */
+    int stopNote (int noteNumber) noexcept;
+
+    int getChannelForNote (int noteNumber) const noexcept;
+    void releaseAll() noexcept;
+
+    /** Pitch bend (0-16383), channel pressure and CC74 for one note's channel.
+        Writes maxExpressionMessages messages into dest.
+    */
+    static int createExpression (int channel, int pitchBend, int pressure, int timbre, MidiMessage* dest) noexcept;
+
+private:
+    //==============================================================================
+    int getMemberChannel (int index) const noexcept { return layout == lowerZone ? 2 + index : 15 - index; }
+
+    Layout layout = lowerZone;
+    int numMembers = 0;
+
+    int noteOnMember[maxMemberChannels];        // -1 when the member is free
+    uint32 lastChange[maxMemberChannels];
+    uint32 changeCounter = 0;
+    int8 memberOfNote[128];                     // -1 when the note isn't playing
+};
@@ -0,0 +1,430 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#include "PresetSwitchTester.h"
+#include "RealtimeThreads.h"
+
+namespace
+{
+    // a preset counts as slow when its median is this far above the median of all of them
+    const double slowRatio = 1.5;
+    const double slowMarginMs = 5.0;
+}
+
+//==============================================================================
+PresetSwitchTester::PresetSwitchTester (MidiTestPorts& p)
+    : Thread ("Preset switch test"), ports (p)
+{
+    for (auto& t : timeouts)
+        t = 0;
+}
+
+PresetSwitchTester::~PresetSwitchTester()
+{
+    stop();
+}
+
+StringArray PresetSwitchTester::getResponseNames()
+{
+    return { "Any message", "Controller", "SysEx", "Pattern" };
+}
+
+Array<int> PresetSwitchTester::parsePattern (const String& text)
+{
+    Array<int> bytes;
+
+    for (auto& token : StringArray::fromTokens (text, " ,", ""))
+    {
+        if (token == "??" || token.equalsIgnoreCase ("xx"))
+            bytes.add (-1);
+        else if (token.length() <= 2 && token.containsOnly ("0123456789abcdefABCDEF"))
+            bytes.add (token.getHexValue32());
+        else
+            return {};
+    }
+
+    return bytes;
+}
+
+//==============================================================================
+bool PresetSwitchTester::start (MidiDeviceListEntry::Ptr newOutput, MidiDeviceListEntry::Ptr newInput, const Settings& newSettings)
+{
+    stop();
+
+    if (newOutput == nullptr || ! newOutput->isOutputOpen()
+         || newInput == nullptr || ! newInput->isInputOpen())
+        return false;
+
+    auto newPattern = parsePattern (newSettings.pattern);
+
+    if (newSettings.response == customPattern && newPattern.isEmpty())
+        return false;
+
+    output = newOutput;
+    input = newInput;
+    settings = newSettings;
+    settings.channel = jlimit (1, 16, settings.channel);
+    settings.firstProgram = jlimit (0, 127, settings.firstProgram);
+    settings.lastProgram = jlimit (settings.firstProgram, 127, settings.lastProgram);
+    settings.switchesPerProgram = jmax (1, settings.switchesPerProgram);
+    pattern = newPattern;
+    conditions = RealtimeThreads::getConditionsSummary();
+
+    for (auto program = settings.firstProgram; program <= settings.lastProgram; ++program)
+    {
+        if (histograms[program] == nullptr)
+            histograms[program].reset (new LatencyHistogram());
+
+        histograms[program]->reset();
+    }
+
+    for (auto& t : timeouts)
+        t = 0;
+
+    overall.reset();
+    switches = 0;
+    awaitingResponse = false;
+
+    inputDevice = input.get();
+    ports.addListener (this);
+    ports.getClock().threadStarting (*this);
+    startThread (9);
+    return true;
+}
+
+void PresetSwitchTester::stop()
+{
+    signalThreadShouldExit();
+    ports.getClock().wake (*this);
+    stopThread (2000);
+    ports.removeListener (this);
+    inputDevice = nullptr;
+}
+
+//==============================================================================
+void PresetSwitchTester::run()
+{
+    auto& scheduler = ports.getScheduler();
+    auto& clock = ports.getClock();
+    const VirtualClock::ScopedThread participant (clock, *this);
+
+    for (int round = 0; round < settings.switchesPerProgram; ++round)
+    {
+        for (auto program = settings.firstProgram; program <= settings.lastProgram; ++program)
+        {
+            RealtimeThreads::applyToCurrentThread (RealtimeThreads::timingThread);
+
+            if (threadShouldExit())
+                return;
+
+            if (settings.bankMsb >= 0)
+                scheduler.send (*output, MidiMessage::controllerEvent (settings.channel, 0, settings.bankMsb),
+                                MidiOutputScheduler::voicePriority);
+
+            if (settings.bankLsb >= 0)
+                scheduler.send (*output, MidiMessage::controllerEvent (settings.channel, 32, settings.bankLsb),
+                                MidiOutputScheduler::voicePriority);
+
+            respondedAt = -1.0;
+            awaitingResponse = true;
+            auto sentAt = clock.now();
+
+            if (! scheduler.send (*output, MidiMessage::programChange (settings.channel, program),
+                                  MidiOutputScheduler::voicePriority))
+            {
+                // the queue is full, so try the same program again shortly
+                awaitingResponse = false;
+                clock.waitFor (*this, 10);
+                --program;
+                continue;
+            }
+
+            ++switches;
+
+            // the answer, a timeout or a stop, whichever comes first
+            while (awaitingResponse.load() && ! threadShouldExit())
+            {
+                auto deadline = sentAt + settings.timeoutMs;
+
+                if (clock.now() >= deadline)
+                    break;
+
+                clock.waitUntil (*this, deadline);
+            }
+
+            if (threadShouldExit())
+                return;
+
+            auto expected = true;
+
+            if (awaitingResponse.compare_exchange_strong (expected, false))
+            {
+                ++timeouts[program];
+            }
+            else
+            {
+                // the MIDI thread won the answer and stores its time straight
+                // after, then wakes us; only that short gap is ever waited for
+                while (respondedAt.load() < 0.0 && ! threadShouldExit())
+                    clock.waitUntil (*this, sentAt + settings.timeoutMs);
+
+                auto latency = respondedAt.load() - sentAt;
+                histograms[program]->record (latency);
+                overall.record (latency);
+            }
+
+            clock.waitFor (*this, jmax (1.0, settings.gapMs));
+        }
+    }
+}
+
+bool PresetSwitchTester::isResponse (const MidiMessage& message) const noexcept
+{
+    // a loopback or thru hands back the switch itself, Bank Select included,
+    // which proves nothing whatever the device is expected to answer with
+    if (message.getChannel() == settings.channel
+         && (message.isProgramChange() || (message.isController() && (message.getControllerNumber() == 0
+                                                                       || message.getControllerNumber() == 32))))
+        return false;
+
+    switch (settings.response)
+    {
+        case controllerMessage:     return message.isController();
+        case sysExMessage:          return message.isSysEx();
+
+        case customPattern:
+        {
+            auto* data = message.getRawData();
+
+            if (message.getRawDataSize() < pattern.size())
+                return false;
+
+            for (int i = 0; i < pattern.size(); ++i)
+                if (pattern.getUnchecked (i) >= 0 && pattern.getUnchecked (i) != data[i])
+                    return false;
+
+            return true;
+        }
+
+        case anyMessage:
+        default:
+            break;
+    }
+
+    return ! message.isActiveSense() && ! message.isMidiClock();
+}
+
+void PresetSwitchTester::midiReceived (MidiDeviceListEntry* source, const MidiMessage& message)
+{
+    // This is called on the MIDI thread
+    if (source != inputDevice.load() || ! awaitingResponse.load() || ! isResponse (message))
+        return;
+
+    auto now = ports.getClock().now();
+    auto expected = true;
+
+    if (awaitingResponse.compare_exchange_strong (expected, false))
+    {
+        respondedAt = now;
+        ports.getClock().wake (*this);
+    }
+}
+
+//==============================================================================
+String PresetSwitchTester::getReport() const
+{
+    if (output == nullptr || input == nullptr)
+        return {};
+
+    String s;
+    s << "Preset switch: " << output->deviceInfo.name << " -> " << input->deviceInfo.name
+      << ", channel " << settings.channel << ", waiting for " << getResponseNames()[(int) settings.response].toLowerCase();
+
+    if (settings.response == customPattern)
+        s << " " << settings.pattern;
+
+    s << "\nThreads: " << conditions << "\n"
+      << "Switches " << switches.load() << "\n\n"
+      << "All programs: " << overall.getSummary() << "\n\n";
+
+    // the typical switch time, to compare each program against
+    Array<double> medians;
+
+    for (auto program = settings.firstProgram; program <= settings.lastProgram; ++program)
+        if (histograms[program] != nullptr && histograms[program]->getCount() > 0)
+            medians.add (histograms[program]->getPercentile (50.0));
+
+    std::sort (medians.begin(), medians.end());
+    auto typical = medians.isEmpty() ? 0.0 : medians[medians.size() / 2];
+
+    s << String ("prog").paddedLeft (' ', 5) << String ("n").paddedLeft (' ', 6) << String ("t/o").paddedLeft (' ', 5)
+      << String ("p50").paddedLeft (' ', 9) << String ("p90").paddedLeft (' ', 9)
+      << String ("max").paddedLeft (' ', 9) << String ("mean").paddedLeft (' ', 9) << "  ms\n";
+
+    for (auto program = settings.firstProgram; program <= settings.lastProgram; ++program)
+    {
+        auto* h = histograms[program].get();
+
+        if (h == nullptr)
+            continue;
+
+        auto median = h->getPercentile (50.0);
+
+        s << String (program).paddedLeft (' ', 5)
+          << String (h->getCount()).paddedLeft (' ', 6)
+          << String (timeouts[program].load()).paddedLeft (' ', 5)
+          << String (median, 2).paddedLeft (' ', 9)
+          << String (h->getPercentile (90.0), 2).paddedLeft (' ', 9)
+          << String (h->getMaximum(), 2).paddedLeft (' ', 9)
+          << String (h->getMean(), 2).paddedLeft (' ', 9);
+
+        if (h->getCount() > 0 && median > typical * slowRatio && median > typical + slowMarginMs)
+            s << "  <- slow";
+        else if (timeouts[program].load() > 0)
+            s << "  <- no answer";
+
+        s << "\n";
+    }
+
+    return s;
+}
+
+//==============================================================================
+PresetSwitchPanel::PresetSwitchPanel (PresetSwitchTester& t, MidiTestPorts& ports)
+    : ToolPanel (ports), tester (t)
+{
+    PresetSwitchTester::Settings defaults;
+    channelLabel.setText ("Channel:", dontSendNotification);
+    addAndMakeVisible (channelLabel);
+    channel.setSliderStyle (Slider::IncDecButtons);
+    channel.setRange (1.0, 16.0, 1.0);
+    channel.setValue (defaults.channel, dontSendNotification);
+    addAndMakeVisible (channel);
+
+    programLabel.setText ("Programs:", dontSendNotification);
+    addAndMakeVisible (programLabel);
+    programs.setSliderStyle (Slider::TwoValueHorizontal);
+    programs.setRange (0.0, 127.0, 1.0);
+    programs.setMinAndMaxValues (defaults.firstProgram, defaults.lastProgram, dontSendNotification);
+    programs.setPopupDisplayEnabled (true, true, this);
+    addAndMakeVisible (programs);
+
+    repeatLabel.setText ("Each:", dontSendNotification);
+    addAndMakeVisible (repeatLabel);
+    repeats.setSliderStyle (Slider::LinearHorizontal);
+    repeats.setTextBoxStyle (Slider::TextBoxRight, false, 50, 20);
+    repeats.setRange (1.0, 200.0, 1.0);
+    repeats.setValue (defaults.switchesPerProgram, dontSendNotification);
+    repeats.setTextValueSuffix ("x");
+    addAndMakeVisible (repeats);
+
+    addAndMakeVisible (useBank);
+
+    for (auto* bank : { &bankMsb, &bankLsb })
+    {
+        bank->setSliderStyle (Slider::IncDecButtons);
+        bank->setRange (0.0, 127.0, 1.0);
+        addAndMakeVisible (*bank);
+    }
+
+    bankMsb.setTextValueSuffix (" MSB");
+    bankLsb.setTextValueSuffix (" LSB");
+
+    responseLabel.setText ("Answer:", dontSendNotification);
+    addAndMakeVisible (responseLabel);
+    response.addItemList (PresetSwitchTester::getResponseNames(), 1);
+    response.setSelectedItemIndex ((int) defaults.response, dontSendNotification);
+    addAndMakeVisible (response);
+
+    pattern.setText (defaults.pattern, false);
+    addAndMakeVisible (pattern);
+
+    startButton.onClick = [this] { startOrStop(); };
+    addAndMakeVisible (startButton);
+}
+
+void PresetSwitchPanel::startOrStop()
+{
+    if (tester.isRunning())
+    {
+        tester.stop();
+    }
+    else
+    {
+        PresetSwitchTester::Settings settings;
+        settings.channel = (int) channel.getValue();
+        settings.firstProgram = (int) programs.getMinValue();
+        settings.lastProgram = (int) programs.getMaxValue();
+        settings.switchesPerProgram = (int) repeats.getValue();
+        settings.bankMsb = useBank.getToggleState() ? (int) bankMsb.getValue() : -1;
+        settings.bankLsb = useBank.getToggleState() ? (int) bankLsb.getValue() : -1;
+        settings.response = (PresetSwitchTester::Response) response.getSelectedItemIndex();
+        settings.pattern = pattern.getText();
+
+        if (! tester.start (getOutput(), getInput(), settings))
+            showMessage ("Open an output and an input on the main page. "
+                         "A pattern is hex bytes separated by spaces, with ?? for any byte.");
+    }
+
+    refresh();
+}
+
+void PresetSwitchPanel::update()
+{
+    startButton.setButtonText (tester.isRunning() ? "Stop" : "Start");
+}
+
+String PresetSwitchPanel::getReportText()
+{
+    return tester.getReport();
+}
+
+void PresetSwitchPanel::resized()
+{
+    auto area = layOutPair();
+
+    auto row = area.removeFromTop (rowHeight);
+    channelLabel.setBounds (row.removeFromLeft (60));
+    channel.setBounds (row.removeFromLeft (100).reduced (2));
+    programLabel.setBounds (row.removeFromLeft (70));
+    programs.setBounds (row.removeFromLeft (200).reduced (2));
+    repeatLabel.setBounds (row.removeFromLeft (40));
+    repeats.setBounds (row.removeFromLeft (160).reduced (2));
+    startButton.setBounds (row.removeFromRight (80).reduced (2));
+    area.removeFromTop (4);
+
+    row = area.removeFromTop (rowHeight);
+    useBank.setBounds (row.removeFromLeft (110).reduced (2));
+    bankMsb.setBounds (row.removeFromLeft (120).reduced (2));
+    bankLsb.setBounds (row.removeFromLeft (120).reduced (2));
+    row.removeFromLeft (10);
+    responseLabel.setBounds (row.removeFromLeft (60));
+    response.setBounds (row.removeFromLeft (130).reduced (2));
+    pattern.setBounds (row.reduced (2));
+
+    area.removeFromTop (10);
+    report.setBounds (area);
+}
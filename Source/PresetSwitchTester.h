@@ -0,0 +1,138 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+#include "LatencyHistogram.h"
+#include "MidiTestPorts.h"
+#include "ToolPanel.h"
+
+//==============================================================================
+/**
+    Measures how long a device takes to switch presets.
+
+    Each switch is a Program Change, optionally preceded by Bank Select, and
+    the time runs from when the Program Change is queued until the first
+    message that looks like the device's answer arrives. Only one switch is
+    in flight at a time, so the answer can't be confused with another's.
+
+    The programs are visited in turn, round and round, so that every switch
+    really changes the preset. Each program keeps its own histogram, which
+    makes a preset that loads slowly stand out from the rest.
+*/
+class PresetSwitchTester  : private Thread,
+                            private MidiTestPorts::Listener
+{
+public:
+    enum Response
+    {
+        anyMessage = 0,         // anything but an echo of the switch itself
+        controllerMessage,
+        sysExMessage,
+        customPattern
+    };
+
+    struct Settings
+    {
+        int channel = 1;
+        int firstProgram = 0;
+        int lastProgram = 7;
+        int bankMsb = -1;               // -1 to leave out Bank Select
+        int bankLsb = -1;
+        int switchesPerProgram = 10;
+        double timeoutMs = 2000.0;
+        double gapMs = 200.0;           // after each answer, before the next switch
+        Response response = anyMessage;
+        String pattern { "F0 7D ??" };  // hex bytes, ?? for any; matches the start of a message
+    };
+
+    //==============================================================================
+    explicit PresetSwitchTester (MidiTestPorts& ports);
+    ~PresetSwitchTester();
+
+    /** Returns false if either device isn't open or the pattern can't be parsed. */
+    bool start (MidiDeviceListEntry::Ptr output, MidiDeviceListEntry::Ptr input, const Settings& settings);
+    void stop();
+    bool isRunning() const                  { return isThreadRunning(); }
+
+    String getReport() const;
+
+    static StringArray getResponseNames();
+
+    /** Parses "F0 7D ?? 01" into bytes, with -1 for a wildcard. Returns an
+        empty array if anything isn't a hex byte.
+    */
+    static Array<int> parsePattern (const String& text);
+
+private:
+    //==============================================================================
+    void run() override;
+    bool isResponse (const MidiMessage& message) const noexcept;
+    void midiReceived (MidiDeviceListEntry* source, const MidiMessage& message) override;
+
+    MidiTestPorts& ports;
+    MidiDeviceListEntry::Ptr output, input;
+    std::atomic<MidiDeviceListEntry*> inputDevice { nullptr };
+    Settings settings;
+    Array<int> pattern;
+    String conditions;
+
+    // the switch waiting for an answer
+    std::atomic<bool> awaitingResponse { false };
+    std::atomic<double> respondedAt { -1.0 };       // -1 until the answer's time is known
+
+    std::unique_ptr<LatencyHistogram> histograms[128];
+    LatencyHistogram overall;
+    std::atomic<int> timeouts[128];
+    std::atomic<int> switches { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PresetSwitchTester)
+};
+
+//==============================================================================
+class PresetSwitchPanel  : public ToolPanel
+{
+public:
+    PresetSwitchPanel (PresetSwitchTester& tester, MidiTestPorts& ports);
+
+    void resized() override;
+
+private:
+    String getReportText() override;
+    void update() override;
+    void startOrStop();
+
+    PresetSwitchTester& tester;
+    Label channelLabel, programLabel, repeatLabel, responseLabel;
+    Slider channel, programs, repeats, bankMsb, bankLsb;
+    ToggleButton useBank { "Bank Select" };
+    ComboBox response;
+    TextEditor pattern;
+    TextButton startButton { "Start" };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PresetSwitchPanel)
+};
@@ -0,0 +1,117 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#include "ProcessStats.h"
+
+#if JUCE_LINUX
+ #include <dirent.h>
+ #include <fcntl.h>
+ #include <unistd.h>
+#endif
+
+//==============================================================================
+#if JUCE_LINUX
+namespace
+{
+    /** /proc files report a size of zero, so they have to be read until the end. */
+    String readProcFile (const char* path)
+    {
+        auto fd = ::open (path, O_RDONLY);
+
+        if (fd < 0)
+            return {};
+
+        char buffer[1024];
+        auto numRead = ::read (fd, buffer, sizeof (buffer) - 1);
+        ::close (fd);
+
+        return numRead > 0 ? String (CharPointer_UTF8 (buffer), (size_t) numRead) : String();
+    }
+
+    /** The name and the user plus system time from a /proc/.../stat line. */
+    bool parseStat (const String& stat, String& name, double& cpuSeconds)
+    {
+        // the name is in brackets and may itself contain spaces or brackets
+        auto open = stat.indexOfChar ('(');
+        auto close = stat.lastIndexOfChar (')');
+
+        if (open < 0 || close < open)
+            return false;
+
+        name = stat.substring (open + 1, close);
+
+        // after the name: state, then the fields up to utime (14th) and stime (15th)
+        auto fields = StringArray::fromTokens (stat.substring (close + 1), " ", "");
+        fields.removeEmptyStrings();
+
+        if (fields.size() < 13)
+            return false;
+
+        static const double ticksPerSecond = (double) sysconf (_SC_CLK_TCK);
+        cpuSeconds = (double) (fields[11].getLargeIntValue() + fields[12].getLargeIntValue()) / ticksPerSecond;
+        return true;
+    }
+}
+#endif
+
+ProcessStats ProcessStats::capture()
+{
+    ProcessStats stats;
+
+   #if JUCE_LINUX
+    auto statm = StringArray::fromTokens (readProcFile ("/proc/self/statm"), " ", "");
+
+    if (statm.size() < 2)
+        return stats;
+
+    stats.residentBytes = statm[1].getLargeIntValue() * (int64) sysconf (_SC_PAGESIZE);
+
+    String name;
+    parseStat (readProcFile ("/proc/self/stat"), name, stats.cpuSeconds);
+
+    if (auto* dir = opendir ("/proc/self/task"))
+    {
+        while (auto* entry = readdir (dir))
+        {
+            if (entry->d_name[0] == '.')
+                continue;
+
+            ThreadTime t;
+            t.id = String (entry->d_name).getLargeIntValue();
+            auto path = "/proc/self/task/" + String (entry->d_name) + "/stat";
+
+            if (parseStat (readProcFile (path.toRawUTF8()), t.name, t.cpuSeconds))
+                stats.threads.add (t);
+        }
+
+        closedir (dir);
+    }
+
+    stats.isValid = true;
+   #endif
+
+    return stats;
+}
@@ -0,0 +1,54 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+
+//==============================================================================
+/**
+    A snapshot of this process's memory and CPU use, for watching trends over
+    long runs.
+
+    Only Linux is supported, where it comes from /proc. Elsewhere capture()
+    returns a snapshot with isValid false.
+*/
+struct ProcessStats
+{
+    struct ThreadTime
+    {
+        int64 id = 0;
+        String name;
+        double cpuSeconds = 0.0;        // user and system time since the thread started
+    };
+
+    bool isValid = false;
+    int64 residentBytes = 0;
+    double cpuSeconds = 0.0;            // all threads, user and system
+    Array<ThreadTime> threads;
+
+    static ProcessStats capture();
+};
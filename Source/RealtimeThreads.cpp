@@ -0,0 +1,394 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#include "RealtimeThreads.h"
+
+#if JUCE_LINUX
+ #include <pthread.h>
+ #include <sched.h>
+ #include <cerrno>
+#endif
+
+//==============================================================================
+namespace
+{
+    CriticalSection& getLock()
+    {
+        static CriticalSection lock;
+        return lock;
+    }
+
+    RealtimeThreads::RoleSettings roleSettings[RealtimeThreads::numRoles];
+    Array<RealtimeThreads::ThreadStatus> threadStatus;
+
+    // takes a thread's entry out of the status when the thread exits, so
+    // tools that have stopped don't go on labelling the results
+    struct StatusCleanup
+    {
+        ~StatusCleanup()
+        {
+            if (! listed)
+                return;
+
+            auto id = Thread::getCurrentThreadId();
+            const ScopedLock sl (getLock());
+
+            for (int i = threadStatus.size(); --i >= 0;)
+                if (threadStatus.getReference (i).threadId == id)
+                    threadStatus.remove (i);
+        }
+
+        bool listed = false;
+    };
+
+    thread_local StatusCleanup statusCleanup;
+
+    std::atomic<int> settingsGeneration { 0 };
+    thread_local int appliedGeneration = -1;
+    thread_local bool madeRealtime = false;
+
+   #if JUCE_LINUX
+    // the affinity a thread had before we pinned it, to go back to
+    thread_local bool pinned = false;
+    thread_local cpu_set_t inheritedCores;
+
+    String getPolicyName (int policy)
+    {
+        switch (policy)
+        {
+            case SCHED_FIFO:  return "SCHED_FIFO";
+            case SCHED_RR:    return "SCHED_RR";
+            default:          return "SCHED_OTHER";
+        }
+    }
+
+    /** Parses "0,2-3" style lists. Returns false if nothing usable was given. */
+    bool parseCores (const String& text, cpu_set_t& set)
+    {
+        CPU_ZERO (&set);
+        bool any = false;
+
+        for (auto& token : StringArray::fromTokens (text, ",", ""))
+        {
+            auto first = token.upToFirstOccurrenceOf ("-", false, false).trim().getIntValue();
+            auto last = token.containsChar ('-') ? token.fromFirstOccurrenceOf ("-", false, false).trim().getIntValue()
+                                                 : first;
+
+            for (int cpu = first; cpu <= last; ++cpu)
+            {
+                // CPU ids needn't be contiguous, so anything the set can hold is
+                // allowed, and the kernel says which of them exist
+                if (isPositiveAndBelow (cpu, (int) CPU_SETSIZE))
+                {
+                    CPU_SET (cpu, &set);
+                    any = true;
+                }
+            }
+        }
+
+        return any;
+    }
+
+    String describeCores (const cpu_set_t& set)
+    {
+        StringArray cpus;
+
+        for (int cpu = 0; cpu < (int) CPU_SETSIZE; ++cpu)
+            if (CPU_ISSET (cpu, &set))
+                cpus.add (String (cpu));
+
+        return cpus.size() >= SystemStats::getNumCpus() ? String ("any") : cpus.joinIntoString (",");
+    }
+   #endif
+}
+
+//==============================================================================
+bool RealtimeThreads::isSupported() noexcept
+{
+   #if JUCE_LINUX
+    return true;
+   #else
+    return false;
+   #endif
+}
+
+String RealtimeThreads::getRoleName (Role role)
+{
+    switch (role)
+    {
+        case inputThread:   return "MIDI input";
+        case outputThread:  return "MIDI output";
+        case timingThread:  return "Timing";
+        case numRoles:
+        default:            return {};
+    }
+}
+
+void RealtimeThreads::setSettings (Role role, const RoleSettings& settings)
+{
+    const ScopedLock sl (getLock());
+    roleSettings[role] = settings;
+    ++settingsGeneration;
+}
+
+RealtimeThreads::RoleSettings RealtimeThreads::getSettings (Role role)
+{
+    const ScopedLock sl (getLock());
+    return roleSettings[role];
+}
+
+void RealtimeThreads::applyToCurrentThread (Role role)
+{
+    if (appliedGeneration != settingsGeneration.load (std::memory_order_relaxed))
+        apply (role);
+}
+
+void RealtimeThreads::apply (Role role)
+{
+    appliedGeneration = settingsGeneration.load();
+    auto settings = getSettings (role);
+
+    ThreadStatus s;
+    s.role = role;
+    s.threadId = Thread::getCurrentThreadId();
+
+    if (auto* t = Thread::getCurrentThread())
+        s.threadName = t->getThreadName();
+    else
+        s.threadName = getRoleName (role) + " (system)";
+
+   #if JUCE_LINUX
+    auto self = pthread_self();
+    StringArray notes;
+
+    if (settings.policy != normalPolicy)
+    {
+        auto policy = settings.policy == fifoPolicy ? SCHED_FIFO : SCHED_RR;
+        sched_param param;
+        param.sched_priority = jlimit (sched_get_priority_min (policy), sched_get_priority_max (policy), settings.priority);
+
+        auto result = pthread_setschedparam (self, policy, &param);
+
+        if (result == EPERM)
+            notes.add ("no permission for " + getPolicyName (policy) + " (needs CAP_SYS_NICE or an rtprio limit)");
+        else if (result != 0)
+            notes.add (getPolicyName (policy) + " failed (error " + String (result) + ")");
+        else
+            madeRealtime = true;
+    }
+    else if (madeRealtime)
+    {
+        // drop back from our own earlier real-time setting, but leave
+        // whatever priority the thread was started with alone otherwise
+        sched_param param;
+        param.sched_priority = 0;
+        pthread_setschedparam (self, SCHED_OTHER, &param);
+        madeRealtime = false;
+    }
+
+    cpu_set_t cores;
+
+    if (parseCores (settings.cores, cores))
+    {
+        if (! pinned)
+            pinned = pthread_getaffinity_np (self, sizeof (inheritedCores), &inheritedCores) == 0;
+
+        if (auto result = pthread_setaffinity_np (self, sizeof (cores), &cores))
+            notes.add ("affinity failed (error " + String (result) + ")");
+    }
+    else
+    {
+        if (settings.cores.trim().isNotEmpty())
+            notes.add ("no valid cores in \"" + settings.cores + "\"");
+
+        // with no cores given, the affinity the thread inherited (taskset,
+        // cpusets) is left alone, or put back if we changed it
+        if (pinned)
+        {
+            pthread_setaffinity_np (self, sizeof (inheritedCores), &inheritedCores);
+            pinned = false;
+        }
+    }
+
+    // report what we actually got, not what we asked for
+    int policy = SCHED_OTHER;
+    sched_param param;
+
+    if (pthread_getschedparam (self, &policy, &param) == 0)
+    {
+        s.policy = getPolicyName (policy);
+        s.priority = param.sched_priority;
+    }
+
+    if (pthread_getaffinity_np (self, sizeof (cores), &cores) == 0)
+        s.cores = describeCores (cores);
+
+    s.note = notes.joinIntoString ("; ");
+   #else
+    s.policy = "default";
+    s.cores = "any";
+
+    if (settings.policy != normalPolicy || settings.cores.isNotEmpty())
+        s.note = "real-time scheduling is only supported on Linux";
+   #endif
+
+    const ScopedLock sl (getLock());
+    statusCleanup.listed = true;
+
+    for (auto& existing : threadStatus)
+    {
+        if (existing.role == role && existing.threadId == s.threadId)
+        {
+            existing = s;
+            return;
+        }
+    }
+
+    threadStatus.add (s);
+}
+
+Array<RealtimeThreads::ThreadStatus> RealtimeThreads::getThreadStatus()
+{
+    const ScopedLock sl (getLock());
+    return threadStatus;
+}
+
+String RealtimeThreads::getConditionsSummary()
+{
+    StringArray parts;
+
+    for (auto& s : getThreadStatus())
+        parts.add (s.threadName + ": " + s.policy + "/" + String (s.priority) + " cpus " + s.cores);
+
+    return parts.isEmpty() ? String ("default scheduling") : parts.joinIntoString (", ");
+}
+
+//==============================================================================
+RealtimeThreadsPanel::RealtimeThreadsPanel()
+{
+    for (int i = 0; i < RealtimeThreads::numRoles; ++i)
+    {
+        auto role = (RealtimeThreads::Role) i;
+        auto settings = RealtimeThreads::getSettings (role);
+        auto* c = roleControls.add (new RoleControls());
+
+        c->name.setText (RealtimeThreads::getRoleName (role), dontSendNotification);
+        addAndMakeVisible (c->name);
+
+        c->policy.addItemList ({ "Normal", "SCHED_FIFO", "SCHED_RR" }, 1);
+        c->policy.setSelectedItemIndex ((int) settings.policy, dontSendNotification);
+        addAndMakeVisible (c->policy);
+
+        c->priority.setSliderStyle (Slider::LinearHorizontal);
+        c->priority.setTextBoxStyle (Slider::TextBoxRight, false, 40, 20);
+        c->priority.setRange (1.0, 99.0, 1.0);
+        c->priority.setValue (settings.priority, dontSendNotification);
+        addAndMakeVisible (c->priority);
+
+        c->coresLabel.setText ("Cores:", dontSendNotification);
+        addAndMakeVisible (c->coresLabel);
+        c->cores.setInputRestrictions (32, "0123456789,-");
+        c->cores.setText (settings.cores);
+        addAndMakeVisible (c->cores);
+    }
+
+    applyButton.onClick = [this] { applySettings(); };
+    applyButton.setEnabled (RealtimeThreads::isSupported());
+    addAndMakeVisible (applyButton);
+
+    hint.setText (RealtimeThreads::isSupported() ? "The input thread picks up changes with its next message."
+                                                 : "Real-time scheduling is only supported on Linux.",
+                  dontSendNotification);
+    addAndMakeVisible (hint);
+
+    status.setMultiLine (true);
+    status.setReadOnly (true);
+    status.setCaretVisible (false);
+    addAndMakeVisible (status);
+
+    startTimerHz (2);
+}
+
+RealtimeThreadsPanel::~RealtimeThreadsPanel()
+{
+    stopTimer();
+}
+
+void RealtimeThreadsPanel::applySettings()
+{
+    for (int i = 0; i < RealtimeThreads::numRoles; ++i)
+    {
+        auto* c = roleControls[i];
+        RealtimeThreads::RoleSettings settings;
+        settings.policy = (RealtimeThreads::Policy) c->policy.getSelectedItemIndex();
+        settings.priority = (int) c->priority.getValue();
+        settings.cores = c->cores.getText();
+        RealtimeThreads::setSettings ((RealtimeThreads::Role) i, settings);
+    }
+}
+
+void RealtimeThreadsPanel::timerCallback()
+{
+    String text;
+
+    for (auto& s : RealtimeThreads::getThreadStatus())
+    {
+        text << RealtimeThreads::getRoleName (s.role) << " - " << s.threadName << ": "
+             << s.policy << " priority " << s.priority << ", cpus " << s.cores;
+
+        if (s.note.isNotEmpty())
+            text << "  [" << s.note << "]";
+
+        text << "\n";
+    }
+
+    if (text != status.getText())
+        status.setText (text, false);
+}
+
+void RealtimeThreadsPanel::resized()
+{
+    auto area = getLocalBounds().reduced (10);
+    const int rowHeight = 28;
+
+    for (auto* c : roleControls)
+    {
+        auto row = area.removeFromTop (rowHeight);
+        c->name.setBounds (row.removeFromLeft (90));
+        c->policy.setBounds (row.removeFromLeft (120).reduced (2));
+        c->priority.setBounds (row.removeFromLeft (180).reduced (2));
+        c->coresLabel.setBounds (row.removeFromLeft (50));
+        c->cores.setBounds (row.removeFromLeft (100).reduced (2));
+        area.removeFromTop (4);
+    }
+
+    auto row = area.removeFromTop (rowHeight);
+    applyButton.setBounds (row.removeFromRight (80).reduced (2));
+    hint.setBounds (row);
+
+    area.removeFromTop (10);
+    status.setBounds (area);
+}
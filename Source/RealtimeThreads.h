@@ -0,0 +1,129 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+
+//==============================================================================
+/**
+    Optional real-time scheduling and CPU pinning for the threads that touch
+    MIDI, and a record of what each of them actually got.
+
+    Settings are kept per role. Every MIDI or timing thread calls
+    applyToCurrentThread() at the top of its loop; that is a single atomic
+    compare unless the settings changed, in which case the thread re-applies
+    them to itself. This is also how the input thread, which belongs to the
+    platform MIDI API, gets configured: on the next message it delivers.
+
+    Only Linux is supported. Elsewhere, and when the process lacks the
+    privilege, threads stay on the normal scheduler and the status says why.
+*/
+class RealtimeThreads
+{
+public:
+    enum Role
+    {
+        inputThread = 0,
+        outputThread,
+        timingThread,
+        numRoles
+    };
+
+    enum Policy
+    {
+        normalPolicy = 0,
+        fifoPolicy,
+        roundRobinPolicy
+    };
+
+    struct RoleSettings
+    {
+        Policy policy = normalPolicy;
+        int priority = 50;          // 1-99 for the real-time policies
+        String cores;               // e.g. "2" or "0,2-3"; empty for any core
+    };
+
+    struct ThreadStatus
+    {
+        Role role;
+        String threadName;
+        Thread::ThreadID threadId = nullptr;
+        String policy;
+        int priority = 0;
+        String cores;
+        String note;                // why the request wasn't met, if it wasn't
+    };
+
+    //==============================================================================
+    static void setSettings (Role role, const RoleSettings& settings);
+    static RoleSettings getSettings (Role role);
+
+    static void applyToCurrentThread (Role role);
+
+    /** The threads that have applied their settings and are still running. */
+    static Array<ThreadStatus> getThreadStatus();
+
+    /** One line describing the conditions, for labelling test results. */
+    static String getConditionsSummary();
+
+    static String getRoleName (Role role);
+    static bool isSupported() noexcept;
+
+private:
+    static void apply (Role role);
+};
+
+//==============================================================================
+class RealtimeThreadsPanel  : public Component,
+                              private Timer
+{
+public:
+    RealtimeThreadsPanel();
+    ~RealtimeThreadsPanel();
+
+    void resized() override;
+
+private:
+    void timerCallback() override;
+    void applySettings();
+
+    struct RoleControls
+    {
+        Label name;
+        ComboBox policy;
+        Slider priority;
+        Label coresLabel;
+        TextEditor cores;
+    };
+
+    OwnedArray<RoleControls> roleControls;
+    TextButton applyButton { "Apply" };
+    Label hint;
+    TextEditor status;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (RealtimeThreadsPanel)
+};
@@ -0,0 +1,361 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#include "RigRunner.h"
+
+//==============================================================================
+class RigRunner::PairJob  : public ThreadPoolJob
+{
+public:
+    PairJob (MidiTestPorts& p, const Pair& pr, const Settings& s)
+        : ThreadPoolJob ("Rig " + pr.output->deviceInfo.name), ports (p), pair (pr), settings (s)
+    {
+    }
+
+    JobStatus runJob() override
+    {
+        // the job waits on the pool thread it was given
+        thread = Thread::getCurrentThread();
+        const VirtualClock::ScopedThread participant (ports.getClock(), *thread);
+
+        {
+            const ScopedLock sl (lock);
+            startedAt = ports.getClock().now();
+        }
+
+        if ((settings.tests & latencyTest) != 0)
+            runLatency();
+
+        if ((settings.tests & throughputTest) != 0 && ! shouldExit())
+            runThroughput();
+
+        if ((settings.tests & sweepTest) != 0 && ! shouldExit())
+            runSweep();
+
+        const ScopedLock sl (lock);
+        status = shouldExit() ? "stopped" : "done";
+        finishedAt = ports.getClock().now();
+        return jobHasFinished;
+    }
+
+    /** How long the pair has taken so far, in seconds. */
+    double getSeconds() const
+    {
+        const ScopedLock sl (lock);
+
+        if (startedAt == 0.0)
+            return 0.0;
+
+        return ((finishedAt > 0.0 ? finishedAt : ports.getClock().now()) - startedAt) * 0.001;
+    }
+
+    String getSummary() const
+    {
+        String s;
+        s << pair.output->deviceInfo.name << " -> " << pair.input->deviceInfo.name << "  [";
+
+        const ScopedLock sl (lock);
+        s << status;
+
+        if (startedAt > 0.0)
+            s << ", " << String (((finishedAt > 0.0 ? finishedAt : ports.getClock().now()) - startedAt) * 0.001, 1) << " s";
+
+        s << "]\n";
+
+        for (auto& line : results)
+            s << "    " << line << "\n";
+
+        return s;
+    }
+
+private:
+    void setStatus (const String& newStatus)
+    {
+        const ScopedLock sl (lock);
+        status = newStatus;
+    }
+
+    void addResult (const String& line)
+    {
+        const ScopedLock sl (lock);
+        results.add (line);
+    }
+
+    /** Waits for a tester to finish on its own, or until the given time if
+        it has one; stops it early if the rig is stopped.
+    */
+    template <typename Tester>
+    void waitFor (Tester& tester, double untilMs = 0.0)
+    {
+        while (tester.isRunning())
+        {
+            if (shouldExit() || (untilMs > 0.0 && ports.getClock().now() >= untilMs))
+            {
+                tester.stop();
+                break;
+            }
+
+            ports.getClock().waitFor (*thread, 50);
+        }
+    }
+
+    void runLatency()
+    {
+        setStatus ("latency");
+        auto tester = std::make_unique<LatencyTester> (ports);
+
+        if (! tester->start (pair.output, pair.input, settings.latency))
+        {
+            addResult ("latency: devices not open");
+            return;
+        }
+
+        waitFor (*tester, ports.getClock().now() + settings.latencySeconds * 1000.0);
+
+        auto results = tester->getResults();
+        addResult ("latency: " + tester->getHistogram().getSummary() + ", " + String (results.lost) + " lost");
+    }
+
+    void runThroughput()
+    {
+        setStatus ("throughput");
+        auto tester = std::make_unique<StressTester> (ports);
+
+        if (! tester->start (pair.output, pair.input, settings.throughput))
+        {
+            addResult ("throughput: devices not open");
+            return;
+        }
+
+        waitFor (*tester);
+        addResult ("throughput: " + (shouldExit() ? String ("stopped") : tester->getVerdict()));
+    }
+
+    void runSweep()
+    {
+        setStatus ("sweep");
+        auto tester = std::make_unique<SweepVerifier> (ports);
+
+        if (! tester->start (pair.output, pair.input, settings.sweep))
+        {
+            addResult ("sweep: devices not open, or nothing to sweep");
+            return;
+        }
+
+        waitFor (*tester);
+        addResult ("sweep: " + (shouldExit() ? String ("stopped") : tester->getVerdict()));
+    }
+
+    MidiTestPorts& ports;
+    const Pair pair;
+    const Settings settings;
+    Thread* thread = nullptr;
+
+    CriticalSection lock;
+    String status { "waiting" };
+    StringArray results;
+    double startedAt = 0.0, finishedAt = 0.0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PairJob)
+};
+
+//==============================================================================
+RigRunner::RigRunner (MidiTestPorts& p)
+    : ports (p)
+{
+}
+
+RigRunner::~RigRunner()
+{
+    stop();
+}
+
+Array<RigRunner::Pair> RigRunner::pairByName (MidiTestPorts& ports)
+{
+    Array<Pair> pairs;
+    auto inputs = ports.getOpenDevices (true);
+
+    for (auto* output : ports.getOpenDevices (false))
+    {
+        for (auto* input : inputs)
+        {
+            if (input->deviceInfo.name == output->deviceInfo.name)
+            {
+                pairs.add ({ output, input });
+                break;
+            }
+        }
+    }
+
+    return pairs;
+}
+
+bool RigRunner::start (const Array<Pair>& pairs, const Settings& newSettings)
+{
+    stop();
+    jobs.clear();
+    settings = newSettings;
+
+    for (auto& pair : pairs)
+        if (pair.output != nullptr && pair.output->isOutputOpen()
+             && pair.input != nullptr && pair.input->isInputOpen())
+            jobs.add (new PairJob (ports, pair, settings));
+
+    if (jobs.isEmpty())
+        return false;
+
+    // the pool threads only supervise; each tester has its own timing thread
+    pool.reset (new ThreadPool (jlimit (1, jobs.size(), settings.maxConcurrentPairs)));
+    startTime = ports.getClock().now();
+
+    for (auto* job : jobs)
+        pool->addJob (job, false);
+
+    return true;
+}
+
+void RigRunner::stop()
+{
+    if (pool != nullptr)
+    {
+        pool->removeAllJobs (true, 10000);
+        pool.reset();
+    }
+}
+
+bool RigRunner::isRunning() const
+{
+    return pool != nullptr && pool->getNumJobs() > 0;
+}
+
+String RigRunner::getReport() const
+{
+    if (jobs.isEmpty())
+        return {};
+
+    double total = 0.0, longest = 0.0;
+
+    for (auto* job : jobs)
+    {
+        auto seconds = job->getSeconds();
+        total += seconds;
+        longest = jmax (longest, seconds);
+    }
+
+    String s;
+    s << "Rig: " << jobs.size() << " pairs, " << jlimit (1, jobs.size(), settings.maxConcurrentPairs) << " at a time\n"
+      << "Pairs have taken " << String (total, 1) << " s between them; the longest " << String (longest, 1) << " s\n\n";
+
+    for (auto* job : jobs)
+        s << job->getSummary() << "\n";
+
+    return s;
+}
+
+//==============================================================================
+RigPanel::RigPanel (RigRunner& r, MidiTestPorts& p)
+    : runner (r), ports (p)
+{
+    for (auto* toggle : { &latency, &throughput, &sweep })
+        addAndMakeVisible (*toggle);
+
+    latency.setToggleState (true, dontSendNotification);
+    throughput.setToggleState (true, dontSendNotification);
+
+    secondsLabel.setText ("Latency s:", dontSendNotification);
+    addAndMakeVisible (secondsLabel);
+    latencySeconds.setSliderStyle (Slider::LinearHorizontal);
+    latencySeconds.setTextBoxStyle (Slider::TextBoxRight, false, 60, 20);
+    latencySeconds.setRange (1.0, 120.0, 1.0);
+    latencySeconds.setValue (RigRunner::Settings().latencySeconds, dontSendNotification);
+    addAndMakeVisible (latencySeconds);
+
+    controllerLabel.setText ("Sweep CCs:", dontSendNotification);
+    addAndMakeVisible (controllerLabel);
+    controllers.setText (SweepVerifier::Settings().controllers, false);
+    addAndMakeVisible (controllers);
+
+    startButton.onClick = [this] { startOrStop(); };
+    addAndMakeVisible (startButton);
+}
+
+void RigPanel::startOrStop()
+{
+    if (runner.isRunning())
+    {
+        runner.stop();
+    }
+    else
+    {
+        RigRunner::Settings settings;
+        settings.tests = (latency.getToggleState() ? RigRunner::latencyTest : 0)
+                       | (throughput.getToggleState() ? RigRunner::throughputTest : 0)
+                       | (sweep.getToggleState() ? RigRunner::sweepTest : 0);
+        settings.latencySeconds = latencySeconds.getValue();
+
+        // a pedal listens on one channel, and all sixteen would take most of an hour
+        settings.sweep.firstChannel = settings.sweep.lastChannel = 1;
+        settings.sweep.controllers = controllers.getText();
+        settings.sweep.sweepNotes = false;
+
+        if (settings.tests == 0 || ! runner.start (RigRunner::pairByName (ports), settings))
+            showMessage ("Open each device's output and input on the main page, connect them, "
+                         "and choose at least one test. Ports are paired by name.");
+    }
+
+    refresh();
+}
+
+void RigPanel::update()
+{
+    startButton.setButtonText (runner.isRunning() ? "Stop" : "Start");
+}
+
+String RigPanel::getReportText()
+{
+    return runner.getReport();
+}
+
+void RigPanel::resized()
+{
+    auto area = layOutPair();
+
+    auto row = area.removeFromTop (rowHeight);
+    latency.setBounds (row.removeFromLeft (90).reduced (2));
+    throughput.setBounds (row.removeFromLeft (110).reduced (2));
+    sweep.setBounds (row.removeFromLeft (80).reduced (2));
+    startButton.setBounds (row.removeFromRight (80).reduced (2));
+    secondsLabel.setBounds (row.removeFromLeft (80));
+    latencySeconds.setBounds (row.reduced (2));
+    area.removeFromTop (4);
+
+    row = area.removeFromTop (rowHeight);
+    controllerLabel.setBounds (row.removeFromLeft (80));
+    controllers.setBounds (row.removeFromLeft (200).reduced (2));
+
+    area.removeFromTop (10);
+    report.setBounds (area);
+}
@@ -0,0 +1,123 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+#include "LatencyTester.h"
+#include "StressTester.h"
+#include "SweepVerifier.h"
+#include "ToolPanel.h"
+
+//==============================================================================
+/**
+    Runs the latency, throughput and sweep tests on many output and input
+    pairs at the same time.
+
+    Each pair is a job on a thread pool, and runs its chosen tests one after
+    another with testers of its own, so no two pairs share a queue, a table
+    of states or a set of statistics. Every output already has its own queues
+    in the scheduler. With a thread for every pair, the whole rig takes about
+    as long as its slowest device instead of the sum of all of them.
+*/
+class RigRunner
+{
+public:
+    enum Tests
+    {
+        latencyTest     = 1 << 0,
+        throughputTest  = 1 << 1,
+        sweepTest       = 1 << 2
+    };
+
+    struct Settings
+    {
+        int tests = latencyTest | throughputTest;
+        int maxConcurrentPairs = 16;
+        double latencySeconds = 10.0;
+
+        LatencyTester::Settings latency;
+        StressTester::Settings throughput;
+        SweepVerifier::Settings sweep;
+    };
+
+    struct Pair
+    {
+        MidiDeviceListEntry::Ptr output, input;
+    };
+
+    //==============================================================================
+    explicit RigRunner (MidiTestPorts& ports);
+    ~RigRunner();
+
+    /** Every open output with the open input of the same name, which is how
+        drivers name the two halves of one device's port. Message thread only.
+    */
+    static Array<Pair> pairByName (MidiTestPorts& ports);
+
+    /** Returns false if there are no pairs with both devices open. */
+    bool start (const Array<Pair>& pairs, const Settings& settings);
+    void stop();
+    bool isRunning() const;
+
+    String getReport() const;
+
+private:
+    //==============================================================================
+    class PairJob;
+
+    MidiTestPorts& ports;
+    Settings settings;
+    std::unique_ptr<ThreadPool> pool;
+    OwnedArray<PairJob> jobs;
+    double startTime = 0.0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (RigRunner)
+};
+
+//==============================================================================
+class RigPanel  : public ToolPanel
+{
+public:
+    RigPanel (RigRunner& runner, MidiTestPorts& ports);
+
+    void resized() override;
+
+private:
+    String getReportText() override;
+    void update() override;
+    void startOrStop();
+
+    RigRunner& runner;
+    MidiTestPorts& ports;
+    ToggleButton latency { "Latency" }, throughput { "Throughput" }, sweep { "Sweep" };
+    Label secondsLabel, controllerLabel;
+    Slider latencySeconds;
+    TextEditor controllers;
+    TextButton startButton { "Start" };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (RigPanel)
+};
@@ -0,0 +1,727 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#include "ScriptRunner.h"
+#include "RealtimeThreads.h"
+
+namespace
+{
+    const char* const exampleScript =
+        "<TestScript name=\"Knob echo\" channel=\"1\" timeout=\"500\">\n"
+        "  <Loop count=\"8\">\n"
+        "    <Send cc=\"16\" value=\"0\"/>\n"
+        "    <Expect cc=\"16\" value=\"0\"/>\n"
+        "    <Send cc=\"16\" value=\"127\"/>\n"
+        "    <Expect cc=\"16\" min=\"120\" max=\"127\"/>\n"
+        "    <Wait ms=\"50\"/>\n"
+        "  </Loop>\n"
+        "  <Send program=\"1\"/>\n"
+        "  <Expect data=\"?? ?? ??\" timeout=\"2000\" wait=\"true\"/>\n"
+        "</TestScript>\n";
+
+    /** Hex bytes, with -1 for ??. Empty if anything else is in there. */
+    Array<int> parseBytes (const String& text)
+    {
+        auto tokens = StringArray::fromTokens (text, " ,", "");
+        tokens.removeEmptyStrings();
+        Array<int> bytes;
+
+        for (auto& token : tokens)
+        {
+            if (token == "??" || token.equalsIgnoreCase ("xx"))
+                bytes.add (-1);
+            else if (token.length() <= 2 && token.containsOnly ("0123456789abcdefABCDEF"))
+                bytes.add (token.getHexValue32());
+            else
+                return {};
+        }
+
+        return bytes;
+    }
+
+    String describeSend (const MidiMessage& message)
+    {
+        return "send " + String::toHexString (message.getRawData(), jmin (message.getRawDataSize(), 8)).toUpperCase()
+                 + (message.getRawDataSize() > 8 ? " ..." : "");
+    }
+}
+
+//==============================================================================
+ScriptRunner::ScriptRunner (MidiTestPorts& p)
+    : Thread ("Test script"), ports (p)
+{
+}
+
+ScriptRunner::~ScriptRunner()
+{
+    stop();
+}
+
+//==============================================================================
+String ScriptRunner::parse (const String& text, String& name, std::vector<Step>& result)
+{
+    XmlDocument document (text);
+    auto root = document.getDocumentElement();
+
+    if (root == nullptr)
+        return "Not valid XML: " + document.getLastParseError();
+
+    if (! root->hasTagName ("TestScript"))
+        return "The root element should be <TestScript>";
+
+    name = root->getStringAttribute ("name", "Untitled");
+    result.clear();
+
+    auto defaultChannel = jlimit (1, 16, root->getIntAttribute ("channel", 1));
+    auto defaultTimeout = root->getDoubleAttribute ("timeout", 1000.0);
+
+    std::function<String (const XmlElement&)> parseChildren = [&] (const XmlElement& parent) -> String
+    {
+        for (auto* e : parent.getChildIterator())
+        {
+            if ((int) result.size() >= maxSteps)
+                return "The script unrolls to more than " + String ((int) maxSteps) + " steps";
+
+            auto channel = jlimit (1, 16, e->getIntAttribute ("channel", defaultChannel));
+            auto where = "<" + e->getTagName() + "> (step " + String ((int) result.size() + 1) + ")";
+
+            if (e->hasTagName ("Loop"))
+            {
+                auto count = e->getIntAttribute ("count", 1);
+
+                for (int i = 0; i < count; ++i)
+                {
+                    auto error = parseChildren (*e);
+
+                    if (error.isNotEmpty())
+                        return error;
+                }
+
+                continue;
+            }
+
+            Step step;
+
+            if (e->hasTagName ("Send"))
+            {
+                step.type = sendStep;
+
+                if (e->hasAttribute ("data"))
+                {
+                    auto bytes = parseBytes (e->getStringAttribute ("data"));
+                    MemoryBlock data;
+
+                    for (auto b : bytes)
+                    {
+                        if (b < 0)
+                            return where + ": a Send can't have ?? in it";
+
+                        auto byte = (uint8) b;
+                        data.append (&byte, 1);
+                    }
+
+                    if (data.getSize() == 0)
+                        return where + ": data should be hex bytes";
+
+                    step.message = MidiMessage (data.getData(), (int) data.getSize());
+                }
+                else if (e->hasAttribute ("cc"))
+                {
+                    step.message = MidiMessage::controllerEvent (channel, e->getIntAttribute ("cc") & 0x7f,
+                                                                 e->getIntAttribute ("value") & 0x7f);
+                }
+                else if (e->hasAttribute ("note"))
+                {
+                    auto velocity = e->getIntAttribute ("velocity", 100) & 0x7f;
+                    step.message = velocity > 0 ? MidiMessage::noteOn (channel, e->getIntAttribute ("note") & 0x7f, (uint8) velocity)
+                                                : MidiMessage::noteOff (channel, e->getIntAttribute ("note") & 0x7f);
+                }
+                else if (e->hasAttribute ("program"))
+                {
+                    step.message = MidiMessage::programChange (channel, e->getIntAttribute ("program") & 0x7f);
+                }
+                else
+                {
+                    return where + ": needs data, cc, note or program";
+                }
+
+                step.description = describeSend (step.message);
+            }
+            else if (e->hasTagName ("Wait"))
+            {
+                step.type = waitStep;
+                step.waitMs = jmax (0.0, e->getDoubleAttribute ("ms"));
+                step.description = "wait " + String (step.waitMs) + " ms";
+            }
+            else if (e->hasTagName ("Sync"))
+            {
+                step.type = syncStep;
+                step.description = "sync";
+            }
+            else if (e->hasTagName ("Expect"))
+            {
+                step.type = expectStep;
+                step.timeoutMs = e->getDoubleAttribute ("timeout", defaultTimeout);
+                auto status = (uint8) (channel - 1);
+
+                if (e->hasAttribute ("data"))
+                {
+                    auto bytes = parseBytes (e->getStringAttribute ("data"));
+
+                    if (bytes.isEmpty() || bytes.size() > Step::maxPatternSize)
+                        return where + ": data should be up to " + String ((int) Step::maxPatternSize) + " hex bytes, with ?? for any";
+
+                    for (int i = 0; i < bytes.size(); ++i)
+                    {
+                        step.isWildcard[i] = bytes[i] < 0;
+                        step.pattern[i] = (uint8) jmax (0, bytes[i]);
+                    }
+
+                    step.patternSize = bytes.size();
+                    step.description = "expect " + e->getStringAttribute ("data").toUpperCase();
+                }
+                else if (e->hasAttribute ("cc") || e->hasAttribute ("note") || e->hasAttribute ("program"))
+                {
+                    auto isProgram = e->hasAttribute ("program");
+                    auto attribute = e->hasAttribute ("cc") ? "cc" : (isProgram ? "program" : "note");
+
+                    step.pattern[0] = (uint8) ((e->hasAttribute ("cc") ? 0xb0 : (isProgram ? 0xc0 : 0x90)) | status);
+                    step.pattern[1] = (uint8) (e->getIntAttribute (attribute) & 0x7f);
+                    step.patternSize = isProgram ? 2 : 3;
+                    step.isWildcard[2] = true;
+
+                    // a program change has no value; its number is what gets checked
+                    step.valueIndex = isProgram ? -1 : 2;
+                    step.takesNoteOff = ! (isProgram || e->hasAttribute ("cc"));
+                    step.description = "expect ch " + String (channel) + " " + attribute + " " + String (step.pattern[1]);
+                }
+                else
+                {
+                    return where + ": needs data, cc, note or program";
+                }
+
+                if (e->hasAttribute ("value") || e->hasAttribute ("velocity"))
+                {
+                    step.minValue = step.maxValue = e->getIntAttribute (e->hasAttribute ("value") ? "value" : "velocity");
+                }
+                else
+                {
+                    step.minValue = e->getIntAttribute ("min", 0);
+                    step.maxValue = e->getIntAttribute ("max", 127);
+                }
+
+                if (step.valueIndex < 0 && step.patternSize > 0 && (e->hasAttribute ("value") || e->hasAttribute ("min")))
+                    step.valueIndex = step.patternSize - 1;
+
+                if (step.valueIndex >= 0 && (step.minValue > 0 || step.maxValue < 127))
+                    step.description << (step.minValue == step.maxValue ? " = " + String (step.minValue)
+                                                                        : " in " + String (step.minValue) + ".." + String (step.maxValue));
+            }
+            else
+            {
+                return "Unknown step " + where;
+            }
+
+            result.push_back (step);
+
+            if (step.type == expectStep && e->getBoolAttribute ("wait"))
+            {
+                Step sync;
+                sync.type = syncStep;
+                sync.description = "sync";
+                result.push_back (sync);
+            }
+        }
+
+        return {};
+    };
+
+    auto error = parseChildren (*root);
+
+    if (error.isEmpty() && result.empty())
+        error = "The script has no steps";
+
+    return error;
+}
+
+//==============================================================================
+String ScriptRunner::start (const String& scriptText, MidiDeviceListEntry::Ptr newOutput, MidiDeviceListEntry::Ptr newInput)
+{
+    stop();
+
+    if (newOutput == nullptr || ! newOutput->isOutputOpen()
+         || newInput == nullptr || ! newInput->isInputOpen())
+        return "Open an output and an input on the main page first.";
+
+    String name;
+    std::vector<Step> parsed;
+    auto error = parse (scriptText, name, parsed);
+
+    if (error.isNotEmpty())
+        return error;
+
+    output = newOutput;
+    input = newInput;
+
+    for (auto& slot : slots)
+        slot.stepIndex = -1;
+
+    {
+        const ScopedLock sl (resultsLock);
+        scriptName = name;
+        steps = std::move (parsed);
+        stepsDone = numPassed = numFailed = 0;
+        elapsedMs = 0.0;
+        finished = false;
+    }
+
+    inputDevice = input.get();
+    ports.addListener (this);
+    ports.getClock().threadStarting (*this);
+    startThread (9);
+    return {};
+}
+
+void ScriptRunner::stop()
+{
+    stopThread (2000);
+    ports.removeListener (this);
+    inputDevice = nullptr;
+}
+
+//==============================================================================
+void ScriptRunner::run()
+{
+    auto& clock = ports.getClock();
+    const VirtualClock::ScopedThread participant (clock, *this);
+    startTime = clock.now();
+    auto cursor = startTime;            // when the next step is due
+    auto lastSendAt = startTime;
+    size_t next = 0;
+    int numArmed = 0;
+    std::vector<bool> alreadyArmed (steps.size(), false);
+
+    // sends, waits and syncs can't fail; only Expects count as passes or failures
+    auto finish = [&] (Step& step, double now)
+    {
+        const ScopedLock sl (resultsLock);
+        step.outcome = passed;
+        step.ranAt = now - startTime;
+        ++stepsDone;
+        elapsedMs = now - startTime;
+    };
+
+    while (! threadShouldExit())
+    {
+        RealtimeThreads::applyToCurrentThread (RealtimeThreads::timingThread);
+        auto now = clock.now();
+        numArmed -= collect (now);
+
+        while (next < steps.size())
+        {
+            auto& step = steps[next];
+
+            {
+                const ScopedLock sl (resultsLock);
+                step.scheduledAt = cursor - startTime;
+            }
+
+            if (step.type == waitStep)
+            {
+                cursor += step.waitMs;
+                finish (step, now);
+                ++next;
+                continue;
+            }
+
+            if (step.type == syncStep)
+            {
+                if (numArmed > 0)
+                    break;
+
+                cursor = jmax (cursor, now);
+                finish (step, now);
+                ++next;
+                continue;
+            }
+
+            if (cursor > now)
+                break;
+
+            if (step.type == expectStep)
+            {
+                if (! alreadyArmed[next])
+                {
+                    if (! arm (next, now, lastSendAt))
+                        break;
+
+                    ++numArmed;
+                }
+
+                ++next;
+                continue;
+            }
+
+            // the Expects straight after a Send listen before it goes
+            auto following = next + 1;
+            auto armedOk = true;
+
+            for (; following < steps.size() && steps[following].type == expectStep && armedOk; ++following)
+            {
+                if (alreadyArmed[following])
+                    continue;
+
+                armedOk = arm (following, now, now);
+
+                if (armedOk)
+                {
+                    alreadyArmed[following] = true;
+                    ++numArmed;
+                }
+            }
+
+            if (! armedOk || ! ports.getScheduler().send (*output, step.message))
+                break;
+
+            lastSendAt = now;
+            finish (step, now);
+
+            if (now - cursor > 1.0)
+            {
+                const ScopedLock sl (resultsLock);
+                step.detail = "late " + String (now - cursor, 2) + " ms";
+            }
+
+            ++next;
+        }
+
+        if (next >= steps.size() && numArmed == 0)
+            break;
+
+        // sleep until the next step is due, or the next deadline passes
+        auto wakeAt = now + 10.0;
+
+        if (next < steps.size() && steps[next].type != syncStep)
+            wakeAt = jmin (wakeAt, cursor);
+
+        for (auto& slot : slots)
+            if (slot.stepIndex.load() >= 0)
+                wakeAt = jmin (wakeAt, slot.deadline);
+
+        clock.waitUntil (*this, wakeAt);
+    }
+
+    const ScopedLock sl (resultsLock);
+    elapsedMs = clock.now() - startTime;
+    finished = ! threadShouldExit();
+}
+
+bool ScriptRunner::arm (size_t stepIndex, double now, double lastSendAt)
+{
+    for (auto& slot : slots)
+    {
+        if (slot.stepIndex.load() >= 0)
+            continue;
+
+        slot.armOrder = nextArmOrder++;
+        slot.deadline = now + steps[stepIndex].timeoutMs;
+        slot.armedAfterSend = lastSendAt;
+        slot.state = slotWaiting;
+        slot.stepIndex.store ((int) stepIndex, std::memory_order_release);
+        return true;
+    }
+
+    return false;
+}
+
+/*  Moves the answers and timeouts of armed Expects into their steps, and
+    returns how many slots were freed.
+*/
+int ScriptRunner::collect (double now)
+{
+    int freed = 0;
+
+    for (auto& slot : slots)
+    {
+        auto index = slot.stepIndex.load (std::memory_order_acquire);
+
+        if (index < 0)
+            continue;
+
+        auto state = slot.state.load (std::memory_order_acquire);
+
+        if (state == slotWaiting && now >= slot.deadline)
+        {
+            if (slot.state.compare_exchange_strong (state, slotTimedOut))
+                state = slotTimedOut;
+        }
+
+        if (state == slotWaiting || state == slotClaimed)
+            continue;
+
+        auto& step = steps[(size_t) index];
+        const ScopedLock sl (resultsLock);
+
+        step.outcome = state == slotPassed ? passed : failed;
+        step.ranAt = (state == slotTimedOut ? now : slot.answeredAt) - startTime;
+        step.latencyMs = state == slotTimedOut ? 0.0 : slot.answeredAt - slot.armedAfterSend;
+
+        if (state == slotTimedOut)
+            step.detail = "nothing within " + String (step.timeoutMs, 0) + " ms";
+        else if (state == slotFailed)
+            step.detail = "got " + String (slot.gotValue) + " after " + String (step.latencyMs, 2) + " ms";
+        else
+            step.detail = String (step.latencyMs, 2) + " ms";
+
+        ++stepsDone;
+        state == slotPassed ? ++numPassed : ++numFailed;
+
+        slot.stepIndex.store (-1, std::memory_order_release);
+        ++freed;
+    }
+
+    return freed;
+}
+
+//==============================================================================
+bool ScriptRunner::matchesPattern (const Step& step, const uint8* data, int size) noexcept
+{
+    if (size < step.patternSize)
+        return false;
+
+    for (int i = 0; i < step.patternSize; ++i)
+        if (! step.isWildcard[i] && step.pattern[i] != data[i])
+            return false;
+
+    return true;
+}
+
+/*  Returns the bytes the step matched, or nullptr. A note expectation falls
+    back to the note-off written as a note-on with velocity 0.
+*/
+const uint8* ScriptRunner::findMatch (const Step& step, const uint8* data, const uint8* noteOff, int size) noexcept
+{
+    if (matchesPattern (step, data, size))
+        return data;
+
+    if (step.takesNoteOff && noteOff != nullptr && matchesPattern (step, noteOff, size))
+        return noteOff;
+
+    return nullptr;
+}
+
+void ScriptRunner::midiReceived (MidiDeviceListEntry* source, const MidiMessage& message)
+{
+    // This is called on the MIDI thread
+    if (source != inputDevice.load())
+        return;
+
+    auto now = ports.getClock().now();
+    auto* data = message.getRawData();
+    auto size = message.getRawDataSize();
+
+    // a note expectation takes a note-off either way it is written
+    uint8 normalised[3];
+    const uint8* noteOff = nullptr;
+
+    if (size == 3 && (data[0] & 0xf0) == 0x80)
+    {
+        normalised[0] = (uint8) (0x90 | (data[0] & 0x0f));
+        normalised[1] = data[1];
+        normalised[2] = 0;
+        noteOff = normalised;
+    }
+
+    for (;;)
+    {
+        Slot* best = nullptr;
+        int bestIndex = -1;
+        const uint8* matched = nullptr;
+
+        for (auto& slot : slots)
+        {
+            auto index = slot.stepIndex.load (std::memory_order_acquire);
+
+            if (index < 0 || slot.state.load() != slotWaiting)
+                continue;
+
+            if (best != nullptr && slot.armOrder >= best->armOrder)
+                continue;
+
+            if (auto* bytes = findMatch (steps[(size_t) index], data, noteOff, size))
+            {
+                best = &slot;
+                bestIndex = index;
+                matched = bytes;
+            }
+        }
+
+        if (best == nullptr)
+            return;
+
+        auto expected = (int) slotWaiting;
+
+        if (! best->state.compare_exchange_strong (expected, slotClaimed))
+            continue;
+
+        // the slot may have been freed and armed again while we were looking
+        if (best->stepIndex.load() != bestIndex)
+        {
+            best->state = slotWaiting;
+            continue;
+        }
+
+        auto& step = steps[(size_t) bestIndex];
+        auto value = step.valueIndex >= 0 && step.valueIndex < size ? (int) matched[step.valueIndex] : -1;
+
+        best->answeredAt = now;
+        best->gotValue = value;
+        best->state.store (value < 0 || (value >= step.minValue && value <= step.maxValue) ? slotPassed : slotFailed,
+                           std::memory_order_release);
+        return;
+    }
+}
+
+//==============================================================================
+String ScriptRunner::getReport() const
+{
+    if (output == nullptr || input == nullptr)
+        return {};
+
+    const ScopedLock sl (resultsLock);
+    String s;
+
+    s << "Script \"" << scriptName << "\": " << output->deviceInfo.name << " -> " << input->deviceInfo.name << "\n"
+      << (int) steps.size() << " steps, " << stepsDone << " done; expectations " << numPassed << " passed, " << numFailed << " failed; "
+      << String (elapsedMs * 0.001, 2) << " s\n";
+
+    if (finished)
+        s << (numFailed == 0 ? "PASS" : "FAIL") << "\n";
+
+    auto addRow = [&s] (size_t index, const Step& step)
+    {
+        static const char* const outcomeNames[] = { "", "ok", "FAIL" };
+
+        s << String ((int) index + 1).paddedLeft (' ', 6)
+          << String (step.scheduledAt, 1).paddedLeft (' ', 10)
+          << (step.outcome != notRun ? String (step.ranAt, 1) : String()).paddedLeft (' ', 10) << "  "
+          << step.description.paddedRight (' ', 32).substring (0, 32) << "  "
+          << String (outcomeNames[step.outcome]).paddedRight (' ', 5) << step.detail << "\n";
+    };
+
+    auto header = String ("step").paddedLeft (' ', 6) + String ("due ms").paddedLeft (' ', 10)
+                    + String ("ran ms").paddedLeft (' ', 10) + "  " + String ("what").paddedRight (' ', 32) + "  result\n";
+
+    if (numFailed > 0)
+    {
+        s << "\nFailures\n" << header;
+        int shown = 0;
+
+        for (size_t i = 0; i < steps.size() && shown < maxRowsShown; ++i)
+        {
+            if (steps[i].outcome == failed)
+            {
+                addRow (i, steps[i]);
+                ++shown;
+            }
+        }
+    }
+
+    s << "\nSteps\n" << header;
+
+    for (size_t i = 0; i < steps.size() && i < (size_t) maxRowsShown; ++i)
+        addRow (i, steps[i]);
+
+    if (steps.size() > (size_t) maxRowsShown)
+        s << "... " << (int) (steps.size() - (size_t) maxRowsShown) << " more steps\n";
+
+    return s;
+}
+
+//==============================================================================
+ScriptPanel::ScriptPanel (ScriptRunner& r, MidiTestPorts& ports)
+    : ToolPanel (ports), runner (r)
+{
+    script.setMultiLine (true);
+    script.setReturnKeyStartsNewLine (true);
+    script.setFont (report.getFont());
+    script.setText (exampleScript, false);
+    addAndMakeVisible (script);
+
+    loadButton.onClick = [this] { loadScript(); };
+    addAndMakeVisible (loadButton);
+    runButton.onClick = [this] { runOrStop(); };
+    addAndMakeVisible (runButton);
+}
+
+void ScriptPanel::loadScript()
+{
+    FileChooser chooser ("Choose a test script...", File::getCurrentWorkingDirectory(), "*.xml");
+
+    if (chooser.browseForFileToOpen())
+        script.setText (chooser.getResult().loadFileAsString(), false);
+}
+
+void ScriptPanel::runOrStop()
+{
+    if (runner.isRunning())
+    {
+        runner.stop();
+    }
+    else
+    {
+        auto error = runner.start (script.getText(), getOutput(), getInput());
+
+        if (error.isNotEmpty())
+            showMessage (error);
+    }
+
+    refresh();
+}
+
+void ScriptPanel::update()
+{
+    runButton.setButtonText (runner.isRunning() ? "Stop" : "Run");
+}
+
+String ScriptPanel::getReportText()
+{
+    return runner.getReport();
+}
+
+void ScriptPanel::resized()
+{
+    auto area = layOutPair();
+
+    auto row = area.removeFromTop (rowHeight);
+    loadButton.setBounds (row.removeFromLeft (80).reduced (2));
+    runButton.setBounds (row.removeFromRight (80).reduced (2));
+    area.removeFromTop (10);
+
+    script.setBounds (area.removeFromLeft (area.getWidth() * 2 / 5));
+    area.removeFromLeft (10);
+    report.setBounds (area);
+}
@@ -0,0 +1,182 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+#include "MidiTestPorts.h"
+#include "ToolPanel.h"
+
+//==============================================================================
+/**
+    Runs a test script against an output and input pair.
+
+    Scripts are XML:
+
+        <TestScript name="Delay knobs" channel="1" timeout="500">
+          <Loop count="4">
+            <Send cc="16" value="0"/>
+            <Expect cc="16" min="0" max="2"/>
+            <Wait ms="50"/>
+            <Send data="B0 11 7F"/>
+            <Expect data="B0 11 ??" wait="true"/>
+          </Loop>
+          <Send program="2"/>
+          <Expect data="F0 7D ??" timeout="2000"/>
+          <Sync/>
+        </TestScript>
+
+    Send takes raw hex data or cc/value, note/velocity or program. Expect
+    takes a hex pattern with ?? for any byte, or cc, note or program, with an
+    optional value, or min and max, to check. A note Expect also takes a
+    note-off sent as 8n, which it sees as a note-on with velocity 0; a data
+    pattern only matches the bytes as they came in. Loops are unrolled when
+    the script is loaded.
+
+    Steps run on a timing thread against a schedule fixed from the start, so
+    waits don't accumulate drift. An Expect doesn't hold up the steps after
+    it; it is armed, and the script carries on while it waits for its
+    message. Only wait="true" or a Sync step stops the script until
+    everything armed so far has been answered or has timed out. Expects that
+    follow a Send are armed before it goes, so the fastest echo can't be
+    missed. An arriving message answers the oldest armed Expect it matches.
+*/
+class ScriptRunner  : private Thread,
+                      private MidiTestPorts::Listener
+{
+public:
+    enum StepType { sendStep = 0, waitStep, expectStep, syncStep };
+    enum Outcome { notRun = 0, passed, failed };
+
+    struct Step
+    {
+        StepType type = sendStep;
+        String description;
+
+        MidiMessage message;                // send
+        double waitMs = 0.0;                // wait
+
+        // expect
+        enum { maxPatternSize = 16 };
+        uint8 pattern[maxPatternSize] = {};
+        bool isWildcard[maxPatternSize] = {};
+        int patternSize = 0;
+        int valueIndex = -1;                // byte checked against the range, or -1
+        bool takesNoteOff = false;          // a note expectation also matches 8n nn vv, as 9n nn 00
+        int minValue = 0, maxValue = 127;
+        double timeoutMs = 1000.0;
+
+        // results
+        Outcome outcome = notRun;
+        double scheduledAt = 0.0;           // ms from the start
+        double ranAt = 0.0;
+        double latencyMs = 0.0;             // expect: from the last send before it
+        String detail;
+    };
+
+    //==============================================================================
+    explicit ScriptRunner (MidiTestPorts& ports);
+    ~ScriptRunner();
+
+    /** Parses a script. Returns an error message, or an empty string if it is fine. */
+    static String parse (const String& text, String& name, std::vector<Step>& steps);
+
+    /** Returns an error message, or an empty string if the script has started. */
+    String start (const String& scriptText, MidiDeviceListEntry::Ptr output, MidiDeviceListEntry::Ptr input);
+    void stop();
+    bool isRunning() const                  { return isThreadRunning(); }
+
+    String getReport() const;
+
+private:
+    //==============================================================================
+    enum
+    {
+        maxSteps = 100000,
+        maxArmed = 256,
+        maxRowsShown = 500
+    };
+
+    enum SlotState { slotWaiting = 0, slotClaimed, slotPassed, slotFailed, slotTimedOut };
+
+    // an armed Expect, shared with the MIDI thread
+    struct Slot
+    {
+        std::atomic<int> stepIndex { -1 };
+        std::atomic<int> state { slotWaiting };
+        int64 armOrder = 0;
+        double deadline = 0.0;
+        double armedAfterSend = 0.0;
+        double answeredAt = 0.0;
+        int gotValue = 0;
+    };
+
+    void run() override;
+    bool arm (size_t stepIndex, double now, double lastSendAt);
+    int collect (double now);
+    static bool matchesPattern (const Step& step, const uint8* data, int size) noexcept;
+    static const uint8* findMatch (const Step& step, const uint8* data, const uint8* noteOff, int size) noexcept;
+
+    void midiReceived (MidiDeviceListEntry* source, const MidiMessage& message) override;
+
+    MidiTestPorts& ports;
+    MidiDeviceListEntry::Ptr output, input;
+    std::atomic<MidiDeviceListEntry*> inputDevice { nullptr };
+    String scriptName;
+    double startTime = 0.0;
+
+    std::vector<Step> steps;
+    Slot slots[maxArmed];
+    int64 nextArmOrder = 0;
+
+    CriticalSection resultsLock;
+    int stepsDone = 0, numPassed = 0, numFailed = 0;
+    double elapsedMs = 0.0;
+    bool finished = false;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ScriptRunner)
+};
+
+//==============================================================================
+class ScriptPanel  : public ToolPanel
+{
+public:
+    ScriptPanel (ScriptRunner& runner, MidiTestPorts& ports);
+
+    void resized() override;
+
+private:
+    String getReportText() override;
+    void update() override;
+    void loadScript();
+    void runOrStop();
+
+    ScriptRunner& runner;
+    TextEditor script;
+    TextButton loadButton { "Load..." }, runButton { "Run" };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ScriptPanel)
+};
@@ -0,0 +1,475 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#include "SimulatedPedal.h"
+#include "RealtimeThreads.h"
+
+//==============================================================================
+struct SimulatedPedal::Port  : public MidiDeviceListEntry
+{
+    Port (SimulatedPedal& p, bool isInputPort)
+        : MidiDeviceListEntry (MidiDeviceInfo ("BA Simulated Pedal", isInputPort ? "simulated-pedal-in" : "simulated-pedal-out")),
+          pedal (&p)
+    {
+    }
+
+    bool openInput (Receiver& receiver) override
+    {
+        const ScopedLock sl (lock);
+        inputReceiver = &receiver;
+        return true;
+    }
+
+    void closeInput() override
+    {
+        // once this returns, nothing more is delivered
+        const ScopedLock sl (lock);
+        inputReceiver = nullptr;
+    }
+
+    bool openOutput() override              { outputOpen = true; return true; }
+    void closeOutput() override             { outputOpen = false; }
+
+    bool isInputOpen() const override       { return inputReceiver.load() != nullptr; }
+    bool isOutputOpen() const override      { return outputOpen.load(); }
+
+    // the pedal parses a byte stream, like a DIN port
+    bool takesSysExSegments() const override    { return true; }
+
+    void transmit (const MidiMessage& message) override
+    {
+        // This is called on the scheduler thread
+        const ScopedLock sl (lock);
+
+        if (! outputOpen.load() || pedal == nullptr)
+            return;
+
+        pedal->incoming.push (message.getRawData(), message.getRawDataSize(), pedal->clock.now());
+        pedal->clock.wake (*pedal);
+    }
+
+    bool deliver (const MidiMessage& message)
+    {
+        const ScopedLock sl (lock);
+
+        if (auto* r = inputReceiver.load())
+        {
+            r->midiReceived (*this, message);
+            return true;
+        }
+
+        return false;
+    }
+
+    void detach()
+    {
+        const ScopedLock sl (lock);
+        pedal = nullptr;
+    }
+
+    CriticalSection lock;
+    SimulatedPedal* pedal;
+    std::atomic<Receiver*> inputReceiver { nullptr };
+    std::atomic<bool> outputOpen { false };
+};
+
+//==============================================================================
+SimulatedPedal::SimulatedPedal (VirtualClock& c)
+    : Thread ("Simulated pedal"), clock (c),
+      input (new Port (*this, true)), output (new Port (*this, false))
+{
+    clock.threadStarting (*this);
+    startThread (9);
+}
+
+SimulatedPedal::~SimulatedPedal()
+{
+    // test tools may still hold on to the entries
+    input->detach();
+    output->detach();
+
+    signalThreadShouldExit();
+    clock.wake (*this);
+    stopThread (2000);
+}
+
+MidiDeviceListEntry::Ptr SimulatedPedal::getEntry (bool isInput) const
+{
+    return isInput ? input.get() : output.get();
+}
+
+StringArray SimulatedPedal::getDistributionNames()
+{
+    return { "Fixed", "Uniform", "Normal", "Exponential tail" };
+}
+
+void SimulatedPedal::setSettings (const Settings& newSettings)
+{
+    {
+        const ScopedLock sl (settingsLock);
+        settings = newSettings;
+        reseed = true;
+    }
+
+    clock.wake (*this);
+}
+
+SimulatedPedal::Settings SimulatedPedal::getSettings() const
+{
+    const ScopedLock sl (settingsLock);
+    return settings;
+}
+
+SimulatedPedal::Stats SimulatedPedal::getStats() const
+{
+    Stats s;
+    s.received = received.load();
+    s.answered = answered.load();
+    s.dropped = dropped.load();
+    s.corrupted = corrupted.load();
+    s.unheard = unheard.load();
+    s.overflowed = incoming.getNumDropped();
+    return s;
+}
+
+int SimulatedPedal::getParameterIndex (int controller) noexcept
+{
+    if (controller == buttonACc || controller == buttonACc + 1)
+        return controller - buttonACc;
+
+    if (controller >= knob1Cc && controller < knob1Cc + numParameters - 2)
+        return 2 + controller - knob1Cc;
+
+    return -1;
+}
+
+//==============================================================================
+void SimulatedPedal::run()
+{
+    const VirtualClock::ScopedThread participant (clock, *this);
+
+    while (! threadShouldExit())
+    {
+        RealtimeThreads::applyToCurrentThread (RealtimeThreads::inputThread);
+
+        {
+            const ScopedLock sl (settingsLock);
+            current = settings;
+
+            if (reseed)
+            {
+                reseed = false;
+                restart();
+            }
+        }
+
+        incoming.drain ([this] (const MidiEventFifo::Event& e) { receive (e.data, e.size, e.timeStamp); });
+
+        auto now = clock.now();
+
+        while (! answers.empty() && answers.front().due <= now)
+        {
+            auto& answer = answers.front();
+            answer.message.setTimeStamp (answer.due * 0.001);
+
+            if (input->deliver (answer.message))
+                ++answered;
+            else
+                ++unheard;
+
+            answers.pop_front();
+        }
+
+        clock.waitUntil (*this, answers.empty() ? -1.0 : answers.front().due);
+    }
+}
+
+void SimulatedPedal::restart()
+{
+    random.setSeed (current.seed);
+    answers.clear();
+    sysEx.clearQuick();
+    linkBusyUntil = 0.0;
+    currentProgram = 0;
+
+    // both buttons off, and the knobs spread out differently in every preset
+    for (int program = 0; program < numPresets; ++program)
+        for (int p = 0; p < numParameters; ++p)
+            presets[program][p] = (uint8) (p < 2 ? 0 : (program * 5 + (p - 2) * 32) % 128);
+}
+
+void SimulatedPedal::receive (const uint8* data, int size, double time)
+{
+    // SysEx comes in segments, with at most realtime messages in between
+    if (data[0] == 0xf0 || (data[0] < 0x80 && ! sysEx.isEmpty()))
+    {
+        if (data[0] == 0xf0)
+            sysEx.clearQuick();
+
+        sysEx.addArray (data, size);
+
+        if (sysEx.getLast() == 0xf7)
+        {
+            handle (MidiMessage (sysEx.getRawDataPointer(), sysEx.size(), time));
+            sysEx.clearQuick();
+        }
+
+        return;
+    }
+
+    if (data[0] >= 0x80)
+        handle (MidiMessage (data, size, time));
+}
+
+void SimulatedPedal::handle (const MidiMessage& message)
+{
+    ++received;
+    auto arrivedAt = message.getTimeStamp();
+
+    if (message.isController())
+    {
+        auto controller = message.getControllerNumber();
+        auto index = getParameterIndex (controller);
+
+        // a bank select only takes effect with the next Program Change
+        if (controller == 0 || controller == 32)
+            return;
+
+        if (index >= 0)
+        {
+            auto value = message.getControllerValue();
+
+            if (index < 2)
+                value = value >= 64 ? 127 : 0;
+
+            presets[currentProgram.load()][index] = (uint8) value;
+            respond (MidiMessage::controllerEvent (message.getChannel(), controller, value), arrivedAt);
+            return;
+        }
+    }
+    else if (message.isProgramChange())
+    {
+        auto program = message.getProgramChangeNumber();
+        currentProgram = program;
+
+        for (int i = 0; i < numParameters; ++i)
+        {
+            auto controller = i < 2 ? buttonACc + i : knob1Cc + i - 2;
+            respond (MidiMessage::controllerEvent (message.getChannel(), controller, presets[program][i]),
+                     arrivedAt + current.presetLoadMs);
+        }
+
+        return;
+    }
+
+    if (current.thru)
+        respond (message, arrivedAt);
+}
+
+void SimulatedPedal::respond (const MidiMessage& message, double readyAt)
+{
+    // the draws are the same whatever happens to the answer, so one loss doesn't shift the rest
+    auto latency = drawLatency();
+    auto drop = random.nextDouble() < current.dropRate;
+    auto corrupt = random.nextDouble() < current.corruptRate;
+    auto corruptAt = random.nextInt (0x10000);
+    auto corruptBit = random.nextInt (7);
+
+    if (drop)
+    {
+        ++dropped;
+        return;
+    }
+
+    auto answer = message;
+    auto size = answer.getRawDataSize();
+    auto firstData = 1, lastData = answer.isSysEx() ? size - 2 : size - 1;
+
+    if (corrupt && lastData >= firstData)
+    {
+        MemoryBlock bytes (answer.getRawData(), (size_t) size);
+        static_cast<uint8*> (bytes.getData())[firstData + corruptAt % (lastData - firstData + 1)] ^= (uint8) (1 << corruptBit);
+        answer = MidiMessage (bytes.getData(), size);
+        ++corrupted;
+    }
+
+    // a serial link keeps the order, and can't carry the next message until this one is through
+    auto msPerByte = current.bytesPerSecond > 0.0 ? 1000.0 / current.bytesPerSecond : 0.0;
+    auto start = jmax (readyAt + latency, linkBusyUntil);
+    linkBusyUntil = start + size * msPerByte;
+
+    answers.push_back ({ linkBusyUntil, answer });
+}
+
+double SimulatedPedal::drawLatency()
+{
+    auto jitter = current.jitterMs;
+    auto r = random.nextDouble();
+    double latency;
+
+    switch (current.distribution)
+    {
+        case uniformLatency:
+            latency = current.latencyMs + (2.0 * r - 1.0) * jitter;
+            break;
+
+        case normalLatency:
+        {
+            // Box-Muller, from two uniform draws
+            auto r2 = random.nextDouble();
+            latency = current.latencyMs + jitter * std::sqrt (-2.0 * std::log (1.0 - r)) * std::cos (MathConstants<double>::twoPi * r2);
+            break;
+        }
+
+        case exponentialLatency:
+            latency = current.latencyMs - jitter * std::log (1.0 - r);
+            break;
+
+        case fixedLatency:
+        default:
+            latency = current.latencyMs;
+            break;
+    }
+
+    return jmax (0.0, latency);
+}
+
+//==============================================================================
+SimulatedPedalPanel::SimulatedPedalPanel (SimulatedPedal& p)
+    : pedal (p)
+{
+    auto settings = pedal.getSettings();
+
+    auto addSlider = [this] (Label& label, const String& name, Slider& slider, double minimum, double maximum,
+                             double interval, double value, const String& suffix)
+    {
+        label.setText (name, dontSendNotification);
+        addAndMakeVisible (label);
+        slider.setSliderStyle (Slider::LinearHorizontal);
+        slider.setTextBoxStyle (Slider::TextBoxRight, false, 80, 20);
+        slider.setRange (minimum, maximum, interval);
+        slider.setTextValueSuffix (suffix);
+        slider.setValue (value, dontSendNotification);
+        addAndMakeVisible (slider);
+    };
+
+    distributionLabel.setText ("Latency:", dontSendNotification);
+    addAndMakeVisible (distributionLabel);
+    distribution.addItemList (SimulatedPedal::getDistributionNames(), 1);
+    distribution.setSelectedItemIndex ((int) settings.distribution, dontSendNotification);
+    addAndMakeVisible (distribution);
+
+    addSlider (latencyLabel, "Base:", latency, 0.0, 100.0, 0.1, settings.latencyMs, " ms");
+    addSlider (jitterLabel, "Jitter:", jitter, 0.0, 50.0, 0.05, settings.jitterMs, " ms");
+    addSlider (dropLabel, "Drop:", dropRate, 0.0, 50.0, 0.01, settings.dropRate * 100.0, " %");
+    addSlider (corruptLabel, "Corrupt:", corruptRate, 0.0, 50.0, 0.01, settings.corruptRate * 100.0, " %");
+    addSlider (loadLabel, "Preset load:", loadTime, 0.0, 500.0, 1.0, settings.presetLoadMs, " ms");
+    addSlider (rateLabel, "Return link:", bytesPerSecond, 0.0, 100000.0, 25.0, settings.bytesPerSecond, " B/s");
+    bytesPerSecond.setSkewFactorFromMidPoint (3125.0);
+
+    thru.setToggleState (settings.thru, dontSendNotification);
+    addAndMakeVisible (thru);
+
+    seedLabel.setText ("Seed:", dontSendNotification);
+    addAndMakeVisible (seedLabel);
+    seed.setInputRestrictions (9, "0123456789");
+    seed.setText (String (settings.seed), false);
+    addAndMakeVisible (seed);
+
+    applyButton.onClick = [this] { apply(); };
+    addAndMakeVisible (applyButton);
+}
+
+void SimulatedPedalPanel::apply()
+{
+    SimulatedPedal::Settings settings;
+    settings.distribution = (SimulatedPedal::Distribution) distribution.getSelectedItemIndex();
+    settings.latencyMs = latency.getValue();
+    settings.jitterMs = jitter.getValue();
+    settings.dropRate = dropRate.getValue() * 0.01;
+    settings.corruptRate = corruptRate.getValue() * 0.01;
+    settings.presetLoadMs = loadTime.getValue();
+    settings.bytesPerSecond = bytesPerSecond.getValue();
+    settings.thru = thru.getToggleState();
+    settings.seed = seed.getText().getLargeIntValue();
+
+    pedal.setSettings (settings);
+    refresh();
+}
+
+String SimulatedPedalPanel::getReportText()
+{
+    auto stats = pedal.getStats();
+    String text;
+
+    text << "Open \"BA Simulated Pedal\" as an input and an output on the main page to test against it.\n"
+         << "Apply puts it back as it started, so a run can be repeated.\n\n"
+         << "Program:     " << pedal.getCurrentProgram() << "\n"
+         << "Received:    " << stats.received << "\n"
+         << "Answered:    " << stats.answered << "\n"
+         << "Dropped:     " << stats.dropped << "\n"
+         << "Corrupted:   " << stats.corrupted << "\n"
+         << "Unheard:     " << stats.unheard << "  (the input wasn't open)\n";
+
+    if (stats.overflowed > 0)
+        text << "Overflowed:  " << stats.overflowed << "\n";
+
+    return text;
+}
+
+void SimulatedPedalPanel::resized()
+{
+    auto area = layOutPair();
+
+    auto row = area.removeFromTop (rowHeight);
+    distributionLabel.setBounds (row.removeFromLeft (90));
+    distribution.setBounds (row.removeFromLeft (150).reduced (2));
+    applyButton.setBounds (row.removeFromRight (80).reduced (2));
+    area.removeFromTop (4);
+
+    auto layoutPair = [&] (Label& leftLabel, Slider& left, Label& rightLabel, Slider& right)
+    {
+        auto r = area.removeFromTop (rowHeight);
+        auto half = r.removeFromLeft (r.getWidth() / 2);
+        leftLabel.setBounds (half.removeFromLeft (90));
+        left.setBounds (half.reduced (2));
+        rightLabel.setBounds (r.removeFromLeft (90));
+        right.setBounds (r.reduced (2));
+        area.removeFromTop (4);
+    };
+
+    layoutPair (latencyLabel, latency, jitterLabel, jitter);
+    layoutPair (dropLabel, dropRate, corruptLabel, corruptRate);
+    layoutPair (loadLabel, loadTime, rateLabel, bytesPerSecond);
+
+    row = area.removeFromTop (rowHeight);
+    thru.setBounds (row.removeFromLeft (200));
+    seedLabel.setBounds (row.removeFromLeft (50));
+    seed.setBounds (row.removeFromLeft (120).reduced (2));
+
+    area.removeFromTop (10);
+    report.setBounds (area);
+}
@@ -0,0 +1,178 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+#include "MidiDeviceListEntry.h"
+#include "MidiEventFifo.h"
+#include "ToolPanel.h"
+
+//==============================================================================
+/**
+    A Blackaddr pedal that lives inside the app, listed next to the real
+    devices as an input and an output of the same name.
+
+    Like the pedal, it keeps the two buttons (CC 16 and 17) and four knobs
+    (CC 20 to 23) of every preset, and echoes each change with the value it
+    kept; a button is either on or off. A Program Change loads the preset and
+    answers with all six values once the load time has passed. Bank selects
+    are taken in silently. With thru on, everything else comes straight
+    back, as if the pedal's MIDI thru were looped back to the input, so the
+    echo-based tests run against it as they would against a cable.
+
+    Each answer is held back by a latency drawn from the chosen distribution,
+    then paced onto a return link of the given byte rate. Like a real serial
+    link it never reorders, so jitter shows up as uneven gaps. Answers can
+    also be dropped, or have one bit of a data byte flipped, so no framing
+    is broken.
+
+    The model runs on its own thread, which waits on the app's clock. Under
+    simulated time everything it does happens at simulated times, drawn from
+    a seeded random stream, so a whole test against it repeats exactly.
+*/
+class SimulatedPedal  : private Thread
+{
+public:
+    enum Distribution
+    {
+        fixedLatency = 0,
+        uniformLatency,             // latency +- jitter
+        normalLatency,              // jitter is the standard deviation
+        exponentialLatency,         // latency, plus a tail with jitter as its mean
+        numDistributions
+    };
+
+    struct Settings
+    {
+        Distribution distribution = normalLatency;
+        double latencyMs = 2.0;
+        double jitterMs = 0.3;
+        double dropRate = 0.0;              // 0 to 1, per answer
+        double corruptRate = 0.0;           // 0 to 1, per answer
+        double presetLoadMs = 15.0;
+        double bytesPerSecond = 3125.0;     // <= 0 answers unpaced
+        bool thru = true;
+        int64 seed = 1;
+    };
+
+    struct Stats
+    {
+        int64 received = 0, answered = 0, dropped = 0, corrupted = 0, unheard = 0, overflowed = 0;
+    };
+
+    //==============================================================================
+    explicit SimulatedPedal (VirtualClock& clock);
+    ~SimulatedPedal();
+
+    /** The list entries standing for the pedal's input and output. */
+    MidiDeviceListEntry::Ptr getEntry (bool isInput) const;
+
+    /** Also puts the pedal back as it started, with its random stream
+        restarted from the seed, so a run can be repeated.
+    */
+    void setSettings (const Settings& newSettings);
+    Settings getSettings() const;
+
+    Stats getStats() const;
+    int getCurrentProgram() const noexcept  { return currentProgram.load(); }
+
+    static StringArray getDistributionNames();
+
+private:
+    //==============================================================================
+    enum
+    {
+        numPresets = 128,
+        numParameters = 6,
+        buttonACc = 16,
+        knob1Cc = 20,
+        incomingSize = 64 * 1024
+    };
+
+    struct Port;
+
+    struct Answer
+    {
+        double due;
+        MidiMessage message;
+    };
+
+    void run() override;
+    void restart();
+    void receive (const uint8* data, int size, double time);
+    void handle (const MidiMessage& message);
+    void respond (const MidiMessage& message, double readyAt);
+    double drawLatency();
+
+    static int getParameterIndex (int controller) noexcept;
+
+    VirtualClock& clock;
+    ReferenceCountedObjectPtr<Port> input, output;
+
+    // written on the scheduler thread, read by the model
+    MidiEventFifo incoming { incomingSize };
+
+    CriticalSection settingsLock;
+    Settings settings;
+    bool reseed = true;
+
+    // model thread only
+    Settings current;
+    Random random;
+    uint8 presets[numPresets][numParameters];
+    Array<uint8> sysEx;                 // a SysEx still arriving in segments
+    std::deque<Answer> answers;
+    double linkBusyUntil = 0.0;
+
+    std::atomic<int> currentProgram { 0 };
+    std::atomic<int64> received { 0 }, answered { 0 }, dropped { 0 }, corrupted { 0 }, unheard { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SimulatedPedal)
+};
+
+//==============================================================================
+class SimulatedPedalPanel  : public ToolPanel
+{
+public:
+    explicit SimulatedPedalPanel (SimulatedPedal& pedal);
+
+    void resized() override;
+
+private:
+    String getReportText() override;
+    void apply();
+
+    SimulatedPedal& pedal;
+    Label distributionLabel, latencyLabel, jitterLabel, dropLabel, corruptLabel, loadLabel, rateLabel, seedLabel;
+    ComboBox distribution;
+    Slider latency, jitter, dropRate, corruptRate, loadTime, bytesPerSecond;
+    ToggleButton thru { "Thru everything else" };
+    TextEditor seed;
+    TextButton applyButton { "Apply" };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SimulatedPedalPanel)
+};
@@ -0,0 +1,619 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#include "SoakTester.h"
+#include "RealtimeThreads.h"
+
+//==============================================================================
+SoakTester::SoakTester (MidiTestPorts& p)
+    : Thread ("Soak test"), ports (p)
+{
+}
+
+SoakTester::~SoakTester()
+{
+    stop();
+}
+
+bool SoakTester::start (const Array<RigRunner::Pair>& pairs, const Settings& newSettings)
+{
+    stop();
+    lanes.clear();
+    settings = newSettings;
+
+    for (auto& pair : pairs)
+    {
+        if (pair.output == nullptr || ! pair.output->isOutputOpen()
+             || pair.input == nullptr || ! pair.input->isInputOpen())
+            continue;
+
+        auto* lane = lanes.add (new Lane());
+        lane->output = pair.output;
+        lane->input = pair.input;
+        lane->inputDevice = pair.input.get();
+        lane->random.setSeed (settings.seed + lanes.size() - 1);
+        lane->ring.resize (ringSize);
+        lane->arrivals.resize (arrivalQueueSize);
+    }
+
+    if (lanes.isEmpty())
+        return false;
+
+    {
+        const ScopedLock sl (resultsLock);
+        samples.clear();
+        busiestThreads.clear();
+        logError.clear();
+        stoppedAt = 0.0;
+    }
+
+    startTime = ports.getClock().now();
+    ports.addListener (this);
+    ports.getClock().threadStarting (*this);
+    startThread (9);
+    return true;
+}
+
+void SoakTester::stop()
+{
+    stopThread (2000);
+    ports.removeListener (this);
+}
+
+//==============================================================================
+void SoakTester::run()
+{
+    auto& clock = ports.getClock();
+    const VirtualClock::ScopedThread participant (clock, *this);
+    beginSampling (startTime);
+
+    auto meanInterval = 1000.0 / jmax (0.1, settings.messagesPerSecond);
+
+    for (auto* lane : lanes)
+        lane->nextSendAt = startTime;
+
+    while (! threadShouldExit())
+    {
+        RealtimeThreads::applyToCurrentThread (RealtimeThreads::timingThread);
+        auto now = clock.now();
+        auto wakeAt = now + 10.0;
+
+        for (auto* lane : lanes)
+        {
+            drainArrivals (*lane);
+            expire (*lane, now);
+
+            while (lane->nextSendAt <= now)
+            {
+                // the stream is drawn the same way whether or not the send goes through
+                auto message = nextMessage (*lane);
+                lane->nextSendAt += lane->random.nextDouble() * 2.0 * meanInterval;
+
+                if (lane->count == ringSize || ! ports.getScheduler().send (*lane->output, message))
+                {
+                    ++lane->refused;
+                    continue;
+                }
+
+                lane->ring[(size_t) ((lane->head + lane->count) % ringSize)]
+                    = normalise (message.getRawData(), message.getRawDataSize(), now);
+                ++lane->count;
+                ++lane->sent;
+            }
+
+            // after a stall, carry on from now rather than catching up in a burst
+            if (lane->nextSendAt < now - 100.0)
+                lane->nextSendAt = now;
+
+            lane->inFlight = lane->count;
+            wakeAt = jmin (wakeAt, lane->nextSendAt);
+        }
+
+        if (now - lastSampleAt >= settings.sampleSeconds * 1000.0)
+            takeSample (now);
+
+        clock.waitUntil (*this, wakeAt);
+    }
+
+    for (auto* lane : lanes)
+        ports.getScheduler().send (*lane->output, MidiMessage::allNotesOff (settings.channel));
+
+    log.reset();
+
+    const ScopedLock sl (resultsLock);
+    stoppedAt = clock.now();
+}
+
+MidiMessage SoakTester::nextMessage (Lane& lane)
+{
+    auto& r = lane.random;
+    auto kind = r.nextInt (100);
+
+    if (kind < 30)
+    {
+        if (lane.heldNote >= 0)
+        {
+            auto note = lane.heldNote;
+            lane.heldNote = -1;
+            return MidiMessage::noteOff (settings.channel, note);
+        }
+
+        lane.heldNote = r.nextInt (128);
+        return MidiMessage::noteOn (settings.channel, lane.heldNote, (uint8) (1 + r.nextInt (127)));
+    }
+
+    if (kind < 85)
+        return MidiMessage::controllerEvent (settings.channel, r.nextInt (120), r.nextInt (128));
+
+    if (kind < 95)
+        return MidiMessage::pitchWheel (settings.channel, r.nextInt (16384));
+
+    return MidiMessage::channelPressureChange (settings.channel, r.nextInt (128));
+}
+
+void SoakTester::drainArrivals (Lane& lane)
+{
+    auto match = [&lane] (const Short& arrival)
+    {
+        auto searchEnd = jmin (lane.count, (int) lookAhead);
+
+        for (int i = 0; i < searchEnd; ++i)
+        {
+            auto& sent = lane.ring[(size_t) ((lane.head + i) % ringSize)];
+
+            if (sent == arrival)
+            {
+                // anything it overtook is taken as lost
+                lane.lost += i;
+                ++lane.matched;
+                lane.latency.record (arrival.time - sent.time);
+                lane.head = (lane.head + i + 1) % ringSize;
+                lane.count -= i + 1;
+                return;
+            }
+        }
+
+        ++lane.unexpected;
+    };
+
+    int start1, size1, start2, size2;
+    lane.arrivalFifo.prepareToRead (lane.arrivalFifo.getNumReady(), start1, size1, start2, size2);
+
+    for (int i = 0; i < size1; ++i)  match (lane.arrivals[(size_t) (start1 + i)]);
+    for (int i = 0; i < size2; ++i)  match (lane.arrivals[(size_t) (start2 + i)]);
+
+    lane.arrivalFifo.finishedRead (size1 + size2);
+}
+
+void SoakTester::expire (Lane& lane, double now)
+{
+    while (lane.count > 0 && now - lane.ring[(size_t) lane.head].time > settings.timeoutMs)
+    {
+        ++lane.lost;
+        lane.head = (lane.head + 1) % ringSize;
+        --lane.count;
+    }
+}
+
+SoakTester::Short SoakTester::normalise (const uint8* data, int size, double time) noexcept
+{
+    Short s;
+    s.size = jmin (size, 3);
+    s.time = time;
+    memcpy (s.bytes, data, (size_t) s.size);
+
+    // a note-off may come back as a note-on with velocity 0, and lose its release velocity
+    auto type = data[0] & 0xf0;
+
+    if (size == 3 && (type == 0x80 || (type == 0x90 && data[2] == 0)))
+    {
+        s.bytes[0] = (uint8) (0x80 | (data[0] & 0x0f));
+        s.bytes[2] = 0;
+    }
+
+    return s;
+}
+
+void SoakTester::midiReceived (MidiDeviceListEntry* source, const MidiMessage& message)
+{
+    // This is called on the MIDI thread
+    auto* data = message.getRawData();
+    auto size = message.getRawDataSize();
+
+    // only channel messages are sent; clock, sensing and SysEx come and go on their own
+    if (size > 3 || data[0] >= 0xf0)
+        return;
+
+    auto now = ports.getClock().now();
+
+    for (auto* lane : lanes)
+    {
+        if (lane->inputDevice != source)
+            continue;
+
+        int start1, size1, start2, size2;
+        lane->arrivalFifo.prepareToWrite (1, start1, size1, start2, size2);
+
+        if (size1 == 0)
+        {
+            ++lane->overflowed;
+            continue;
+        }
+
+        lane->arrivals[(size_t) start1] = normalise (data, size, now);
+        lane->arrivalFifo.finishedWrite (1);
+    }
+}
+
+//==============================================================================
+void SoakTester::beginSampling (double now)
+{
+    auto stats = ProcessStats::capture();
+
+    threadColumns.clear();
+    lastThreadCpu.clear();
+
+    for (auto& t : stats.threads)
+    {
+        threadColumns.add (t.id);
+        lastThreadCpu[t.id] = t.cpuSeconds;
+    }
+
+    lastProcessCpu = stats.cpuSeconds;
+    lastSampleAt = now;
+    log.reset();
+
+    if (settings.logFile == File())
+        return;
+
+    std::unique_ptr<FileOutputStream> stream (settings.logFile.createOutputStream());
+
+    if (stream == nullptr || ! stream->openedOk() || ! stream->setPosition (0) || stream->truncate().failed())
+    {
+        const ScopedLock sl (resultsLock);
+        logError = "couldn't write to " + settings.logFile.getFullPathName();
+        return;
+    }
+
+    String header;
+    header << "# soak test, seed " << settings.seed << ", " << settings.messagesPerSecond << " msg/s per pair:";
+
+    for (auto* lane : lanes)
+        header << " " << lane->output->deviceInfo.name << " -> " << lane->input->deviceInfo.name << ";";
+
+    // threads started later are added up in the last column
+    header << "\nseconds,rss_mb,cpu_percent,queued,in_flight,sent,matched,lost,unexpected";
+
+    for (auto& t : stats.threads)
+        header << ",cpu:" << t.name.removeCharacters (",") << "/" << t.id;
+
+    header << ",cpu:other\n";
+
+    stream->writeText (header, false, false, nullptr);
+    stream->flush();
+    log = std::move (stream);
+}
+
+void SoakTester::takeSample (double now)
+{
+    auto stats = ProcessStats::capture();
+    auto intervalSeconds = jmax (0.001, (now - lastSampleAt) * 0.001);
+    lastSampleAt = now;
+
+    Sample sample;
+    sample.seconds = (now - startTime) * 0.001;
+    sample.residentMB = (double) stats.residentBytes / (1024.0 * 1024.0);
+    sample.cpuPercent = 100.0 * (stats.cpuSeconds - lastProcessCpu) / intervalSeconds;
+    lastProcessCpu = stats.cpuSeconds;
+
+    int64 sent = 0, matched = 0, lost = 0, unexpected = 0;
+
+    for (auto* lane : lanes)
+    {
+        auto link = ports.getScheduler().getStats (*lane->output);
+
+        for (auto queued : link.queued)
+            sample.queued += queued;
+
+        sample.inFlight += lane->count;
+        sent += lane->sent;
+        matched += lane->matched;
+        lost += lane->lost;
+        unexpected += lane->unexpected;
+    }
+
+    // CPU per thread over the interval; threads that have gone are forgotten
+    std::vector<double> columnPercent ((size_t) threadColumns.size(), 0.0);
+    std::vector<std::pair<double, String>> busiest;
+    std::map<int64, double> threadCpu;
+    double otherPercent = 0.0;
+
+    for (auto& t : stats.threads)
+    {
+        auto previous = lastThreadCpu.find (t.id);
+        auto percent = 100.0 * (t.cpuSeconds - (previous != lastThreadCpu.end() ? previous->second : 0.0)) / intervalSeconds;
+        auto column = threadColumns.indexOf (t.id);
+
+        if (column >= 0)
+            columnPercent[(size_t) column] = percent;
+        else
+            otherPercent += percent;
+
+        threadCpu[t.id] = t.cpuSeconds;
+        busiest.push_back ({ percent, t.name });
+    }
+
+    lastThreadCpu.swap (threadCpu);
+    std::sort (busiest.begin(), busiest.end(), [] (const std::pair<double, String>& a, const std::pair<double, String>& b)
+                                               { return a.first > b.first; });
+
+    if (log != nullptr)
+    {
+        String line;
+        line << String (sample.seconds, 1) << "," << String (sample.residentMB, 2) << "," << String (sample.cpuPercent, 2)
+             << "," << (int) sample.queued << "," << (int) sample.inFlight
+             << "," << sent << "," << matched << "," << lost << "," << unexpected;
+
+        for (auto percent : columnPercent)
+            line << "," << String (percent, 2);
+
+        line << "," << String (otherPercent, 2) << "\n";
+        log->writeText (line, false, false, nullptr);
+        log->flush();
+    }
+
+    const ScopedLock sl (resultsLock);
+    samples.push_back (sample);
+
+    // keep every other sample; the trends only need the shape of the run
+    if (samples.size() >= (size_t) maxSamplesKept)
+    {
+        for (size_t i = 0; i < samples.size() / 2; ++i)
+            samples[i] = samples[i * 2];
+
+        samples.resize (samples.size() / 2);
+    }
+
+    busiestThreads.clear();
+
+    for (size_t i = 0; i < busiest.size() && i < 6; ++i)
+        busiestThreads.add (busiest[i].second + " " + String (busiest[i].first, 1) + "%");
+}
+
+//==============================================================================
+String SoakTester::describeGrowth (const std::vector<double>& seconds, const std::vector<double>& values,
+                                   double minimumRise, const String& units)
+{
+    auto n = values.size();
+
+    if (n < 2 * (size_t) growthSegments || seconds.size() != n)
+        return {};
+
+    // the floor of each part of the run has to rise, or at least hold, every time
+    double firstLow = 0.0, previousLow = 0.0;
+
+    for (size_t s = 0; s < (size_t) growthSegments; ++s)
+    {
+        auto begin = values.begin() + (std::ptrdiff_t) (n * s / growthSegments);
+        auto end = values.begin() + (std::ptrdiff_t) (n * (s + 1) / growthSegments);
+        auto low = *std::min_element (begin, end);
+
+        if (s == 0)
+            firstLow = low;
+        else if (low < previousLow)
+            return {};
+
+        previousLow = low;
+    }
+
+    if (previousLow - firstLow < minimumRise)
+        return {};
+
+    double meanX = 0.0, meanY = 0.0;
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        meanX += seconds[i];
+        meanY += values[i];
+    }
+
+    meanX /= (double) n;
+    meanY /= (double) n;
+    double sxy = 0.0, sxx = 0.0;
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        sxy += (seconds[i] - meanX) * (values[i] - meanY);
+        sxx += (seconds[i] - meanX) * (seconds[i] - meanX);
+    }
+
+    auto perHour = sxx > 0.0 ? sxy / sxx * 3600.0 : 0.0;
+
+    return "GROWING: the floor has risen " + String (previousLow - firstLow, 2) + " " + units
+             + ", about " + String (perHour, 2) + " " + units + " per hour";
+}
+
+String SoakTester::getReport() const
+{
+    if (lanes.isEmpty())
+        return {};
+
+    const ScopedLock sl (resultsLock);
+    auto elapsed = (stoppedAt > 0.0 ? stoppedAt : ports.getClock().now()) - startTime;
+
+    String s;
+    s << "Soak: seed " << settings.seed << ", " << settings.messagesPerSecond << " msg/s per pair, channel " << settings.channel
+      << ", " << RelativeTime::milliseconds ((int64) elapsed).getDescription() << (stoppedAt > 0.0 ? " (stopped)" : "") << "\n";
+
+    if (logError.isNotEmpty())
+        s << "Log: " << logError << "\n";
+    else if (settings.logFile != File())
+        s << "Log: " << settings.logFile.getFullPathName() << "\n";
+
+    s << "\n";
+
+    for (auto* lane : lanes)
+    {
+        s << lane->output->deviceInfo.name << " -> " << lane->input->deviceInfo.name << "\n"
+          << "    sent " << lane->sent.load() << ", back " << lane->matched.load() << ", lost " << lane->lost.load()
+          << ", unexpected " << lane->unexpected.load() << ", in flight " << lane->inFlight.load()
+          << ", refused " << lane->refused.load() << ", overflowed " << lane->overflowed.load() << "\n"
+          << "    " << lane->latency.getSummary() << "\n";
+    }
+
+    if (samples.empty())
+        return s;
+
+    auto& last = samples.back();
+    s << "\nNow: RSS " << String (last.residentMB, 1) << " MB, CPU " << String (last.cpuPercent, 1) << "%, queued "
+      << (int) last.queued << ", in flight " << (int) last.inFlight << "\n";
+
+    if (busiestThreads.size() > 0)
+        s << "Busiest threads: " << busiestThreads.joinIntoString (", ") << "\n";
+
+   #if ! JUCE_LINUX
+    s << "Memory and CPU are only sampled on Linux\n";
+   #endif
+
+    std::vector<double> times, values;
+
+    for (auto& sample : samples)
+        times.push_back (sample.seconds);
+
+    auto addTrend = [&] (const char* name, double Sample::* field, double minimumRise, const char* units)
+    {
+        values.clear();
+
+        for (auto& sample : samples)
+            values.push_back (sample.*field);
+
+        auto growth = describeGrowth (times, values, minimumRise, units);
+        s << "    " << String (name).paddedRight (' ', 12) << (growth.isNotEmpty() ? growth : String ("steady")) << "\n";
+    };
+
+    s << "\nTrends over " << (int) samples.size() << " samples\n";
+    addTrend ("memory", &Sample::residentMB, 1.0, "MB");
+    addTrend ("CPU", &Sample::cpuPercent, 2.0, "%");
+    addTrend ("queued", &Sample::queued, 16.0, "messages");
+    addTrend ("in flight", &Sample::inFlight, 16.0, "messages");
+
+    return s;
+}
+
+//==============================================================================
+SoakPanel::SoakPanel (SoakTester& t, MidiTestPorts& p)
+    : ToolPanel (p, 1), tester (t), ports (p)
+{
+    addAndMakeVisible (allPairs);
+
+    seedLabel.setText ("Seed:", dontSendNotification);
+    addAndMakeVisible (seedLabel);
+    seed.setInputRestrictions (9, "0123456789");
+    seed.setText (String (Random::getSystemRandom().nextInt (1000000)), false);
+    addAndMakeVisible (seed);
+
+    rateLabel.setText ("Msg/s:", dontSendNotification);
+    addAndMakeVisible (rateLabel);
+    rate.setSliderStyle (Slider::LinearHorizontal);
+    rate.setTextBoxStyle (Slider::TextBoxRight, false, 60, 20);
+    rate.setRange (1.0, 1000.0, 1.0);
+    rate.setSkewFactorFromMidPoint (100.0);
+    rate.setValue (SoakTester::Settings().messagesPerSecond, dontSendNotification);
+    addAndMakeVisible (rate);
+
+    intervalLabel.setText ("Sample s:", dontSendNotification);
+    addAndMakeVisible (intervalLabel);
+    interval.setSliderStyle (Slider::LinearHorizontal);
+    interval.setTextBoxStyle (Slider::TextBoxRight, false, 60, 20);
+    interval.setRange (1.0, 300.0, 1.0);
+    interval.setSkewFactorFromMidPoint (30.0);
+    interval.setValue (SoakTester::Settings().sampleSeconds, dontSendNotification);
+    addAndMakeVisible (interval);
+
+    startButton.onClick = [this] { startOrStop(); };
+    addAndMakeVisible (startButton);
+}
+
+void SoakPanel::startOrStop()
+{
+    if (tester.isRunning())
+    {
+        tester.stop();
+    }
+    else
+    {
+        SoakTester::Settings settings;
+        settings.seed = seed.getText().getLargeIntValue();
+        settings.messagesPerSecond = rate.getValue();
+        settings.sampleSeconds = interval.getValue();
+        settings.logFile = File::getSpecialLocation (File::userDocumentsDirectory)
+                               .getChildFile ("BAMidiTester soak " + Time::getCurrentTime().formatted ("%Y-%m-%d %H%M%S") + ".csv");
+
+        Array<RigRunner::Pair> pairs;
+
+        if (allPairs.getToggleState())
+            pairs = RigRunner::pairByName (ports);
+        else
+            pairs.add ({ getOutput(), getInput() });
+
+        if (! tester.start (pairs, settings))
+            showMessage ("Open an output and an input on the main page and connect them, "
+                         "or open each device's ports to soak every pair by name.");
+    }
+
+    refresh();
+}
+
+void SoakPanel::update()
+{
+    startButton.setButtonText (tester.isRunning() ? "Stop" : "Start");
+}
+
+String SoakPanel::getReportText()
+{
+    return tester.getReport();
+}
+
+void SoakPanel::resized()
+{
+    auto area = layOutPair();
+
+    auto row = area.removeFromTop (rowHeight);
+    allPairs.setBounds (row.removeFromLeft (170).reduced (2));
+    seedLabel.setBounds (row.removeFromLeft (50));
+    seed.setBounds (row.removeFromLeft (100).reduced (2));
+    startButton.setBounds (row.removeFromRight (80).reduced (2));
+    area.removeFromTop (4);
+
+    row = area.removeFromTop (rowHeight);
+    rateLabel.setBounds (row.removeFromLeft (60));
+    rate.setBounds (row.removeFromLeft (row.getWidth() / 2).reduced (2));
+    intervalLabel.setBounds (row.removeFromLeft (70));
+    interval.setBounds (row.reduced (2));
+
+    area.removeFromTop (10);
+    report.setBounds (area);
+}
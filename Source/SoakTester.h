@@ -0,0 +1,189 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+#include "LatencyHistogram.h"
+#include "ProcessStats.h"
+#include "RigRunner.h"
+#include "ToolPanel.h"
+
+//==============================================================================
+/**
+    Runs seeded random traffic through one or more pairs for as long as it is
+    left alone, and keeps an eye on the app itself while it does.
+
+    Each pair gets its own random stream from the seed, so a run can be
+    repeated message for message. Notes, controllers, pitch bends and
+    channel pressure go out at random intervals around the chosen rate.
+    Every return is checked against what was sent, in order, with a short
+    look-ahead so a lost message doesn't throw the rest out of step.
+
+    At every sample interval it records the resident memory, the CPU used by
+    each thread, the scheduler queues and the messages in flight. Each sample
+    is one line of a CSV file. The report flags any of these that keeps
+    growing: the lowest value in each eighth of the run rises every time.
+    The samples kept in memory are thinned out as the run grows, so even a
+    run of several days uses a fixed amount of memory.
+*/
+class SoakTester  : private Thread,
+                    private MidiTestPorts::Listener
+{
+public:
+    struct Settings
+    {
+        int64 seed = 1;
+        double messagesPerSecond = 50.0;    // per pair
+        int channel = 1;
+        double timeoutMs = 2000.0;
+        double sampleSeconds = 10.0;
+        File logFile;                       // a CSV of the samples; none if this is empty
+    };
+
+    //==============================================================================
+    explicit SoakTester (MidiTestPorts& ports);
+    ~SoakTester();
+
+    /** Returns false if none of the pairs has both devices open. */
+    bool start (const Array<RigRunner::Pair>& pairs, const Settings& settings);
+    void stop();
+    bool isRunning() const                  { return isThreadRunning(); }
+
+    String getReport() const;
+
+    /** An empty string unless the values keep growing, otherwise how fast
+        they grow. A rise smaller than minimumRise over the run doesn't count.
+    */
+    static String describeGrowth (const std::vector<double>& seconds, const std::vector<double>& values,
+                                  double minimumRise, const String& units);
+
+private:
+    //==============================================================================
+    enum
+    {
+        ringSize = 8192,
+        arrivalQueueSize = 1024,
+        lookAhead = 64,
+        maxSamplesKept = 20000,
+        growthSegments = 8
+    };
+
+    struct Short
+    {
+        uint8 bytes[3] = {};
+        int size = 0;
+        double time = 0.0;
+
+        bool operator== (const Short& other) const noexcept
+        {
+            return size == other.size && memcmp (bytes, other.bytes, (size_t) size) == 0;
+        }
+    };
+
+    struct Lane
+    {
+        MidiDeviceListEntry::Ptr output, input;
+        MidiDeviceListEntry* inputDevice = nullptr;
+        Random random;
+        double nextSendAt = 0.0;
+        int heldNote = -1;
+
+        // sent and not yet back, oldest first; worker only
+        std::vector<Short> ring;
+        int head = 0, count = 0;
+
+        AbstractFifo arrivalFifo { arrivalQueueSize };
+        std::vector<Short> arrivals;
+
+        LatencyHistogram latency;
+        std::atomic<int64> sent { 0 }, matched { 0 }, lost { 0 }, unexpected { 0 }, refused { 0 }, overflowed { 0 };
+        std::atomic<int> inFlight { 0 };
+    };
+
+    struct Sample
+    {
+        double seconds = 0.0;
+        double residentMB = 0.0;
+        double cpuPercent = 0.0;
+        double queued = 0.0;
+        double inFlight = 0.0;
+    };
+
+    void run() override;
+    MidiMessage nextMessage (Lane& lane);
+    void drainArrivals (Lane& lane);
+    void expire (Lane& lane, double now);
+    void beginSampling (double now);
+    void takeSample (double now);
+
+    static Short normalise (const uint8* data, int size, double time) noexcept;
+
+    void midiReceived (MidiDeviceListEntry* source, const MidiMessage& message) override;
+
+    MidiTestPorts& ports;
+    Settings settings;
+    OwnedArray<Lane> lanes;
+    double startTime = 0.0;
+
+    // worker only
+    std::unique_ptr<FileOutputStream> log;
+    Array<int64> threadColumns;
+    std::map<int64, double> lastThreadCpu;
+    double lastProcessCpu = 0.0, lastSampleAt = 0.0;
+
+    CriticalSection resultsLock;
+    std::vector<Sample> samples;
+    StringArray busiestThreads;
+    String logError;
+    double stoppedAt = 0.0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SoakTester)
+};
+
+//==============================================================================
+class SoakPanel  : public ToolPanel
+{
+public:
+    SoakPanel (SoakTester& tester, MidiTestPorts& ports);
+
+    void resized() override;
+
+private:
+    String getReportText() override;
+    void update() override;
+    void startOrStop();
+
+    SoakTester& tester;
+    MidiTestPorts& ports;
+    ToggleButton allPairs { "Every pair by name" };
+    Label seedLabel, rateLabel, intervalLabel;
+    TextEditor seed;
+    Slider rate, interval;
+    TextButton startButton { "Start" };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SoakPanel)
+};
@@ -0,0 +1,487 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#include "StreamDiff.h"
+
+namespace
+{
+    bool pushEvent (AbstractFifo& fifo, std::vector<StreamDiff::Event>& slots, const StreamDiff::Event& event) noexcept
+    {
+        int start1, size1, start2, size2;
+        fifo.prepareToWrite (1, start1, size1, start2, size2);
+
+        if (size1 == 0)
+            return false;
+
+        slots[(size_t) start1] = event;
+        fifo.finishedWrite (1);
+        return true;
+    }
+
+    bool isSameMessage (const StreamDiff::Event& a, const StreamDiff::Event& b) noexcept
+    {
+        return a.hash == b.hash && a.size == b.size;
+    }
+
+    bool isSameType (const StreamDiff::Event& a, const StreamDiff::Event& b) noexcept
+    {
+        return a.size > 0 && b.size > 0 && a.bytes[0] == b.bytes[0];
+    }
+}
+
+//==============================================================================
+StreamDiff::StreamDiff (MidiTestPorts& p)
+    : Thread ("MIDI stream diff"), ports (p),
+      sentSlots ((size_t) queueSize), receivedSlots ((size_t) queueSize)
+{
+}
+
+StreamDiff::~StreamDiff()
+{
+    stop();
+}
+
+//==============================================================================
+bool StreamDiff::start (MidiDeviceListEntry::Ptr newOutput, MidiDeviceListEntry::Ptr newInput, const Settings& newSettings)
+{
+    stop();
+
+    if (newOutput == nullptr || ! newOutput->isOutputOpen()
+         || newInput == nullptr || ! newInput->isInputOpen())
+        return false;
+
+    output = newOutput;
+    input = newInput;
+    settings = newSettings;
+    settings.horizonMs = jmax (10.0, settings.horizonMs);
+    settings.window = jlimit (16, 4096, settings.window);
+
+    sentFifo.reset();
+    receivedFifo.reset();
+    sentPending.clear();
+    receivedPending.clear();
+    overflowed = 0;
+    lcs.resize ((size_t) ((settings.window + 1) * (settings.window + 1)));
+    startTime = ports.getClock().now();
+
+    {
+        const ScopedLock sl (resultsLock);
+        totals = {};
+        delaySum = 0.0;
+        differences.clear();
+    }
+
+    outputDestination = output.get();
+    inputDevice = input.get();
+    ports.addListener (this);
+    ports.getScheduler().addMonitor (this);
+    ports.getClock().threadStarting (*this);
+    startThread (5);
+    return true;
+}
+
+void StreamDiff::stop()
+{
+    // no more events, then let the worker settle what it holds
+    ports.removeListener (this);
+    ports.getScheduler().removeMonitor (this);
+    inputDevice = nullptr;
+    outputDestination = nullptr;
+    stopThread (5000);
+}
+
+StreamDiff::Totals StreamDiff::getTotals() const
+{
+    const ScopedLock sl (resultsLock);
+    auto t = totals;
+    t.overflowed = overflowed.load();
+    return t;
+}
+
+//==============================================================================
+StreamDiff::Event StreamDiff::makeEvent (const MidiMessage& message, double time) noexcept
+{
+    Event event;
+    event.time = time;
+    event.size = message.getRawDataSize();
+
+    auto* data = message.getRawData();
+    uint32 hash = 2166136261u;
+
+    for (int i = 0; i < event.size; ++i)
+        hash = (hash ^ data[i]) * 16777619u;
+
+    event.hash = hash;
+
+    for (int i = 0; i < jmin (event.size, (int) sizeof (event.bytes)); ++i)
+        event.bytes[i] = data[i];
+
+    return event;
+}
+
+bool StreamDiff::isIgnored (const MidiMessage& message) const noexcept
+{
+    return settings.ignoreRealtime && message.getRawDataSize() == 1 && message.getRawData()[0] >= 0xf8;
+}
+
+void StreamDiff::midiReceived (MidiDeviceListEntry* source, const MidiMessage& message)
+{
+    // This is called on the MIDI thread
+    if (source != inputDevice.load() || isIgnored (message))
+        return;
+
+    if (! pushEvent (receivedFifo, receivedSlots, makeEvent (message, ports.getClock().now())))
+        ++overflowed;
+}
+
+void StreamDiff::messageSent (MidiOutputScheduler::Destination& destination, const MidiMessage& message, double time)
+{
+    // This is called on the output scheduler thread
+    if (&destination != outputDestination.load() || isIgnored (message))
+        return;
+
+    if (! pushEvent (sentFifo, sentSlots, makeEvent (message, time)))
+        ++overflowed;
+}
+
+//==============================================================================
+void StreamDiff::run()
+{
+    auto& clock = ports.getClock();
+    const VirtualClock::ScopedThread participant (clock, *this);
+
+    while (! threadShouldExit())
+    {
+        drainAll();
+        align (clock.now(), false);
+        clock.waitFor (*this, 10);
+    }
+
+    drainAll();
+
+    while (! sentPending.empty() || ! receivedPending.empty())
+        align (clock.now(), true);
+}
+
+void StreamDiff::drainAll()
+{
+    auto numSent = drain (sentFifo, sentSlots, sentPending);
+    auto numReceived = drain (receivedFifo, receivedSlots, receivedPending);
+
+    const ScopedLock sl (resultsLock);
+    totals.sent += numSent;
+    totals.received += numReceived;
+}
+
+int StreamDiff::drain (AbstractFifo& fifo, std::vector<Event>& slots, std::deque<Event>& pending)
+{
+    int start1, size1, start2, size2;
+    fifo.prepareToRead (fifo.getNumReady(), start1, size1, start2, size2);
+
+    for (int i = 0; i < size1; ++i)  pending.push_back (slots[(size_t) (start1 + i)]);
+    for (int i = 0; i < size2; ++i)  pending.push_back (slots[(size_t) (start2 + i)]);
+
+    fifo.finishedRead (size1 + size2);
+    return size1 + size2;
+}
+
+/*  Aligns the front of both streams and settles the part that is older than
+    the horizon, walking the LCS from the front until it reaches a message
+    that might still find a partner.
+*/
+void StreamDiff::align (double now, bool settleAll)
+{
+    auto window = (size_t) settings.window;
+    auto n = jmin (sentPending.size(), window);
+    auto m = jmin (receivedPending.size(), window);
+    auto cutoff = now - settings.horizonMs;
+
+    // a side that has outgrown the window must give up its oldest half regardless
+    auto sentOverflowing = sentPending.size() > window;
+    auto receivedOverflowing = receivedPending.size() > window;
+
+    auto isSettledSent = [&] (size_t i)
+    {
+        return settleAll || sentPending[i].time < cutoff || (sentOverflowing && i < n / 2);
+    };
+
+    auto isSettledReceived = [&] (size_t j)
+    {
+        return settleAll || receivedPending[j].time < cutoff || (receivedOverflowing && j < m / 2);
+    };
+
+    if ((n == 0 || ! isSettledSent (0)) && (m == 0 || ! isSettledReceived (0)))
+        return;
+
+    // suffix LCS lengths, so the walk below can go forwards
+    auto stride = m + 1;
+    auto at = [&] (size_t i, size_t j) -> uint16& { return lcs[i * stride + j]; };
+
+    for (size_t j = 0; j <= m; ++j)
+        at (n, j) = 0;
+
+    for (auto i = n; i-- > 0;)
+    {
+        at (i, m) = 0;
+
+        for (auto j = m; j-- > 0;)
+            at (i, j) = isSameMessage (sentPending[i], receivedPending[j]) ? (uint16) (at (i + 1, j + 1) + 1)
+                                                                          : jmax (at (i + 1, j), at (i, j + 1));
+    }
+
+    std::vector<Event> lostEvents, extraEvents;
+    size_t i = 0, j = 0;
+    int64 matched = 0;
+    double delays = 0.0, maxDelay = 0.0;
+
+    while (i < n || j < m)
+    {
+        if (i < n && j < m && isSameMessage (sentPending[i], receivedPending[j]) && at (i, j) == at (i + 1, j + 1) + 1)
+        {
+            if (! isSettledSent (i))
+                break;
+
+            auto delay = receivedPending[j].time - sentPending[i].time;
+            delays += delay;
+            maxDelay = jmax (maxDelay, delay);
+            ++matched;
+            ++i;
+            ++j;
+        }
+        else if (j >= m || (i < n && at (i + 1, j) >= at (i, j + 1)))
+        {
+            if (! isSettledSent (i))
+                break;
+
+            lostEvents.push_back (sentPending[i++]);
+        }
+        else
+        {
+            if (! isSettledReceived (j))
+                break;
+
+            extraEvents.push_back (receivedPending[j++]);
+        }
+    }
+
+    sentPending.erase (sentPending.begin(), sentPending.begin() + (std::ptrdiff_t) i);
+    receivedPending.erase (receivedPending.begin(), receivedPending.begin() + (std::ptrdiff_t) j);
+
+    {
+        const ScopedLock sl (resultsLock);
+        totals.matched += matched;
+        delaySum += delays;
+        totals.meanDelayMs = totals.matched > 0 ? delaySum / (double) totals.matched : 0.0;
+        totals.maxDelayMs = jmax (totals.maxDelayMs, maxDelay);
+    }
+
+    settle (lostEvents, extraEvents);
+}
+
+void StreamDiff::settle (const std::vector<Event>& lostEvents, const std::vector<Event>& extraEvents)
+{
+    std::vector<bool> lostUsed (lostEvents.size(), false), extraUsed (extraEvents.size(), false);
+    std::vector<Difference> found;
+
+    auto pairUp = [&] (Kind kind, std::function<bool (const Event&, const Event&)> matches)
+    {
+        for (size_t l = 0; l < lostEvents.size(); ++l)
+        {
+            for (size_t e = 0; e < extraEvents.size() && ! lostUsed[l]; ++e)
+            {
+                if (! extraUsed[e] && extraEvents[e].time >= lostEvents[l].time && matches (lostEvents[l], extraEvents[e]))
+                {
+                    found.push_back ({ kind, lostEvents[l], extraEvents[e] });
+                    lostUsed[l] = extraUsed[e] = true;
+                }
+            }
+        }
+    };
+
+    // the same bytes out of place first, then a message whose bytes changed on the way
+    pairUp (reordered, isSameMessage);
+    pairUp (altered, isSameType);
+
+    for (size_t l = 0; l < lostEvents.size(); ++l)
+        if (! lostUsed[l])
+            found.push_back ({ lost, lostEvents[l], {} });
+
+    for (size_t e = 0; e < extraEvents.size(); ++e)
+        if (! extraUsed[e])
+            found.push_back ({ extra, {}, extraEvents[e] });
+
+    std::sort (found.begin(), found.end(), [] (const Difference& a, const Difference& b)
+    {
+        return (a.sent.size > 0 ? a.sent.time : a.received.time) < (b.sent.size > 0 ? b.sent.time : b.received.time);
+    });
+
+    for (auto& d : found)
+        addDifference (d.kind, d.sent, d.received);
+}
+
+void StreamDiff::addDifference (Kind kind, const Event& sent, const Event& received)
+{
+    const ScopedLock sl (resultsLock);
+
+    switch (kind)
+    {
+        case lost:          ++totals.lost; break;
+        case extra:         ++totals.extra; break;
+        case altered:       ++totals.altered; break;
+        case reordered:     ++totals.reordered; break;
+        default:            break;
+    }
+
+    differences.push_back ({ kind, sent, received });
+
+    if (differences.size() > (size_t) maxDifferencesKept)
+        differences.pop_front();
+}
+
+//==============================================================================
+String StreamDiff::describe (const Event& event)
+{
+    if (event.size == 0)
+        return "-";
+
+    if (event.bytes[0] == 0xf0)
+        return "SysEx, " + String (event.size) + " bytes";
+
+    return String::toHexString (event.bytes, jmin (event.size, (int) sizeof (event.bytes))).toUpperCase();
+}
+
+String StreamDiff::getReport() const
+{
+    if (output == nullptr || input == nullptr)
+        return {};
+
+    auto t = getTotals();
+    String s;
+
+    s << "Stream diff: " << output->deviceInfo.name << " -> " << input->deviceInfo.name
+      << ", horizon " << String (settings.horizonMs, 0) << " ms\n"
+      << "Sent " << t.sent << "  received " << t.received << "  matched " << t.matched
+      << "  delay mean " << String (t.meanDelayMs, 2) << " ms, max " << String (t.maxDelayMs, 2) << " ms\n"
+      << "Lost " << t.lost << "  extra " << t.extra << "  altered " << t.altered << "  reordered " << t.reordered << "\n";
+
+    if (t.overflowed > 0)
+        s << t.overflowed << " messages arrived faster than they could be compared and were left out\n";
+
+    static const char* const kindNames[] = { "lost", "extra", "altered", "reordered" };
+
+    s << "\n" << String ("time").paddedLeft (' ', 10) << "  " << String ("Sent").paddedRight (' ', 22)
+      << String ("Received").paddedRight (' ', 22) << String ("delta").paddedLeft (' ', 10) << "\n";
+
+    const ScopedLock sl (resultsLock);
+    auto first = differences.size() > (size_t) maxDifferencesShown ? differences.size() - (size_t) maxDifferencesShown : 0;
+
+    if (first > 0)
+        s << String ("...").paddedLeft (' ', 10) << "  " << String (first) << " earlier differences not shown\n";
+
+    for (auto i = first; i < differences.size(); ++i)
+    {
+        auto& d = differences[i];
+        auto time = (d.sent.size > 0 ? d.sent.time : d.received.time) - startTime;
+
+        s << (String (time * 0.001, 3) + " s").paddedLeft (' ', 10) << "  "
+          << describe (d.sent).paddedRight (' ', 22)
+          << describe (d.received).paddedRight (' ', 22);
+
+        if (d.sent.size > 0 && d.received.size > 0)
+            s << (String (d.received.time - d.sent.time, 2) + " ms").paddedLeft (' ', 10);
+        else
+            s << String().paddedLeft (' ', 10);
+
+        s << "  " << kindNames[d.kind] << "\n";
+    }
+
+    return s;
+}
+
+//==============================================================================
+StreamDiffPanel::StreamDiffPanel (StreamDiff& d, MidiTestPorts& ports)
+    : ToolPanel (ports), diff (d)
+{
+    horizonLabel.setText ("Horizon:", dontSendNotification);
+    addAndMakeVisible (horizonLabel);
+    horizon.setSliderStyle (Slider::LinearHorizontal);
+    horizon.setTextBoxStyle (Slider::TextBoxRight, false, 70, 20);
+    horizon.setRange (50.0, 10000.0, 10.0);
+    horizon.setSkewFactorFromMidPoint (1000.0);
+    horizon.setTextValueSuffix (" ms");
+    horizon.setValue (StreamDiff::Settings().horizonMs, dontSendNotification);
+    addAndMakeVisible (horizon);
+
+    ignoreRealtime.setToggleState (true, dontSendNotification);
+    addAndMakeVisible (ignoreRealtime);
+
+    startButton.onClick = [this] { startOrStop(); };
+    addAndMakeVisible (startButton);
+}
+
+void StreamDiffPanel::startOrStop()
+{
+    if (diff.isRunning())
+    {
+        diff.stop();
+    }
+    else
+    {
+        StreamDiff::Settings settings;
+        settings.horizonMs = horizon.getValue();
+        settings.ignoreRealtime = ignoreRealtime.getToggleState();
+
+        if (! diff.start (getOutput(), getInput(), settings))
+            showMessage ("Open an output and an input on the main page. The diff watches whatever "
+                         "goes out on the output, from any test tool or the controls on the main page.");
+    }
+
+    refresh();
+}
+
+void StreamDiffPanel::update()
+{
+    startButton.setButtonText (diff.isRunning() ? "Stop" : "Start");
+}
+
+String StreamDiffPanel::getReportText()
+{
+    return diff.getReport();
+}
+
+void StreamDiffPanel::resized()
+{
+    auto area = layOutPair();
+
+    auto row = area.removeFromTop (rowHeight);
+    horizonLabel.setBounds (row.removeFromLeft (60));
+    horizon.setBounds (row.removeFromLeft (250).reduced (2));
+    ignoreRealtime.setBounds (row.removeFromLeft (240).reduced (2));
+    startButton.setBounds (row.removeFromRight (80).reduced (2));
+
+    area.removeFromTop (10);
+    report.setBounds (area);
+}
@@ -0,0 +1,173 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+#include "MidiTestPorts.h"
+#include "ToolPanel.h"
+
+//==============================================================================
+/**
+    Lines up what went out of one port with what came back on another, and
+    keeps a record of every difference.
+
+    Both streams are watched passively: the sent side through the output
+    scheduler as each message leaves, the received side on the MIDI thread.
+    It works alongside any other test, or the knobs and keyboard.
+
+    Messages are compared by a hash of their bytes. A worker aligns the two
+    streams with a longest-common-subsequence over a bounded window, and only
+    settles the part older than the horizon, so late arrivals still find
+    their partner. What is settled is dropped, so memory stays the same over
+    a run of any length. Among the settled messages, a lost one and an extra
+    one with the same bytes are a reordering, and a lost one next to an extra
+    one of the same type is an altered message.
+*/
+class StreamDiff  : private Thread,
+                    private MidiTestPorts::Listener,
+                    private MidiOutputScheduler::Monitor
+{
+public:
+    enum Kind
+    {
+        lost = 0,
+        extra,
+        altered,
+        reordered
+    };
+
+    struct Event
+    {
+        uint32 hash = 0;
+        double time = 0.0;
+        int size = 0;
+        uint8 bytes[3] = {};            // enough to show a short message; SysEx is shown by length
+    };
+
+    struct Difference
+    {
+        Kind kind;
+        Event sent, received;           // either may be empty (size 0)
+    };
+
+    struct Settings
+    {
+        double horizonMs = 1000.0;      // how long a message may take to come back
+        int window = 512;               // most messages aligned at once on each side
+        bool ignoreRealtime = true;     // clock and active sensing come and go on their own
+    };
+
+    struct Totals
+    {
+        int64 sent = 0, received = 0, matched = 0;
+        int64 lost = 0, extra = 0, altered = 0, reordered = 0;
+        int64 overflowed = 0;           // events that didn't fit in the hand-off queues
+        double meanDelayMs = 0.0, maxDelayMs = 0.0;
+    };
+
+    //==============================================================================
+    explicit StreamDiff (MidiTestPorts& ports);
+    ~StreamDiff();
+
+    /** Returns false if either device isn't open. */
+    bool start (MidiDeviceListEntry::Ptr output, MidiDeviceListEntry::Ptr input, const Settings& settings);
+
+    /** Settles everything still waiting, then stops. */
+    void stop();
+    bool isRunning() const                  { return isThreadRunning(); }
+
+    Totals getTotals() const;
+    String getReport() const;
+
+private:
+    //==============================================================================
+    enum
+    {
+        queueSize = 8192,
+        maxDifferencesKept = 2000,
+        maxDifferencesShown = 200
+    };
+
+    void run() override;
+    void drainAll();
+    int drain (AbstractFifo& fifo, std::vector<Event>& slots, std::deque<Event>& pending);
+    void align (double now, bool settleAll);
+    void settle (const std::vector<Event>& lostEvents, const std::vector<Event>& extraEvents);
+    void addDifference (Kind kind, const Event& sent, const Event& received);
+
+    static Event makeEvent (const MidiMessage& message, double time) noexcept;
+    static String describe (const Event& event);
+    bool isIgnored (const MidiMessage& message) const noexcept;
+
+    void midiReceived (MidiDeviceListEntry* source, const MidiMessage& message) override;
+    void messageSent (MidiOutputScheduler::Destination& destination, const MidiMessage& message, double time) override;
+
+    MidiTestPorts& ports;
+    MidiDeviceListEntry::Ptr output, input;
+    std::atomic<MidiOutputScheduler::Destination*> outputDestination { nullptr };
+    std::atomic<MidiDeviceListEntry*> inputDevice { nullptr };
+    Settings settings;
+    double startTime = 0.0;
+
+    // events travel to the worker through these, one writer each
+    AbstractFifo sentFifo { queueSize }, receivedFifo { queueSize };
+    std::vector<Event> sentSlots, receivedSlots;
+    std::atomic<int64> overflowed { 0 };
+
+    // worker thread only
+    std::deque<Event> sentPending, receivedPending;
+    std::vector<uint16> lcs;
+
+    CriticalSection resultsLock;
+    Totals totals;
+    double delaySum = 0.0;
+    std::deque<Difference> differences;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (StreamDiff)
+};
+
+//==============================================================================
+class StreamDiffPanel  : public ToolPanel
+{
+public:
+    StreamDiffPanel (StreamDiff& diff, MidiTestPorts& ports);
+
+    void resized() override;
+
+private:
+    String getReportText() override;
+    void update() override;
+    void startOrStop();
+
+    StreamDiff& diff;
+    Label horizonLabel;
+    Slider horizon;
+    ToggleButton ignoreRealtime { "Ignore clock and active sensing" };
+    TextButton startButton { "Start" };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (StreamDiffPanel)
+};
@@ -0,0 +1,522 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#include "StressTester.h"
+#include "RealtimeThreads.h"
+
+namespace
+{
+    const uint8 nonCommercialId = 0x7d;
+    const uint8 sequenceType = 'S';
+    const int64 sysExModulus = (int64) 1 << 28;
+    const double settleMs = 300.0;
+}
+
+//==============================================================================
+StressTester::StressTester (MidiTestPorts& p)
+    : Thread ("MIDI stress test"), ports (p)
+{
+    for (auto& word : seen)
+        word = 0;
+}
+
+StressTester::~StressTester()
+{
+    stop();
+}
+
+StringArray StressTester::getPatternNames()
+{
+    return { "Dense chords", "Arpeggio", "CC sweep", "Mixed traffic" };
+}
+
+//==============================================================================
+bool StressTester::start (MidiDeviceListEntry::Ptr newOutput, MidiDeviceListEntry::Ptr newInput, const Settings& newSettings)
+{
+    stop();
+
+    if (newOutput == nullptr || ! newOutput->isOutputOpen()
+         || newInput == nullptr || ! newInput->isInputOpen())
+        return false;
+
+    output = newOutput;
+    input = newInput;
+    settings = newSettings;
+    settings.chordSize = jlimit (1, 16, settings.chordSize);
+    settings.stepFactor = jmax (1.01, settings.stepFactor);
+    conditions = RealtimeThreads::getConditionsSummary();
+
+    for (auto& word : seen)
+        word = 0;
+
+    nextSequence = 0;
+    highestReceived = -1;
+    duplicates = 0;
+    reordered = 0;
+
+    {
+        const ScopedLock sl (resultsLock);
+        steps.clear();
+        verdict.clear();
+    }
+
+    inputDevice = input.get();
+    ports.addListener (this);
+    ports.getClock().threadStarting (*this);
+    startThread (9);
+    return true;
+}
+
+void StressTester::stop()
+{
+    stopThread (2000);
+    ports.removeListener (this);
+    inputDevice = nullptr;
+}
+
+Array<StressTester::Step> StressTester::getSteps() const
+{
+    const ScopedLock sl (resultsLock);
+    return steps;
+}
+
+//==============================================================================
+void StressTester::run()
+{
+    const VirtualClock::ScopedThread participant (ports.getClock(), *this);
+    auto rate = settings.startRate;
+    int lossySteps = 0;
+    String result;
+
+    while (! threadShouldExit() && rate <= settings.maxRate * 1.0001)
+    {
+        Step step;
+
+        if (! runStep (rate, step))
+            break;
+
+        auto lossy = step.isLossy (settings.lossThreshold);
+
+        {
+            const ScopedLock sl (resultsLock);
+            steps.add (step);
+        }
+
+        lossySteps = lossy ? lossySteps + 1 : 0;
+
+        if (lossySteps >= settings.lossyStepsToStop)
+            break;
+
+        rate *= settings.stepFactor;
+    }
+
+    // a note-off lost on the way leaves its note hanging
+    ports.getScheduler().send (*output, MidiMessage::allNotesOff (settings.channel));
+
+    auto all = getSteps();
+    int knee = -1;
+
+    for (int i = 0; i < all.size() && knee < 0; ++i)
+        if (all[i].isLossy (settings.lossThreshold))
+            knee = i;
+
+    if (knee < 0)
+        result << "No loss up to " << String (all.isEmpty() ? 0.0 : all.getLast().offeredRate, 0) << " msg/s";
+    else if (knee == 0)
+        result << "Lossy from the first step, " << String (all[0].offeredRate, 0) << " msg/s";
+    else
+        result << "Loss begins at " << String (all[knee].offeredRate, 0) << " msg/s; last clean step "
+               << String (all[knee - 1].offeredRate, 0) << " msg/s (" << String (all[knee - 1].achievedRate, 0) << " received)";
+
+    const ScopedLock sl (resultsLock);
+    verdict = result;
+}
+
+bool StressTester::runStep (double rate, Step& step)
+{
+    step.offeredRate = rate;
+    auto durationMs = settings.stepSeconds * 1000.0;
+    auto burst = settings.pattern == chords ? (int64) settings.chordSize : 1;
+    auto firstSequence = nextSequence;
+    auto duplicatesBefore = duplicates.load();
+    auto reorderedBefore = reordered.load();
+    auto stepStart = ports.getClock().now();
+    int64 due = 0;
+
+    for (;;)
+    {
+        RealtimeThreads::applyToCurrentThread (RealtimeThreads::timingThread);
+
+        if (threadShouldExit())
+            return false;
+
+        auto elapsed = ports.getClock().now() - stepStart;
+
+        if (elapsed >= durationMs)
+            break;
+
+        // chords go out a whole chord at a time
+        due = jmax (due, ((int64) (elapsed * rate * 0.001) / burst + 1) * burst);
+
+        while (step.sent < due)
+        {
+            auto sequence = nextSequence;
+            auto& word = seen[(sequence % windowBits) / 32];
+            word.fetch_and (~(1u << (sequence % 32)), std::memory_order_relaxed);
+
+            // a refused message keeps its number, so a full queue never shows up as loss
+            if (! ports.getScheduler().send (*output, createMessage (sequence)))
+                break;
+
+            ++nextSequence;
+            ++step.sent;
+        }
+
+        ports.getClock().waitFor (*this, 1);
+    }
+
+    step.notQueued = jmax ((int64) 0, (int64) (rate * settings.stepSeconds) - step.sent);
+
+    // let the output queue drain onto the link, then give the last messages time to come back
+    for (;;)
+    {
+        auto stats = ports.getScheduler().getStats (*output);
+
+        if (stats.queued[MidiOutputScheduler::voicePriority] + stats.queued[MidiOutputScheduler::bulkPriority] == 0)
+            break;
+
+        ports.getClock().waitFor (*this, 10);
+
+        if (threadShouldExit())
+            return false;
+    }
+
+    auto settleUntil = ports.getClock().now() + settleMs;
+
+    while (ports.getClock().now() < settleUntil)
+    {
+        ports.getClock().waitFor (*this, 10);
+
+        if (threadShouldExit())
+            return false;
+    }
+
+    step.received = countReceived (firstSequence, nextSequence);
+    step.lost = step.sent - step.received;
+    step.duplicates = duplicates.load() - duplicatesBefore;
+    step.reordered = reordered.load() - reorderedBefore;
+    step.achievedRate = (double) step.received / settings.stepSeconds;
+    return true;
+}
+
+int64 StressTester::countReceived (int64 first, int64 end) const noexcept
+{
+    int64 total = 0;
+
+    for (auto sequence = first; sequence < end; ++sequence)
+        if ((seen[(sequence % windowBits) / 32].load (std::memory_order_relaxed) >> (sequence % 32)) & 1)
+            ++total;
+
+    return total;
+}
+
+//==============================================================================
+StressTester::Kind StressTester::getKind (int64 sequence) const noexcept
+{
+    switch (settings.pattern)
+    {
+        case chords:            return (sequence / settings.chordSize) % 2 == 0 ? noteOn : noteOff;
+        case arpeggio:          return sequence % 2 == 0 ? noteOn : noteOff;
+        case controllerSweep:   return controller;
+
+        case mixedTraffic:
+        default:
+        {
+            // each note-off comes two after its note-on
+            static const Kind mix[] = { controller, noteOn, controller, noteOff, noteOn, sysEx, noteOff, controller };
+            return mix[sequence % numElementsInArray (mix)];
+        }
+    }
+}
+
+/*  How far back in the sequence the note-on a note-off ends is: a whole
+    chord, the previous note, or two places back in the mix.
+*/
+int StressTester::getNoteOffDistance() const noexcept
+{
+    switch (settings.pattern)
+    {
+        case chords:            return settings.chordSize;
+        case arpeggio:          return 1;
+        case controllerSweep:
+        case mixedTraffic:
+        default:                return 2;
+    }
+}
+
+MidiMessage StressTester::createMessage (int64 sequence) const noexcept
+{
+    auto kind = getKind (sequence);
+
+    if (kind == sysEx)
+    {
+        uint8 data[] = { 0xf0, nonCommercialId, sequenceType,
+                         (uint8) (sequence & 0x7f), (uint8) ((sequence >> 7) & 0x7f),
+                         (uint8) ((sequence >> 14) & 0x7f), (uint8) ((sequence >> 21) & 0x7f),
+                         0xf7 };
+
+        return MidiMessage (data, (int) sizeof (data));
+    }
+
+    auto low = (int) (sequence & 0x7f);
+
+    if (kind == controller)
+        return MidiMessage::controllerEvent (settings.channel, firstController + (int) ((sequence >> 7) % numControllers), low);
+
+    // velocity 0 would read as a note-off on the way back, so it carries 1-127
+    auto velocity = (uint8) (1 + (sequence >> 7) % 127);
+
+    if (kind == noteOn)
+        return MidiMessage::noteOn (settings.channel, low, velocity);
+
+    // the key of the note being ended
+    auto key = (int) ((sequence - getNoteOffDistance()) & 0x7f);
+    return MidiMessage::noteOff (settings.channel, key, velocity);
+}
+
+//==============================================================================
+bool StressTester::decode (const MidiMessage& message, int64& value, int64& modulus) const noexcept
+{
+    if (message.isSysEx())
+    {
+        auto* data = message.getSysExData();
+
+        if (message.getSysExDataSize() != 6 || data[0] != nonCommercialId || data[1] != sequenceType)
+            return false;
+
+        value = (int64) data[2] | ((int64) data[3] << 7) | ((int64) data[4] << 14) | ((int64) data[5] << 21);
+        modulus = sysExModulus;
+        return true;
+    }
+
+    if (message.getRawDataSize() != 3 || message.getChannel() != settings.channel)
+        return false;
+
+    auto* data = message.getRawData();
+    auto type = data[0] & 0xf0;
+
+    if (type == 0x90 && data[2] > 0)
+    {
+        value = (int64) data[1] | ((int64) (data[2] - 1) << 7);
+        modulus = noteModulus;
+        return true;
+    }
+
+    if (type == 0x80 || type == 0x90)
+    {
+        auto low = (int64) ((data[1] + getNoteOffDistance()) & 0x7f);
+
+        // a note-on with velocity 0 has lost the high bits
+        if (type == 0x90 || data[2] == 0)
+        {
+            value = low;
+            modulus = noteOffKeyModulus;
+        }
+        else
+        {
+            value = low | ((int64) (data[2] - 1) << 7);
+            modulus = noteModulus;
+        }
+
+        return true;
+    }
+
+    if (type == 0xb0 && data[1] >= firstController && data[1] < firstController + numControllers)
+    {
+        value = (int64) data[2] | ((int64) (data[1] - firstController) << 7);
+        modulus = controllerModulus;
+        return true;
+    }
+
+    return false;
+}
+
+void StressTester::midiReceived (MidiDeviceListEntry* source, const MidiMessage& message)
+{
+    // This is called on the MIDI thread
+    int64 value, modulus;
+
+    if (source != inputDevice.load() || ! decode (message, value, modulus))
+        return;
+
+    // the sequence number nearest to the one we expect next that has these low bits
+    auto expected = highestReceived + 1;
+    auto offset = ((value - expected) % modulus + modulus) % modulus;
+
+    if (offset >= modulus / 2)
+        offset -= modulus;
+
+    auto sequence = expected + offset;
+
+    if (sequence < 0)
+        return;
+
+    auto& word = seen[(sequence % windowBits) / 32];
+    auto bit = 1u << (sequence % 32);
+    auto wasSeen = (word.fetch_or (bit, std::memory_order_relaxed) & bit) != 0;
+
+    if (sequence > highestReceived)
+        highestReceived = sequence;
+    else if (wasSeen)
+        ++duplicates;
+    else
+        ++reordered;
+}
+
+//==============================================================================
+String StressTester::getVerdict() const
+{
+    const ScopedLock sl (resultsLock);
+    return verdict;
+}
+
+String StressTester::getReport() const
+{
+    if (output == nullptr || input == nullptr)
+        return {};
+
+    String s;
+    s << getPatternNames()[(int) settings.pattern] << ": " << output->deviceInfo.name << " -> " << input->deviceInfo.name << "\n"
+      << "Threads: " << conditions << "\n\n"
+      << String ("offered").paddedLeft (' ', 9) << String ("received").paddedLeft (' ', 10)
+      << String ("sent").paddedLeft (' ', 9) << String ("lost").paddedLeft (' ', 8)
+      << String ("dupes").paddedLeft (' ', 7) << String ("reorder").paddedLeft (' ', 9)
+      << String ("refused").paddedLeft (' ', 9) << "\n";
+
+    const ScopedLock sl (resultsLock);
+
+    for (auto& step : steps)
+    {
+        s << String (step.offeredRate, 0).paddedLeft (' ', 9)
+          << String (step.achievedRate, 0).paddedLeft (' ', 10)
+          << String (step.sent).paddedLeft (' ', 9)
+          << String (step.lost).paddedLeft (' ', 8)
+          << String (step.duplicates).paddedLeft (' ', 7)
+          << String (step.reordered).paddedLeft (' ', 9)
+          << String (step.notQueued).paddedLeft (' ', 9)
+          << (step.isLossy (settings.lossThreshold) ? "  <- loss" : "") << "\n";
+    }
+
+    if (verdict.isNotEmpty())
+        s << "\n" << verdict << "\n";
+
+    return s;
+}
+
+//==============================================================================
+StressPanel::StressPanel (StressTester& t, MidiTestPorts& ports)
+    : ToolPanel (ports), tester (t)
+{
+    patternLabel.setText ("Pattern:", dontSendNotification);
+    addAndMakeVisible (patternLabel);
+    pattern.addItemList (StressTester::getPatternNames(), 1);
+    pattern.setSelectedItemIndex ((int) StressTester::mixedTraffic, dontSendNotification);
+    addAndMakeVisible (pattern);
+
+    rangeLabel.setText ("Rate:", dontSendNotification);
+    addAndMakeVisible (rangeLabel);
+    rateRange.setSliderStyle (Slider::TwoValueHorizontal);
+    rateRange.setRange (10.0, 50000.0, 10.0);
+    rateRange.setSkewFactorFromMidPoint (2000.0);
+    rateRange.setMinAndMaxValues (100.0, 20000.0, dontSendNotification);
+    rateRange.setPopupDisplayEnabled (true, true, this);
+    rateRange.setTextValueSuffix (" msg/s");
+    addAndMakeVisible (rateRange);
+
+    stepLabel.setText ("Step:", dontSendNotification);
+    addAndMakeVisible (stepLabel);
+    stepSeconds.setSliderStyle (Slider::LinearHorizontal);
+    stepSeconds.setTextBoxStyle (Slider::TextBoxRight, false, 60, 20);
+    stepSeconds.setRange (0.5, 10.0, 0.5);
+    stepSeconds.setTextValueSuffix (" s");
+    stepSeconds.setValue (2.0, dontSendNotification);
+    addAndMakeVisible (stepSeconds);
+
+    startButton.onClick = [this] { startOrStop(); };
+    addAndMakeVisible (startButton);
+}
+
+void StressPanel::startOrStop()
+{
+    if (tester.isRunning())
+    {
+        tester.stop();
+    }
+    else
+    {
+        StressTester::Settings settings;
+        settings.pattern = (StressTester::Pattern) pattern.getSelectedItemIndex();
+        settings.startRate = rateRange.getMinValue();
+        settings.maxRate = rateRange.getMaxValue();
+        settings.stepSeconds = stepSeconds.getValue();
+
+        if (! tester.start (getOutput(), getInput(), settings))
+            showMessage ("Open an output and an input on the main page and connect them. "
+                         "Set the link to USB (unpaced) to test beyond the DIN rate.");
+    }
+
+    refresh();
+}
+
+void StressPanel::update()
+{
+    startButton.setButtonText (tester.isRunning() ? "Stop" : "Start");
+}
+
+String StressPanel::getReportText()
+{
+    return tester.getReport();
+}
+
+void StressPanel::resized()
+{
+    auto area = layOutPair();
+
+    auto row = area.removeFromTop (rowHeight);
+    patternLabel.setBounds (row.removeFromLeft (60));
+    pattern.setBounds (row.removeFromLeft (150).reduced (2));
+    stepLabel.setBounds (row.removeFromLeft (40));
+    stepSeconds.setBounds (row.removeFromLeft (200).reduced (2));
+    startButton.setBounds (row.removeFromRight (80).reduced (2));
+    area.removeFromTop (4);
+
+    row = area.removeFromTop (rowHeight);
+    rangeLabel.setBounds (row.removeFromLeft (60));
+    rateRange.setBounds (row.reduced (2));
+
+    area.removeFromTop (10);
+    report.setBounds (area);
+}
@@ -0,0 +1,173 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+#include "MidiTestPorts.h"
+#include "ToolPanel.h"
+
+//==============================================================================
+/**
+    Finds the highest message rate a device or cable passes without loss.
+
+    Traffic goes out at a rate that rises step by step. Every message carries
+    the low bits of a running sequence number: notes in their key and
+    velocity, controllers in the controller number (102-119) and value, and
+    SysEx in a 28-bit payload. A note-off always releases the key of the note
+    it ends, a fixed distance back in the sequence, so a synth under test
+    never piles up notes; the receiver adds that distance back. A note-off
+    sent back as a note-on with velocity 0 keeps only its key, so it is
+    placed on the low 7 bits alone. The receiving side unwraps these against the
+    highest number seen so far, and marks each arrival in a window of seen
+    bits. That is enough to tell gaps, duplicates and late (reordered)
+    arrivals apart.
+
+    After each step the generator pauses briefly so stragglers can arrive,
+    then counts what came back. The first step that loses messages is the knee.
+*/
+class StressTester  : private Thread,
+                      private MidiTestPorts::Listener
+{
+public:
+    enum Pattern
+    {
+        chords = 0,
+        arpeggio,
+        controllerSweep,
+        mixedTraffic
+    };
+
+    struct Settings
+    {
+        Pattern pattern = mixedTraffic;
+        int channel = 16;
+        int chordSize = 4;
+        double startRate = 100.0;       // messages per second
+        double maxRate = 20000.0;
+        double stepFactor = 1.25;
+        double stepSeconds = 2.0;
+        double lossThreshold = 0.001;   // fraction of a step that may go missing before it counts as lossy
+        int lossyStepsToStop = 2;
+    };
+
+    struct Step
+    {
+        double offeredRate = 0.0;
+        double achievedRate = 0.0;      // distinct messages received per second
+        int64 sent = 0;
+        int64 notQueued = 0;            // due but refused by a full output queue
+        int64 received = 0;
+        int64 lost = 0;
+        int64 duplicates = 0;
+        int64 reordered = 0;
+
+        bool isLossy (double threshold) const noexcept   { return sent > 0 && (double) lost > threshold * (double) sent; }
+    };
+
+    //==============================================================================
+    explicit StressTester (MidiTestPorts& ports);
+    ~StressTester();
+
+    /** Returns false if either device isn't open. */
+    bool start (MidiDeviceListEntry::Ptr output, MidiDeviceListEntry::Ptr input, const Settings& settings);
+    void stop();
+    bool isRunning() const                  { return isThreadRunning(); }
+
+    Array<Step> getSteps() const;
+
+    /** The one-line outcome, once a run has finished; empty until then. */
+    String getVerdict() const;
+    String getReport() const;
+
+    static StringArray getPatternNames();
+
+private:
+    //==============================================================================
+    enum
+    {
+        windowBits = 1 << 20,
+        firstController = 102,
+        numControllers = 18,
+        noteModulus = 128 * 127,
+        noteOffKeyModulus = 128,
+        controllerModulus = 128 * numControllers
+    };
+
+    enum Kind { noteOn, noteOff, controller, sysEx };
+
+    void run() override;
+    bool runStep (double rate, Step& step);
+    Kind getKind (int64 sequence) const noexcept;
+    int getNoteOffDistance() const noexcept;
+    MidiMessage createMessage (int64 sequence) const noexcept;
+    int64 countReceived (int64 first, int64 end) const noexcept;
+
+    void midiReceived (MidiDeviceListEntry* source, const MidiMessage& message) override;
+    bool decode (const MidiMessage& message, int64& value, int64& modulus) const noexcept;
+
+    MidiTestPorts& ports;
+    MidiDeviceListEntry::Ptr output, input;
+    std::atomic<MidiDeviceListEntry*> inputDevice { nullptr };
+    Settings settings;
+    String conditions;
+
+    int64 nextSequence = 0;
+    std::atomic<uint32> seen[windowBits / 32];
+
+    // MIDI thread only
+    int64 highestReceived = -1;
+
+    std::atomic<int64> duplicates { 0 }, reordered { 0 };
+
+    CriticalSection resultsLock;
+    Array<Step> steps;
+    String verdict;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (StressTester)
+};
+
+//==============================================================================
+class StressPanel  : public ToolPanel
+{
+public:
+    StressPanel (StressTester& tester, MidiTestPorts& ports);
+
+    void resized() override;
+
+private:
+    String getReportText() override;
+    void update() override;
+    void startOrStop();
+
+    StressTester& tester;
+    Label patternLabel, rangeLabel, stepLabel;
+    ComboBox pattern;
+    Slider rateRange, stepSeconds;
+    TextButton startButton { "Start" };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (StressPanel)
+};
@@ -0,0 +1,609 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#include "SweepVerifier.h"
+#include "RealtimeThreads.h"
+
+namespace
+{
+    const double settleMs = 300.0;
+    const int maxRowsShown = 500;
+
+    inline bool isNoteItem (int item) noexcept      { return (item >> 18) != 0; }
+    inline int getItemKey (int item) noexcept       { return item >> 7; }
+    inline int getItemValue (int item) noexcept     { return item & 0x7f; }
+}
+
+//==============================================================================
+SweepVerifier::SweepVerifier (MidiTestPorts& p)
+    : Thread ("MIDI sweep verifier"), ports (p)
+{
+    for (auto& state : itemStates)
+        state = idle;
+}
+
+SweepVerifier::~SweepVerifier()
+{
+    stop();
+}
+
+BigInteger SweepVerifier::parseNumberList (const String& list)
+{
+    BigInteger numbers;
+
+    for (auto& token : StringArray::fromTokens (list, ",", ""))
+    {
+        auto first = token.upToFirstOccurrenceOf ("-", false, false).trim();
+        auto last = token.fromFirstOccurrenceOf ("-", false, false).trim();
+
+        if (first.isEmpty() || ! first.containsOnly ("0123456789") || ! last.containsOnly ("0123456789"))
+            continue;
+
+        auto from = jlimit (0, 127, first.getIntValue());
+        auto to = last.isEmpty() ? from : jlimit (0, 127, last.getIntValue());
+
+        for (auto n = jmin (from, to); n <= jmax (from, to); ++n)
+            numbers.setBit (n);
+    }
+
+    return numbers;
+}
+
+int SweepVerifier::getItem (bool isNote, int channel, int number, int value) noexcept
+{
+    return ((((isNote ? 1 : 0) * 16 + channel - 1) * 128 + number) * 128) + value;
+}
+
+MidiMessage SweepVerifier::createMessage (int item) noexcept
+{
+    auto value = getItemValue (item);
+    auto number = (item >> 7) & 0x7f;
+    auto channel = ((item >> 14) & 0x0f) + 1;
+
+    if (! isNoteItem (item))
+        return MidiMessage::controllerEvent (channel, number, value);
+
+    return value > 0 ? MidiMessage::noteOn (channel, number, (uint8) value)
+                     : MidiMessage::noteOff (channel, number, (uint8) 0);
+}
+
+//==============================================================================
+bool SweepVerifier::start (MidiDeviceListEntry::Ptr newOutput, MidiDeviceListEntry::Ptr newInput, const Settings& newSettings)
+{
+    stop();
+
+    if (newOutput == nullptr || ! newOutput->isOutputOpen()
+         || newInput == nullptr || ! newInput->isInputOpen())
+        return false;
+
+    settings = newSettings;
+    settings.firstChannel = jlimit (1, 16, settings.firstChannel);
+    settings.lastChannel = jlimit (settings.firstChannel, 16, settings.lastChannel);
+    settings.maxInFlight = jlimit (1, 4096, settings.maxInFlight);
+
+    auto controllerNumbers = parseNumberList (settings.controllers);
+    items.clear();
+
+    for (auto channel = settings.firstChannel; channel <= settings.lastChannel; ++channel)
+    {
+        if (settings.sweepControllers)
+            for (int number = 0; number < 128; ++number)
+                if (controllerNumbers[number])
+                    for (int value = 0; value < 128; ++value)
+                        items.push_back (getItem (false, channel, number, value));
+
+        // every velocity, then the release
+        if (settings.sweepNotes)
+            for (int number = 0; number < 128; ++number)
+                for (int value = 1; value <= 128; ++value)
+                    items.push_back (getItem (true, channel, number, value & 0x7f));
+    }
+
+    if (items.empty())
+        return false;
+
+    output = newOutput;
+    input = newInput;
+
+    for (auto& state : itemStates)
+        state = idle;
+
+    matchedCount = 0;
+    droppedArrivals = 0;
+    arrivalFifo.reset();
+
+    {
+        const ScopedLock sl (resultsLock);
+        mismatches.clear();
+        mismatchCount = 0;
+        progress = {};
+        progress.total = (int) items.size();
+        verdict.clear();
+    }
+
+    inputDevice = input.get();
+    ports.addListener (this);
+    ports.getClock().threadStarting (*this);
+    startThread (9);
+    return true;
+}
+
+void SweepVerifier::stop()
+{
+    stopThread (2000);
+    ports.removeListener (this);
+    inputDevice = nullptr;
+}
+
+SweepVerifier::Progress SweepVerifier::getProgress() const
+{
+    const ScopedLock sl (resultsLock);
+    return progress;
+}
+
+//==============================================================================
+void SweepVerifier::run()
+{
+    auto& clock = ports.getClock();
+    const VirtualClock::ScopedThread participant (clock, *this);
+    RealtimeThreads::applyToCurrentThread (RealtimeThreads::timingThread);
+
+    auto window = (size_t) settings.maxInFlight;
+    std::vector<int> ringItems (window);
+    std::vector<double> ringSentAt (window);
+    size_t ringStart = 0, inFlight = 0, next = 0;
+    auto startTime = clock.now();
+
+    auto updateProgress = [&]
+    {
+        const ScopedLock sl (resultsLock);
+        progress.sent = (int) next;
+        progress.matched = matchedCount.load();
+        progress.inFlight = (int) inFlight;
+        progress.mismatches = mismatchCount;
+        progress.elapsedSeconds = (clock.now() - startTime) * 0.001;
+    };
+
+    while (! threadShouldExit())
+    {
+        drainArrivals();
+        auto now = clock.now();
+
+        // retire the oldest sends once they're answered or overdue
+        while (inFlight > 0)
+        {
+            auto item = ringItems[ringStart];
+
+            if (itemStates[item].load() == pending)
+            {
+                if (now - ringSentAt[ringStart] < settings.timeoutMs)
+                    break;
+
+                uint8 expected = pending;
+
+                if (itemStates[item].compare_exchange_strong (expected, (uint8) timedOut))
+                    addMismatch (missing, item, -1);
+            }
+
+            ringStart = (ringStart + 1) % window;
+            --inFlight;
+        }
+
+        while (next < items.size() && inFlight < window)
+        {
+            auto item = items[next];
+
+            // marked before it goes, so an instant echo finds it waiting
+            itemStates[item] = pending;
+
+            if (! ports.getScheduler().send (*output, createMessage (item)))
+            {
+                itemStates[item] = idle;
+                break;
+            }
+
+            auto slot = (ringStart + inFlight) % window;
+            ringItems[slot] = item;
+            ringSentAt[slot] = now;
+            ++inFlight;
+            ++next;
+        }
+
+        updateProgress();
+
+        if (next == items.size() && inFlight == 0)
+            break;
+
+        clock.waitFor (*this, 1);
+    }
+
+    if (threadShouldExit())
+        return;
+
+    // anything arriving now is a straggler or a duplicate
+    auto settleUntil = clock.now() + settleMs;
+
+    while (clock.now() < settleUntil && ! threadShouldExit())
+    {
+        drainArrivals();
+        clock.waitFor (*this, 10);
+    }
+
+    drainArrivals();
+    pairAlteredValues();
+    updateProgress();
+
+    auto p = getProgress();
+    auto notBack = p.total - p.matched;
+    String result;
+
+    if (p.mismatches == 0)
+        result << "Passed: all " << p.total << " messages came back";
+    else if (notBack == 0)
+        result << "All " << p.total << " messages came back, along with " << p.mismatches << " unexpected ones";
+    else
+        result << "Failed: " << notBack << " of " << p.total << " messages did not come back intact";
+
+    if (droppedArrivals.load() > 0)
+        result << " (" << droppedArrivals.load() << " unexpected arrivals were not recorded)";
+
+    const ScopedLock sl (resultsLock);
+    verdict = result;
+}
+
+void SweepVerifier::drainArrivals()
+{
+    int start1, size1, start2, size2;
+    arrivalFifo.prepareToRead (arrivalFifo.getNumReady(), start1, size1, start2, size2);
+
+    auto handle = [this] (int arrival)
+    {
+        auto item = arrival & ((1 << problemShift) - 1);
+        auto problem = (Problem) (arrival >> problemShift);
+
+        if (problem == late)
+        {
+            // it was already written off as missing
+            const ScopedLock sl (resultsLock);
+
+            for (auto i = mismatches.size(); i > 0; --i)
+            {
+                auto& m = mismatches[i - 1];
+
+                if (m.problem == missing && m.expected == item)
+                {
+                    m.problem = late;
+                    m.received = item;
+                    return;
+                }
+            }
+        }
+
+        addMismatch (problem, problem == late ? item : -1, item);
+    };
+
+    for (int i = 0; i < size1; ++i)  handle (arrivals[start1 + i]);
+    for (int i = 0; i < size2; ++i)  handle (arrivals[start2 + i]);
+
+    arrivalFifo.finishedRead (size1 + size2);
+}
+
+void SweepVerifier::addMismatch (Problem problem, int expected, int received)
+{
+    const ScopedLock sl (resultsLock);
+    ++mismatchCount;
+
+    if (mismatches.size() < (size_t) maxMismatches)
+        mismatches.push_back ({ problem, expected, received });
+}
+
+void SweepVerifier::pairAlteredValues()
+{
+    const ScopedLock sl (resultsLock);
+
+    // unexpected arrivals, by controller or note, waiting for a missing value to explain them
+    std::map<int, std::vector<size_t>> strays;
+
+    for (size_t i = 0; i < mismatches.size(); ++i)
+        if (mismatches[i].problem == unexpected)
+            strays[getItemKey (mismatches[i].received)].push_back (i);
+
+    std::vector<bool> absorbed (mismatches.size(), false);
+
+    for (auto& m : mismatches)
+    {
+        if (m.problem != missing)
+            continue;
+
+        auto found = strays.find (getItemKey (m.expected));
+
+        if (found == strays.end() || found->second.empty())
+            continue;
+
+        auto stray = found->second.front();
+        found->second.erase (found->second.begin());
+
+        m.problem = altered;
+        m.received = mismatches[stray].received;
+        absorbed[stray] = true;
+        --mismatchCount;
+    }
+
+    size_t kept = 0;
+
+    for (size_t i = 0; i < mismatches.size(); ++i)
+        if (! absorbed[i])
+            mismatches[kept++] = mismatches[i];
+
+    mismatches.resize (kept);
+}
+
+//==============================================================================
+void SweepVerifier::midiReceived (MidiDeviceListEntry* source, const MidiMessage& message)
+{
+    // This is called on the MIDI thread
+    if (source != inputDevice.load() || message.getRawDataSize() != 3)
+        return;
+
+    auto* data = message.getRawData();
+    auto type = data[0] & 0xf0;
+    auto channel = (data[0] & 0x0f) + 1;
+    int item;
+
+    if (type == 0xb0)
+        item = getItem (false, channel, data[1], data[2]);
+    else if (type == 0x90)
+        item = getItem (true, channel, data[1], data[2]);
+    else if (type == 0x80)
+        item = getItem (true, channel, data[1], 0);
+    else
+        return;
+
+    auto& state = itemStates[item];
+    uint8 expected = pending;
+
+    if (state.compare_exchange_strong (expected, (uint8) matched))
+    {
+        ++matchedCount;
+        return;
+    }
+
+    Problem problem;
+
+    if (expected == timedOut && state.compare_exchange_strong (expected, (uint8) matched))
+        problem = late;
+    else if (expected == matched || expected == timedOut)
+        problem = duplicate;
+    else
+        problem = unexpected;
+
+    int start1, size1, start2, size2;
+    arrivalFifo.prepareToWrite (1, start1, size1, start2, size2);
+
+    if (size1 == 0)
+    {
+        ++droppedArrivals;
+        return;
+    }
+
+    arrivals[start1] = item | ((int) problem << problemShift);
+    arrivalFifo.finishedWrite (1);
+}
+
+//==============================================================================
+String SweepVerifier::describe (int item, int lastItem)
+{
+    if (item < 0)
+        return "-";
+
+    auto channel = ((item >> 14) & 0x0f) + 1;
+    auto number = (item >> 7) & 0x7f;
+    auto valueText = [] (int value, bool isNote) { return isNote && value == 0 ? String ("off") : String (value); };
+    auto isNote = isNoteItem (item);
+
+    String s;
+    s << "ch " << channel << (isNote ? " note " : " CC ") << number << (isNote ? " vel " : " = ")
+      << valueText (getItemValue (item), isNote);
+
+    if (lastItem != item)
+        s << ".." << valueText (getItemValue (lastItem), isNote);
+
+    return s;
+}
+
+String SweepVerifier::getVerdict() const
+{
+    const ScopedLock sl (resultsLock);
+    return verdict;
+}
+
+String SweepVerifier::getReport() const
+{
+    if (output == nullptr || input == nullptr)
+        return {};
+
+    std::vector<Mismatch> rows;
+    Progress p;
+    String result;
+
+    {
+        const ScopedLock sl (resultsLock);
+        rows = mismatches;
+        p = progress;
+        result = verdict;
+    }
+
+    String s;
+    s << "Sweep: " << output->deviceInfo.name << " -> " << input->deviceInfo.name << "\n"
+      << "Sent " << p.sent << " of " << p.total << ", matched " << p.matched << ", in flight " << p.inFlight
+      << ", " << String (p.elapsedSeconds, 1) << " s";
+
+    if (p.elapsedSeconds > 0.0)
+        s << " (" << String ((double) p.sent / p.elapsedSeconds, 0) << " msg/s)";
+
+    s << "\n";
+
+    if (result.isNotEmpty())
+        s << result << "\n";
+
+    if (rows.empty())
+        return s;
+
+    // fold runs of the same problem on consecutive values into one row
+    auto sortKey = [] (const Mismatch& m) { return m.expected >= 0 ? m.expected : m.received; };
+
+    std::stable_sort (rows.begin(), rows.end(), [&] (const Mismatch& a, const Mismatch& b)
+    {
+        return a.problem != b.problem ? a.problem < b.problem : sortKey (a) < sortKey (b);
+    });
+
+    static const char* const problemNames[] = { "missing", "altered", "late", "unexpected", "duplicate" };
+
+    s << "\n" << String ("Expected").paddedRight (' ', 28) << String ("Received").paddedRight (' ', 28) << "Problem\n";
+    int shown = 0;
+
+    for (size_t i = 0; i < rows.size() && shown < maxRowsShown; ++shown)
+    {
+        auto& first = rows[i];
+        auto end = i + 1;
+        auto foldable = first.expected < 0 || first.received < 0 || first.expected == first.received;
+
+        while (foldable && end < rows.size()
+                && rows[end].problem == first.problem
+                && (rows[end].expected < 0) == (first.expected < 0)
+                && (rows[end].received < 0) == (first.received < 0)
+                && getItemKey (sortKey (rows[end])) == getItemKey (sortKey (first))
+                && sortKey (rows[end]) == sortKey (rows[end - 1]) + 1)
+            ++end;
+
+        auto& last = rows[end - 1];
+        s << describe (first.expected, last.expected).paddedRight (' ', 28)
+          << describe (first.received, last.received).paddedRight (' ', 28)
+          << problemNames[first.problem];
+
+        if (end - i > 1)
+            s << " x" << (int) (end - i);
+
+        s << "\n";
+        i = end;
+    }
+
+    if (p.mismatches > 0 && shown == maxRowsShown)
+        s << "... and more; " << p.mismatches << " mismatches in all\n";
+
+    return s;
+}
+
+//==============================================================================
+SweepPanel::SweepPanel (SweepVerifier& v, MidiTestPorts& ports)
+    : ToolPanel (ports), verifier (v)
+{
+    channelLabel.setText ("Channels:", dontSendNotification);
+    addAndMakeVisible (channelLabel);
+    channels.setSliderStyle (Slider::TwoValueHorizontal);
+    channels.setRange (1.0, 16.0, 1.0);
+    channels.setMinAndMaxValues (1.0, 16.0, dontSendNotification);
+    channels.setPopupDisplayEnabled (true, true, this);
+    addAndMakeVisible (channels);
+
+    addAndMakeVisible (sweepControllers);
+    sweepControllers.setToggleState (true, dontSendNotification);
+    addAndMakeVisible (sweepNotes);
+    sweepNotes.setToggleState (true, dontSendNotification);
+
+    controllerLabel.setText ("CCs:", dontSendNotification);
+    addAndMakeVisible (controllerLabel);
+    controllers.setText (SweepVerifier::Settings().controllers, false);
+    addAndMakeVisible (controllers);
+
+    windowLabel.setText ("In flight:", dontSendNotification);
+    addAndMakeVisible (windowLabel);
+    window.setSliderStyle (Slider::LinearHorizontal);
+    window.setTextBoxStyle (Slider::TextBoxRight, false, 60, 20);
+    window.setRange (1.0, 1024.0, 1.0);
+    window.setSkewFactorFromMidPoint (64.0);
+    window.setValue (256.0, dontSendNotification);
+    addAndMakeVisible (window);
+
+    startButton.onClick = [this] { startOrStop(); };
+    addAndMakeVisible (startButton);
+}
+
+void SweepPanel::startOrStop()
+{
+    if (verifier.isRunning())
+    {
+        verifier.stop();
+    }
+    else
+    {
+        SweepVerifier::Settings settings;
+        settings.firstChannel = (int) channels.getMinValue();
+        settings.lastChannel = (int) channels.getMaxValue();
+        settings.controllers = controllers.getText();
+        settings.sweepControllers = sweepControllers.getToggleState();
+        settings.sweepNotes = sweepNotes.getToggleState();
+        settings.maxInFlight = (int) window.getValue();
+
+        if (! verifier.start (getOutput(), getInput(), settings))
+            showMessage ("Open an output and an input on the main page, connect them, "
+                         "and choose some controllers or notes to sweep.");
+    }
+
+    refresh();
+}
+
+void SweepPanel::update()
+{
+    startButton.setButtonText (verifier.isRunning() ? "Stop" : "Start");
+}
+
+String SweepPanel::getReportText()
+{
+    return verifier.getReport();
+}
+
+void SweepPanel::resized()
+{
+    auto area = layOutPair();
+
+    auto row = area.removeFromTop (rowHeight);
+    channelLabel.setBounds (row.removeFromLeft (70));
+    channels.setBounds (row.removeFromLeft (200).reduced (2));
+    sweepControllers.setBounds (row.removeFromLeft (100).reduced (2));
+    sweepNotes.setBounds (row.removeFromLeft (80).reduced (2));
+    startButton.setBounds (row.removeFromRight (80).reduced (2));
+    area.removeFromTop (4);
+
+    row = area.removeFromTop (rowHeight);
+    controllerLabel.setBounds (row.removeFromLeft (70));
+    controllers.setBounds (row.removeFromLeft (200).reduced (2));
+    windowLabel.setBounds (row.removeFromLeft (70));
+    window.setBounds (row.reduced (2));
+
+    area.removeFromTop (10);
+    report.setBounds (area);
+}
@@ -0,0 +1,179 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+#include "MidiTestPorts.h"
+#include "ToolPanel.h"
+
+//==============================================================================
+/**
+    Sends every value of every chosen controller, and every velocity of every
+    note, on a range of channels, and checks that each one comes back.
+
+    A message is its own identity: channel, number and value together pick one
+    slot in a table of states, so nothing extra has to travel with it. Up to a
+    window of messages are in flight at once; the MIDI thread ticks off
+    arrivals as they come in, and the worker retires the oldest send once it
+    has been answered or has timed out. A full sweep therefore runs at the
+    speed of the link rather than one round trip per message.
+
+    Notes are struck with velocities 1-127 and then released; the release may
+    come back as either form of note-off.
+
+    Anything that doesn't match goes into a mismatch table. A missing message
+    and an unexpected one for the same controller or note are reported
+    together as an altered value, and runs of consecutive values are folded
+    into ranges.
+*/
+class SweepVerifier  : private Thread,
+                       private MidiTestPorts::Listener
+{
+public:
+    struct Settings
+    {
+        int firstChannel = 1;
+        int lastChannel = 16;
+        String controllers { "0-119" };     // numbers and ranges, e.g. "16,17,20-23"
+        bool sweepControllers = true;
+        bool sweepNotes = true;
+        int maxInFlight = 256;
+        double timeoutMs = 2000.0;          // from when the message was queued
+    };
+
+    enum Problem
+    {
+        missing = 0,
+        altered,
+        late,
+        unexpected,
+        duplicate
+    };
+
+    struct Progress
+    {
+        int total = 0;
+        int sent = 0;
+        int matched = 0;
+        int inFlight = 0;
+        int mismatches = 0;
+        double elapsedSeconds = 0.0;
+    };
+
+    //==============================================================================
+    explicit SweepVerifier (MidiTestPorts& ports);
+    ~SweepVerifier();
+
+    /** Returns false if either device isn't open or there is nothing to sweep. */
+    bool start (MidiDeviceListEntry::Ptr output, MidiDeviceListEntry::Ptr input, const Settings& settings);
+    void stop();
+    bool isRunning() const                  { return isThreadRunning(); }
+
+    Progress getProgress() const;
+
+    /** The one-line outcome, once a run has finished; empty until then. */
+    String getVerdict() const;
+    String getReport() const;
+
+    /** Parses a list like "1,7,16-19" into a set of 7-bit numbers. */
+    static BigInteger parseNumberList (const String& list);
+
+private:
+    //==============================================================================
+    enum
+    {
+        numItems = 2 * 16 * 128 * 128,
+        arrivalQueueSize = 1024,
+        maxMismatches = 100000,
+        problemShift = 20
+    };
+
+    enum ItemState { idle = 0, pending, matched, timedOut };
+
+    struct Mismatch
+    {
+        Problem problem;
+        int expected = -1;
+        int received = -1;
+    };
+
+    void run() override;
+    void drainArrivals();
+    void addMismatch (Problem problem, int expected, int received);
+    void pairAlteredValues();
+
+    static int getItem (bool isNote, int channel, int number, int value) noexcept;
+    static MidiMessage createMessage (int item) noexcept;
+    static String describe (int item, int lastItem);
+
+    void midiReceived (MidiDeviceListEntry* source, const MidiMessage& message) override;
+
+    MidiTestPorts& ports;
+    MidiDeviceListEntry::Ptr output, input;
+    std::atomic<MidiDeviceListEntry*> inputDevice { nullptr };
+    Settings settings;
+    std::vector<int> items;
+
+    std::atomic<uint8> itemStates[numItems];
+    std::atomic<int> matchedCount { 0 };
+
+    // surprises travel from the MIDI thread to the worker through here
+    AbstractFifo arrivalFifo { arrivalQueueSize };
+    int arrivals[arrivalQueueSize];
+    std::atomic<int> droppedArrivals { 0 };
+
+    CriticalSection resultsLock;
+    std::vector<Mismatch> mismatches;
+    int mismatchCount = 0;
+    Progress progress;
+    String verdict;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SweepVerifier)
+};
+
+//==============================================================================
+class SweepPanel  : public ToolPanel
+{
+public:
+    SweepPanel (SweepVerifier& verifier, MidiTestPorts& ports);
+
+    void resized() override;
+
+private:
+    String getReportText() override;
+    void update() override;
+    void startOrStop();
+
+    SweepVerifier& verifier;
+    Label channelLabel, controllerLabel, windowLabel;
+    Slider channels, window;
+    TextEditor controllers;
+    ToggleButton sweepControllers { "Controllers" }, sweepNotes { "Notes" };
+    TextButton startButton { "Start" };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SweepPanel)
+};
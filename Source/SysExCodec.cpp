@@ -0,0 +1,543 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#include "SysExCodec.h"
+
+#if JUCE_INTEL
+ #include <emmintrin.h>
+ #include <immintrin.h>
+
+ #if JUCE_GCC || JUCE_CLANG
+  #define BA_TARGET_SSE2 __attribute__ ((target ("sse2")))
+  #define BA_TARGET_AVX2 __attribute__ ((target ("avx2")))
+ #else
+  #define BA_TARGET_SSE2
+  #define BA_TARGET_AVX2
+ #endif
+#endif
+
+namespace
+{
+    //==============================================================================
+    void packScalar (const uint8* source, int numBytes, uint8* dest) noexcept
+    {
+        while (numBytes > 0)
+        {
+            auto groupSize = jmin (7, numBytes);
+            uint8 topBits = 0;
+
+            for (int i = 0; i < groupSize; ++i)
+            {
+                topBits |= (uint8) ((source[i] >> 7) << i);
+                dest[i + 1] = source[i] & 0x7f;
+            }
+
+            dest[0] = topBits;
+            source += groupSize;
+            dest += groupSize + 1;
+            numBytes -= groupSize;
+        }
+    }
+
+    uint8 unpackScalar (const uint8* source, int numPacked, uint8* dest) noexcept
+    {
+        uint8 allBits = 0;
+
+        while (numPacked > 1)
+        {
+            auto groupSize = jmin (7, numPacked - 1);
+            auto topBits = source[0];
+            allBits |= topBits;
+
+            for (int i = 0; i < groupSize; ++i)
+            {
+                allBits |= source[i + 1];
+                dest[i] = (uint8) (source[i + 1] | (((topBits >> i) & 1) << 7));
+            }
+
+            source += groupSize + 1;
+            dest += groupSize;
+            numPacked -= groupSize + 1;
+        }
+
+        return allBits;
+    }
+
+    //==============================================================================
+   #if JUCE_INTEL
+    /*  The vector kernels work on whole groups and return how much of the source
+        they got through; the scalar code finishes the rest. Each store spills a
+        byte or two past its groups, into space a later group always overwrites,
+        which is why the loops stop short of the end.
+    */
+    struct TopBitTable
+    {
+        TopBitTable()
+        {
+            // 0x80 in byte n of the entry for every bit n set in a group's leading byte
+            for (int h = 0; h < 128; ++h)
+            {
+                bits[h] = 0;
+
+                for (int i = 0; i < 7; ++i)
+                    if ((h >> i) & 1)
+                        bits[h] |= (uint64) 0x80 << (8 * i);
+            }
+        }
+
+        uint64 bits[128];
+    };
+
+    const uint64* getTopBits() noexcept
+    {
+        static const TopBitTable table;
+        return table.bits;
+    }
+
+    BA_TARGET_SSE2 int packSSE2 (const uint8* source, int numBytes, uint8* dest) noexcept
+    {
+        const auto low7 = _mm_set1_epi8 (0x7f);
+        const auto firstGroup  = _mm_setr_epi8 (-1, -1, -1, -1, -1, -1, -1, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+        const auto secondGroup = _mm_setr_epi8 (0, 0, 0, 0, 0, 0, 0, -1, -1, -1, -1, -1, -1, -1, 0, 0);
+        int done = 0;
+
+        // two groups at a time: 14 bytes in, 16 out
+        while (done + 16 <= numBytes)
+        {
+            auto v = _mm_loadu_si128 ((const __m128i*) (source + done));
+            auto topBits = _mm_movemask_epi8 (v);
+            v = _mm_and_si128 (v, low7);
+
+            auto spread = _mm_or_si128 (_mm_and_si128 (v, firstGroup),
+                                        _mm_slli_si128 (_mm_and_si128 (v, secondGroup), 1));
+
+            auto* out = dest + done / 7 * 8;
+            _mm_storeu_si128 ((__m128i*) (out + 1), spread);
+            out[0] = (uint8) (topBits & 0x7f);
+            out[8] = (uint8) ((topBits >> 7) & 0x7f);
+            done += 14;
+        }
+
+        return done;
+    }
+
+    BA_TARGET_SSE2 int unpackSSE2 (const uint8* source, int numPacked, uint8* dest, uint8& allBits) noexcept
+    {
+        const auto* topBitTable = getTopBits();
+        const auto firstGroup  = _mm_setr_epi8 (-1, -1, -1, -1, -1, -1, -1, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+        const auto secondGroup = _mm_setr_epi8 (0, 0, 0, 0, 0, 0, 0, 0, -1, -1, -1, -1, -1, -1, -1, 0);
+        auto seen = _mm_setzero_si128();
+        int done = 0;
+
+        // two groups at a time: 16 bytes in, 14 out
+        while (done + 24 <= numPacked)
+        {
+            auto* in = source + done;
+            auto v = _mm_loadu_si128 ((const __m128i*) (in + 1));
+            seen = _mm_or_si128 (seen, v);
+            allBits |= in[0];
+
+            v = _mm_or_si128 (v, _mm_set_epi64x ((long long) topBitTable[in[8] & 0x7f],
+                                                 (long long) topBitTable[in[0] & 0x7f]));
+
+            // close the gap left by the second group's leading byte
+            auto joined = _mm_or_si128 (_mm_and_si128 (v, firstGroup),
+                                        _mm_srli_si128 (_mm_and_si128 (v, secondGroup), 1));
+
+            _mm_storeu_si128 ((__m128i*) (dest + done / 8 * 7), joined);
+            done += 16;
+        }
+
+        if (_mm_movemask_epi8 (seen) != 0)
+            allBits |= 0x80;
+
+        return done;
+    }
+
+    BA_TARGET_SSE2 uint32 sumSSE2 (const uint8* data, int numBytes, int& done) noexcept
+    {
+        const auto zero = _mm_setzero_si128();
+        auto sums = zero;
+
+        for (done = 0; done + 16 <= numBytes; done += 16)
+            sums = _mm_add_epi64 (sums, _mm_sad_epu8 (_mm_loadu_si128 ((const __m128i*) (data + done)), zero));
+
+        // only the low bits matter to a 7-bit checksum
+        return (uint32) _mm_cvtsi128_si32 (sums) + (uint32) _mm_cvtsi128_si32 (_mm_unpackhi_epi64 (sums, sums));
+    }
+
+    BA_TARGET_SSE2 uint8 foldXorSSE2 (__m128i x) noexcept
+    {
+        x = _mm_xor_si128 (x, _mm_srli_si128 (x, 8));
+        x = _mm_xor_si128 (x, _mm_srli_si128 (x, 4));
+        x = _mm_xor_si128 (x, _mm_srli_si128 (x, 2));
+        x = _mm_xor_si128 (x, _mm_srli_si128 (x, 1));
+        return (uint8) _mm_cvtsi128_si32 (x);
+    }
+
+    BA_TARGET_SSE2 uint8 xorSSE2 (const uint8* data, int numBytes, int& done) noexcept
+    {
+        auto x = _mm_setzero_si128();
+
+        for (done = 0; done + 16 <= numBytes; done += 16)
+            x = _mm_xor_si128 (x, _mm_loadu_si128 ((const __m128i*) (data + done)));
+
+        return foldXorSSE2 (x);
+    }
+
+    //==============================================================================
+    BA_TARGET_AVX2 int packAVX2 (const uint8* source, int numBytes, uint8* dest) noexcept
+    {
+        const auto low7 = _mm256_set1_epi8 (0x7f);
+        const auto firstGroups  = _mm256_setr_epi8 (-1, -1, -1, -1, -1, -1, -1, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+                                                    -1, -1, -1, -1, -1, -1, -1, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+        const auto secondGroups = _mm256_setr_epi8 (0, 0, 0, 0, 0, 0, 0, -1, -1, -1, -1, -1, -1, -1, 0, 0,
+                                                    0, 0, 0, 0, 0, 0, 0, -1, -1, -1, -1, -1, -1, -1, 0, 0);
+        int done = 0;
+
+        // four groups at a time, two in each 128-bit lane: 28 bytes in, 32 out
+        while (done + 30 <= numBytes)
+        {
+            auto v = _mm256_inserti128_si256 (_mm256_castsi128_si256 (_mm_loadu_si128 ((const __m128i*) (source + done))),
+                                              _mm_loadu_si128 ((const __m128i*) (source + done + 14)), 1);
+            auto topBits = (uint32) _mm256_movemask_epi8 (v);
+            v = _mm256_and_si256 (v, low7);
+
+            auto spread = _mm256_or_si256 (_mm256_and_si256 (v, firstGroups),
+                                           _mm256_slli_si256 (_mm256_and_si256 (v, secondGroups), 1));
+
+            auto* out = dest + done / 7 * 8;
+            _mm_storeu_si128 ((__m128i*) (out + 1),  _mm256_castsi256_si128 (spread));
+            _mm_storeu_si128 ((__m128i*) (out + 17), _mm256_extracti128_si256 (spread, 1));
+            out[0]  = (uint8) (topBits & 0x7f);
+            out[8]  = (uint8) ((topBits >> 7) & 0x7f);
+            out[16] = (uint8) ((topBits >> 16) & 0x7f);
+            out[24] = (uint8) ((topBits >> 23) & 0x7f);
+            done += 28;
+        }
+
+        return done + packSSE2 (source + done, numBytes - done, dest + done / 7 * 8);
+    }
+
+    BA_TARGET_AVX2 int unpackAVX2 (const uint8* source, int numPacked, uint8* dest, uint8& allBits) noexcept
+    {
+        const auto* topBitTable = getTopBits();
+        const auto firstGroups  = _mm256_setr_epi8 (-1, -1, -1, -1, -1, -1, -1, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+                                                    -1, -1, -1, -1, -1, -1, -1, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+        const auto secondGroups = _mm256_setr_epi8 (0, 0, 0, 0, 0, 0, 0, 0, -1, -1, -1, -1, -1, -1, -1, 0,
+                                                    0, 0, 0, 0, 0, 0, 0, 0, -1, -1, -1, -1, -1, -1, -1, 0);
+        auto seen = _mm256_setzero_si256();
+        int done = 0;
+
+        // four groups at a time: 32 bytes in, 28 out
+        while (done + 40 <= numPacked)
+        {
+            auto* in = source + done;
+            auto v = _mm256_loadu_si256 ((const __m256i*) (in + 1));
+            seen = _mm256_or_si256 (seen, v);
+            allBits |= in[0];
+
+            v = _mm256_or_si256 (v, _mm256_set_epi64x ((long long) topBitTable[in[24] & 0x7f],
+                                                       (long long) topBitTable[in[16] & 0x7f],
+                                                       (long long) topBitTable[in[8] & 0x7f],
+                                                       (long long) topBitTable[in[0] & 0x7f]));
+
+            auto joined = _mm256_or_si256 (_mm256_and_si256 (v, firstGroups),
+                                           _mm256_srli_si256 (_mm256_and_si256 (v, secondGroups), 1));
+
+            auto* out = dest + done / 8 * 7;
+            _mm_storeu_si128 ((__m128i*) out, _mm256_castsi256_si128 (joined));
+            _mm_storeu_si128 ((__m128i*) (out + 14), _mm256_extracti128_si256 (joined, 1));
+            done += 32;
+        }
+
+        if (_mm256_movemask_epi8 (seen) != 0)
+            allBits |= 0x80;
+
+        return done + unpackSSE2 (source + done, numPacked - done, dest + done / 8 * 7, allBits);
+    }
+
+    BA_TARGET_AVX2 uint32 sumAVX2 (const uint8* data, int numBytes, int& done) noexcept
+    {
+        const auto zero = _mm256_setzero_si256();
+        auto sums = zero;
+
+        for (done = 0; done + 32 <= numBytes; done += 32)
+            sums = _mm256_add_epi64 (sums, _mm256_sad_epu8 (_mm256_loadu_si256 ((const __m256i*) (data + done)), zero));
+
+        auto halves = _mm_add_epi64 (_mm256_castsi256_si128 (sums), _mm256_extracti128_si256 (sums, 1));
+        return (uint32) _mm_cvtsi128_si32 (halves) + (uint32) _mm_cvtsi128_si32 (_mm_unpackhi_epi64 (halves, halves));
+    }
+
+    BA_TARGET_AVX2 uint8 xorAVX2 (const uint8* data, int numBytes, int& done) noexcept
+    {
+        auto x = _mm256_setzero_si256();
+
+        for (done = 0; done + 32 <= numBytes; done += 32)
+            x = _mm256_xor_si256 (x, _mm256_loadu_si256 ((const __m256i*) (data + done)));
+
+        return foldXorSSE2 (_mm_xor_si128 (_mm256_castsi256_si128 (x), _mm256_extracti128_si256 (x, 1)));
+    }
+   #endif
+
+    //==============================================================================
+    std::atomic<int> currentKernel { -1 };
+
+    SysExCodec::Kernel getBestKernel() noexcept
+    {
+        if (SysExCodec::isKernelAvailable (SysExCodec::avx2Kernel))  return SysExCodec::avx2Kernel;
+        if (SysExCodec::isKernelAvailable (SysExCodec::sse2Kernel))  return SysExCodec::sse2Kernel;
+
+        return SysExCodec::scalarKernel;
+    }
+
+    template <typename Function>
+    double measureGigabytesPerSecond (int64 bytesPerCall, Function&& function)
+    {
+        auto start = Time::getMillisecondCounterHiRes();
+        double elapsedMs;
+        int64 calls = 0;
+
+        do
+        {
+            function();
+            ++calls;
+            elapsedMs = Time::getMillisecondCounterHiRes() - start;
+        }
+        while (elapsedMs < 100.0);
+
+        return (double) (bytesPerCall * calls) / (elapsedMs * 1.0e6);
+    }
+
+    //==============================================================================
+    // The work behind the public functions, with the kernel given, so the
+    // benchmark can run each one without changing the one in use
+    void packWith (SysExCodec::Kernel kernel, const uint8* source, int numBytes, uint8* dest) noexcept
+    {
+        int done = 0;
+
+       #if JUCE_INTEL
+        switch (kernel)
+        {
+            case SysExCodec::avx2Kernel:    done = packAVX2 (source, numBytes, dest); break;
+            case SysExCodec::sse2Kernel:    done = packSSE2 (source, numBytes, dest); break;
+            case SysExCodec::scalarKernel:
+            case SysExCodec::numKernels:
+            default:                        break;
+        }
+       #endif
+
+        packScalar (source + done, numBytes - done, dest + done / 7 * 8);
+    }
+
+    bool unpackWith (SysExCodec::Kernel kernel, const uint8* source, int numPacked, uint8* dest) noexcept
+    {
+        uint8 allBits = 0;
+        int done = 0;
+
+       #if JUCE_INTEL
+        switch (kernel)
+        {
+            case SysExCodec::avx2Kernel:    done = unpackAVX2 (source, numPacked, dest, allBits); break;
+            case SysExCodec::sse2Kernel:    done = unpackSSE2 (source, numPacked, dest, allBits); break;
+            case SysExCodec::scalarKernel:
+            case SysExCodec::numKernels:
+            default:                        break;
+        }
+       #endif
+
+        allBits |= unpackScalar (source + done, numPacked - done, dest + done / 8 * 7);
+        return (allBits & 0x80) == 0;
+    }
+
+    uint8 rolandChecksumWith (SysExCodec::Kernel kernel, const uint8* data, int numBytes) noexcept
+    {
+        uint32 sum = 0;
+        int done = 0;
+
+       #if JUCE_INTEL
+        switch (kernel)
+        {
+            case SysExCodec::avx2Kernel:    sum = sumAVX2 (data, numBytes, done); break;
+            case SysExCodec::sse2Kernel:    sum = sumSSE2 (data, numBytes, done); break;
+            case SysExCodec::scalarKernel:
+            case SysExCodec::numKernels:
+            default:                        break;
+        }
+       #endif
+
+        for (int i = done; i < numBytes; ++i)
+            sum += data[i];
+
+        return (uint8) ((128 - (sum & 0x7f)) & 0x7f);
+    }
+
+    uint8 xorChecksumWith (SysExCodec::Kernel kernel, const uint8* data, int numBytes) noexcept
+    {
+        uint8 result = 0;
+        int done = 0;
+
+       #if JUCE_INTEL
+        switch (kernel)
+        {
+            case SysExCodec::avx2Kernel:    result = xorAVX2 (data, numBytes, done); break;
+            case SysExCodec::sse2Kernel:    result = xorSSE2 (data, numBytes, done); break;
+            case SysExCodec::scalarKernel:
+            case SysExCodec::numKernels:
+            default:                        break;
+        }
+       #endif
+
+        for (int i = done; i < numBytes; ++i)
+            result ^= data[i];
+
+        return result & 0x7f;
+    }
+}
+
+//==============================================================================
+bool SysExCodec::isKernelAvailable (Kernel kernel) noexcept
+{
+    switch (kernel)
+    {
+        case scalarKernel:  return true;
+       #if JUCE_INTEL
+        case sse2Kernel:    return SystemStats::hasSSE2();
+        case avx2Kernel:    return SystemStats::hasAVX2();
+       #endif
+        default:            return false;
+    }
+}
+
+SysExCodec::Kernel SysExCodec::getKernel() noexcept
+{
+    auto kernel = currentKernel.load();
+
+    if (kernel < 0)
+    {
+        kernel = (int) getBestKernel();
+        currentKernel = kernel;
+    }
+
+    return (Kernel) kernel;
+}
+
+void SysExCodec::setKernel (Kernel kernel) noexcept
+{
+    currentKernel = (int) (isKernelAvailable (kernel) ? kernel : scalarKernel);
+}
+
+String SysExCodec::getKernelName (Kernel kernel)
+{
+    switch (kernel)
+    {
+        case scalarKernel:  return "Scalar";
+        case sse2Kernel:    return "SSE2";
+        case avx2Kernel:    return "AVX2";
+        case numKernels:
+        default:            return {};
+    }
+}
+
+//==============================================================================
+void SysExCodec::pack (const uint8* source, int numBytes, uint8* dest) noexcept
+{
+    packWith (getKernel(), source, numBytes, dest);
+}
+
+bool SysExCodec::unpack (const uint8* source, int numPacked, uint8* dest) noexcept
+{
+    return unpackWith (getKernel(), source, numPacked, dest);
+}
+
+uint8 SysExCodec::getRolandChecksum (const uint8* data, int numBytes) noexcept
+{
+    return rolandChecksumWith (getKernel(), data, numBytes);
+}
+
+uint8 SysExCodec::getXorChecksum (const uint8* data, int numBytes) noexcept
+{
+    return xorChecksumWith (getKernel(), data, numBytes);
+}
+
+//==============================================================================
+String SysExCodec::runBenchmark (int numBytes)
+{
+    numBytes = jmax (1024, numBytes);
+    auto numPacked = getPackedSize (numBytes);
+
+    HeapBlock<uint8> source ((size_t) numBytes), reference ((size_t) numPacked),
+                     packed ((size_t) numPacked), unpacked ((size_t) numBytes);
+
+    Random random (1);
+
+    for (int i = 0; i < numBytes; ++i)
+        source[i] = (uint8) random.nextInt (256);
+
+    // kernels are called directly, so live transfers keep the one in use
+    packWith (scalarKernel, source, numBytes, reference);
+    auto referenceRoland = rolandChecksumWith (scalarKernel, reference, numPacked);
+    auto referenceXor = xorChecksumWith (scalarKernel, source, numBytes);
+    std::atomic<int> sink { 0 };
+
+    String report;
+    report << "SysEx codec, " << String (numBytes / 1024) << " KB of data, GB/s of unpacked bytes\n\n"
+           << String ("kernel").paddedRight (' ', 8) << String ("pack").paddedLeft (' ', 9)
+           << String ("unpack").paddedLeft (' ', 9) << String ("roland").paddedLeft (' ', 9)
+           << String ("xor").paddedLeft (' ', 9) << "\n";
+
+    for (int k = 0; k < numKernels; ++k)
+    {
+        auto kernel = (Kernel) k;
+
+        if (! isKernelAvailable (kernel))
+            continue;
+
+        // every kernel has to agree with the scalar code before its speed means anything
+        zeromem (packed, (size_t) numPacked);
+        zeromem (unpacked, (size_t) numBytes);
+        packWith (kernel, source, numBytes, packed);
+
+        auto verified = memcmp (packed, reference, (size_t) numPacked) == 0
+                         && unpackWith (kernel, packed, numPacked, unpacked)
+                         && memcmp (unpacked, source, (size_t) numBytes) == 0
+                         && rolandChecksumWith (kernel, packed, numPacked) == referenceRoland
+                         && xorChecksumWith (kernel, source, numBytes) == referenceXor;
+
+        auto packRate   = measureGigabytesPerSecond (numBytes, [&] { packWith (kernel, source, numBytes, packed); });
+        auto unpackRate = measureGigabytesPerSecond (numBytes, [&] { unpackWith (kernel, packed, numPacked, unpacked); });
+        auto rolandRate = measureGigabytesPerSecond (numBytes, [&] { sink += rolandChecksumWith (kernel, source, numBytes); });
+        auto xorRate    = measureGigabytesPerSecond (numBytes, [&] { sink += xorChecksumWith (kernel, source, numBytes); });
+
+        report << getKernelName (kernel).paddedRight (' ', 8)
+               << String (packRate, 2).paddedLeft (' ', 9) << String (unpackRate, 2).paddedLeft (' ', 9)
+               << String (rolandRate, 2).paddedLeft (' ', 9) << String (xorRate, 2).paddedLeft (' ', 9)
+               << (verified ? "" : "   MISMATCH") << "\n";
+    }
+
+    report << "\nIn use: " << getKernelName (getKernel()) << "\n";
+    return report;
+}
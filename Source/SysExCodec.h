@@ -0,0 +1,91 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+
+//==============================================================================
+/**
+    Conversions between 8-bit data and the 7-bit bytes SysEx can carry.
+
+    Packing follows the common scheme: every group of seven bytes becomes
+    eight, a leading byte holding their top bits (bit n for byte n) followed by
+    the seven bytes with their top bit cleared. A short last group packs the
+    same way with fewer bytes.
+
+    On x86 the work is done by SSE2 or AVX2 kernels, picked once from what the
+    CPU supports; elsewhere, and for the short tails, by plain scalar code. All
+    kernels give identical results.
+*/
+namespace SysExCodec
+{
+    inline int getPackedSize (int numBytes) noexcept        { return numBytes + (numBytes + 6) / 7; }
+
+    inline int getUnpackedSize (int numPacked) noexcept
+    {
+        auto remainder = numPacked % 8;
+        return (numPacked / 8) * 7 + (remainder > 0 ? remainder - 1 : 0);
+    }
+
+    /** Writes getPackedSize (numBytes) bytes to dest. */
+    void pack (const uint8* source, int numBytes, uint8* dest) noexcept;
+
+    /** Writes getUnpackedSize (numPacked) bytes to dest. Returns false if any
+        source byte had its top bit set.
+    */
+    bool unpack (const uint8* source, int numPacked, uint8* dest) noexcept;
+
+    /** The value that brings the 7-bit sum of the data to zero, as Roland uses. */
+    uint8 getRolandChecksum (const uint8* data, int numBytes) noexcept;
+
+    /** All bytes XORed together, masked to 7 bits. */
+    uint8 getXorChecksum (const uint8* data, int numBytes) noexcept;
+
+    //==============================================================================
+    enum Kernel
+    {
+        scalarKernel = 0,
+        sse2Kernel,
+        avx2Kernel,
+        numKernels
+    };
+
+    bool isKernelAvailable (Kernel kernel) noexcept;
+    Kernel getKernel() noexcept;
+
+    /** Forces a kernel, for comparisons. Falls back to scalar if the CPU can't run it. */
+    void setKernel (Kernel kernel) noexcept;
+
+    String getKernelName (Kernel kernel);
+
+    /** Times every available kernel over a buffer of the given size and checks
+        their output against the scalar code. The kernel in use is left alone,
+        so it is safe while transfers run. Takes a second or so; don't call it
+        on the message thread.
+    */
+    String runBenchmark (int numBytes);
+}
@@ -0,0 +1,98 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#include "ToolPanel.h"
+
+//==============================================================================
+ToolPanel::ToolPanel (int refreshHz)
+{
+    report.setMultiLine (true);
+    report.setReadOnly (true);
+    report.setCaretVisible (false);
+    report.setFont (Font (Font::getDefaultMonospacedFontName(), 13.0f, Font::plain));
+    addAndMakeVisible (report);
+
+    startTimerHz (refreshHz);
+}
+
+ToolPanel::ToolPanel (MidiTestPorts& ports, int refreshHz)
+    : ToolPanel (refreshHz)
+{
+    pair.reset (new MidiPairSelector (ports));
+    addAndMakeVisible (*pair);
+}
+
+ToolPanel::~ToolPanel()
+{
+    stopTimer();
+}
+
+void ToolPanel::refresh()
+{
+    update();
+    auto text = getReportText();
+
+    if (text.isNotEmpty() && text != report.getText())
+        report.setText (text, false);
+}
+
+void ToolPanel::showMessage (const String& message)
+{
+    report.setText (message, false);
+}
+
+MidiDeviceListEntry::Ptr ToolPanel::getOutput() const
+{
+    return pair != nullptr ? pair->getOutput() : nullptr;
+}
+
+MidiDeviceListEntry::Ptr ToolPanel::getInput() const
+{
+    return pair != nullptr ? pair->getInput() : nullptr;
+}
+
+Rectangle<int> ToolPanel::layOutPair()
+{
+    auto area = getLocalBounds().reduced (10);
+
+    if (pair != nullptr)
+    {
+        pair->setBounds (area.removeFromTop (rowHeight));
+        area.removeFromTop (4);
+    }
+
+    return area;
+}
+
+String ToolPanel::openFirst (const String& what)
+{
+    return "Open " + what + " on the main page first.";
+}
+
+void ToolPanel::timerCallback()
+{
+    refresh();
+}
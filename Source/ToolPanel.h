@@ -0,0 +1,81 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+#include "MidiTestPorts.h"
+
+//==============================================================================
+/**
+    What every test tool's panel shares: the row choosing an output and an
+    input, when the tool sends or listens, and a read-only report below the
+    controls that follows the engine's getReport() a few times a second.
+
+    A panel gives the text through getReportText() and brings its buttons up
+    to date in update(). An empty report leaves the last text standing, so a
+    message put up with showMessage() stays until the engine has something
+    to say.
+*/
+class ToolPanel  : public Component,
+                   private Timer
+{
+public:
+    ~ToolPanel();
+
+protected:
+    explicit ToolPanel (int refreshHz = 4);
+    ToolPanel (MidiTestPorts& ports, int refreshHz = 4);
+
+    virtual String getReportText() = 0;
+    virtual void update()                   {}
+
+    /** Updates straight away, after a button has changed what's running. */
+    void refresh();
+    void showMessage (const String& message);
+
+    MidiDeviceListEntry::Ptr getOutput() const;
+    MidiDeviceListEntry::Ptr getInput() const;
+
+    /** Lays out the device row, if there is one, and returns the rest of the
+        panel inside its margin.
+    */
+    Rectangle<int> layOutPair();
+
+    /** "Open <what> on the main page first." */
+    static String openFirst (const String& what);
+
+    enum { rowHeight = 28 };
+
+    TextEditor report;
+
+private:
+    void timerCallback() override;
+
+    std::unique_ptr<MidiPairSelector> pair;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ToolPanel)
+};
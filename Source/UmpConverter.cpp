@@ -0,0 +1,366 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#include "UmpConverter.h"
+
+namespace
+{
+    enum SysExStatus { completeSysEx = 0, startSysEx, continueSysEx, endSysEx };
+
+    // MIDI 2.0 channel voice statuses with no MIDI 1.0 counterpart of their own
+    const int registeredController = 0x2;
+    const int assignableController = 0x3;
+
+    int getSysExLength (const uint8* data, int size) noexcept
+    {
+        // the packets carry what's between F0 and F7
+        return size - 1 - (data[size - 1] == 0xf7 ? 1 : 0);
+    }
+
+    int getNumPackets (const uint8* data, int size) noexcept
+    {
+        return size > 0 && data[0] == 0xf0 ? jmax (1, (getSysExLength (data, size) + 5) / 6) : 1;
+    }
+}
+
+//==============================================================================
+String UmpEvent::toHexString() const
+{
+    auto s = String::toHexString ((int) words[0]).paddedLeft ('0', 8);
+
+    if (getNumWords() > 1)
+        s << " " << String::toHexString ((int) words[1]).paddedLeft ('0', 8);
+
+    return s.toUpperCase();
+}
+
+//==============================================================================
+UmpConverter::UmpConverter (Protocol p, int group)
+    : protocol (p), groupBits ((uint32) (group & 0xf) << 24)
+{
+}
+
+void UmpConverter::reset()
+{
+    for (auto& data : sysExData)
+        data.clearQuick();
+}
+
+uint32 UmpConverter::scaleUp (uint32 value, int sourceBits, int destBits) noexcept
+{
+    auto scaleBits = destBits - sourceBits;
+    auto shifted = value << scaleBits;
+    auto centre = 1u << (sourceBits - 1);
+
+    if (value <= centre)
+        return shifted;
+
+    // above the centre, the bits below the top one are repeated to fill the gap
+    auto repeatBits = sourceBits - 1;
+    auto repeat = value & ((1u << repeatBits) - 1);
+
+    if (scaleBits > repeatBits)
+        repeat <<= scaleBits - repeatBits;
+    else
+        repeat >>= repeatBits - scaleBits;
+
+    while (repeat != 0)
+    {
+        shifted |= repeat;
+        repeat >>= repeatBits;
+    }
+
+    return shifted;
+}
+
+uint32 UmpConverter::scaleDown (uint32 value, int sourceBits, int destBits) noexcept
+{
+    return value >> (sourceBits - destBits);
+}
+
+//==============================================================================
+int UmpConverter::toUmp (const uint8* data, int size, double timeStamp, UmpEvent* dest, int maxEvents) const noexcept
+{
+    if (size <= 0 || maxEvents <= 0)
+        return 0;
+
+    auto byte = [data, size] (int i) { return i < size ? (uint32) (data[i] & 0x7f) : 0u; };
+    auto status = (uint32) data[0];
+
+    if (status == 0xf0)
+    {
+        auto length = getSysExLength (data, size);
+        auto numPackets = getNumPackets (data, size);
+
+        if (numPackets > maxEvents)
+            return 0;
+
+        for (int i = 0; i < numPackets; ++i)
+        {
+            auto first = 1 + i * 6;
+            auto count = jmin (6, length - i * 6);
+            auto sysExStatus = numPackets == 1 ? completeSysEx
+                             : i == 0 ? startSysEx
+                             : i == numPackets - 1 ? endSysEx : continueSysEx;
+
+            uint8 chunk[6] = {};
+
+            for (int j = 0; j < count; ++j)
+                chunk[j] = data[first + j];
+
+            auto& e = dest[i];
+            e.words[0] = ((uint32) UmpEvent::sysEx7 << 28) | groupBits | ((uint32) sysExStatus << 20) | ((uint32) count << 16)
+                           | ((uint32) chunk[0] << 8) | chunk[1];
+            e.words[1] = ((uint32) chunk[2] << 24) | ((uint32) chunk[3] << 16) | ((uint32) chunk[4] << 8) | chunk[5];
+            e.timeStamp = timeStamp;
+        }
+
+        return numPackets;
+    }
+
+    auto& e = *dest;
+    e.words[1] = 0;
+    e.timeStamp = timeStamp;
+
+    if (status >= 0xf0)
+    {
+        // F4, F5, F7 and FD are undefined or only mean something inside SysEx
+        if (status == 0xf4 || status == 0xf5 || status == 0xf7 || status == 0xfd)
+            return 0;
+
+        e.words[0] = ((uint32) UmpEvent::system << 28) | groupBits | (status << 16) | (byte (1) << 8) | byte (2);
+        return 1;
+    }
+
+    if (status < 0x80)
+        return 0;
+
+    if (protocol == midi1Protocol)
+    {
+        e.words[0] = ((uint32) UmpEvent::midi1ChannelVoice << 28) | groupBits | (status << 16) | (byte (1) << 8) | byte (2);
+        return 1;
+    }
+
+    auto type = status >> 4;
+    auto channel = status & 0xf;
+
+    if (type == 0x9 && byte (2) == 0)
+        type = 0x8;
+
+    e.words[0] = ((uint32) UmpEvent::midi2ChannelVoice << 28) | groupBits | (type << 20) | (channel << 16);
+
+    switch (type)
+    {
+        case 0x8:
+            e.words[0] |= byte (1) << 8;
+            e.words[1] = status >> 4 == 0x8 ? scaleUp (byte (2), 7, 16) << 16 : 0u;
+            break;
+
+        case 0x9:
+            e.words[0] |= byte (1) << 8;
+            e.words[1] = scaleUp (byte (2), 7, 16) << 16;
+            break;
+
+        case 0xa:
+        case 0xb:
+            e.words[0] |= byte (1) << 8;
+            e.words[1] = scaleUp (byte (2), 7, 32);
+            break;
+
+        case 0xc:
+            e.words[1] = byte (1) << 24;
+            break;
+
+        case 0xd:
+            e.words[1] = scaleUp (byte (1), 7, 32);
+            break;
+
+        case 0xe:
+        default:
+            e.words[1] = scaleUp (byte (1) | (byte (2) << 7), 14, 32);
+            break;
+    }
+
+    return 1;
+}
+
+int UmpConverter::toUmp (const MidiMessage* messages, int numMessages, UmpEvent* dest, int maxEvents, int& numConverted) const noexcept
+{
+    int written = 0;
+    numConverted = 0;
+
+    for (; numConverted < numMessages; ++numConverted)
+    {
+        auto& m = messages[numConverted];
+        auto* data = m.getRawData();
+        auto size = m.getRawDataSize();
+
+        if (getNumPackets (data, size) > maxEvents - written)
+            break;
+
+        written += toUmp (data, size, m.getTimeStamp(), dest + written, maxEvents - written);
+    }
+
+    return written;
+}
+
+//==============================================================================
+int UmpConverter::toBytestream (const UmpEvent* events, int numEvents, MidiMessage* dest, int maxMessages, int& numConsumed)
+{
+    int written = 0;
+    numConsumed = 0;
+
+    for (; numConsumed < numEvents && maxMessages - written >= maxMessagesPerPacket; ++numConsumed)
+    {
+        auto& e = events[numConsumed];
+        auto status = e.getStatus();
+        auto* out = dest + written;
+        int count = 0;
+
+        switch (e.getMessageType())
+        {
+            case UmpEvent::system:
+            case UmpEvent::midi1ChannelVoice:
+            {
+                auto length = MidiMessage::getMessageLengthFromFirstByte ((uint8) status);
+                auto data1 = (int) ((e.words[0] >> 8) & 0x7f), data2 = (int) (e.words[0] & 0x7f);
+
+                out[0] = length == 1 ? MidiMessage (status)
+                       : length == 2 ? MidiMessage (status, data1)
+                                     : MidiMessage (status, data1, data2);
+                count = 1;
+                break;
+            }
+
+            case UmpEvent::sysEx7:
+                count = sysExToBytestream (e, out);
+                break;
+
+            case UmpEvent::midi2ChannelVoice:
+                count = midi2ToBytestream (e, out);
+                break;
+
+            default:
+                break;
+        }
+
+        for (int i = 0; i < count; ++i)
+            out[i].setTimeStamp (e.timeStamp);
+
+        written += count;
+    }
+
+    return written;
+}
+
+int UmpConverter::midi2ToBytestream (const UmpEvent& e, MidiMessage* dest) const noexcept
+{
+    auto type = (e.words[0] >> 20) & 0xf;
+    auto channel = (int) ((e.words[0] >> 16) & 0xf);
+    auto index = (int) ((e.words[0] >> 8) & 0x7f);
+    auto value = e.words[1];
+
+    switch (type)
+    {
+        case 0x8:
+            dest[0] = MidiMessage (0x80 | channel, index, (int) scaleDown (value >> 16, 16, 7));
+            return 1;
+
+        case 0x9:
+            // velocity 0 would read as a note-off
+            dest[0] = MidiMessage (0x90 | channel, index, jmax (1, (int) scaleDown (value >> 16, 16, 7)));
+            return 1;
+
+        case 0xa:
+        case 0xb:
+            dest[0] = MidiMessage ((int) (type << 4) | channel, index, (int) scaleDown (value, 32, 7));
+            return 1;
+
+        case 0xc:
+        {
+            int count = 0;
+
+            if ((e.words[0] & 1) != 0)
+            {
+                dest[count++] = MidiMessage (0xb0 | channel, 0, (int) ((value >> 8) & 0x7f));
+                dest[count++] = MidiMessage (0xb0 | channel, 32, (int) (value & 0x7f));
+            }
+
+            dest[count++] = MidiMessage (0xc0 | channel, (int) ((value >> 24) & 0x7f));
+            return count;
+        }
+
+        case 0xd:
+            dest[0] = MidiMessage (0xd0 | channel, (int) scaleDown (value, 32, 7));
+            return 1;
+
+        case 0xe:
+        {
+            auto bend = (int) scaleDown (value, 32, 14);
+            dest[0] = MidiMessage (0xe0 | channel, bend & 0x7f, bend >> 7);
+            return 1;
+        }
+
+        case registeredController:
+        case assignableController:
+        {
+            auto registered = type == registeredController;
+            auto data = (int) scaleDown (value, 32, 14);
+
+            dest[0] = MidiMessage (0xb0 | channel, registered ? 101 : 99, index);
+            dest[1] = MidiMessage (0xb0 | channel, registered ? 100 : 98, (int) (e.words[0] & 0x7f));
+            dest[2] = MidiMessage (0xb0 | channel, 6, data >> 7);
+            dest[3] = MidiMessage (0xb0 | channel, 38, data & 0x7f);
+            return 4;
+        }
+
+        default:
+            return 0;
+    }
+}
+
+int UmpConverter::sysExToBytestream (const UmpEvent& e, MidiMessage* dest)
+{
+    auto& data = sysExData[e.getGroup()];
+    auto sysExStatus = (int) ((e.words[0] >> 20) & 0xf);
+    auto count = jmin (6, (int) ((e.words[0] >> 16) & 0xf));
+
+    if (sysExStatus == completeSysEx || sysExStatus == startSysEx)
+        data.clearQuick();
+
+    const uint8 bytes[] = { (uint8) (e.words[0] >> 8), (uint8) e.words[0],
+                            (uint8) (e.words[1] >> 24), (uint8) (e.words[1] >> 16),
+                            (uint8) (e.words[1] >> 8), (uint8) e.words[1] };
+
+    data.addArray (bytes, count);
+
+    if (sysExStatus != completeSysEx && sysExStatus != endSysEx)
+        return 0;
+
+    dest[0] = MidiMessage::createSysExMessage (data.getRawDataPointer(), data.size());
+    data.clearQuick();
+    return 1;
+}
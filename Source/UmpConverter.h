@@ -0,0 +1,136 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+
+//==============================================================================
+/**
+    One Universal MIDI Packet with its time, at a fixed 16 bytes.
+
+    32-bit packets only use the first word. Arrays of these can be scanned
+    and filtered without parsing variable-length bytes first, which is the
+    point of keeping captured and generated events in this form.
+*/
+struct UmpEvent
+{
+    enum MessageType
+    {
+        utility = 0x0,
+        system = 0x1,
+        midi1ChannelVoice = 0x2,
+        sysEx7 = 0x3,
+        midi2ChannelVoice = 0x4
+    };
+
+    uint32 words[2];
+    double timeStamp;
+
+    int getMessageType() const noexcept     { return (int) (words[0] >> 28); }
+    int getGroup() const noexcept           { return (int) ((words[0] >> 24) & 0xf); }
+    int getStatus() const noexcept          { return (int) ((words[0] >> 16) & 0xff); }
+
+    /** 1 or 2; the 128-bit types don't fit in an event and are never produced. */
+    int getNumWords() const noexcept        { return getMessageType() == sysEx7 || getMessageType() == midi2ChannelVoice ? 2 : 1; }
+
+    String toHexString() const;
+};
+
+//==============================================================================
+/**
+    Translates between MIDI 1.0 bytestream messages and Universal MIDI Packets.
+
+    Going to UMP, channel voice messages become either MIDI 1.0 packets (type
+    2, the same bytes in a word) or MIDI 2.0 packets (type 4), as chosen.
+    MIDI 2.0 values are scaled up with the spec's min-centre-max rule, so
+    velocity is 16-bit and controllers, pressure and bend are 32-bit, and
+    scaling back down gives the original value. A note-on with velocity 0
+    becomes a note-off. System messages become type 1 packets. SysEx is split
+    into 7-bit data packets, six bytes each.
+
+    Going back, MIDI 2.0 values are scaled down. A program change with a
+    bank becomes the bank select pair and then the program change. Registered
+    and assignable controllers become RPN or NRPN sequences. SysEx is
+    gathered across packets for each group. Packets with no MIDI 1.0 form,
+    such as per-note controllers and utility messages, are skipped.
+
+    RPN and NRPN sequences going up are sent as the plain controllers they
+    are made of, and are not folded into registered controllers.
+
+    Conversion to UMP keeps no state and never allocates. Conversion back
+    only allocates for SysEx, as MidiMessage does.
+*/
+class UmpConverter
+{
+public:
+    enum Protocol
+    {
+        midi1Protocol = 0,
+        midi2Protocol
+    };
+
+    /** The most messages one packet can turn back into. */
+    enum { maxMessagesPerPacket = 4 };
+
+    //==============================================================================
+    explicit UmpConverter (Protocol protocol = midi2Protocol, int group = 0);
+
+    Protocol getProtocol() const noexcept   { return protocol; }
+
+    /** Writes the packets for one complete bytestream message and returns how
+        many. Returns 0 if dest doesn't have room for all of them, or if the
+        message has no UMP form.
+    */
+    int toUmp (const uint8* data, int size, double timeStamp, UmpEvent* dest, int maxEvents) const noexcept;
+
+    /** Converts as many whole messages as fit and returns the number of
+        packets written; numConverted says how many messages that was.
+    */
+    int toUmp (const MidiMessage* messages, int numMessages, UmpEvent* dest, int maxEvents, int& numConverted) const noexcept;
+
+    /** Converts as many packets as there is room for and returns the number of
+        messages written; numConsumed says how many packets that was.
+    */
+    int toBytestream (const UmpEvent* events, int numEvents, MidiMessage* dest, int maxMessages, int& numConsumed);
+
+    /** Forgets any SysEx gathered so far. */
+    void reset();
+
+    static uint32 scaleUp (uint32 value, int sourceBits, int destBits) noexcept;
+    static uint32 scaleDown (uint32 value, int sourceBits, int destBits) noexcept;
+
+private:
+    //==============================================================================
+    int midi2ToBytestream (const UmpEvent& event, MidiMessage* dest) const noexcept;
+    int sysExToBytestream (const UmpEvent& event, MidiMessage* dest);
+
+    Protocol protocol;
+    uint32 groupBits;
+    Array<uint8> sysExData[16];
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (UmpConverter)
+};
@@ -0,0 +1,403 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#include "UmpMonitor.h"
+
+namespace
+{
+    const double benchmarkMs = 1000.0;
+
+    /** A seeded mix that looks like a busy controller: mostly notes and
+        controllers, some bend, pressure and clock, and the odd SysEx.
+    */
+    Array<MidiMessage> createCorpus (int size)
+    {
+        Random random (0x554d50);
+        Array<MidiMessage> corpus;
+        corpus.ensureStorageAllocated (size);
+
+        while (corpus.size() < size)
+        {
+            auto channel = 1 + random.nextInt (16);
+            auto kind = random.nextInt (100);
+            auto time = corpus.size() * 0.001;
+
+            if (kind < 35)
+            {
+                auto note = random.nextInt (128);
+                corpus.add (MidiMessage (MidiMessage::noteOn (channel, note, (uint8) (1 + random.nextInt (127))), time));
+                corpus.add (MidiMessage (MidiMessage::noteOff (channel, note, (uint8) random.nextInt (128)), time));
+            }
+            else if (kind < 65)  corpus.add (MidiMessage (MidiMessage::controllerEvent (channel, random.nextInt (120), random.nextInt (128)), time));
+            else if (kind < 75)  corpus.add (MidiMessage (MidiMessage::pitchWheel (channel, random.nextInt (16384)), time));
+            else if (kind < 83)  corpus.add (MidiMessage (MidiMessage::channelPressureChange (channel, random.nextInt (128)), time));
+            else if (kind < 88)  corpus.add (MidiMessage (MidiMessage::aftertouchChange (channel, random.nextInt (128), random.nextInt (128)), time));
+            else if (kind < 92)  corpus.add (MidiMessage (MidiMessage::programChange (channel, random.nextInt (128)), time));
+            else if (kind < 98)  corpus.add (MidiMessage (MidiMessage::midiClock(), time));
+            else
+            {
+                HeapBlock<uint8> data ((size_t) 256);
+                auto length = 4 + random.nextInt (252);
+
+                for (int i = 0; i < length; ++i)
+                    data[i] = (uint8) random.nextInt (128);
+
+                corpus.add (MidiMessage (MidiMessage::createSysExMessage (data, length), time));
+            }
+        }
+
+        corpus.removeRange (size, corpus.size() - size);
+        return corpus;
+    }
+
+    bool isSameMessage (const MidiMessage& a, const MidiMessage& b)
+    {
+        return a.getRawDataSize() == b.getRawDataSize()
+                && std::memcmp (a.getRawData(), b.getRawData(), (size_t) a.getRawDataSize()) == 0;
+    }
+}
+
+//==============================================================================
+UmpMonitor::UmpMonitor (MidiTestPorts& p)
+    : Thread ("UMP benchmark"), ports (p),
+      scratch ((size_t) scratchSize), captured ((size_t) fifoSize)
+{
+}
+
+UmpMonitor::~UmpMonitor()
+{
+    stopCapture();
+    stopBenchmark();
+}
+
+//==============================================================================
+bool UmpMonitor::startCapture (MidiDeviceListEntry::Ptr newInput, UmpConverter::Protocol protocol)
+{
+    stopCapture();
+
+    if (newInput == nullptr || ! newInput->isInputOpen())
+        return false;
+
+    input = newInput;
+    captureConverter.reset (new UmpConverter (protocol));
+    fifo.reset();
+    messagesCaptured = 0;
+    packetsCaptured = 0;
+    notConverted = 0;
+    overflowed = 0;
+
+    inputDevice = input.get();
+    ports.addListener (this);
+    return true;
+}
+
+void UmpMonitor::stopCapture()
+{
+    ports.removeListener (this);
+    inputDevice = nullptr;
+}
+
+void UmpMonitor::midiReceived (MidiDeviceListEntry* source, const MidiMessage& message)
+{
+    // This is called on the MIDI thread
+    if (source != inputDevice.load())
+        return;
+
+    auto count = captureConverter->toUmp (message.getRawData(), message.getRawDataSize(),
+                                          message.getTimeStamp(), scratch, scratchSize);
+    ++messagesCaptured;
+
+    if (count == 0)
+    {
+        ++notConverted;
+        return;
+    }
+
+    int start1, size1, start2, size2;
+    fifo.prepareToWrite (count, start1, size1, start2, size2);
+
+    if (size1 + size2 < count)
+    {
+        ++overflowed;
+        return;
+    }
+
+    std::copy (scratch.get(), scratch.get() + size1, captured.get() + start1);
+    std::copy (scratch.get() + size1, scratch.get() + count, captured.get() + start2);
+    fifo.finishedWrite (count);
+    packetsCaptured += count;
+}
+
+int UmpMonitor::readCaptured (UmpEvent* dest, int maxEvents)
+{
+    int start1, size1, start2, size2;
+    fifo.prepareToRead (maxEvents, start1, size1, start2, size2);
+
+    std::copy (captured.get() + start1, captured.get() + start1 + size1, dest);
+    std::copy (captured.get() + start2, captured.get() + start2 + size2, dest + size1);
+    fifo.finishedRead (size1 + size2);
+    return size1 + size2;
+}
+
+//==============================================================================
+void UmpMonitor::startBenchmark()
+{
+    stopBenchmark();
+
+    {
+        const ScopedLock sl (resultsLock);
+        benchmarkReport = "Benchmark running...\n";
+    }
+
+    startThread (5);
+}
+
+void UmpMonitor::stopBenchmark()
+{
+    stopThread (4000);
+}
+
+void UmpMonitor::run()
+{
+    auto corpus = createCorpus (corpusSize);
+    auto* messages = corpus.getRawDataPointer();
+
+    UmpConverter midi1 (UmpConverter::midi1Protocol), midi2 (UmpConverter::midi2Protocol);
+
+    // more than enough: one packet per six bytes, and one over
+    int maxPackets = 0, numConverted;
+
+    for (auto& m : corpus)
+        maxPackets += m.getRawDataSize() / 6 + 1;
+
+    HeapBlock<UmpEvent> packets ((size_t) maxPackets);
+    std::vector<MidiMessage> back ((size_t) corpusSize + UmpConverter::maxMessagesPerPacket);
+
+    auto toUmp = [&] (UmpConverter& converter)
+    {
+        int written = 0;
+
+        for (int i = 0; i < corpusSize; i += batchSize)
+            written += converter.toUmp (messages + i, jmin ((int) batchSize, corpusSize - i),
+                                        packets + written, maxPackets - written, numConverted);
+
+        return written;
+    };
+
+    auto toBytestream = [&] (UmpConverter& converter, int numPackets)
+    {
+        int written = 0;
+
+        for (int i = 0, consumed = 1; i < numPackets && consumed > 0; i += consumed)
+            written += converter.toBytestream (packets + i, jmin ((int) batchSize, numPackets - i),
+                                               back.data() + written, (int) back.size() - written, consumed);
+
+        return written;
+    };
+
+    // packets per second, converting the whole corpus over and over
+    auto measure = [this] (std::function<int()> pass)
+    {
+        int64 total = 0;
+        auto start = Time::getMillisecondCounterHiRes();
+        double elapsed;
+
+        do
+        {
+            total += pass();
+            elapsed = Time::getMillisecondCounterHiRes() - start;
+        }
+        while (elapsed < benchmarkMs && ! threadShouldExit());
+
+        return (double) total * 1000.0 / elapsed;
+    };
+
+    auto describe = [] (const String& name, double packetsPerSecond)
+    {
+        return name.paddedRight (' ', 36) + String (packetsPerSecond * 1.0e-6, 2).paddedLeft (' ', 7) + " M packets/s, "
+                 + String (1.0e9 / packetsPerSecond, 1) + " ns per packet\n";
+    };
+
+    auto checkRoundTrip = [&] (UmpConverter& converter, const String& name)
+    {
+        auto numBack = toBytestream (converter, toUmp (converter));
+        int changed = 0;
+        String first;
+
+        for (int i = 0; i < jmin (numBack, (int) corpusSize); ++i)
+            if (! isSameMessage (corpus.getReference (i), back[(size_t) i]) && changed++ == 0)
+                first = corpus.getReference (i).getDescription() + " came back as " + back[(size_t) i].getDescription();
+
+        String s ("Round trip through " + name + ": ");
+
+        if (numBack != corpusSize)
+            s << numBack << " messages came back from " << (int) corpusSize << "; ";
+
+        return s + (changed == 0 ? String ("every message unchanged") : String (changed) + " changed, first: " + first) + "\n";
+    };
+
+    String s;
+    s << "Benchmark over " << (int) corpusSize << " messages (" << toUmp (midi2) << " packets), in batches of "
+      << (int) batchSize << "\n\n";
+
+    s << describe ("MIDI 1.0 -> UMP, MIDI 1.0 packets:", measure ([&] { return toUmp (midi1); }));
+    s << describe ("MIDI 1.0 -> UMP, MIDI 2.0 packets:", measure ([&] { return toUmp (midi2); }));
+
+    auto numPackets = toUmp (midi2);
+    s << describe ("UMP, MIDI 2.0 packets -> MIDI 1.0:", measure ([&] { toBytestream (midi2, numPackets); return numPackets; }));
+
+    s << "\n" << checkRoundTrip (midi1, "MIDI 1.0 packets") << checkRoundTrip (midi2, "MIDI 2.0 packets");
+
+    if (threadShouldExit())
+        s = "Benchmark stopped.\n";
+
+    const ScopedLock sl (resultsLock);
+    benchmarkReport = s;
+}
+
+//==============================================================================
+String UmpMonitor::getReport() const
+{
+    String s;
+
+    if (input != nullptr)
+        s << "UMP capture on " << input->deviceInfo.name << (isCapturing() ? "" : " (stopped)") << ": "
+          << messagesCaptured.load() << " messages, " << packetsCaptured.load() << " packets, "
+          << notConverted.load() << " not converted, " << overflowed.load() << " dropped with the display behind\n";
+
+    const ScopedLock sl (resultsLock);
+
+    if (benchmarkReport.isNotEmpty())
+        s << (s.isNotEmpty() ? "\n" : "") << benchmarkReport;
+
+    return s;
+}
+
+//==============================================================================
+UmpPanel::UmpPanel (UmpMonitor& m, MidiTestPorts& ports)
+    : ToolPanel (ports), monitor (m), incoming ((size_t) 1024)
+{
+    protocolLabel.setText ("Packets:", dontSendNotification);
+    addAndMakeVisible (protocolLabel);
+    protocolBox.addItem ("MIDI 1.0 (type 2)", 1 + (int) UmpConverter::midi1Protocol);
+    protocolBox.addItem ("MIDI 2.0 (type 4)", 1 + (int) UmpConverter::midi2Protocol);
+    protocolBox.setSelectedId (1 + (int) UmpConverter::midi2Protocol, dontSendNotification);
+    addAndMakeVisible (protocolBox);
+
+    captureButton.onClick = [this] { captureOrStop(); };
+    addAndMakeVisible (captureButton);
+
+    benchmarkButton.onClick = [this]
+    {
+        if (monitor.isBenchmarking())
+            monitor.stopBenchmark();
+        else
+            monitor.startBenchmark();
+
+        refresh();
+    };
+    addAndMakeVisible (benchmarkButton);
+}
+
+void UmpPanel::captureOrStop()
+{
+    if (monitor.isCapturing())
+    {
+        monitor.stopCapture();
+    }
+    else
+    {
+        lines.clear();
+        displayConverter.reset();
+
+        if (! monitor.startCapture (getInput(), (UmpConverter::Protocol) (protocolBox.getSelectedId() - 1)))
+            showMessage (openFirst ("an input"));
+    }
+
+    refresh();
+}
+
+void UmpPanel::showCaptured()
+{
+    MidiMessage back[UmpConverter::maxMessagesPerPacket];
+
+    for (;;)
+    {
+        auto count = monitor.readCaptured (incoming, 1024);
+
+        for (int i = 0; i < count; ++i)
+        {
+            // one packet at a time, so each line shows what that packet turned back into
+            int consumed;
+            auto numBack = displayConverter.toBytestream (incoming + i, 1, back, UmpConverter::maxMessagesPerPacket, consumed);
+
+            String line;
+            line << String (incoming[i].timeStamp, 3).paddedLeft (' ', 10) << "  " << incoming[i].toHexString().paddedRight (' ', 19);
+
+            for (int j = 0; j < numBack; ++j)
+                line << (j == 0 ? "  " : "; ") << back[j].getDescription();
+
+            lines.add (line);
+        }
+
+        if (count < 1024)
+            break;
+    }
+
+    if (lines.size() > maxLines)
+        lines.removeRange (0, lines.size() - maxLines);
+}
+
+void UmpPanel::update()
+{
+    captureButton.setButtonText (monitor.isCapturing() ? "Stop capture" : "Capture input");
+    benchmarkButton.setButtonText (monitor.isBenchmarking() ? "Stop benchmark" : "Benchmark");
+    showCaptured();
+}
+
+String UmpPanel::getReportText()
+{
+    auto text = monitor.getReport();
+
+    if (! lines.isEmpty())
+        text << "\n" << lines.joinIntoString ("\n") << "\n";
+
+    return text;
+}
+
+void UmpPanel::resized()
+{
+    auto area = layOutPair();
+
+    auto row = area.removeFromTop (rowHeight);
+    protocolLabel.setBounds (row.removeFromLeft (60));
+    protocolBox.setBounds (row.removeFromLeft (160).reduced (2));
+    benchmarkButton.setBounds (row.removeFromRight (120).reduced (2));
+    captureButton.setBounds (row.removeFromRight (120).reduced (2));
+
+    area.removeFromTop (10);
+    report.setBounds (area);
+}
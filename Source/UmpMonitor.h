@@ -0,0 +1,128 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+#include "MidiTestPorts.h"
+#include "UmpConverter.h"
+#include "ToolPanel.h"
+
+//==============================================================================
+/**
+    Shows an input's traffic as Universal MIDI Packets, and benchmarks the
+    translation both ways.
+
+    Capture converts each message on the MIDI thread, into a scratch block
+    allocated up front, and hands the packets over through a FIFO of fixed
+    size events. The panel turns the packets back into MIDI 1.0 for display,
+    so a translation that doesn't round-trip shows up side by side. A SysEx
+    too long for the scratch block is counted and not converted.
+
+    The benchmark runs on its own thread. It converts a seeded mix of
+    typical traffic in batches, much like capture and playback would, for a
+    fixed time in each direction. It reports packets per second and checks
+    that every message survives the round trip unchanged.
+*/
+class UmpMonitor  : private Thread,
+                    private MidiTestPorts::Listener
+{
+public:
+    explicit UmpMonitor (MidiTestPorts& ports);
+    ~UmpMonitor();
+
+    /** Returns false if the input isn't open. */
+    bool startCapture (MidiDeviceListEntry::Ptr input, UmpConverter::Protocol protocol);
+    void stopCapture();
+    bool isCapturing() const noexcept       { return inputDevice.load() != nullptr; }
+
+    /** Takes packets captured since the last call; returns how many. */
+    int readCaptured (UmpEvent* dest, int maxEvents);
+
+    void startBenchmark();
+    void stopBenchmark();
+    bool isBenchmarking() const             { return isThreadRunning(); }
+
+    String getReport() const;
+
+private:
+    //==============================================================================
+    enum
+    {
+        fifoSize = 1 << 14,
+        scratchSize = 2048,                 // enough for a 12 kB SysEx
+        corpusSize = 1 << 16,
+        batchSize = 256
+    };
+
+    void run() override;
+    void midiReceived (MidiDeviceListEntry* source, const MidiMessage& message) override;
+
+    MidiTestPorts& ports;
+    MidiDeviceListEntry::Ptr input;
+    std::atomic<MidiDeviceListEntry*> inputDevice { nullptr };
+    std::unique_ptr<UmpConverter> captureConverter;
+
+    // MIDI thread only
+    HeapBlock<UmpEvent> scratch;
+
+    AbstractFifo fifo { fifoSize };
+    HeapBlock<UmpEvent> captured;
+    std::atomic<int64> messagesCaptured { 0 }, packetsCaptured { 0 }, notConverted { 0 }, overflowed { 0 };
+
+    CriticalSection resultsLock;
+    String benchmarkReport;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (UmpMonitor)
+};
+
+//==============================================================================
+class UmpPanel  : public ToolPanel
+{
+public:
+    UmpPanel (UmpMonitor& monitor, MidiTestPorts& ports);
+
+    void resized() override;
+
+private:
+    enum { maxLines = 200 };
+
+    String getReportText() override;
+    void update() override;
+    void captureOrStop();
+    void showCaptured();
+
+    UmpMonitor& monitor;
+    Label protocolLabel;
+    ComboBox protocolBox;
+    TextButton captureButton { "Capture input" }, benchmarkButton { "Benchmark" };
+
+    UmpConverter displayConverter;
+    HeapBlock<UmpEvent> incoming;
+    StringArray lines;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (UmpPanel)
+};
@@ -0,0 +1,247 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#include "VirtualClock.h"
+
+//==============================================================================
+double SystemClock::now() const
+{
+    return Time::getMillisecondCounterHiRes();
+}
+
+void SystemClock::waitUntil (Thread& thread, double time)
+{
+    if (time < 0.0)
+    {
+        thread.wait (-1);
+        return;
+    }
+
+    auto remaining = time - now();
+
+    // rounded up, so the wait never ends early and a caller waiting in a
+    // loop sleeps through the last fraction of a millisecond too
+    if (remaining > 0.0)
+        thread.wait ((int) std::ceil (remaining));
+}
+
+void SystemClock::waitPrecisely (Thread& thread, double time)
+{
+    // sleep until shortly before; wake() can cut a sleep short, so go round again
+    for (;;)
+    {
+        if (thread.threadShouldExit())
+            return;
+
+        auto remaining = time - now();
+
+        if (remaining <= spinMs)
+            break;
+
+        thread.wait (jmax (1, (int) (remaining - spinMs)));
+    }
+
+    // then spin for what's left, which is never more than spinMs
+    while (now() < time)
+        Thread::yield();
+}
+
+void SystemClock::wake (Thread& thread)
+{
+    thread.notify();
+}
+
+//==============================================================================
+SimulatedClock::SimulatedClock (double startTime)
+    : currentTime (startTime)
+{
+}
+
+SimulatedClock::~SimulatedClock()
+{
+    // every thread should have finished with the clock before it goes
+    jassert (participants.isEmpty());
+}
+
+SimulatedClock::Participant* SimulatedClock::find (Thread& thread) const noexcept
+{
+    for (auto* p : participants)
+        if (p->thread == &thread)
+            return p;
+
+    return nullptr;
+}
+
+void SimulatedClock::threadStarting (Thread& thread)
+{
+    const ScopedLock sl (lock);
+
+    if (find (thread) == nullptr)
+    {
+        auto* p = participants.add (new Participant());
+        p->thread = &thread;
+        startWaiting (*p, currentTime.load());
+    }
+}
+
+void SimulatedClock::threadStarted (Thread& thread)
+{
+    threadStarting (thread);
+
+    Participant* p;
+
+    {
+        const ScopedLock sl (lock);
+        p = find (thread);
+    }
+
+    awaitTurn (*p);
+}
+
+void SimulatedClock::threadFinished (Thread& thread)
+{
+    const ScopedLock sl (lock);
+
+    if (auto* p = find (thread))
+    {
+        if (running == p)
+            running = nullptr;
+
+        participants.removeObject (p);
+
+        if (running == nullptr)
+            passTurn();
+    }
+}
+
+void SimulatedClock::waitUntil (Thread& thread, double time)
+{
+    Participant* p;
+
+    {
+        const ScopedLock sl (lock);
+        p = find (thread);
+
+        // a thread that waits on simulated time has to take part in it; see ScopedThread
+        if (p == nullptr)
+        {
+            jassertfalse;
+            return;
+        }
+
+        startWaiting (*p, time < 0.0 ? std::numeric_limits<double>::infinity()
+                                     : jmax (time, currentTime.load()));
+    }
+
+    awaitTurn (*p);
+}
+
+void SimulatedClock::waitPrecisely (Thread& thread, double time)
+{
+    waitUntil (thread, time);
+}
+
+void SimulatedClock::wake (Thread& thread)
+{
+    const ScopedLock sl (lock);
+
+    if (auto* p = find (thread))
+    {
+        if (! p->waiting)
+        {
+            p->woken = true;
+        }
+        else if (p->wakeAt > currentTime.load())
+        {
+            p->wakeAt = currentTime.load();
+            p->order = nextOrder++;
+        }
+
+        if (running == nullptr)
+            passTurn();
+    }
+    else
+    {
+        thread.notify();
+    }
+}
+
+//==============================================================================
+void SimulatedClock::startWaiting (Participant& p, double time) noexcept
+{
+    // called with the lock held
+    p.wakeAt = p.woken ? currentTime.load() : time;
+    p.woken = false;
+    p.order = nextOrder++;
+    p.waiting = true;
+    p.hasTurn = false;
+
+    if (running == &p)
+        running = nullptr;
+
+    if (running == nullptr)
+        passTurn();
+}
+
+void SimulatedClock::passTurn() noexcept
+{
+    // called with the lock held, when nobody is running
+    Participant* next = nullptr;
+
+    for (auto* p : participants)
+        if (p->waiting && (next == nullptr || p->wakeAt < next->wakeAt
+                            || (p->wakeAt == next->wakeAt && p->order < next->order)))
+            next = p;
+
+    // with everyone waiting to be woken, time stands still until someone outside wakes them
+    if (next == nullptr || next->wakeAt == std::numeric_limits<double>::infinity())
+        return;
+
+    currentTime = jmax (currentTime.load(), next->wakeAt);
+    next->waiting = false;
+    next->hasTurn = true;
+    running = next;
+    next->turn.signal();
+}
+
+void SimulatedClock::awaitTurn (Participant& p)
+{
+    while (! p.hasTurn.load())
+    {
+        if (p.thread->threadShouldExit())
+        {
+            // it runs on its own from here, and the others carry on without it
+            const ScopedLock sl (lock);
+
+            if (! p.hasTurn.load())
+                p.waiting = false;
+
+            return;
+        }
+
+        p.turn.wait (exitPollMs);
+    }
+}
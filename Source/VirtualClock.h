@@ -0,0 +1,171 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+
+//==============================================================================
+/**
+    Where the app reads the time and waits for it.
+
+    Times are in milliseconds, on the same scale as
+    Time::getMillisecondCounterHiRes(). A thread that waits through a clock
+    does so with waitUntil(), and another thread hurries it along with
+    wake(), in place of Thread::wait() and Thread::notify().
+
+    Threads that wait on the clock also announce themselves with a
+    ScopedThread for the length of their run(). The system clock ignores
+    this. A SimulatedClock needs it to know when every thread is waiting, so
+    it can skip to the next thing due.
+*/
+class VirtualClock
+{
+public:
+    virtual ~VirtualClock() = default;
+
+    virtual double now() const = 0;
+
+    /** Returns once the time is reached, the thread is woken, or it is asked
+        to exit. A negative time waits to be woken.
+    */
+    virtual void waitUntil (Thread& thread, double time) = 0;
+
+    /** Like waitUntil(), but lands as close to the time as the clock can, and
+        isn't cut short by wake(). It still returns early if the thread is
+        asked to exit.
+    */
+    virtual void waitPrecisely (Thread& thread, double time) = 0;
+
+    virtual void wake (Thread& thread) = 0;
+
+    /** Optional, from whoever starts the thread, before it starts. A simulated
+        clock then holds time still until the thread arrives, instead of
+        letting it join at whatever time has been reached by then.
+    */
+    virtual void threadStarting (Thread&)   {}
+    virtual void threadStarted (Thread&)    {}
+    virtual void threadFinished (Thread&)   {}
+
+    virtual bool isSimulated() const        { return false; }
+
+    void waitFor (Thread& thread, double milliseconds)  { waitUntil (thread, now() + milliseconds); }
+
+    //==============================================================================
+    struct ScopedThread
+    {
+        ScopedThread (VirtualClock& c, Thread& t)  : clock (c), thread (t)   { clock.threadStarted (thread); }
+        ~ScopedThread()                                                        { clock.threadFinished (thread); }
+
+        VirtualClock& clock;
+        Thread& thread;
+
+        JUCE_DECLARE_NON_COPYABLE (ScopedThread)
+    };
+};
+
+//==============================================================================
+/** Wall-clock time. Plain waits sleep, rounded up to the next millisecond.
+    Precise waits sleep until a millisecond before, then spin for the rest.
+*/
+class SystemClock  : public VirtualClock
+{
+public:
+    SystemClock() = default;
+
+    double now() const override;
+    void waitUntil (Thread& thread, double time) override;
+    void waitPrecisely (Thread& thread, double time) override;
+    void wake (Thread& thread) override;
+
+private:
+    enum { spinMs = 1 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SystemClock)
+};
+
+//==============================================================================
+/**
+    Time that only moves when every thread taking part is waiting.
+
+    Only one thread taking part runs at a time. When it waits, the thread
+    with the earliest wake-up goes next, and the time jumps straight to that
+    wake-up; threads due together go in the order they started waiting. An
+    hour of pacing, polling and settling therefore costs only the CPU time
+    of the work in between, and the same starting point always plays out
+    the same way.
+
+    That only holds while everything that acts takes part: the scheduler,
+    the test engines and simulated devices. Real devices and the message
+    thread can still read the time and wake threads, but they do it in real
+    time, so a run that involves them can't be reproduced.
+*/
+class SimulatedClock  : public VirtualClock
+{
+public:
+    explicit SimulatedClock (double startTime = 0.0);
+    ~SimulatedClock();
+
+    double now() const override             { return currentTime.load(); }
+    void waitUntil (Thread& thread, double time) override;
+    void waitPrecisely (Thread& thread, double time) override;
+    void wake (Thread& thread) override;
+
+    void threadStarting (Thread& thread) override;
+    void threadStarted (Thread& thread) override;
+    void threadFinished (Thread& thread) override;
+
+    bool isSimulated() const override       { return true; }
+
+private:
+    //==============================================================================
+    struct Participant
+    {
+        Thread* thread = nullptr;
+        double wakeAt = 0.0;
+        int64 order = 0;
+        bool waiting = false;
+        bool woken = false;             // woken while it was running, so its next wait ends at once
+        std::atomic<bool> hasTurn { false };
+        WaitableEvent turn;
+    };
+
+    // only to notice a thread being asked to stop while it waits for its turn
+    enum { exitPollMs = 10 };
+
+    Participant* find (Thread& thread) const noexcept;
+    void startWaiting (Participant& participant, double time) noexcept;
+    void passTurn() noexcept;
+    void awaitTurn (Participant& participant);
+
+    CriticalSection lock;
+    OwnedArray<Participant> participants;
+    Participant* running = nullptr;
+    int64 nextOrder = 0;
+    std::atomic<double> currentTime;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SimulatedClock)
+};
@@ -0,0 +1,154 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#include "JuceHeader.h"
+#include "../Source/CaptureFile.h"
+
+//==============================================================================
+class CaptureFileTests  : public UnitTest
+{
+public:
+    CaptureFileTests()  : UnitTest ("Capture files") {}
+
+    void initialise() override
+    {
+        folder = File::getSpecialLocation (File::tempDirectory).getNonexistentChildFile ("BAMidiTester tests", {}, false);
+    }
+
+    void shutdown() override
+    {
+        folder.deleteRecursively();
+    }
+
+    void runTest() override
+    {
+        // enough to fill more than one of the smallest segments
+        const int numEvents = 150000;
+        uint8 sysExData[64];
+
+        for (int i = 0; i < 64; ++i)
+            sysExData[i] = (uint8) i;
+
+        Array<MidiMessage> corpus;
+        corpus.add (MidiMessage::noteOn (1, 60, (uint8) 100));
+        corpus.add (MidiMessage::controllerEvent (2, 7, 90));
+        corpus.add (MidiMessage::midiClock());
+        corpus.add (MidiMessage::pitchWheel (16, 1234));
+        corpus.add (MidiMessage::createSysExMessage (sysExData, 64));
+
+        auto messageFor = [&corpus] (int i) -> const MidiMessage&  { return corpus.getReference (i % corpus.size()); };
+        auto timeFor = [] (int i)                                   { return i * 0.25; };
+
+        CaptureWriter::Settings settings;
+        settings.folder = folder;
+        settings.segmentBytes = CaptureWriter::minSegmentBytes;
+
+        beginTest ("Writing");
+        {
+            Array<CaptureWriter::Source> sources;
+            sources.add ({ "in", false });
+            sources.add ({ "out", true });
+
+            CaptureWriter writer;
+            expect (writer.open (settings, sources, 0.0), writer.getError());
+
+            for (int i = 0; i < numEvents; ++i)
+            {
+                auto& m = messageFor (i);
+                writer.write (i & 1, m.getRawData(), m.getRawDataSize(), timeFor (i));
+            }
+
+            // an event a little earlier than the one before
+            auto& late = messageFor (0);
+            expect (writer.write (0, late.getRawData(), late.getRawDataSize(), timeFor (numEvents - 1) - 0.1));
+
+            writer.close();
+            expectEquals (writer.getError(), String());
+            expectEquals (writer.getNumEvents(), (int64) numEvents + 1);
+            expect (writer.getNumSegments() > 1);
+        }
+
+        beginTest ("Reading back every segment");
+        {
+            int i = 0, numSegments = 0;
+
+            for (auto file = CaptureWriter::getSegmentFile (folder, settings.name, 1); file.existsAsFile();)
+            {
+                CaptureReader reader (file);
+                expect (reader.isValid(), reader.getError());
+                expect (reader.hasIndex());
+                expectEquals (reader.getSegmentNumber(), ++numSegments);
+                expectEquals (reader.getSources().size(), 2);
+
+                CaptureReader::Event e;
+
+                while (reader.readNext (e))
+                {
+                    auto number = jmin (i, numEvents - 1);
+                    auto& m = i < numEvents ? messageFor (i) : messageFor (0);
+                    auto time = i < numEvents ? timeFor (i) : timeFor (numEvents - 1) - 0.1;
+
+                    if (e.source != (i < numEvents ? (number & 1) : 0) || std::abs (e.time - time) > 0.0005
+                         || e.size != m.getRawDataSize() || std::memcmp (e.data, m.getRawData(), (size_t) e.size) != 0)
+                    {
+                        expect (false, "event " + String (i) + " came back changed");
+                        return;
+                    }
+
+                    ++i;
+                }
+
+                expectEquals (reader.getError(), String());
+                file = reader.getNextSegment();
+            }
+
+            expectEquals (i, numEvents + 1);
+        }
+
+        beginTest ("Seeking");
+        {
+            CaptureReader reader (CaptureWriter::getSegmentFile (folder, settings.name, 1));
+            expect (reader.getNumSyncPoints() > 1);
+
+            const int target = 20000;
+            reader.seek (timeFor (target));
+
+            CaptureReader::Event e;
+            expect (reader.readNext (e));
+            expect (e.time <= timeFor (target));
+
+            while (e.time < timeFor (target) && reader.readNext (e)) {}
+
+            expectWithinAbsoluteError (e.time, timeFor (target), 0.0005);
+            expectEquals (reader.getEventNumber(), (int64) target + 1);
+        }
+    }
+
+private:
+    File folder;
+};
+
+static CaptureFileTests captureFileTests;
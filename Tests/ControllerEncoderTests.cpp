@@ -0,0 +1,115 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#include "JuceHeader.h"
+#include "../Source/ControllerEncoder.h"
+
+namespace
+{
+    bool isController (const MidiMessage& m, int controller, int value)
+    {
+        return m.isController() && m.getControllerNumber() == controller && m.getControllerValue() == value;
+    }
+}
+
+//==============================================================================
+class ControllerEncoderTests  : public UnitTest
+{
+public:
+    ControllerEncoderTests()  : UnitTest ("ControllerEncoder") {}
+
+    void runTest() override
+    {
+        ControllerEncoder::ChannelState state;
+        MidiMessage messages[ControllerEncoder::maxMessages];
+
+        beginTest ("7-bit CC");
+        {
+            ControllerEncoder encoder;
+            encoder.setController (7);
+
+            expectEquals (encoder.encode (1, 64, state, messages), 1);
+            expect (isController (messages[0], 7, 64));
+            expectEquals (encoder.encode (1, 64, state, messages), 0);
+            expectEquals (encoder.encode (1, 200, state, messages), 1);
+            expect (isController (messages[0], 7, 127));
+
+            // a different channel hasn't heard anything yet
+            expectEquals (encoder.encode (2, 127, state, messages), 1);
+            expectEquals (messages[0].getChannel(), 2);
+        }
+
+        beginTest ("14-bit CC");
+        {
+            ControllerEncoder encoder;
+            encoder.setMode (ControllerEncoder::fourteenBitCC);
+            encoder.setController (1);
+
+            // a new MSB clears the LSB, so a zero LSB isn't sent
+            expectEquals (encoder.encode (1, 0x2000, state, messages), 1);
+            expect (isController (messages[0], 1, 0x40));
+
+            expectEquals (encoder.encode (1, 0x2001, state, messages), 1);
+            expect (isController (messages[0], 33, 1));
+
+            expectEquals (encoder.encode (1, 0x2081, state, messages), 2);
+            expect (isController (messages[0], 1, 0x41));
+            expect (isController (messages[1], 33, 1));
+
+            expectEquals (encoder.encode (1, 0x2081, state, messages), 0);
+        }
+
+        beginTest ("NRPN");
+        {
+            ControllerEncoder a, b;
+
+            for (auto* encoder : { &a, &b })
+                encoder->setMode (ControllerEncoder::nrpn);
+
+            a.setController (0x123);
+            b.setController (0x124);
+
+            expectEquals (a.encode (1, 5, state, messages), 4);
+            expect (isController (messages[0], 99, 0x02));
+            expect (isController (messages[1], 98, 0x23));
+            expect (isController (messages[2], 6, 0));
+            expect (isController (messages[3], 38, 5));
+
+            expectEquals (a.encode (1, 6, state, messages), 1);
+            expect (isController (messages[0], 38, 6));
+
+            // another parameter on the same channel means selecting this one again
+            expectEquals (b.encode (1, 1, state, messages), 4);
+            expectEquals (a.encode (1, 6, state, messages), 4);
+            expect (isController (messages[0], 99, 0x02));
+            expect (isController (messages[1], 98, 0x23));
+            expect (isController (messages[2], 6, 0));
+            expect (isController (messages[3], 38, 6));
+        }
+    }
+};
+
+static ControllerEncoderTests controllerEncoderTests;
@@ -0,0 +1,259 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#include "JuceHeader.h"
+#include "../Source/MidiFileWriter.h"
+#include "../Source/MidiFileReader.h"
+
+namespace
+{
+    /** Walks every track of a file as a strict reader would, where running
+        status only follows a channel message. Returns what was wrong, if
+        anything.
+    */
+    String findStrictProblem (const MemoryBlock& file)
+    {
+        auto* bytes = static_cast<const uint8*> (file.getData());
+        auto size = file.getSize();
+        size_t position = 8 + 6;
+
+        auto readLength = [&] (size_t& p) -> uint32
+        {
+            uint32 value = 0;
+
+            for (int i = 0; i < 4 && p < size; ++i)
+            {
+                auto byte = bytes[p++];
+                value = (value << 7) | (byte & 0x7f);
+
+                if ((byte & 0x80) == 0)
+                    break;
+            }
+
+            return value;
+        };
+
+        while (position + 8 <= size)
+        {
+            if (std::memcmp (bytes + position, "MTrk", 4) != 0)
+                return "a chunk that isn't a track";
+
+            auto length = ((uint32) bytes[position + 4] << 24) | ((uint32) bytes[position + 5] << 16)
+                        | ((uint32) bytes[position + 6] << 8) | (uint32) bytes[position + 7];
+            position += 8;
+            auto end = position + length;
+
+            if (end > size)
+                return "a track longer than the file";
+
+            uint8 runningStatus = 0;
+
+            while (position < end)
+            {
+                readLength (position);
+                auto byte = bytes[position];
+
+                if (byte == 0xff)
+                {
+                    position += 2;
+                    position += readLength (position);
+                    runningStatus = 0;
+                }
+                else if (byte == 0xf0 || byte == 0xf7)
+                {
+                    ++position;
+                    position += readLength (position);
+                    runningStatus = 0;
+                }
+                else
+                {
+                    if (byte >= 0x80)
+                        runningStatus = bytes[position++];
+                    else if (runningStatus == 0)
+                        return "data with no status at byte " + String ((int64) position);
+
+                    position += (size_t) MidiMessage::getMessageLengthFromFirstByte (runningStatus) - 1;
+                }
+            }
+
+            if (position != end)
+                return "an event running past the end of its track";
+        }
+
+        return position == size ? String() : String ("bytes after the last track");
+    }
+
+    struct WrittenEvent
+    {
+        int track;
+        int64 tick;
+        MidiMessage message;
+    };
+}
+
+//==============================================================================
+class MidiFileTests  : public UnitTest
+{
+public:
+    MidiFileTests()  : UnitTest ("Standard MIDI File writer and reader") {}
+
+    void initialise() override
+    {
+        folder = File::getSpecialLocation (File::tempDirectory).getNonexistentChildFile ("BAMidiTester tests", {}, false);
+        folder.createDirectory();
+    }
+
+    void shutdown() override
+    {
+        folder.deleteRecursively();
+    }
+
+    void runTest() override
+    {
+        beginTest ("Round trip");
+        {
+            // 125 bpm at 960 ticks a quarter note is exactly two ticks a millisecond
+            MidiFileWriter::Settings settings;
+            settings.file = folder.getChildFile ("round trip.mid");
+            settings.beatsPerMinute = 125.0;
+            settings.ticksPerQuarterNote = 960;
+
+            const uint8 sysExData[] = { 0x41, 0x10, 0x42, 0x12, 0x40, 0x00, 0x7f, 0x00, 0x41 };
+            const int64 longGap = 2 * (int64) 0x0fffffff + 5;
+
+            Array<WrittenEvent> events;
+            events.add ({ 0, 0,  MidiMessage::noteOn (1, 60, (uint8) 100) });
+            events.add ({ 1, 5,  MidiMessage::noteOn (2, 64, (uint8) 1) });
+            events.add ({ 0, 10, MidiMessage::noteOn (1, 62, (uint8) 100) });               // running status
+            events.add ({ 0, 20, MidiMessage::controllerEvent (1, 7, 90) });
+            events.add ({ 1, 25, MidiMessage::noteOff (2, 64) });
+            events.add ({ 0, 30, MidiMessage::createSysExMessage (sysExData, (int) sizeof (sysExData)) });
+            events.add ({ 0, 40, MidiMessage::controllerEvent (1, 7, 91) });                // status again after the SysEx
+            events.add ({ 0, 50, MidiMessage::midiClock() });                               // an F7 escape
+            events.add ({ 0, 60, MidiMessage::songPositionPointer (0x1234) });
+            events.add ({ 0, 70, MidiMessage::controllerEvent (1, 7, 92) });
+            events.add ({ 0, 70 + longGap, MidiMessage::controllerEvent (1, 7, 93) });      // after the bridging text events
+
+            MidiFileWriter writer;
+            expect (writer.open (settings, { "In: a", "Out: b" }, 0.0), writer.getError());
+
+            for (auto& e : events)
+                expect (writer.write (e.track, e.message.getRawData(), e.message.getRawDataSize(), (double) e.tick / 2.0));
+
+            writer.close();
+            expectEquals (writer.getError(), String());
+
+            MemoryBlock file;
+            expect (settings.file.loadFileAsData (file));
+            expectEquals (findStrictProblem (file), String());
+
+            // the reader gives them in time order, tracks after the tempo track
+            std::stable_sort (events.begin(), events.end(), [] (const WrittenEvent& a, const WrittenEvent& b)
+            {
+                return a.tick != b.tick ? a.tick < b.tick : a.track < b.track;
+            });
+
+            MidiFileReader reader;
+            expect (reader.open (settings.file), reader.getError());
+            expectEquals (reader.getNumTracks(), 3);
+
+            MidiFileReader::Event event;
+            int numRead = 0;
+
+            while (reader.readNext (event))
+            {
+                if (numRead < events.size())
+                {
+                    auto& expected = events.getReference (numRead);
+                    auto& m = expected.message;
+
+                    expectEquals (event.track, expected.track + 1);
+                    expectEquals (event.tick, expected.tick);
+                    expectWithinAbsoluteError (event.time, (double) expected.tick / 2.0, 0.001);
+                    expect (event.message.getRawDataSize() == m.getRawDataSize()
+                             && std::memcmp (event.message.getRawData(), m.getRawData(), (size_t) m.getRawDataSize()) == 0,
+                            "event " + String (numRead) + " came back changed");
+                }
+
+                ++numRead;
+            }
+
+            expectEquals (reader.getError(), String());
+            expectEquals (numRead, events.size());
+            expectWithinAbsoluteError (reader.getTempo(), 125.0, 0.001);
+
+            beginTest ("Cut short");
+
+            auto cut = folder.getChildFile ("cut.mid");
+            expect (cut.replaceWithData (file.getData(), file.getSize() - 6));
+            expect (reader.open (cut), reader.getError());
+
+            while (reader.readNext (event)) {}
+
+            expect (reader.getError().isNotEmpty());
+        }
+
+        beginTest ("Tempo change");
+        {
+            // 96 ticks a quarter note, at 120 bpm and then 60
+            const uint8 bytes[] = { 'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 0, 0, 1, 0, 96,
+                                    'M', 'T', 'r', 'k', 0, 0, 0, 26,
+                                    0x00, 0x90, 0x3c, 0x40,
+                                    0x60, 0x90, 0x3e, 0x40,
+                                    0x00, 0xff, 0x51, 0x03, 0x0f, 0x42, 0x40,
+                                    0x60, 0x80, 0x3c, 0x00,
+                                    0x00, 0x3e, 0x00,
+                                    0x00, 0xff, 0x2f, 0x00 };
+
+            auto file = folder.getChildFile ("tempo.mid");
+            expect (file.replaceWithData (bytes, sizeof (bytes)));
+
+            MidiFileReader reader;
+            expect (reader.open (file), reader.getError());
+
+            const double expectedTimes[] = { 0.0, 500.0, 1500.0, 1500.0 };
+            MidiFileReader::Event event;
+            int numRead = 0;
+
+            while (reader.readNext (event))
+            {
+                if (numRead < 4)
+                    expectWithinAbsoluteError (event.time, expectedTimes[numRead], 0.001);
+
+                ++numRead;
+            }
+
+            expectEquals (reader.getError(), String());
+            expectEquals (numRead, 4);
+            expectWithinAbsoluteError (reader.getTempo(), 60.0, 0.001);
+        }
+    }
+
+private:
+    File folder;
+};
+
+static MidiFileTests midiFileTests;
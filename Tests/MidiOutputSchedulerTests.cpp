@@ -0,0 +1,254 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#include "JuceHeader.h"
+#include "../Source/MidiOutputScheduler.h"
+#include "../Source/RealtimeThreads.h"
+
+// The real-time settings live with their panel, which needs the GUI
+// modules. The tests leave the scheduler's thread as it is.
+void RealtimeThreads::applyToCurrentThread (Role) {}
+
+namespace
+{
+    /** Keeps what reaches it, with the simulated time it went out. */
+    struct RecordingDestination  : public MidiOutputScheduler::Destination
+    {
+        RecordingDestination (VirtualClock& c, bool raw)  : clock (c), takesRawBytes (raw) {}
+
+        void transmit (const MidiMessage& message) override
+        {
+            messages.add (message);
+            times.add (clock.now());
+        }
+
+        bool takesSysExSegments() const override    { return takesRawBytes; }
+
+        VirtualClock& clock;
+        bool takesRawBytes;
+        Array<MidiMessage> messages;
+        Array<double> times;
+    };
+
+    struct RecordingMonitor  : public MidiOutputScheduler::Monitor
+    {
+        void messageSent (MidiOutputScheduler::Destination&, const MidiMessage& message, double) override
+        {
+            messages.add (message);
+        }
+
+        Array<MidiMessage> messages;
+    };
+
+    struct Driver  : public Thread
+    {
+        Driver (SimulatedClock& c, std::function<void (Thread&)> f)
+            : Thread ("Scheduler test"), clock (c), body (f) {}
+
+        void run() override
+        {
+            const VirtualClock::ScopedThread participant (clock, *this);
+            body (*this);
+            clock.waitUntil (*this, clock.now() + 10000.0);
+        }
+
+        SimulatedClock& clock;
+        std::function<void (Thread&)> body;
+    };
+
+    /** Runs a test step on a thread taking part in the simulated clock. It
+        holds the clock while it queues, so the scheduler only sees the whole
+        batch, then waits long enough for the scheduler to send it all.
+    */
+    void drive (SimulatedClock& clock, std::function<void (Thread&)> body)
+    {
+        Driver driver (clock, body);
+        clock.threadStarting (driver);
+        driver.startThread();
+        driver.waitForThreadToExit (-1);
+    }
+
+    MidiMessage createSysEx (int numDataBytes)
+    {
+        HeapBlock<uint8> data ((size_t) numDataBytes);
+
+        for (int i = 0; i < numDataBytes; ++i)
+            data[i] = (uint8) (i & 0x7f);
+
+        return MidiMessage::createSysExMessage (data, numDataBytes);
+    }
+
+    bool isSameMessage (const MidiMessage& a, const MidiMessage& b)
+    {
+        return a.getRawDataSize() == b.getRawDataSize()
+                && std::memcmp (a.getRawData(), b.getRawData(), (size_t) a.getRawDataSize()) == 0;
+    }
+}
+
+//==============================================================================
+class MidiOutputSchedulerTests  : public UnitTest
+{
+public:
+    MidiOutputSchedulerTests()  : UnitTest ("MidiOutputScheduler") {}
+
+    void runTest() override
+    {
+        // DIN rate: 0.32 ms a byte, with 3 bytes of burst
+        const double msPerByte = 1000.0 / 3125.0;
+        auto sysEx = createSysEx (98);
+
+        beginTest ("Priority order and pacing");
+        {
+            SimulatedClock clock;
+            RecordingDestination output (clock, false);
+            MidiOutputScheduler scheduler (clock);
+            scheduler.addDestination (output, {});
+
+            drive (clock, [&] (Thread&)
+            {
+                scheduler.send (output, sysEx);
+                scheduler.send (output, MidiMessage::noteOn (1, 60, (uint8) 100));
+                scheduler.send (output, MidiMessage::noteOn (1, 64, (uint8) 100));
+                scheduler.send (output, MidiMessage::midiClock());
+            });
+
+            expectEquals (output.messages.size(), 4);
+
+            if (output.messages.size() == 4)
+            {
+                // realtime first, then voice, and the SysEx goes out whole
+                expect (output.messages[0].isMidiClock());
+                expectEquals (output.messages[1].getNoteNumber(), 60);
+                expectEquals (output.messages[2].getNoteNumber(), 64);
+                expect (isSameMessage (output.messages[3], sysEx));
+
+                // each waits until the link is within its burst of being free
+                expectWithinAbsoluteError (output.times[0], 0.0, 1.0e-9);
+                expectWithinAbsoluteError (output.times[1], 0.0, 1.0e-9);
+                expectWithinAbsoluteError (output.times[2], 1.0 * msPerByte, 1.0e-9);
+                expectWithinAbsoluteError (output.times[3], 4.0 * msPerByte, 1.0e-9);
+            }
+
+            auto stats = scheduler.getStats (output);
+            expectEquals (stats.messagesSent, (int64) 4);
+            expectEquals (stats.bytesSent, (int64) (7 + sysEx.getRawDataSize()));
+        }
+
+        beginTest ("A SysEx is never split for a MidiOutput");
+        {
+            SimulatedClock clock;
+            RecordingDestination output (clock, false);
+            MidiOutputScheduler scheduler (clock);
+
+            MidiOutputScheduler::LinkSettings settings;
+            settings.sysExSegmentSize = 32;
+            scheduler.addDestination (output, settings);
+
+            drive (clock, [&] (Thread&)  { scheduler.send (output, sysEx); });
+
+            expectEquals (output.messages.size(), 1);
+            expect (output.messages.size() == 1 && isSameMessage (output.messages[0], sysEx));
+        }
+
+        beginTest ("Realtime goes between the segments of a raw-byte link");
+        {
+            SimulatedClock clock;
+            RecordingDestination output (clock, true);
+            RecordingMonitor monitor;
+            MidiOutputScheduler scheduler (clock);
+            scheduler.addMonitor (&monitor);
+
+            MidiOutputScheduler::LinkSettings settings;
+            settings.sysExSegmentSize = 32;
+            scheduler.addDestination (output, settings);
+
+            drive (clock, [&] (Thread& driver)
+            {
+                scheduler.send (output, sysEx);
+
+                // while the first segment is still going out
+                clock.waitUntil (driver, 5.0);
+                scheduler.send (output, MidiMessage::midiClock());
+            });
+
+            scheduler.removeMonitor (&monitor);
+
+            // 100 bytes go as 32 + 32 + 32 + 4, with the clock after the first
+            expectEquals (output.messages.size(), 5);
+            MemoryBlock joined;
+
+            for (int i = 0; i < output.messages.size(); ++i)
+            {
+                auto& m = output.messages.getReference (i);
+
+                if (i == 1)
+                {
+                    // as soon as the first segment is within the burst of done
+                    expect (m.isMidiClock());
+                    expectWithinAbsoluteError (output.times[i], 29.0 * msPerByte, 1.0e-9);
+                }
+                else
+                {
+                    joined.append (m.getRawData(), (size_t) m.getRawDataSize());
+                }
+            }
+
+            expect (joined == MemoryBlock (sysEx.getRawData(), (size_t) sysEx.getRawDataSize()));
+
+            // monitors see the SysEx once, whole
+            expectEquals (monitor.messages.size(), 2);
+            expect (monitor.messages.size() == 2 && monitor.messages[0].isMidiClock()
+                     && isSameMessage (monitor.messages[1], sysEx));
+        }
+
+        beginTest ("A full queue refuses messages");
+        {
+            SimulatedClock clock;
+            RecordingDestination output (clock, false);
+            MidiOutputScheduler scheduler (clock);
+
+            MidiOutputScheduler::LinkSettings settings;
+            settings.queueCapacity = 4;
+            scheduler.addDestination (output, settings);
+
+            int numQueued = 0;
+
+            drive (clock, [&] (Thread&)
+            {
+                for (int i = 0; i < 10; ++i)
+                    if (scheduler.send (output, MidiMessage::controllerEvent (1, 7, i)))
+                        ++numQueued;
+            });
+
+            // a fifo of 4 holds 3
+            expectEquals (numQueued, 3);
+            expectEquals (output.messages.size(), 3);
+            expectEquals (scheduler.getStats (output).messagesDropped, (int64) 7);
+        }
+    }
+};
+
+static MidiOutputSchedulerTests midiOutputSchedulerTests;
@@ -0,0 +1,149 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#include "JuceHeader.h"
+#include "../Source/MpeZone.h"
+
+namespace
+{
+    bool isController (const MidiMessage& m, int channel, int controller, int value)
+    {
+        return m.isController() && m.getChannel() == channel
+                && m.getControllerNumber() == controller && m.getControllerValue() == value;
+    }
+}
+
+//==============================================================================
+class MpeZoneTests  : public UnitTest
+{
+public:
+    MpeZoneTests()  : UnitTest ("MpeZone") {}
+
+    void runTest() override
+    {
+        beginTest ("Member channels");
+        {
+            MpeZone zone;
+            expect (! zone.isActive());
+
+            int stolen;
+            expectEquals (zone.startNote (60, stolen), -1);
+
+            zone.setLayout (MpeZone::lowerZone, 15);
+            expectEquals (zone.getMasterChannel(), 1);
+            expect (! zone.isMemberChannel (1));
+            expect (zone.isMemberChannel (2) && zone.isMemberChannel (16));
+
+            zone.setLayout (MpeZone::upperZone, 3);
+            expectEquals (zone.getMasterChannel(), 16);
+            expect (zone.isMemberChannel (15) && zone.isMemberChannel (13));
+            expect (! zone.isMemberChannel (12) && ! zone.isMemberChannel (16));
+        }
+
+        beginTest ("Allocation");
+        {
+            MpeZone zone;
+            zone.setLayout (MpeZone::lowerZone, 15);
+            int stolen;
+
+            expectEquals (zone.startNote (60, stolen), 2);
+            expectEquals (stolen, -1);
+            expectEquals (zone.startNote (62, stolen), 3);
+            expectEquals (zone.getChannelForNote (60), 2);
+
+            // a released channel is the last to be used again
+            expectEquals (zone.stopNote (60), 2);
+            expectEquals (zone.getChannelForNote (60), -1);
+            expectEquals (zone.startNote (64, stolen), 4);
+
+            expectEquals (zone.stopNote (60), -1);
+
+            // the same key again takes over its own channel
+            expectEquals (zone.startNote (62, stolen), 3);
+            expectEquals (stolen, 62);
+        }
+
+        beginTest ("Stealing");
+        {
+            MpeZone zone;
+            zone.setLayout (MpeZone::upperZone, 3);
+            int stolen;
+
+            expectEquals (zone.startNote (60, stolen), 15);
+            expectEquals (zone.startNote (61, stolen), 14);
+            expectEquals (zone.startNote (62, stolen), 13);
+
+            // every member is busy, so the oldest note makes way
+            expectEquals (zone.startNote (63, stolen), 15);
+            expectEquals (stolen, 60);
+            expectEquals (zone.getChannelForNote (60), -1);
+            expectEquals (zone.getChannelForNote (63), 15);
+
+            zone.releaseAll();
+            expectEquals (zone.getChannelForNote (61), -1);
+        }
+
+        beginTest ("Configuration messages");
+        {
+            MpeZone zone;
+            zone.setLayout (MpeZone::lowerZone, 15);
+            auto messages = zone.getConfigurationMessages (24);
+
+            // RPN 6 on the master, then RPN 0 on the first member
+            expectEquals (messages.size(), 10);
+
+            if (messages.size() == 10)
+            {
+                expect (isController (messages[0], 1, 101, 0));
+                expect (isController (messages[1], 1, 100, 6));
+                expect (isController (messages[2], 1, 6, 15));
+                expect (isController (messages[3], 1, 101, 127));
+                expect (isController (messages[4], 1, 100, 127));
+                expect (isController (messages[5], 2, 101, 0));
+                expect (isController (messages[6], 2, 100, 0));
+                expect (isController (messages[7], 2, 6, 24));
+            }
+
+            // a zone that is off sends the message that turns it off
+            zone.setLayout (MpeZone::upperZone, 0);
+            messages = zone.getConfigurationMessages();
+            expectEquals (messages.size(), 5);
+            expect (messages.size() == 5 && isController (messages[2], 16, 6, 0));
+        }
+
+        beginTest ("Expression");
+        {
+            MidiMessage messages[MpeZone::maxExpressionMessages];
+            expectEquals (MpeZone::createExpression (5, 20000, 64, 200, messages), 3);
+
+            expect (messages[0].isPitchWheel() && messages[0].getPitchWheelValue() == 16383 && messages[0].getChannel() == 5);
+            expect (messages[1].isChannelPressure() && messages[1].getChannelPressureValue() == 64);
+            expect (isController (messages[2], 5, MpeZone::timbreController, 127));
+        }
+    }
+};
+
+static MpeZoneTests mpeZoneTests;
@@ -0,0 +1,114 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#include "JuceHeader.h"
+#include "../Source/SysExCodec.h"
+
+//==============================================================================
+class SysExCodecTests  : public UnitTest
+{
+public:
+    SysExCodecTests()  : UnitTest ("SysExCodec") {}
+
+    void runTest() override
+    {
+        beginTest ("Sizes");
+        {
+            expectEquals (SysExCodec::getPackedSize (0), 0);
+            expectEquals (SysExCodec::getPackedSize (7), 8);
+            expectEquals (SysExCodec::getPackedSize (8), 10);
+            expectEquals (SysExCodec::getUnpackedSize (10), 8);
+            expectEquals (SysExCodec::getUnpackedSize (16), 14);
+        }
+
+        beginTest ("Packing");
+        {
+            const uint8 source[] = { 0x80, 0x01, 0xff };
+            const uint8 expected[] = { 0x05, 0x00, 0x01, 0x7f };
+            uint8 packed[4], unpacked[3];
+
+            SysExCodec::pack (source, 3, packed);
+            expect (std::memcmp (packed, expected, sizeof (expected)) == 0);
+            expect (SysExCodec::unpack (packed, 4, unpacked));
+            expect (std::memcmp (unpacked, source, sizeof (source)) == 0);
+
+            packed[2] = 0x81;
+            expect (! SysExCodec::unpack (packed, 4, unpacked));
+        }
+
+        beginTest ("Checksums");
+        {
+            const uint8 roland[] = { 0x40, 0x00, 0x7f, 0x00 };
+            const uint8 data[] = { 0x01, 0x02, 0x84 };
+
+            expectEquals ((int) SysExCodec::getRolandChecksum (roland, 4), 0x41);
+            expectEquals ((int) SysExCodec::getXorChecksum (data, 3), 0x07);
+        }
+
+        beginTest ("Every kernel matches the scalar code");
+        {
+            auto original = SysExCodec::getKernel();
+            Random random (0x5953);
+            HeapBlock<uint8> source (1024), reference (2048), packed (2048), unpacked (1024);
+
+            for (int k = 0; k < SysExCodec::numKernels; ++k)
+            {
+                auto kernel = (SysExCodec::Kernel) k;
+
+                if (! SysExCodec::isKernelAvailable (kernel))
+                    continue;
+
+                for (int numBytes = 0; numBytes <= 1024; numBytes += 1 + numBytes / 8)
+                {
+                    for (int i = 0; i < numBytes; ++i)
+                        source[i] = (uint8) random.nextInt (256);
+
+                    auto numPacked = SysExCodec::getPackedSize (numBytes);
+
+                    SysExCodec::setKernel (SysExCodec::scalarKernel);
+                    SysExCodec::pack (source, numBytes, reference);
+                    auto rolandChecksum = (int) SysExCodec::getRolandChecksum (reference, numPacked);
+                    auto xorChecksum = (int) SysExCodec::getXorChecksum (reference, numPacked);
+
+                    SysExCodec::setKernel (kernel);
+                    SysExCodec::pack (source, numBytes, packed);
+
+                    expect (std::memcmp (packed, reference, (size_t) numPacked) == 0,
+                            SysExCodec::getKernelName (kernel) + " packs " + String (numBytes) + " bytes differently");
+                    expect (SysExCodec::unpack (packed, numPacked, unpacked));
+                    expect (std::memcmp (unpacked, source, (size_t) numBytes) == 0,
+                            SysExCodec::getKernelName (kernel) + " unpacks " + String (numBytes) + " bytes differently");
+                    expectEquals ((int) SysExCodec::getRolandChecksum (packed, numPacked), rolandChecksum);
+                    expectEquals ((int) SysExCodec::getXorChecksum (packed, numPacked), xorChecksum);
+                }
+            }
+
+            SysExCodec::setKernel (original);
+        }
+    }
+};
+
+static SysExCodecTests sysExCodecTests;
@@ -0,0 +1,127 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#include "JuceHeader.h"
+#include "../Source/UmpConverter.h"
+
+namespace
+{
+    bool isSameMessage (const MidiMessage& a, const MidiMessage& b)
+    {
+        return a.getRawDataSize() == b.getRawDataSize()
+                && std::memcmp (a.getRawData(), b.getRawData(), (size_t) a.getRawDataSize()) == 0;
+    }
+}
+
+//==============================================================================
+class UmpConverterTests  : public UnitTest
+{
+public:
+    UmpConverterTests()  : UnitTest ("UmpConverter") {}
+
+    void runTest() override
+    {
+        beginTest ("Scaling");
+        {
+            expectEquals (UmpConverter::scaleUp (0, 7, 16), (uint32) 0);
+            expectEquals (UmpConverter::scaleUp (64, 7, 16), (uint32) 0x8000);
+            expectEquals (UmpConverter::scaleUp (127, 7, 16), (uint32) 0xffff);
+            expectEquals (UmpConverter::scaleUp (127, 7, 32), (uint32) 0xffffffff);
+            expectEquals (UmpConverter::scaleUp (8192, 14, 32), (uint32) 0x80000000);
+
+            for (uint32 v = 0; v < 128; ++v)
+            {
+                expectEquals (UmpConverter::scaleDown (UmpConverter::scaleUp (v, 7, 16), 16, 7), v);
+                expectEquals (UmpConverter::scaleDown (UmpConverter::scaleUp (v, 7, 32), 32, 7), v);
+            }
+
+            for (uint32 v = 0; v < 16384; ++v)
+                expectEquals (UmpConverter::scaleDown (UmpConverter::scaleUp (v, 14, 32), 32, 14), v);
+        }
+
+        uint8 sysExData[20];
+
+        for (int i = 0; i < 20; ++i)
+            sysExData[i] = (uint8) (i * 5);
+
+        Array<MidiMessage> messages;
+        messages.add (MidiMessage::noteOn (3, 60, (uint8) 100));
+        messages.add (MidiMessage::noteOff (3, 60, (uint8) 64));
+        messages.add (MidiMessage::aftertouchChange (3, 60, 30));
+        messages.add (MidiMessage::controllerEvent (3, 7, 0));
+        messages.add (MidiMessage::controllerEvent (3, 7, 64));
+        messages.add (MidiMessage::controllerEvent (3, 7, 127));
+        messages.add (MidiMessage::programChange (3, 5));
+        messages.add (MidiMessage::channelPressureChange (3, 50));
+        messages.add (MidiMessage::pitchWheel (3, 0));
+        messages.add (MidiMessage::pitchWheel (3, 1234));
+        messages.add (MidiMessage::pitchWheel (3, 8192));
+        messages.add (MidiMessage::pitchWheel (3, 16383));
+        messages.add (MidiMessage::midiClock());
+        messages.add (MidiMessage::songPositionPointer (0x1234));
+        messages.add (MidiMessage::createSysExMessage (sysExData, 6));
+        messages.add (MidiMessage::createSysExMessage (sysExData, 20));
+
+        for (auto protocol : { UmpConverter::midi1Protocol, UmpConverter::midi2Protocol })
+        {
+            beginTest (protocol == UmpConverter::midi1Protocol ? "MIDI 1.0 round trip" : "MIDI 2.0 round trip");
+
+            UmpConverter converter (protocol, 2);
+            UmpEvent packets[64];
+            MidiMessage back[64];
+            int numConverted = 0, numConsumed = 0;
+
+            auto numPackets = converter.toUmp (messages.getRawDataPointer(), messages.size(), packets, 64, numConverted);
+            expectEquals (numConverted, messages.size());
+
+            for (int i = 0; i < numPackets; ++i)
+                expectEquals (packets[i].getGroup(), 2);
+
+            auto numBack = converter.toBytestream (packets, numPackets, back, 64, numConsumed);
+            expectEquals (numConsumed, numPackets);
+            expectEquals (numBack, messages.size());
+
+            for (int i = 0; i < jmin (numBack, messages.size()); ++i)
+                expect (isSameMessage (back[i], messages.getReference (i)),
+                        "message " + String (i) + " came back as " + String::toHexString (back[i].getRawData(), back[i].getRawDataSize()));
+        }
+
+        beginTest ("A note-on at velocity 0 is a note-off");
+        {
+            UmpConverter converter (UmpConverter::midi2Protocol);
+            const uint8 noteOn[] = { 0x92, 60, 0 };
+            UmpEvent packet;
+            MidiMessage back[UmpConverter::maxMessagesPerPacket];
+            int numConsumed = 0;
+
+            expectEquals (converter.toUmp (noteOn, 3, 0.0, &packet, 1), 1);
+            expectEquals (converter.toBytestream (&packet, 1, back, UmpConverter::maxMessagesPerPacket, numConsumed), 1);
+            expect (back[0].isNoteOff() && back[0].getNoteNumber() == 60 && back[0].getChannel() == 3);
+        }
+    }
+};
+
+static UmpConverterTests umpConverterTests;
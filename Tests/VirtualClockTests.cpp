@@ -0,0 +1,148 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library.
+   Copyright (c) 2017 - ROLI Ltd.
+
+   JUCE is an open source library subject to commercial or open-source
+   licensing.
+
+   By using JUCE, you agree to the terms of both the JUCE 5 End-User License
+   Agreement and JUCE 5 Privacy Policy (both updated and effective as of the
+   27th April 2017).
+
+   End User License Agreement: www.juce.com/juce-5-licence
+   Privacy Policy: www.juce.com/juce-5-privacy-policy
+
+   Or: You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   JUCE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#include "JuceHeader.h"
+#include "../Source/VirtualClock.h"
+
+namespace
+{
+    /** A thread taking part in the simulated clock that runs one test body. */
+    struct ClockThread  : public Thread
+    {
+        ClockThread (SimulatedClock& c, const String& name, std::function<void (ClockThread&)> f)
+            : Thread (name), clock (c), body (f) {}
+
+        void run() override
+        {
+            const VirtualClock::ScopedThread participant (clock, *this);
+            body (*this);
+        }
+
+        /** Only one thread taking part runs at a time, so the log needs no lock. */
+        void log (StringArray& events)
+        {
+            events.add (getThreadName() + "@" + String ((int) clock.now()));
+        }
+
+        SimulatedClock& clock;
+        std::function<void (ClockThread&)> body;
+    };
+
+    /** Registers every thread before any starts, so they all begin at the same time. */
+    void runAll (SimulatedClock& clock, const OwnedArray<ClockThread>& threads)
+    {
+        for (auto* t : threads)
+            clock.threadStarting (*t);
+
+        for (auto* t : threads)
+            t->startThread();
+
+        for (auto* t : threads)
+            t->waitForThreadToExit (-1);
+    }
+}
+
+//==============================================================================
+class VirtualClockTests  : public UnitTest
+{
+public:
+    VirtualClockTests()  : UnitTest ("VirtualClock") {}
+
+    void runTest() override
+    {
+        beginTest ("Threads take turns in time order");
+        {
+            SimulatedClock clock;
+            StringArray events;
+            OwnedArray<ClockThread> threads;
+
+            threads.add (new ClockThread (clock, "A", [&] (ClockThread& t)
+            {
+                clock.waitUntil (t, 10.0);
+                t.log (events);
+                clock.waitUntil (t, 30.0);
+                t.log (events);
+            }));
+
+            threads.add (new ClockThread (clock, "B", [&] (ClockThread& t)
+            {
+                clock.waitUntil (t, 20.0);
+                t.log (events);
+                clock.waitUntil (t, 30.0);
+                t.log (events);
+            }));
+
+            runAll (clock, threads);
+
+            // A and B are both due at 30; A started waiting first
+            expectEquals (events.joinIntoString (" "), String ("A@10 B@20 A@30 B@30"));
+        }
+
+        beginTest ("Wake cuts a wait short");
+        {
+            SimulatedClock clock;
+            StringArray events;
+            OwnedArray<ClockThread> threads;
+
+            threads.add (new ClockThread (clock, "A", [&] (ClockThread& t)
+            {
+                clock.waitUntil (t, 50.0);
+                clock.wake (*threads[1]);
+                clock.waitUntil (t, 100.0);
+                t.log (events);
+            }));
+
+            threads.add (new ClockThread (clock, "B", [&] (ClockThread& t)
+            {
+                clock.waitUntil (t, -1.0);
+                t.log (events);
+            }));
+
+            runAll (clock, threads);
+            expectEquals (events.joinIntoString (" "), String ("B@50 A@100"));
+        }
+
+        beginTest ("Long waits cost no real time");
+        {
+            SimulatedClock clock;
+            OwnedArray<ClockThread> threads;
+
+            threads.add (new ClockThread (clock, "Hour", [&] (ClockThread& t)
+            {
+                for (int i = 0; i < 3600; ++i)
+                    clock.waitFor (t, 1000.0);
+            }));
+
+            auto started = Time::getMillisecondCounterHiRes();
+            runAll (clock, threads);
+
+            expectEquals (clock.now(), 3600.0 * 1000.0);
+            expect (Time::getMillisecondCounterHiRes() - started < 60.0 * 1000.0);
+        }
+    }
+};
+
+static VirtualClockTests virtualClockTests;